@@ -15,6 +15,8 @@
 #include "apfPackedField.h"
 #include "apfIntegrate.h"
 #include "apfArrayData.h"
+#include "apfDenseData.h"
+#include "apfSyncPlan.h"
 #include "apfTagData.h"
 #include "apfUserData.h"
 #include <cstdio>
@@ -429,6 +431,68 @@ void accumulate(Field* f, Sharing* shr)
   accumulateFieldData(f->getData(), shr);
 }
 
+SyncPlan* createSyncPlan(Mesh* m, FieldShape* s, Sharing* shr)
+{
+  return new SyncPlan(m, s, shr);
+}
+
+void destroySyncPlan(SyncPlan* p)
+{
+  delete p;
+}
+
+void synchronize(Field* f, SyncPlan* p)
+{
+  synchronizeFieldData<double>(f->getData(), p);
+}
+
+void accumulate(Field* f, SyncPlan* p)
+{
+  accumulateFieldData(f->getData(), p);
+}
+
+SyncBatch* createSyncBatch(Field** fields, int n, Sharing* shr)
+{
+  return new SyncBatch(fields, n, shr);
+}
+
+void destroySyncBatch(SyncBatch* b)
+{
+  delete b;
+}
+
+void synchronize(SyncBatch* b)
+{
+  beginSynchronize(b);
+  endSynchronize(b);
+}
+
+void accumulate(SyncBatch* b)
+{
+  beginAccumulate(b);
+  endAccumulate(b);
+}
+
+void beginSynchronize(SyncBatch* b)
+{
+  b->begin(SyncBatch::SYNCHRONIZING);
+}
+
+void endSynchronize(SyncBatch* b)
+{
+  b->end(SyncBatch::SYNCHRONIZING);
+}
+
+void beginAccumulate(SyncBatch* b)
+{
+  b->begin(SyncBatch::ACCUMULATING);
+}
+
+void endAccumulate(SyncBatch* b)
+{
+  b->end(SyncBatch::ACCUMULATING);
+}
+
 void fail(const char* why)
 {
   fprintf(stderr,"APF FAILED: %s\n",why);
@@ -453,6 +517,27 @@ bool isFrozen(Field* f)
   return f->getData()->isFrozen();
 }
 
+void makeDense(Field* f)
+{
+  if (isDense(f)) return;
+  unfreeze(f);
+  f->getMesh()->hasFrozenFields = true;
+  makeDenseFieldData(f);
+}
+
+bool isDense(Field* f)
+{
+  return dynamic_cast<DenseData*>(f->getData()) != 0;
+}
+
+double* getDenseArray(Field* f, int type, int component)
+{
+  DenseData* d = dynamic_cast<DenseData*>(f->getData());
+  if (!d)
+    return 0;
+  return d->getArray(type, component);
+}
+
 Function::~Function()
 {
 }
@@ -475,7 +560,12 @@ void projectField(Field* to, Field* from)
 
 void axpy(double a, Field* x, Field* y)
 {
-  y->axpy(a, x);
+  DenseData* dx = dynamic_cast<DenseData*>(x->getData());
+  DenseData* dy = dynamic_cast<DenseData*>(y->getData());
+  if (dx && dy && dy->matches(dx))
+    axpyDenseData(a, dx, dy);
+  else
+    y->axpy(a, x);
 }
 
 void renameField(Field* f, const char* name)
@@ -37,6 +37,8 @@ class VectorElement;
 typedef VectorElement MeshElement;
 class FieldShape;
 struct Sharing;
+class SyncPlan;
+class SyncBatch;
 
 /** \brief Destroys an apf::Mesh.
   *
@@ -621,6 +623,62 @@ void synchronize(Field* f, Sharing* shr = 0);
   */
 void accumulate(Field* f, Sharing* shr = 0);
 
+/** \brief Build a reusable plan for synchronizing fields.
+  \details The plan records, for each peer, the entities whose
+  values apf::synchronize and apf::accumulate exchange for fields
+  of shape (s). With it, they only gather values, send one message
+  to each peer, and scatter them. Before each use, the plan is
+  rebuilt if entities were created or destroyed since it was built.
+  If (shr) is zero, the plan uses apf::getSharing.
+  This is a collective call. */
+SyncPlan* createSyncPlan(Mesh* m, FieldShape* s, Sharing* shr = 0);
+
+/** \brief Destroy a plan made by apf::createSyncPlan. */
+void destroySyncPlan(SyncPlan* p);
+
+/** \brief Synchronize field values using a plan.
+  \details the field must have the mesh and shape of the plan.
+  Copies of nodes their owner has no value for get zeros. */
+void synchronize(Field* f, SyncPlan* p);
+
+/** \brief Accumulate field values using a plan. */
+void accumulate(Field* f, SyncPlan* p);
+
+/** \brief Group fields to synchronize or accumulate together.
+  \details The fields may have different shapes, and the batch
+  keeps one apf::SyncPlan for each shape. Synchronizing the batch
+  takes one communication phase for all its fields, with all the
+  values for a peer in one message. This is a collective call. */
+SyncBatch* createSyncBatch(Field** fields, int n, Sharing* shr = 0);
+
+/** \brief Destroy a batch made by apf::createSyncBatch. */
+void destroySyncBatch(SyncBatch* b);
+
+/** \brief Synchronize all the fields of a batch. */
+void synchronize(SyncBatch* b);
+
+/** \brief Accumulate all the fields of a batch. */
+void accumulate(SyncBatch* b);
+
+/** \brief Start synchronizing the fields of a batch.
+  \details This sends the owned values, and apf::endSynchronize
+  receives them, so work that neither reads copies nor writes
+  owned values can overlap the communication. No other
+  communication phase may be started in between. */
+void beginSynchronize(SyncBatch* b);
+
+/** \brief Finish what apf::beginSynchronize started. */
+void endSynchronize(SyncBatch* b);
+
+/** \brief Start accumulating the fields of a batch.
+  \details like apf::beginSynchronize, only the values sent to the
+  owners overlap with other work. apf::endAccumulate then adds them
+  and synchronizes the sums. */
+void beginAccumulate(SyncBatch* b);
+
+/** \brief Finish what apf::beginAccumulate started. */
+void endAccumulate(SyncBatch* b);
+
 /** \brief Declare failure of code inside APF.
   \details This function prints the string as an APF
   failure to stderr and then calls abort.
@@ -635,7 +693,7 @@ void freeze(Field* f);
 /** \brief Convert a Field from array to Tag storage. */
 void unfreeze(Field* f);
 
-/** \brief Returns true iff the Field uses array storage. */
+/** \brief Returns true iff the Field uses array or dense storage. */
 bool isFrozen(Field* f);
 
 /** \brief Return the contiguous array storing this field.
@@ -645,9 +703,34 @@ bool isFrozen(Field* f);
  */
 double* getArrayData(Field* f);
 
+/** \brief Convert a Field to dense structure-of-arrays storage.
+  \details each component of the values on each entity type is
+  kept in its own aligned, contiguous array indexed by
+  apf::Mesh::getIndex, which apf::getDenseArray returns.
+  Like array storage, modifying the mesh converts the field
+  back to tag storage. The mesh must index its entities. */
+void makeDense(Field* f);
+
+/** \brief Returns true iff the Field uses dense storage. */
+bool isDense(Field* f);
+
+/** \brief Return one component array of a dense field.
+  \details node k of the entity of (type) with index i
+  is at i * nodes + k, where nodes is
+  apf::FieldShape::countNodesOn(type). The array holds
+  that many times apf::Mesh::countIndices(type) values.
+  Returns 0 if the field is not dense.
+ */
+double* getDenseArray(Field* f, int type, int component);
+
 /** \brief Initialize all nodal values with all-zero components */
 void zeroField(Field* f);
 
+/** \brief Compute the 2-norm of the values of a Field
+  \details each node counts once, on the part that owns it.
+  This is a collective call. */
+double getNorm(Field* f);
+
 /** \brief User-defined Analytic Function. */
 struct Function
 {
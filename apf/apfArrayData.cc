@@ -123,11 +123,11 @@ template void unfreezeFieldData<int>(FieldBase* field);
 template void unfreezeFieldData<double>(FieldBase* field);
 
 double* getArrayData(Field* f) {
-  if (!isFrozen(f)) {
+  FieldDataOf<double>* p = f->getData();
+  ArrayDataOf<double>* a = dynamic_cast<ArrayDataOf<double>* > (p);
+  if (!a) {
     return 0;
   } else {
-    FieldDataOf<double>* p = f->getData();
-    ArrayDataOf<double>* a = static_cast<ArrayDataOf<double>* > (p);
     return a->getDataArray();
   }
 }
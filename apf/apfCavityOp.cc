@@ -9,6 +9,7 @@
 #include "apfCavityOp.h"
 #include "apf.h"
 #include "apfMesh2.h"
+#include <algorithm>
 
 namespace apf {
 
@@ -18,6 +19,8 @@ CavityOp::CavityOp(Mesh* m, bool cm):
   canModify(cm),
   movedByDeletion(false),
   iterator(0),
+  listedDimension(-1),
+  counts(),
   sharing(0)
 {
 }
@@ -38,10 +41,12 @@ void CavityOp::applyLocallyWithModification(int d)
     if (sharing->isOwned(e))
     {
       Outcome o = setEntity(e);
+      ++counts.examined;
       if (o == OK)
       {
         movedByDeletion = false;
         apply();
+        ++counts.applied;
         if (movedByDeletion)
           continue;
       }
@@ -66,6 +71,15 @@ void CavityOp::applyLocallyWithModification(int d)
 
 void CavityOp::preDeletion(MeshEntity* e)
 {
+  if (listedDimension != -1) {
+    if (getDimension(mesh, e) != listedDimension)
+      return;
+    std::vector<ListedPosition>::iterator it = std::lower_bound(
+        positions.begin(), positions.end(), ListedPosition(e, 0));
+    if (it != positions.end() && it->first == e)
+      listed[it->second] = 0;
+    return;
+  }
   Mesh2* mesh2 = static_cast<Mesh2*>(mesh);
   if (( ! mesh2->isDone(this->iterator))&&
       (e == mesh2->deref(this->iterator)))
@@ -88,13 +102,63 @@ void CavityOp::applyLocallyWithoutModification(int d)
     if ( ! sharing->isOwned(e))
       continue;
     Outcome o = setEntity(e);
-    if (o == OK)
+    ++counts.examined;
+    if (o == OK) {
       apply();
+      ++counts.applied;
+    }
   }
   mesh->end(entities);
 }
 
+/* the same passes as the two functions above,
+   over the listed entities instead of a mesh iterator */
+void CavityOp::applyLocallyToList()
+{
+  isRequesting = ! canModify;
+  for (size_t i = 0; i < listed.size(); ++i)
+  {
+    MeshEntity* e = listed[i];
+    if (( ! e) || ( ! sharing->isOwned(e)))
+      continue;
+    Outcome o = setEntity(e);
+    ++counts.examined;
+    if (o == OK) {
+      apply();
+      ++counts.applied;
+    }
+  }
+  if (canModify)
+  {
+    isRequesting = true;
+    for (size_t i = 0; i < listed.size(); ++i)
+    {
+      MeshEntity* e = listed[i];
+      if (( ! e) || ( ! sharing->isOwned(e)))
+        continue;
+      setEntity(e);
+    }
+  }
+}
+
 void CavityOp::applyToDimension(int d)
+{
+  applyRounds(d);
+}
+
+void CavityOp::applyToEntities(int d,
+    std::vector<MeshEntity*> const& entities)
+{
+  listed = entities;
+  positions.resize(listed.size());
+  for (size_t i = 0; i < listed.size(); ++i)
+    positions[i] = ListedPosition(listed[i], i);
+  std::sort(positions.begin(), positions.end());
+  listedDimension = d;
+  applyRounds(d);
+}
+
+void CavityOp::applyRounds(int d)
 {
   /* the iteration count of this loop is hard to predict,
    * but typical cavity definitions should cause a small
@@ -106,10 +170,18 @@ void CavityOp::applyToDimension(int d)
     sharing = apf::getSharing(mesh);
     /* apply the operator to all local cavities
        and request missing cavity elements */
-    if (this->canModify)
+    if (listedDimension != -1)
+      this->applyLocallyToList();
+    else if (this->canModify)
       this->applyLocallyWithModification(d);
     else
       this->applyLocallyWithoutModification(d);
+    if (listedDimension != -1) {
+      listedDimension = -1;
+      listed.clear();
+      positions.clear();
+    }
+    ++counts.rounds;
     /* this is the exit of the loop:
        tryToPull will return false when no requests
        were made by any process, which should imply
@@ -225,6 +297,11 @@ bool CavityOp::tryToPull()
   Migration* plan = new Migration(mesh);
   for (std::size_t i=0; i < pulls.size(); ++i)
     markElements(plan,pulls[i].e,pulls[i].to);
+  ++counts.pulls;
+  int self = PCU_Comm_Self();
+  for (int i=0; i < plan->count(); ++i)
+    if (plan->sending(plan->get(i)) != self)
+      ++counts.migrated;
   mesh->migrate(plan); //plan deleted here
   return true;
 }
@@ -13,6 +13,7 @@
 
 #include "apfMesh.h"
 #include <vector>
+#include <utility>
 #include <cstring>
 
 namespace apf {
@@ -65,6 +66,21 @@ namespace apf {
    iterator invalidation.
 */
 
+/** \brief counts of the work done by one CavityOp on this process */
+struct CavityOpCounts
+{
+  /** \brief entities CavityOp::setEntity was asked to decide on */
+  size_t examined;
+  /** \brief calls to CavityOp::apply */
+  size_t applied;
+  /** \brief local passes of CavityOp::applyToDimension */
+  size_t rounds;
+  /** \brief passes that ended by migrating requested cavities */
+  size_t pulls;
+  /** \brief elements this process sent away in those migrations */
+  size_t migrated;
+};
+
 /** \brief user-defined mesh cavity operator */
 class CavityOp
 {
@@ -87,10 +103,18 @@ class CavityOp
     virtual void apply() = 0;
     /** \brief parallel collective operation over entities of one dimension */
     void applyToDimension(int d);
+    /** \brief like applyToDimension, but the first local pass only
+      visits the given live entities of dimension d
+      \details the entities must include all those setEntity would not
+      SKIP. Passes after a migration visit the whole dimension, since
+      migrated entities are not in the list. */
+    void applyToEntities(int d, std::vector<MeshEntity*> const& entities);
     /** \brief within setEntity, require that entities be made local */
     bool requestLocality(MeshEntity** entities, int count);
     /** \brief call before deleting a mesh entity during the operation */
     void preDeletion(MeshEntity* e);
+    /** \brief the work this operator has done so far */
+    CavityOpCounts const& getCounts() {return counts;}
     /** \brief mesh pointer for convenience */
     Mesh* mesh;
   private:
@@ -100,11 +124,20 @@ class CavityOp
     struct PullRequest { MeshEntity* e; int to; };
     bool sendPullRequests(std::vector<PullRequest>& received);
     bool tryToPull();
+    void applyRounds(int d);
     void applyLocallyWithModification(int d);
     void applyLocallyWithoutModification(int d);
+    void applyLocallyToList();
     bool canModify;
     bool movedByDeletion;
     MeshIterator* iterator;
+    /* the listed entities in visit order, zeroed when destroyed,
+       and their positions sorted by entity to find them quickly */
+    typedef std::pair<MeshEntity*, size_t> ListedPosition;
+    std::vector<MeshEntity*> listed;
+    std::vector<ListedPosition> positions;
+    int listedDimension;
+    CavityOpCounts counts;
   protected:
     Sharing* sharing;
 };
@@ -0,0 +1,164 @@
+/*
+ * Copyright 2011 Scientific Computation Research Center
+ *
+ * This work is open source software, licensed under the terms of the
+ * BSD license as described in the LICENSE file in the top-level directory.
+ */
+
+#include "apfDenseData.h"
+#include "apf.h"
+#include <cstring>
+#include <stdint.h>
+
+namespace apf {
+
+/* component arrays start on cache lines, 8 doubles apart */
+enum { ALIGN = 64, ALIGN_VALUES = ALIGN / sizeof(double) };
+
+DenseData::DenseData()
+{
+  components = 0;
+  for (int t = 0; t < Mesh::TYPES; ++t) {
+    nodes[t] = 0;
+    size[t] = stride[t] = 0;
+    arrays[t] = 0;
+    blocks[t] = 0;
+  }
+}
+
+DenseData::~DenseData()
+{
+  for (int t = 0; t < Mesh::TYPES; ++t)
+    delete [] blocks[t];
+}
+
+void DenseData::init(FieldBase* f)
+{
+  field = f;
+  Mesh* m = f->getMesh();
+  FieldShape* s = f->getShape();
+  components = f->countComponents();
+  for (int t = 0; t < Mesh::TYPES; ++t) {
+    long n = m->countIndices(t);
+    if (n < 0)
+      fail("dense field storage needs a mesh that indexes its entities");
+    if (n && s->hasNodesIn(Mesh::typeDimension[t]))
+      nodes[t] = s->countNodesOn(t);
+    size[t] = n * nodes[t];
+    stride[t] = (size[t] + ALIGN_VALUES - 1) / ALIGN_VALUES * ALIGN_VALUES;
+    size_t bytes = components * stride[t] * sizeof(double);
+    blocks[t] = new char[bytes + ALIGN];
+    uintptr_t p = reinterpret_cast<uintptr_t>(blocks[t]);
+    p = (p + ALIGN - 1) / ALIGN * ALIGN;
+    arrays[t] = reinterpret_cast<double*>(p);
+    memset(arrays[t], 0, bytes);
+  }
+  for (int d = 0; d < 4; ++d) {
+    if ( ! s->hasNodesIn(d))
+      continue;
+    MeshIterator* it = m->begin(d);
+    MeshEntity* e;
+    while ((e = m->iterate(it))) {
+      int t = m->getType(e);
+      if (( ! nodes[t]) || ( ! m->isShared(e)) || m->isOwned(e))
+        continue;
+      long first = m->getIndex(e) * nodes[t];
+      for (int k = 0; k < nodes[t]; ++k)
+        notOwned[t].push_back(first + k);
+    }
+    m->end(it);
+  }
+}
+
+bool DenseData::hasEntity(MeshEntity*)
+{
+  return true;
+}
+
+void DenseData::removeEntity(MeshEntity*)
+{
+  fail("removeEntity called on dense field data");
+}
+
+void DenseData::get(MeshEntity* e, double* data)
+{
+  Mesh* m = field->getMesh();
+  int t = m->getType(e);
+  long first = m->getIndex(e) * nodes[t];
+  for (int c = 0; c < components; ++c) {
+    double const* a = arrays[t] + c * stride[t] + first;
+    for (int k = 0; k < nodes[t]; ++k)
+      data[k * components + c] = a[k];
+  }
+}
+
+void DenseData::set(MeshEntity* e, double const* data)
+{
+  Mesh* m = field->getMesh();
+  int t = m->getType(e);
+  long first = m->getIndex(e) * nodes[t];
+  for (int c = 0; c < components; ++c) {
+    double* a = arrays[t] + c * stride[t] + first;
+    for (int k = 0; k < nodes[t]; ++k)
+      a[k] = data[k * components + c];
+  }
+}
+
+bool DenseData::matches(DenseData* other)
+{
+  if (field->getMesh() != other->field->getMesh() ||
+      components != other->components)
+    return false;
+  for (int t = 0; t < Mesh::TYPES; ++t)
+    if (nodes[t] != other->nodes[t] || size[t] != other->size[t])
+      return false;
+  return true;
+}
+
+/* holes left by destroyed entities hold zeros, since destroying
+   entities converts the field back to tags, so summing whole
+   arrays and taking out the copies owned elsewhere is enough */
+double DenseData::sumSquares()
+{
+  double sum = 0;
+  for (int t = 0; t < Mesh::TYPES; ++t)
+    for (int c = 0; c < components; ++c) {
+      double const* a = getArray(t, c);
+      long n = size[t];
+      for (long i = 0; i < n; ++i)
+        sum += a[i] * a[i];
+      for (size_t i = 0; i < notOwned[t].size(); ++i)
+        sum -= a[notOwned[t][i]] * a[notOwned[t][i]];
+    }
+  return sum;
+}
+
+void DenseData::zero()
+{
+  for (int t = 0; t < Mesh::TYPES; ++t)
+    memset(arrays[t], 0, components * stride[t] * sizeof(double));
+}
+
+void makeDenseFieldData(FieldBase* field)
+{
+  DenseData* newData = new DenseData();
+  newData->init(field);
+  FieldDataOf<double>* oldData =
+    static_cast<FieldDataOf<double>*>(field->getData());
+  copyFieldData<double>(oldData, newData);
+  field->changeData(newData);
+}
+
+void axpyDenseData(double a, DenseData* x, DenseData* y)
+{
+  for (int t = 0; t < Mesh::TYPES; ++t)
+    for (int c = 0; c < y->countComponents(); ++c) {
+      double const* xa = x->getArray(t, c);
+      double* ya = y->getArray(t, c);
+      long n = y->getSize(t);
+      for (long i = 0; i < n; ++i)
+        ya[i] += a * xa[i];
+    }
+}
+
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright 2011 Scientific Computation Research Center
+ *
+ * This work is open source software, licensed under the terms of the
+ * BSD license as described in the LICENSE file in the top-level directory.
+ */
+
+#ifndef APFDENSEDATA_H
+#define APFDENSEDATA_H
+
+#include "apfFieldData.h"
+#include <vector>
+
+namespace apf {
+
+/* field storage in structure-of-arrays form: for each entity type
+   and each component there is one aligned array indexed by
+   apf::Mesh::getIndex, and node k of the entity with index i
+   is at i * nodes + k. Like array storage, it is frozen,
+   so modifying the mesh converts it back to tags. */
+class DenseData : public FieldDataOf<double>
+{
+  public:
+    DenseData();
+    virtual ~DenseData();
+    virtual void init(FieldBase* f);
+    virtual bool hasEntity(MeshEntity* e);
+    virtual void removeEntity(MeshEntity* e);
+    virtual void get(MeshEntity* e, double* data);
+    virtual void set(MeshEntity* e, double const* data);
+    virtual bool isFrozen() {return true;}
+    int countComponents() {return components;}
+    /* the number of values in each array of (type) */
+    long getSize(int type) {return size[type];}
+    double* getArray(int type, int component)
+    {
+      return arrays[type] + component * stride[type];
+    }
+    /* same layout as the other, so arrays can be combined directly */
+    bool matches(DenseData* other);
+    /* sum of squares over the nodes this part owns */
+    double sumSquares();
+    void zero();
+  private:
+    int components;
+    int nodes[Mesh::TYPES];
+    long size[Mesh::TYPES];
+    long stride[Mesh::TYPES];
+    double* arrays[Mesh::TYPES];
+    char* blocks[Mesh::TYPES];
+    /* array positions of the nodes of shared entities owned elsewhere */
+    std::vector<long> notOwned[Mesh::TYPES];
+};
+
+void makeDenseFieldData(FieldBase* f);
+void axpyDenseData(double a, DenseData* x, DenseData* y);
+
+}
+
+#endif
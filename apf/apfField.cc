@@ -8,6 +8,9 @@
 #include "apfField.h"
 #include "apfShape.h"
 #include "apfTagData.h"
+#include "apfDenseData.h"
+#include <PCU.h>
+#include <cmath>
 
 namespace apf {
 
@@ -122,8 +125,53 @@ struct ZeroOp : public FieldOp
 
 void zeroField(Field* f)
 {
+  DenseData* d = dynamic_cast<DenseData*>(f->getData());
+  if (d) {
+    d->zero();
+    return;
+  }
   ZeroOp op(f);
   op.apply(f);
 }
 
+struct SumSquaresOp : public FieldOp
+{
+  SumSquaresOp(Field* f)
+  {
+    field = f;
+    data.allocate(f->countComponents());
+    ent = 0;
+    sum = 0;
+  }
+  bool inEntity(MeshEntity* e)
+  {
+    ent = e;
+    return field->getMesh()->isOwned(e);
+  }
+  void atNode(int n)
+  {
+    getComponents(field, ent, n, &data[0]);
+    for (int i = 0; i < field->countComponents(); ++i)
+      sum += data[i] * data[i];
+  }
+  Field* field;
+  MeshEntity* ent;
+  apf::NewArray<double> data;
+  double sum;
+};
+
+double getNorm(Field* f)
+{
+  DenseData* d = dynamic_cast<DenseData*>(f->getData());
+  double sum;
+  if (d) {
+    sum = d->sumSquares();
+  } else {
+    SumSquaresOp op(f);
+    op.apply(f);
+    sum = op.sum;
+  }
+  return std::sqrt(PCU_Add_Double(sum));
+}
+
 } //namespace apf
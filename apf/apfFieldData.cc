@@ -68,9 +68,7 @@ void synchronizeFieldData(FieldDataOf<T>* data, Sharing* shr, bool delete_shr)
       MeshEntity* e;
       PCU_COMM_UNPACK(e);
       int n = f->countValuesOn(e);
-      NewArray<T> values(n);
-      PCU_Comm_Unpack(&(values[0]),n*sizeof(T));
-      data->set(e,&(values[0]));
+      data->set(e,PCU_COMM_EXTRACT(T,n));
     }
   }
   if (delete_shr) delete shr;
@@ -127,8 +125,7 @@ void accumulateFieldData(FieldDataOf<double>* data, Sharing* shr, bool delete_sh
         PCU_COMM_UNPACK(e);
         int n = f->countValuesOn(e);
         NewArray<double> values(n);
-        NewArray<double> inValues(n);
-        PCU_Comm_Unpack(&(inValues[0]),n*sizeof(double));
+        double* inValues = PCU_COMM_EXTRACT(double,n);
         data->get(e,&(values[0]));
         for (int i = 0; i < n; ++i)
           values[i] += inValues[i];
@@ -148,6 +148,7 @@ void Mesh::init(FieldShape* s)
   baseP->init("coordinates",this,s,data);
   data->init(baseP);
   hasFrozenFields = false;
+  changeCount = 0;
 }
 
 Mesh::~Mesh()
@@ -257,6 +258,85 @@ void Mesh::getPoint(MeshEntity* e, int node, Vector3& p)
   getVector(coordinateField,e,node,p);
 }
 
+bool Mesh::hasNativeCoordinates()
+{
+  return dynamic_cast<CoordData*>(coordinateField->getData()) != 0;
+}
+
+int Mesh::iterateBatch(MeshIterator* it, MeshEntity** es, int n)
+{
+  int i;
+  for (i = 0; i < n; ++i)
+    if (!(es[i] = iterate(it)))
+      break;
+  return i;
+}
+
+int Mesh::getDownwardBatch(MeshEntity* const* es, int n,
+    int dimension, MeshEntity** adjacent)
+{
+  if (!n)
+    return 0;
+  Downward down;
+  int degree = getDownward(es[0], dimension, down);
+  for (int i = 0; i < n; ++i) {
+    PCU_ALWAYS_ASSERT(getDownward(es[i], dimension, down) == degree);
+    std::copy(down, down + degree, adjacent + i * degree);
+  }
+  return degree;
+}
+
+void Mesh::getPointBatch(MeshEntity* const* es, int n, double* points)
+{
+  Vector3 x;
+  bool native = hasNativeCoordinates();
+  for (int i = 0; i < n; ++i) {
+    if (native)
+      getPoint_(es[i], 0, x);
+    else
+      getPoint(es[i], 0, x);
+    x.toArray(points + 3 * i);
+  }
+}
+
+void Mesh::getIntTagBatch(MeshEntity* const* es, int n,
+    MeshTag* tag, int* data)
+{
+  int size = getTagSize(tag);
+  for (int i = 0; i < n; ++i)
+    getIntTag(es[i], tag, data + i * size);
+}
+
+void Mesh::getDoubleTagBatch(MeshEntity* const* es, int n,
+    MeshTag* tag, double* data)
+{
+  int size = getTagSize(tag);
+  for (int i = 0; i < n; ++i)
+    getDoubleTag(es[i], tag, data + i * size);
+}
+
+void Mesh::toModelBatch(MeshEntity* const* es, int n, ModelEntity** models)
+{
+  for (int i = 0; i < n; ++i)
+    models[i] = toModel(es[i]);
+}
+
+void Mesh::getOwnerBatch(MeshEntity* const* es, int n, int* owners)
+{
+  for (int i = 0; i < n; ++i)
+    owners[i] = getOwner(es[i]);
+}
+
+long Mesh::getIndex(MeshEntity*)
+{
+  return -1;
+}
+
+long Mesh::countIndices(int)
+{
+  return -1;
+}
+
 FieldShape* Mesh::getShape() const
 {
   return coordinateField->getShape();
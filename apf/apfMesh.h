@@ -99,6 +99,15 @@ typedef CopyArray DgCopies;
   so through an apf::Mesh interface object.
   Mesh databases should derive an interface object and implement
   all pure virtual functions to be usable from APF.
+
+  Thread safety: with the MDS database, queries that do not change
+  the mesh (iteration with separate iterators, adjacency, coordinates,
+  tags, classification, remote copies, and reading fields) may be
+  called from many threads at once, as long as no thread changes the
+  mesh, its tags or its fields at the same time. Changes include
+  creating or destroying entities, setting tags or field values,
+  freezing fields and apf::Mesh2::freeze. Other databases make no
+  such promise. See apf::beginMdsRange for splitting a loop.
  */
 class Mesh
 {
@@ -344,6 +353,49 @@ class Mesh
       \returns an estimate of how many bytes are needed
       to store an entity of (type) */
     virtual double getElementBytes(int) {return 1.0;}
+    /** \brief batched queries over arrays of entities
+      \details these fill caller-provided contiguous arrays for
+      (n) entities of one dimension at a time, so that loops like
+      element assembly make one virtual call per batch instead of
+      one per entity. The defaults in apf::Mesh just loop over the
+      single-entity queries; databases may override them.
+      Batches usually come from apf::Mesh::iterateBatch. */
+    /** \brief fill (es) with up to (n) entities from an iterator
+      \returns the number filled, zero once the iterator is done */
+    virtual int iterateBatch(MeshIterator* it, MeshEntity** es, int n);
+    /** \brief batched apf::Mesh::getDownward
+      \details all entities must have the same type. The adjacent
+      entities of es[i] start at adjacent[i * degree].
+      \returns the degree, the number adjacent to each entity */
+    virtual int getDownwardBatch(MeshEntity* const* es, int n,
+        int dimension, MeshEntity** adjacent);
+    /** \brief batched apf::Mesh::getPoint for node 0,
+      three coordinates per entity */
+    virtual void getPointBatch(MeshEntity* const* es, int n, double* points);
+    /** \brief batched apf::Mesh::getIntTag,
+      apf::Mesh::getTagSize values per entity */
+    virtual void getIntTagBatch(MeshEntity* const* es, int n,
+        MeshTag* tag, int* data);
+    /** \brief batched apf::Mesh::getDoubleTag,
+      apf::Mesh::getTagSize values per entity */
+    virtual void getDoubleTagBatch(MeshEntity* const* es, int n,
+        MeshTag* tag, double* data);
+    /** \brief batched apf::Mesh::toModel */
+    virtual void toModelBatch(MeshEntity* const* es, int n,
+        ModelEntity** models);
+    /** \brief batched apf::Mesh::getOwner */
+    virtual void getOwnerBatch(MeshEntity* const* es, int n, int* owners);
+    /** \brief get the dense index of an entity among those of its type
+      \details indices run from zero to apf::Mesh::countIndices and
+      stay fixed until the mesh is modified. They let storage such as
+      dense fields sit in plain arrays.
+      \returns -1 if this database does not index its entities */
+    virtual long getIndex(MeshEntity* e);
+    /** \brief get one past the largest index of an entity of (type)
+      \details this can exceed the number of entities when
+      there are holes left by destroyed ones.
+      \returns -1 if this database does not index its entities */
+    virtual long countIndices(int type);
     /** \brief associate a field with this mesh
       \details most users don't need this, functions in apf.h
                automatically call it */
@@ -381,7 +433,13 @@ class Mesh
     GlobalNumbering* getGlobalNumbering(int i);
     /** \brief true if any associated fields use array storage */
     bool hasFrozenFields;
+    /** \brief counts entity creations, destructions, and renumberings,
+      so that apf::SyncPlan knows when to rebuild. Updated atomically,
+      since threads may modify an MDS mesh, see apf::createMdsBuffer */
+    unsigned long changeCount;
   protected:
+    /** \brief true if getPoint just calls getPoint_ for node 0 */
+    bool hasNativeCoordinates();
     Field* coordinateField;
     std::vector<Field*> fields;
     std::vector<Numbering*> numberings;
@@ -77,6 +77,7 @@ class Mesh2 : public Mesh
     MeshEntity* createVert(ModelEntity* c)
     {
       requireUnfrozen();
+      __atomic_fetch_add(&changeCount, 1, __ATOMIC_RELAXED);
       return createVert_(c);
     }
 /** \brief Underlying implementation of apf::Mesh2::createEntity */
@@ -91,6 +92,7 @@ class Mesh2 : public Mesh
     MeshEntity* createEntity(int type, ModelEntity* c, MeshEntity** down)
     {
       requireUnfrozen();
+      __atomic_fetch_add(&changeCount, 1, __ATOMIC_RELAXED);
       return createEntity_(type,c,down);
     }
 /** \brief Underlying implementation of apf::Mesh2::destroy */
@@ -101,6 +103,7 @@ class Mesh2 : public Mesh
     void destroy(MeshEntity* e)
     {
       requireUnfrozen();
+      __atomic_fetch_add(&changeCount, 1, __ATOMIC_RELAXED);
       destroy_(e);
     }
 /** \brief Change the geometric classification of an entity. */
@@ -116,6 +119,19 @@ class Mesh2 : public Mesh
   mesh modifications so that all structures are properly updated before
   using the mesh any further. */
     virtual void acceptChanges() = 0;
+/** \brief Build contiguous tables for adjacency queries
+  \details until apf::Mesh2::thaw, adjacency queries are answered
+  from compressed sparse row tables holding every upward and
+  multi-level adjacency, in the same order as before.
+  Creating or destroying entities thaws the mesh.
+  Implementations may also pack remote copies into compact
+  per-peer blocks, which changing the copies undoes.
+  This is a hint, implementations may do nothing. */
+    virtual void freeze() {}
+/** \brief Free the tables built by apf::Mesh2::freeze */
+    virtual void thaw() {}
+/** \brief Return true iff the mesh has been frozen and not thawed */
+    virtual bool isFrozen() {return false;}
 };
 
 /** \brief APF's migration function, works on apf::Mesh2
@@ -136,6 +152,15 @@ void migrateSilent(Mesh2* m, Migration* plan);
   be performed as several consecutive migrations. */
 void setMigrationLimit(size_t maxElements);
 
+/** \brief compress migration messages of at least minBytes bytes
+  \details when migrating large meshes over a slow network,
+  compressing the coordinates, tags and remote copies sent by
+  apf::migrate can save more time than it costs.
+  This must be called with the same value on all ranks,
+  and zero (the default) turns compression off.
+  It has no effect when lion was built without compression. */
+void setMigrationCompression(size_t minBytes);
+
 class Field;
 
 /** \brief add a field (times a factor) to the mesh coordinates
@@ -148,6 +173,7 @@ void displaceMesh(Mesh2* m, Field* d, double factor=1.0);
 class BuildCallback
 {
   public:
+    virtual ~BuildCallback() {}
     /** \brief will be called after an entity is created */
     virtual void call(MeshEntity* e) = 0;
 };
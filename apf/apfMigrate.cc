@@ -10,6 +10,7 @@
 #include "apfCavityOp.h"
 #include "apf.h"
 #include <pcu_util.h>
+#include <lionCompress.h>
 #include <cstdlib>
 
 namespace apf {
@@ -893,12 +894,49 @@ static void migrate2(Mesh2* m, Migration* plan)
   }
 }
 
+static size_t compressionThreshold = 0;
+
+void setMigrationCompression(size_t minBytes)
+{
+  compressionThreshold = minBytes;
+}
+
+static size_t boundLion(size_t size)
+{
+  return lion::compressBound(size);
+}
+
+static size_t compressLion(void* to, size_t toSize,
+    const void* from, size_t size)
+{
+  unsigned long toLen = toSize;
+  /* a failure gives zero, and PCU then sends the buffer as it is */
+  lion::compressFast(to, toLen, from, size);
+  return toLen;
+}
+
+static size_t decompressLion(void* to, size_t toSize,
+    const void* from, size_t size)
+{
+  unsigned long toLen = toSize;
+  lion::decompress(to, toLen, from, size);
+  return toLen;
+}
+
+static const PCU_Codec lionCodec =
+{ boundLion, compressLion, decompressLion };
+
 void migrateSilent(Mesh2* m, Migration* plan)
 {
+  bool compress = compressionThreshold && lion::can_compress;
+  if (compress)
+    PCU_Comm_Compress(&lionCodec, compressionThreshold);
   if (PCU_Or(static_cast<size_t>(plan->count()) > migrationLimit))
     migrate2(m, plan);
   else
     migrate1(m, plan);
+  if (compress)
+    PCU_Comm_Compress(NULL, 0);
 }
 
 void migrate(Mesh2* m, Migration* plan)
@@ -0,0 +1,286 @@
+/*
+ * Copyright 2011 Scientific Computation Research Center
+ *
+ * This work is open source software, licensed under the terms of the
+ * BSD license as described in the LICENSE file in the top-level directory.
+ */
+
+#include "apfSyncPlan.h"
+#include "apf.h"
+#include <PCU.h>
+#include <pcu_util.h>
+#include <set>
+
+namespace apf {
+
+SyncPlan::SyncPlan(Mesh* m, FieldShape* s, Sharing* shr)
+{
+  mesh = m;
+  shape = s;
+  sharing = shr;
+  ownsSharing = false;
+  if (!sharing) {
+    sharing = getSharing(m);
+    ownsSharing = true;
+  }
+  build();
+}
+
+SyncPlan::~SyncPlan()
+{
+  if (ownsSharing)
+    delete sharing;
+}
+
+void SyncPlan::update()
+{
+  if (PCU_Or(mesh->changeCount != changes)) {
+    if (ownsSharing) {
+      delete sharing;
+      sharing = getSharing(mesh);
+    }
+    build();
+  }
+}
+
+enum { SYNC, ACCUMULATE };
+
+static void plan(SyncPeers& peers, int kind, int to, MeshEntity* e,
+    MeshEntity* remote)
+{
+  peers[to].send.push_back(e);
+  PCU_COMM_PACK(to, kind);
+  PCU_COMM_PACK(to, remote);
+}
+
+/* the same walk over the entities as synchronizeFieldData and
+   accumulateFieldData, except that values are left out
+   and receivers note the order the entities arrive in */
+void SyncPlan::build()
+{
+  sync.clear();
+  accumulate.clear();
+  changes = mesh->changeCount;
+  PCU_Comm_Begin();
+  for (int d = 0; d < 4; ++d) {
+    if ( ! shape->hasNodesIn(d))
+      continue;
+    MeshIterator* it = mesh->begin(d);
+    MeshEntity* e;
+    while ((e = mesh->iterate(it))) {
+      if ( ! shape->countNodesOn(mesh->getType(e)))
+        continue;
+      CopyArray copies;
+      if (sharing->isOwned(e)) {
+        sharing->getCopies(e, copies);
+        for (size_t i = 0; i < copies.getSize(); ++i)
+          plan(sync, SYNC, copies[i].peer, e, copies[i].entity);
+        Copies ghosts;
+        if (mesh->getGhosts(e, ghosts))
+          APF_ITERATE(Copies, ghosts, git)
+            plan(sync, SYNC, git->first, e, git->second);
+      } else if ( ! mesh->isGhost(e)) {
+        sharing->getCopies(e, copies);
+        for (size_t i = 0; i < copies.getSize(); ++i)
+          plan(accumulate, ACCUMULATE, copies[i].peer, e,
+              copies[i].entity);
+      }
+    }
+    mesh->end(it);
+  }
+  PCU_Comm_Send();
+  while (PCU_Comm_Listen()) {
+    int from = PCU_Comm_Sender();
+    while ( ! PCU_Comm_Unpacked()) {
+      int kind;
+      MeshEntity* e;
+      PCU_COMM_UNPACK(kind);
+      PCU_COMM_UNPACK(e);
+      if (kind == SYNC)
+        sync[from].recv.push_back(e);
+      else
+        accumulate[from].recv.push_back(e);
+    }
+  }
+}
+
+/* one field and the lists its values are exchanged along */
+template <class T>
+struct Exchange
+{
+  FieldDataOf<T>* data;
+  SyncPeers* peers;
+};
+
+/* gathers the values of all the fields for each peer into one block */
+template <class T>
+static void sendValues(Exchange<T>* xs, int n)
+{
+  std::set<int> ranks;
+  for (int k = 0; k < n; ++k)
+    APF_ITERATE(SyncPeers, *(xs[k].peers), pit)
+      if ( ! pit->second.send.empty())
+        ranks.insert(pit->first);
+  std::vector<T> values;
+  PCU_Comm_Begin();
+  APF_ITERATE(std::set<int>, ranks, rit) {
+    values.clear();
+    for (int k = 0; k < n; ++k) {
+      SyncPeers::iterator pit = xs[k].peers->find(*rit);
+      if (pit == xs[k].peers->end())
+        continue;
+      std::vector<MeshEntity*>& send = pit->second.send;
+      FieldDataOf<T>* data = xs[k].data;
+      FieldBase* f = data->getField();
+      for (size_t i = 0; i < send.size(); ++i) {
+        size_t at = values.size();
+        values.resize(at + f->countValuesOn(send[i]), T());
+        if (data->hasEntity(send[i]))
+          data->get(send[i], &values[at]);
+      }
+    }
+    PCU_Comm_Pack(*rit, &values[0], values.size() * sizeof(T));
+  }
+  PCU_Comm_Send();
+}
+
+/* scatters or adds the blocks from each peer in the order they
+   were gathered */
+template <class T>
+static void receiveValues(Exchange<T>* xs, int n, bool add)
+{
+  NewArray<T> sum;
+  while (PCU_Comm_Listen()) {
+    int from = PCU_Comm_Sender();
+    for (int k = 0; k < n; ++k) {
+      SyncPeers::iterator pit = xs[k].peers->find(from);
+      if (pit == xs[k].peers->end())
+        continue;
+      std::vector<MeshEntity*>& recv = pit->second.recv;
+      FieldDataOf<T>* data = xs[k].data;
+      FieldBase* f = data->getField();
+      for (size_t i = 0; i < recv.size(); ++i) {
+        int nv = f->countValuesOn(recv[i]);
+        T* in = PCU_COMM_EXTRACT(T, nv);
+        if (add) {
+          sum.allocate(nv);
+          data->get(recv[i], &sum[0]);
+          for (int j = 0; j < nv; ++j)
+            sum[j] += in[j];
+          in = &sum[0];
+        }
+        data->set(recv[i], in);
+      }
+    }
+    PCU_ALWAYS_ASSERT(PCU_Comm_Unpacked());
+  }
+}
+
+template <class T>
+static void exchange(FieldDataOf<T>* data, SyncPeers& peers, bool add)
+{
+  Exchange<T> x;
+  x.data = data;
+  x.peers = &peers;
+  sendValues(&x, 1);
+  receiveValues(&x, 1, add);
+}
+
+static void check(FieldBase* f, SyncPlan* plan)
+{
+  PCU_ALWAYS_ASSERT(f->getMesh() == plan->getMesh());
+  PCU_ALWAYS_ASSERT(f->getShape() == plan->getShape());
+  plan->update();
+}
+
+template <class T>
+void synchronizeFieldData(FieldDataOf<T>* data, SyncPlan* plan)
+{
+  check(data->getField(), plan);
+  exchange(data, plan->sync, false);
+}
+
+template void synchronizeFieldData<int>(FieldDataOf<int>*, SyncPlan*);
+template void synchronizeFieldData<double>(FieldDataOf<double>*, SyncPlan*);
+template void synchronizeFieldData<long>(FieldDataOf<long>*, SyncPlan*);
+
+void accumulateFieldData(FieldDataOf<double>* data, SyncPlan* plan)
+{
+  check(data->getField(), plan);
+  exchange(data, plan->accumulate, true);
+  /* broadcast back out to non-owners */
+  exchange(data, plan->sync, false);
+}
+
+SyncBatch::SyncBatch(Field** fs, int n, Sharing* shr)
+{
+  state = IDLE;
+  for (int i = 0; i < n; ++i) {
+    SyncPlan* plan = 0;
+    for (size_t j = 0; j < plans.size(); ++j)
+      if (plans[j]->getMesh() == getMesh(fs[i]) &&
+          plans[j]->getShape() == getShape(fs[i]))
+        plan = plans[j];
+    if (!plan) {
+      plan = new SyncPlan(getMesh(fs[i]), getShape(fs[i]), shr);
+      plans.push_back(plan);
+    }
+    fields.push_back(fs[i]);
+    fieldPlans.push_back(plan);
+  }
+}
+
+SyncBatch::~SyncBatch()
+{
+  PCU_ALWAYS_ASSERT(state == IDLE);
+  for (size_t i = 0; i < plans.size(); ++i)
+    delete plans[i];
+}
+
+void SyncBatch::begin(int s)
+{
+  PCU_ALWAYS_ASSERT(state == IDLE);
+  for (size_t i = 0; i < plans.size(); ++i)
+    plans[i]->update();
+  state = s;
+  send(state == ACCUMULATING);
+}
+
+void SyncBatch::end(int s)
+{
+  PCU_ALWAYS_ASSERT(state == s);
+  receive(state == ACCUMULATING);
+  if (state == ACCUMULATING) {
+    /* broadcast back out to non-owners */
+    send(false);
+    receive(false);
+  }
+  state = IDLE;
+}
+
+static void makeExchanges(SyncBatch* b, bool add,
+    std::vector<Exchange<double> >& xs)
+{
+  xs.resize(b->fields.size());
+  for (size_t i = 0; i < xs.size(); ++i) {
+    xs[i].data = b->fields[i]->getData();
+    SyncPlan* plan = b->fieldPlans[i];
+    xs[i].peers = add ? &plan->accumulate : &plan->sync;
+  }
+}
+
+void SyncBatch::send(bool add)
+{
+  std::vector<Exchange<double> > xs;
+  makeExchanges(this, add, xs);
+  sendValues(xs.empty() ? 0 : &xs[0], xs.size());
+}
+
+void SyncBatch::receive(bool add)
+{
+  std::vector<Exchange<double> > xs;
+  makeExchanges(this, add, xs);
+  receiveValues(xs.empty() ? 0 : &xs[0], xs.size(), add);
+}
+
+}
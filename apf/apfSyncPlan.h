@@ -0,0 +1,77 @@
+/*
+ * Copyright 2011 Scientific Computation Research Center
+ *
+ * This work is open source software, licensed under the terms of the
+ * BSD license as described in the LICENSE file in the top-level directory.
+ */
+
+#ifndef APFSYNCPLAN_H
+#define APFSYNCPLAN_H
+
+#include "apfFieldData.h"
+#include <map>
+#include <vector>
+
+namespace apf {
+
+/* the entities whose values go to and come from each peer,
+   in the order they are packed */
+struct SyncLists
+{
+  std::vector<MeshEntity*> send;
+  std::vector<MeshEntity*> recv;
+};
+
+typedef std::map<int, SyncLists> SyncPeers;
+
+class SyncPlan
+{
+  public:
+    SyncPlan(Mesh* m, FieldShape* s, Sharing* shr);
+    ~SyncPlan();
+    /* rebuilds the lists if entities were created or destroyed
+       on any part since they were built. This is collective. */
+    void update();
+    Mesh* getMesh() {return mesh;}
+    FieldShape* getShape() {return shape;}
+    /* owners to their copies and ghosts */
+    SyncPeers sync;
+    /* non-owners to their copies */
+    SyncPeers accumulate;
+  private:
+    void build();
+    Mesh* mesh;
+    FieldShape* shape;
+    Sharing* sharing;
+    bool ownsSharing;
+    unsigned long changes;
+};
+
+/* fields that are synchronized or accumulated together, in one
+   phase, using one plan for each distinct shape. Between begin and
+   end, the phase is open and its messages are in flight. */
+class SyncBatch
+{
+  public:
+    SyncBatch(Field** fs, int n, Sharing* shr);
+    ~SyncBatch();
+    enum { IDLE, SYNCHRONIZING, ACCUMULATING };
+    void begin(int s);
+    void end(int s);
+    std::vector<Field*> fields;
+    std::vector<SyncPlan*> fieldPlans;
+    std::vector<SyncPlan*> plans;
+  private:
+    void send(bool add);
+    void receive(bool add);
+    int state;
+};
+
+template <class T>
+void synchronizeFieldData(FieldDataOf<T>* data, SyncPlan* plan);
+
+void accumulateFieldData(FieldDataOf<double>* data, SyncPlan* plan);
+
+}
+
+#endif
@@ -15,6 +15,7 @@
 #include <maSnap.h>
 #include <maStats.h>
 #include <maLayer.h>
+#include <maProfile.h>
 #include <PCU.h>
 #include <pcu_util.h>
 
@@ -205,31 +206,52 @@ void adapt(ma::Input* in)
   double t0 = PCU_Time();
   ma::validateInput(in);
   Adapt* a = new Adapt(in);
+  ma::beginPhase(a, "preBalance");
   ma::preBalance(a);
+  ma::endPhase(a);
 
+  ma::beginPhase(a, "fixInvalidElements");
   fixInvalidElements(a);
+  ma::endPhase(a);
 
   for (int i=0; i < in->maximumIterations; ++i)
   {
     ma::print("iteration %d",i);
+    ma::beginPhase(a, "coarsen", i);
     ma::coarsen(a);
+    ma::endPhase(a);
+    ma::beginPhase(a, "midBalance", i);
     ma::midBalance(a);
+    ma::endPhase(a);
+    ma::beginPhase(a, "refine", i);
     crv::refine(a);
+    ma::endPhase(a);
     allowSplitCollapseOutsideLayer(a);
     flagCleaner(a); // all true-flags must be false before using markEntities
+    ma::beginPhase(a, "fixElementShapes", i);
     fixCrvElementShapes(a);
+    ma::endPhase(a);
   }
 
   allowSplitCollapseOutsideLayer(a);
 
   if (in->maximumIterations > 0) {
+    ma::beginPhase(a, "fixInvalidElements");
     fixInvalidElements(a);
+    ma::endPhase(a);
     flagCleaner(a); // all true-flags must be false before using markEntities
+    ma::beginPhase(a, "fixElementShapes");
     fixCrvElementShapes(a);
+    ma::endPhase(a);
   }
+  ma::beginPhase(a, "cleanupLayer");
   cleanupLayer(a);
+  ma::endPhase(a);
   ma::printQuality(a);
+  ma::beginPhase(a, "postBalance");
   ma::postBalance(a);
+  ma::endPhase(a);
+  ma::writeProfile(a);
   double t1 = PCU_Time();
   ma::print("mesh adapted in %f seconds",t1-t0);
   apf::printStats(a->mesh);
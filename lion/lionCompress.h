@@ -10,6 +10,17 @@ void compress(void* dest, unsigned long& destLen,
 
 unsigned long compressBound(unsigned long sourceLen);
 
+/* favors speed over ratio, for data that is about to be sent.
+   destLen is the capacity of dest on input and the compressed
+   size on output, or zero if zlib failed */
+void compressFast(void* dest, unsigned long& destLen,
+    const void* source, unsigned long sourceLen);
+
+/* destLen is the capacity of dest on input and
+   the decompressed size on output */
+void decompress(void* dest, unsigned long& destLen,
+    const void* source, unsigned long sourceLen);
+
 }
 
 #endif
@@ -16,6 +16,26 @@ void compress(void* dest, unsigned long& destLen,
   abort();
 }
 
+void compressFast(void* dest, unsigned long& destLen,
+    const void* source, unsigned long sourceLen)
+{
+  (void) dest;
+  (void) destLen;
+  (void) source;
+  (void) sourceLen;
+  abort();
+}
+
+void decompress(void* dest, unsigned long& destLen,
+    const void* source, unsigned long sourceLen)
+{
+  (void) dest;
+  (void) destLen;
+  (void) source;
+  (void) sourceLen;
+  abort();
+}
+
 unsigned long compressBound(unsigned long sourceLen)
 {
 	(void) sourceLen;
@@ -12,6 +12,22 @@ void compress(void* dest, unsigned long& destLen,
   ::compress((Bytef*)dest, &destLen, (const Bytef*)source, sourceLen);
 }
 
+void compressFast(void* dest, unsigned long& destLen,
+    const void* source, unsigned long sourceLen)
+{
+  if (::compress2((Bytef*)dest, &destLen, (const Bytef*)source, sourceLen,
+        Z_BEST_SPEED) != Z_OK)
+    destLen = 0;
+}
+
+void decompress(void* dest, unsigned long& destLen,
+    const void* source, unsigned long sourceLen)
+{
+  if (::uncompress((Bytef*)dest, &destLen, (const Bytef*)source, sourceLen)
+      != Z_OK)
+    destLen = 0;
+}
+
 unsigned long compressBound(unsigned long sourceLen)
 {
 	return ::compressBound(sourceLen);
@@ -17,32 +17,73 @@
 #include "maBalance.h"
 #include "maLayer.h"
 #include "maDBG.h"
+#include "maWorklist.h"
+#include "maProfile.h"
 #include <pcu_util.h>
+#include <cstdio>
 
 namespace ma {
 
+static void reportWork(Adapt* a, int iteration)
+{
+  if ( ! a->worklist)
+    return;
+  char when[32];
+  snprintf(when, sizeof(when), "iteration %d", iteration);
+  a->worklist->report(when);
+}
+
+static void reportWork(Adapt* a, const char* when)
+{
+  if (a->worklist)
+    a->worklist->report(when);
+}
+
 void adapt(Input* in)
 {
   print("version 2.0 !");
   double t0 = PCU_Time();
   validateInput(in);
   Adapt* a = new Adapt(in);
+  beginPhase(a, "preBalance");
   preBalance(a);
+  endPhase(a);
   for (int i = 0; i < in->maximumIterations; ++i)
   {
     print("iteration %d",i);
+    beginPhase(a, "coarsen", i);
     coarsen(a);
+    endPhase(a);
+    beginPhase(a, "coarsenLayer", i);
     coarsenLayer(a);
+    endPhase(a);
+    beginPhase(a, "midBalance", i);
     midBalance(a);
+    endPhase(a);
+    beginPhase(a, "refine", i);
     refine(a);
+    endPhase(a);
+    beginPhase(a, "snap", i);
     snap(a);
+    endPhase(a);
+    reportWork(a, i);
   }
   allowSplitCollapseOutsideLayer(a);
+  beginPhase(a, "fixElementShapes");
   fixElementShapes(a);
+  endPhase(a);
+  reportWork(a, "shape correction");
+  beginPhase(a, "cleanupLayer");
   cleanupLayer(a);
+  endPhase(a);
+  beginPhase(a, "tetrahedronize");
   tetrahedronize(a);
+  endPhase(a);
   printQuality(a);
+  beginPhase(a, "postBalance");
   postBalance(a);
+  endPhase(a);
+  writeProfile(a);
   Mesh* m = a->mesh;
   delete a;
   delete in;
@@ -57,27 +98,45 @@ void adaptVerbose(Input* in, bool verbose)
   double t0 = PCU_Time();
   validateInput(in);
   Adapt* a = new Adapt(in);
+  beginPhase(a, "preBalance");
   preBalance(a);
+  endPhase(a);
   for (int i = 0; i < in->maximumIterations; ++i)
   {
     print("iteration %d",i);
+    beginPhase(a, "coarsen", i);
     coarsen(a);
+    endPhase(a);
     if (verbose && in->shouldCoarsen)
       ma_dbg::dumpMeshWithQualities(a,i,"after_coarsen");
+    beginPhase(a, "coarsenLayer", i);
     coarsenLayer(a);
+    endPhase(a);
+    beginPhase(a, "midBalance", i);
     midBalance(a);
+    endPhase(a);
+    beginPhase(a, "refine", i);
     refine(a);
+    endPhase(a);
     if (verbose)
       ma_dbg::dumpMeshWithQualities(a,i,"after_refine");
+    beginPhase(a, "snap", i);
     snap(a);
+    endPhase(a);
     if (verbose && in->shouldSnap)
       ma_dbg::dumpMeshWithQualities(a,i,"after_snap");
+    beginPhase(a, "fixElementShapes", i);
     fixElementShapes(a);
+    endPhase(a);
     if (verbose && in->shouldFixShape)
       ma_dbg::dumpMeshWithQualities(a,i,"after_fix");
+    reportWork(a, i);
   }
   allowSplitCollapseOutsideLayer(a);
+  beginPhase(a, "fixElementShapes");
   fixElementShapes(a);
+  endPhase(a);
+  reportWork(a, "shape correction");
   if (verbose) ma_dbg::dumpMeshWithQualities(a,999,"after_final_fix");
   /* The following loop ensures that no long edges are left in
    * the mesh. Note that at this point all elements are of "good"
@@ -89,8 +148,12 @@ void adaptVerbose(Input* in, bool verbose)
   print("Maximum (metric) edge length in the mesh is %f", lMax);
   while (lMax > 1.5) {
     print("%dth additional refine-snap call", count);
+    beginPhase(a, "refine", in->maximumIterations + count);
     refine(a);
+    endPhase(a);
+    beginPhase(a, "snap", in->maximumIterations + count);
     snap(a);
+    endPhase(a);
     lMax = ma::getMaximumEdgeLength(a->mesh, a->sizeField);
     count++;
     print("Maximum (metric) edge length in the mesh is %f", lMax);
@@ -98,10 +161,17 @@ void adaptVerbose(Input* in, bool verbose)
   }
   if (verbose)
     ma_dbg::dumpMeshWithQualities(a,999,"after_final_refine_snap_loop");
+  beginPhase(a, "cleanupLayer");
   cleanupLayer(a);
+  endPhase(a);
+  beginPhase(a, "tetrahedronize");
   tetrahedronize(a);
+  endPhase(a);
   printQuality(a);
+  beginPhase(a, "postBalance");
   postBalance(a);
+  endPhase(a);
+  writeProfile(a);
   Mesh* m = a->mesh;
   delete a;
   delete in;
@@ -38,6 +38,8 @@ class DeleteCallback;
 class SolutionTransfer;
 class Refine;
 class ShapeHandler;
+class Worklist;
+class Profile;
 
 class Adapt
 {
@@ -54,6 +56,8 @@ class Adapt
     SolutionTransfer* solutionTransfer;
     Refine* refine;
     ShapeHandler* shape;
+    Worklist* worklist;
+    Profile* profile;
     int coarsensLeft;
     int refinesLeft;
     bool hasLayer;
@@ -101,6 +105,15 @@ int getClosestPair(Adapt* a, Entity* (*pairs)[2], int n);
 struct Predicate
 {
   virtual bool operator()(Entity* e) = 0;
+  /* predicates that are cheaper to answer for many entities
+     at once return how many they take, and markEntities then
+     asks them through evaluate */
+  virtual size_t getBatchSize() {return 1;}
+  virtual void evaluate(Entity** e, size_t n, bool* answers)
+  {
+    for (size_t i = 0; i < n; ++i)
+      answers[i] = (*this)(e[i]);
+  }
 };
 
 long markEntities(
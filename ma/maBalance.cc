@@ -1,6 +1,7 @@
 #include <PCU.h>
 #include "maBalance.h"
 #include "maAdapt.h"
+#include "maWorklist.h"
 #include <parma.h>
 #include <apfZoltan.h>
 
@@ -97,6 +98,8 @@ static void runBalancer(Adapt* a, apf::Balancer* b)
   Tag* weights = getElementWeights(a);
   b->balance(weights,in->maximumImbalance);
   delete b;
+  if (a->worklist)
+    a->worklist->migrated();
   removeTagFromDimension(m,weights,m->getDimension());
   m->destroyTag(weights);
 }
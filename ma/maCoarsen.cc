@@ -58,7 +58,7 @@ class CollapseChecker : public apf::CavityOp
 void checkAllEdgeCollapses(Adapt* a, int modelDimension)
 {
   CollapseChecker checker(a,modelDimension);
-  checker.applyToDimension(1);
+  applyCavityOp(a, checker, 1, COLLAPSE);
   clearFlagFromDimension(a,CHECKED,1);
   PCU_ALWAYS_ASSERT(checkFlagConsistency(a,1,COLLAPSE));
   PCU_ALWAYS_ASSERT(checkFlagConsistency(a,0,COLLAPSE));
@@ -98,7 +98,7 @@ class IndependentSetFinder : public apf::CavityOp
 void findIndependentSet(Adapt* a)
 {
   IndependentSetFinder finder(a);
-  finder.applyToDimension(0);
+  applyCavityOp(a, finder, 0, COLLAPSE);
   clearFlagFromDimension(a,CHECKED,0);
   PCU_ALWAYS_ASSERT(checkFlagConsistency(a, 0, COLLAPSE));
 }
@@ -117,6 +117,7 @@ class AllEdgeCollapser : public Operator
         qualityToBeat = getAdapt()->input->goodQuality;
     }
     virtual int getTargetDimension() {return 1;}
+    virtual int getTargetFlag() {return COLLAPSE;}
     virtual bool shouldApply(Entity* e)
     {
       Adapt* a = getAdapt();
@@ -153,9 +154,18 @@ class AllEdgeCollapser : public Operator
 
 int collapseAllEdges(Adapt* a, int modelDimension)
 {
-  AllEdgeCollapser collapser(a,modelDimension);
-  applyOperator(a,&collapser);
-  return collapser.successCount;
+  int n = getOperatorThreads(a);
+  std::vector<AllEdgeCollapser*> collapsers(n);
+  for (int i = 0; i < n; ++i)
+    collapsers[i] = new AllEdgeCollapser(a,modelDimension);
+  std::vector<Operator*> ops(collapsers.begin(), collapsers.end());
+  applyOperators(a,&ops[0],n);
+  int successCount = 0;
+  for (int i = 0; i < n; ++i) {
+    successCount += collapsers[i]->successCount;
+    delete collapsers[i];
+  }
+  return successCount;
 }
 
 class MatchedEdgeCollapser : public Operator
@@ -168,6 +178,7 @@ class MatchedEdgeCollapser : public Operator
       successCount = 0;
     }
     virtual int getTargetDimension() {return 1;}
+    virtual int getTargetFlag() {return COLLAPSE;}
     virtual bool shouldApply(Entity* e)
     {
       Adapt* a = getAdapt();
@@ -2,7 +2,7 @@
 #include "maCrawler.h"
 #include "maAdapt.h"
 #include "maLayer.h"
-#include <apfCavityOp.h>
+#include "maOperator.h"
 
 namespace ma {
 
@@ -250,7 +250,7 @@ void flagLayerTop(Adapt* a)
 {
   Tag* layerNumbers = numberLayer(a);
   TopFlagger op(a, layerNumbers);
-  op.applyToDimension(0);
+  applyCavityOp(a, op, 0);
   clearFlagFromDimension(a, CHECKED, 0);
   apf::removeTagFromDimension(a->mesh, layerNumbers, 0);
   a->mesh->destroyTag(layerNumbers);
@@ -63,6 +63,10 @@ void setDefaultValues(Input* in)
   in->shouldRefineLayer = false;
   in->shouldCoarsenLayer = false;
   in->splitAllLayerEdges = false;
+  in->shouldCacheEdgeLengths = false;
+  in->shouldAdaptIncrementally = false;
+  in->workerThreads = 1;
+  in->profileFile = 0;
   in->shapeHandler = 0;
 }
 
@@ -110,6 +114,8 @@ void validateInput(Input* in)
     rejectInput("maximum imbalance less than 1.0");
   if (in->maximumEdgeRatio < 1.0)
     rejectInput("maximum tet edge ratio less than one");
+  if (in->workerThreads < 1)
+    rejectInput("fewer than one worker thread");
 }
 
 void setSolutionTransfer(Input* in, SolutionTransfer* s)
@@ -100,6 +100,33 @@ class Input
     bool shouldCoarsenLayer;
 /** \brief set to true during UR to get splits in the normal direction */
     bool splitAllLayerEdges;
+/** \brief whether the size field should cache edge lengths
+    during adaptation (default false)
+    \details the cache is a tag of seven doubles per edge, the length
+    and the endpoints it was measured with, so it trades that much
+    memory for fewer metric integrations */
+    bool shouldCacheEdgeLengths;
+/** \brief whether passes that mark edges and elements only visit
+    those created or changed since the last pass (default false)
+    \details gives the same result as visiting the whole mesh,
+    and prints how many entities each iteration visited */
+    bool shouldAdaptIncrementally;
+/** \brief the threads each process applies edge collapses on
+    (default 1)
+    \details collapses whose cavities share no vertices are grouped
+    into batches that run at the same time on an MDS mesh.
+    Other meshes, layered or matched meshes and configurations that
+    transfer fields or fit curved shapes use one thread.
+    The size function is then called from several threads at once,
+    so it must be safe to do so. */
+    int workerThreads;
+/** \brief if set, ma::adapt and crv::adapt write the time and work
+    of each phase to this CSV file (default none)
+    \details times are given as the minimum, maximum and average
+    over processes, work as global totals of the entities examined,
+    CavityOp applications, elements created and destroyed,
+    CavityOp pull rounds and elements migrated by them */
+    const char* profileFile;
 /** \brief this a folder that debugging meshes will be written to, if provided! */
     const char* debugFolder;
 };
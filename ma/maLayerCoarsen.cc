@@ -5,6 +5,7 @@
 #include "maCoarsen.h"
 #include "maCrawler.h"
 #include "maLayerCollapse.h"
+#include "maWorklist.h"
 #include <pcu_util.h>
 
 /* see maCoarsen.cc for the unstructured equivalent. */
@@ -187,6 +188,8 @@ static void migrateForLayerCollapse(Adapt* a, int d, int round)
   /* before looking for a fix, lets just detect if this ever happens */
   PCU_ALWAYS_ASSERT( ! wouldEmptyParts(plan));
   a->mesh->migrate(plan);
+  if (a->worklist)
+    a->worklist->migrated();
 }
 
 void localizeLayerStacks(Mesh* m) {
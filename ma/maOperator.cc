@@ -9,6 +9,8 @@
 *******************************************************************************/
 #include "maOperator.h"
 #include "maAdapt.h"
+#include "maProfile.h"
+#include "maWorklist.h"
 
 namespace ma {
 
@@ -46,7 +48,23 @@ Operator::~Operator() {}
 void applyOperator(Adapt* a, Operator* o)
 {
   CollectiveOperation op(a,o);
-  op.applyToDimension(o->getTargetDimension());
+  applyCavityOp(a, op, o->getTargetDimension(), o->getTargetFlag());
+}
+
+void applyCavityOp(Adapt* a, apf::CavityOp& op, int dimension,
+    int targetFlag)
+{
+  Worklist* w = a->worklist;
+  if (w && (w->getTargets(dimension) & targetFlag)) {
+    std::vector<Entity*> targets;
+    w->getTargeted(targetFlag, dimension, targets);
+    op.applyToEntities(dimension, targets);
+  } else
+    op.applyToDimension(dimension);
+  if (a->worklist && op.getCounts().pulls)
+    a->worklist->migrated();
+  if (a->profile)
+    a->profile->add(op.getCounts());
 }
 
 }
@@ -23,10 +23,33 @@ class Operator
     virtual bool shouldApply(Entity* e) = 0;
     virtual bool requestLocality(apf::CavityOp* o) = 0;
     virtual void apply() = 0;
+    /* operators that only apply to entities with this flag set
+       return it, so that incremental adaptation visits just those */
+    virtual int getTargetFlag() {return 0;}
 };
 
 void applyOperator(Adapt* a, Operator* o);
 
+/* the threads operators on edges can be applied on,
+   one unless Input::workerThreads allows more and the
+   mesh and configuration support it, see maThreads.cc */
+int getOperatorThreads(Adapt* a);
+
+/* applies ops[i] on thread i to batches of edges whose operators
+   change disjoint parts of the mesh, then ops[0] to the
+   remaining ones like applyOperator. The operators must only
+   change the elements around the vertices of their edge. */
+void applyOperators(Adapt* a, Operator** ops, int n);
+
+/* runs op over a dimension, tells the worklist if it migrated
+   the mesh and adds its work to the adapt profile.
+   If op skips entities without targetFlag, the worklist
+   may give it just the flagged ones.
+   Every CavityOp run during adapt goes through here, since the
+   profile phases only see the work of the ops it was given */
+void applyCavityOp(Adapt* a, apf::CavityOp& op, int dimension,
+    int targetFlag = 0);
+
 }
 
 #endif
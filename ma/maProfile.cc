@@ -0,0 +1,157 @@
+/******************************************************************************
+
+  Copyright 2013 Scientific Computation Research Center,
+      Rensselaer Polytechnic Institute. All rights reserved.
+
+  The LICENSE file included with this distribution describes the terms
+  of the SCOREC Non-Commercial License this program is distributed under.
+
+*******************************************************************************/
+#include <PCU.h>
+#include "maProfile.h"
+#include "maAdapt.h"
+#include "maInput.h"
+#include <pcu_util.h>
+#include <cstdio>
+
+namespace ma {
+
+Profile::Profile(Adapt* a)
+{
+  adapt = a;
+  examined = 0;
+  destroyed = 0;
+  cavity = apf::CavityOpCounts();
+  current.phase = 0;
+}
+
+void Profile::add(apf::CavityOpCounts const& c)
+{
+  cavity.examined += c.examined;
+  cavity.applied += c.applied;
+  cavity.rounds += c.rounds;
+  cavity.pulls += c.pulls;
+  cavity.migrated += c.migrated;
+}
+
+void Profile::begin(const char* phase, int iteration)
+{
+  PCU_ALWAYS_ASSERT( ! current.phase);
+  current.phase = phase;
+  current.iteration = iteration;
+  current.examined = examined;
+  current.destroyed = destroyed;
+  Mesh* m = adapt->mesh;
+  current.elementsBefore = m->count(m->getDimension());
+  start = cavity;
+  startTime = PCU_Time();
+}
+
+void Profile::end()
+{
+  PCU_ALWAYS_ASSERT(current.phase);
+  current.time = PCU_Time() - startTime;
+  apf::CavityOpCounts const& now = cavity;
+  current.examined = examined - current.examined +
+    (now.examined - start.examined);
+  current.applied = now.applied - start.applied;
+  current.destroyed = destroyed - current.destroyed;
+  current.rounds = now.rounds - start.rounds;
+  current.pulls = now.pulls - start.pulls;
+  current.migrated = now.migrated - start.migrated;
+  Mesh* m = adapt->mesh;
+  current.elements = m->count(m->getDimension());
+  records.push_back(current);
+  current.phase = 0;
+}
+
+/* the per-process columns, in the order they are reduced */
+enum { TIME_MIN, TIME_MAX, TIME_SUM, TIMES };
+enum { EXAMINED_MIN, EXAMINED_MAX, EXAMINED_SUM, APPLIED, DESTROYED,
+       ROUNDS, PULLS, MIGRATED_SUM, MIGRATED_MAX, COUNTS };
+enum { CHANGE, ELEMENTS, LONGS };
+
+void Profile::write(const char* filename)
+{
+  size_t n = records.size();
+  std::vector<double> times(n * TIMES);
+  std::vector<size_t> counts(n * COUNTS);
+  std::vector<long> elements(n * LONGS);
+  for (size_t i = 0; i < n; ++i) {
+    Record& r = records[i];
+    double* t = &times[i * TIMES];
+    t[TIME_MIN] = t[TIME_MAX] = t[TIME_SUM] = r.time;
+    size_t* c = &counts[i * COUNTS];
+    c[EXAMINED_MIN] = c[EXAMINED_MAX] = c[EXAMINED_SUM] = r.examined;
+    c[APPLIED] = r.applied;
+    c[DESTROYED] = r.destroyed;
+    c[ROUNDS] = r.rounds;
+    c[PULLS] = r.pulls;
+    c[MIGRATED_SUM] = c[MIGRATED_MAX] = r.migrated;
+    elements[i * LONGS + CHANGE] = r.elements - r.elementsBefore;
+    elements[i * LONGS + ELEMENTS] = r.elements;
+  }
+  /* reduce every column over all processes, then pick
+     the reduction each column wants */
+  std::vector<double> minTimes(times);
+  std::vector<double> maxTimes(times);
+  PCU_Min_Doubles(&minTimes[0], minTimes.size());
+  PCU_Max_Doubles(&maxTimes[0], maxTimes.size());
+  PCU_Add_Doubles(&times[0], times.size());
+  std::vector<size_t> minCounts(counts);
+  std::vector<size_t> maxCounts(counts);
+  PCU_Min_SizeTs(&minCounts[0], minCounts.size());
+  PCU_Max_SizeTs(&maxCounts[0], maxCounts.size());
+  PCU_Add_SizeTs(&counts[0], counts.size());
+  PCU_Add_Longs(&elements[0], elements.size());
+  if (PCU_Comm_Self())
+    return;
+  FILE* f = fopen(filename, "w");
+  if ( ! f) {
+    print("could not open profile file %s", filename);
+    return;
+  }
+  fprintf(f, "phase,iteration,time_min,time_max,time_avg,"
+      "examined_min,examined_max,examined,applied,created,destroyed,"
+      "rounds,pulls,migrated,migrated_max,elements\n");
+  int peers = PCU_Comm_Peers();
+  for (size_t i = 0; i < n; ++i) {
+    size_t* c = &counts[i * COUNTS];
+    size_t* cmin = &minCounts[i * COUNTS];
+    size_t* cmax = &maxCounts[i * COUNTS];
+    long* e = &elements[i * LONGS];
+    /* migration moves elements without creating them,
+       so only the global change is meaningful */
+    long created = e[CHANGE] + long(c[DESTROYED]);
+    fprintf(f, "%s,%d,%f,%f,%f,%lu,%lu,%lu,%lu,%ld,%lu,%lu,%lu,%lu,%lu,%ld\n",
+        records[i].phase, records[i].iteration,
+        minTimes[i * TIMES + TIME_MIN], maxTimes[i * TIMES + TIME_MAX],
+        times[i * TIMES + TIME_SUM] / peers,
+        (unsigned long)cmin[EXAMINED_MIN], (unsigned long)cmax[EXAMINED_MAX],
+        (unsigned long)c[EXAMINED_SUM], (unsigned long)c[APPLIED], created,
+        (unsigned long)c[DESTROYED], (unsigned long)cmax[ROUNDS],
+        (unsigned long)cmax[PULLS], (unsigned long)c[MIGRATED_SUM],
+        (unsigned long)cmax[MIGRATED_MAX], e[ELEMENTS]);
+  }
+  fclose(f);
+}
+
+void beginPhase(Adapt* a, const char* phase, int iteration)
+{
+  if (a->profile)
+    a->profile->begin(phase, iteration);
+}
+
+void endPhase(Adapt* a)
+{
+  if (a->profile)
+    a->profile->end();
+}
+
+void writeProfile(Adapt* a)
+{
+  if (a->profile)
+    a->profile->write(a->input->profileFile);
+}
+
+}
@@ -0,0 +1,71 @@
+/******************************************************************************
+
+  Copyright 2013 Scientific Computation Research Center,
+      Rensselaer Polytechnic Institute. All rights reserved.
+
+  The LICENSE file included with this distribution describes the terms
+  of the SCOREC Non-Commercial License this program is distributed under.
+
+*******************************************************************************/
+#ifndef MA_PROFILE_H
+#define MA_PROFILE_H
+
+#include <apfCavityOp.h>
+#include <vector>
+#include <cstddef>
+
+namespace ma {
+
+class Adapt;
+
+/* records the wall time and the work of each phase of adapt.
+   Phases are collective, so every process records the same
+   sequence of them and write() can combine the records of all
+   processes one column at a time. */
+class Profile
+{
+  public:
+    Profile(Adapt* a);
+    /* iteration is -1 for phases outside the main loop */
+    void begin(const char* phase, int iteration);
+    void end();
+    /* writes one CSV row per phase, from rank 0 */
+    void write(const char* filename);
+    /* entities checked by the marking passes */
+    size_t examined;
+    /* elements destroyed by ma::destroyElement */
+    size_t destroyed;
+    /* adds the work of a finished CavityOp */
+    void add(apf::CavityOpCounts const& c);
+  private:
+    struct Record
+    {
+      const char* phase;
+      int iteration;
+      double time;
+      size_t examined;
+      size_t applied;
+      size_t destroyed;
+      size_t rounds;
+      size_t pulls;
+      size_t migrated;
+      long elements;
+      long elementsBefore;
+    };
+    Adapt* adapt;
+    std::vector<Record> records;
+    Record current;
+    /* the work of all CavityOps so far, and at the phase start */
+    apf::CavityOpCounts cavity;
+    apf::CavityOpCounts start;
+    double startTime;
+};
+
+/* these do nothing unless Input::profileFile is set */
+void beginPhase(Adapt* a, const char* phase, int iteration = -1);
+void endPhase(Adapt* a);
+void writeProfile(Adapt* a);
+
+}
+
+#endif
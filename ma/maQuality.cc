@@ -11,6 +11,7 @@
 #include <cfloat>
 #include <pcu_util.h>
 #include <cstdlib>
+#include <algorithm>
 #include "maMesh.h"
 #include "maSize.h"
 #include "maAdapt.h"
@@ -186,24 +187,25 @@ double getWorstQuality(Adapt* a, Entity** e, size_t n)
   PCU_ALWAYS_ASSERT(n);
   Mesh* m = a->mesh;
   ShapeHandler* sh = a->shape;
-  double worst;
-  if (m->hasTag(e[0], a->qualityCache))
-    worst = getCachedQuality(a, e[0]);
-  else {
-    worst = sh->getQuality(e[0]);
-    setCachedQuality(a, e[0], worst);
-  }
-  for (size_t i = 1; i < n; ++i) {
-    double quality;
-    if (m->hasTag(e[i], a->qualityCache)) {
-      quality = getCachedQuality(a, e[i]);
+  double worst = DBL_MAX;
+  size_t i = 0;
+  while (i < n) {
+    /* measure the elements missing from the cache in one batch */
+    Entity* missing[QUALITY_CHUNK];
+    double quality[QUALITY_CHUNK];
+    size_t k = 0;
+    for (; i < n && k < QUALITY_CHUNK; ++i) {
+      if (m->hasTag(e[i], a->qualityCache))
+        worst = std::min(worst, getCachedQuality(a, e[i]));
+      else
+        missing[k++] = e[i];
     }
-    else {
-      quality = sh->getQuality(e[i]);
-      setCachedQuality(a, e[i], quality);
+    if (k)
+      sh->getQualities(missing, k, quality);
+    for (size_t j = 0; j < k; ++j) {
+      setCachedQuality(a, missing[j], quality[j]);
+      worst = std::min(worst, quality[j]);
     }
-    if (quality < worst)
-      worst = quality;
   }
   return worst;
 }
@@ -217,10 +219,13 @@ bool hasWorseQuality(Adapt* a, EntityArray& e, double qualityToBeat)
 {
   size_t n = e.getSize();
   ShapeHandler* sh = a->shape;
-  for (size_t i = 0; i < n; ++i) {
-    double quality = sh->getQuality(e[i]);
-    if (quality < qualityToBeat)
-      return true;
+  for (size_t i = 0; i < n; i += QUALITY_CHUNK) {
+    size_t k = std::min(n - i, size_t(QUALITY_CHUNK));
+    double quality[QUALITY_CHUNK];
+    sh->getQualities(&(e[i]), k, quality);
+    for (size_t j = 0; j < k; ++j)
+      if (quality[j] < qualityToBeat)
+        return true;
   }
   return false;
 }
@@ -477,6 +482,321 @@ double measureQuadraticTetQuality(Mesh* m, Entity* tet)
   return measureQuadraticTetQuality(xyz);
 }
 
+/* the batch measures below work on blocks of a fixed number of
+   elements stored as structures of arrays, x[i][e] being the i'th
+   coordinate of element e, so that every loop over the elements of a
+   block has a constant trip count and no branches and the compiler
+   can vectorize it.  Blocks that are not full repeat their last
+   element.  Keeping all the arrays of a block in one object lets the
+   compiler see that they do not overlap. */
+
+enum { BLOCK = 16 };
+
+static double lengthSquared(double a, double b, double c)
+{
+  return a * a + b * b + c * c;
+}
+
+/* the control points of a quadratic Bezier tet indexed as
+   tetCtrlPts[i][j][k] in measureBezierTetQuality */
+static int bezierNode(int i, int j, int k)
+{
+  static int const table[3][3][3] =
+  {{{0,7,3},{6,9,-1},{2,-1,-1}}
+  ,{{4,8,-1},{5,-1,-1},{-1,-1,-1}}
+  ,{{1,-1,-1},{-1,-1,-1},{-1,-1,-1}}};
+  return table[i][j][k];
+}
+
+/* the 4 derivative directions of a quadratic Bezier tet, as the
+   index triples of the du, dv and dw arrays of measureBezierTetQuality */
+static int const bezierDerivatives[4][3] =
+{{0,0,0},{0,0,1},{0,1,0},{1,0,0}};
+
+struct QualityBlock
+{
+  /* up to 10 nodes */
+  double x[30][BLOCK];
+  /* the size field transforms */
+  double Q[9][BLOCK];
+  double q[BLOCK];
+  void load(int rows, int n, double const* from, int first, int count,
+      double (*to)[BLOCK])
+  {
+    for (int i = 0; i < rows; ++i) {
+      double const* row = from + i * n + first;
+      for (int e = 0; e < count; ++e)
+        to[i][e] = row[e];
+    }
+    pad(rows, count, to);
+  }
+  void pad(int rows, int count, double (*to)[BLOCK])
+  {
+    for (int i = 0; i < rows; ++i)
+      for (int e = count; e < BLOCK; ++e)
+        to[i][e] = to[i][count - 1];
+  }
+  void setPoint(int node, int e, Vector const& p)
+  {
+    for (int j = 0; j < 3; ++j)
+      x[3 * node + j][e] = p[j];
+  }
+  /* replaces x with transpose(Q) * x for each node, as the
+     integrators of measureTetQuality do to the tangent vectors */
+  void transform(int nodes)
+  {
+    for (int i = 0; i < nodes; ++i)
+      for (int e = 0; e < BLOCK; ++e) {
+        double a = x[3 * i + 0][e];
+        double b = x[3 * i + 1][e];
+        double c = x[3 * i + 2][e];
+        x[3 * i + 0][e] = Q[0][e] * a + Q[3][e] * b + Q[6][e] * c;
+        x[3 * i + 1][e] = Q[1][e] * a + Q[4][e] * b + Q[7][e] * c;
+        x[3 * i + 2][e] = Q[2][e] * a + Q[5][e] * b + Q[8][e] * c;
+      }
+  }
+  void measureLinearTets()
+  {
+    for (int e = 0; e < BLOCK; ++e) {
+      double a0 = x[3][e] - x[0][e];
+      double a1 = x[4][e] - x[1][e];
+      double a2 = x[5][e] - x[2][e];
+      double b0 = x[6][e] - x[0][e];
+      double b1 = x[7][e] - x[1][e];
+      double b2 = x[8][e] - x[2][e];
+      double c0 = x[9][e] - x[0][e];
+      double c1 = x[10][e] - x[1][e];
+      double c2 = x[11][e] - x[2][e];
+      double j = a0 * (b1 * c2 - b2 * c1)
+               + a1 * (b2 * c0 - b0 * c2)
+               + a2 * (b0 * c1 - b1 * c0);
+      double s = lengthSquared(a0, a1, a2)
+               + lengthSquared(b0, b1, b2)
+               + lengthSquared(c0, c1, c2)
+               + lengthSquared(b0 - a0, b1 - a1, b2 - a2)
+               + lengthSquared(c0 - a0, c1 - a1, c2 - a2)
+               + lengthSquared(c0 - b0, c1 - b1, c2 - b2);
+      /* 15552 V^2 / s^3 with V = j / 6 */
+      double r = 432 * j * j / (s * s * s);
+      q[e] = j < 0 ? -r : r;
+    }
+  }
+  void measureLinearTris()
+  {
+    for (int e = 0; e < BLOCK; ++e) {
+      double a0 = x[3][e] - x[0][e];
+      double a1 = x[4][e] - x[1][e];
+      double a2 = x[5][e] - x[2][e];
+      double b0 = x[6][e] - x[0][e];
+      double b1 = x[7][e] - x[1][e];
+      double b2 = x[8][e] - x[2][e];
+      double s = lengthSquared(a0, a1, a2)
+               + lengthSquared(b0, b1, b2)
+               + lengthSquared(b0 - a0, b1 - a1, b2 - a2);
+      double c = lengthSquared(a1 * b2 - a2 * b1,
+                               a2 * b0 - a0 * b2,
+                               a0 * b1 - a1 * b0);
+      /* 48 A^2 / s^2 with A = |c| / 2 */
+      q[e] = 12 * c / (s * s);
+    }
+  }
+  void measureLinear(int nodes)
+  {
+    if (nodes == 4)
+      measureLinearTets();
+    else
+      measureLinearTris();
+  }
+  /* the same as measureQuadraticTetQuality, x having the 4 vertices
+     and then the 6 edge nodes */
+  void measureQuadraticTets()
+  {
+    measureLinearTets();
+    /* edge nodes to Bezier control points */
+    double p[30][BLOCK];
+    for (int i = 0; i < 12; ++i)
+      for (int e = 0; e < BLOCK; ++e)
+        p[i][e] = x[i][e];
+    for (int i = 0; i < 6; ++i) {
+      int const* ev = apf::tet_edge_verts[i];
+      for (int j = 0; j < 3; ++j)
+        for (int e = 0; e < BLOCK; ++e)
+          p[12 + 3 * i + j][e] = ((x[12 + 3 * i + j][e] * 4.0) -
+              (x[3 * ev[0] + j][e] + x[3 * ev[1] + j][e])) / 2.0;
+    }
+    /* the derivative control points along the 3 parametric directions */
+    double d[3][4][3][BLOCK];
+    for (int a = 0; a < 3; ++a)
+      for (int b = 0; b < 4; ++b) {
+        int const* ijk = bezierDerivatives[b];
+        int up[3] = {ijk[0], ijk[1], ijk[2]};
+        ++up[a];
+        int from = bezierNode(ijk[0], ijk[1], ijk[2]);
+        int to = bezierNode(up[0], up[1], up[2]);
+        for (int j = 0; j < 3; ++j)
+          for (int e = 0; e < BLOCK; ++e)
+            d[a][b][j][e] = p[3 * to + j][e] - p[3 * from + j][e];
+      }
+    /* the 20 control points of the Jacobian determinant, summed
+       in the same order as measureBezierTetQuality */
+    double jac[4][4][4][BLOCK];
+    for (int i = 0; i < 4; ++i)
+      for (int j = 0; j < 4 - i; ++j)
+        for (int k = 0; k < 4 - i - j; ++k)
+          for (int e = 0; e < BLOCK; ++e)
+            jac[i][j][k][e] = 0;
+    for (int u = 0; u < 4; ++u)
+    for (int v = 0; v < 4; ++v)
+    for (int w = 0; w < 4; ++w) {
+      int const* iu = bezierDerivatives[u];
+      int const* iv = bezierDerivatives[v];
+      int const* iw = bezierDerivatives[w];
+      double* target = jac[iu[0] + iv[0] + iw[0]]
+                          [iu[1] + iv[1] + iw[1]]
+                          [iu[2] + iv[2] + iw[2]];
+      double (*du)[BLOCK] = d[0][u];
+      double (*dv)[BLOCK] = d[1][v];
+      double (*dw)[BLOCK] = d[2][w];
+      for (int e = 0; e < BLOCK; ++e) {
+        double c0 = du[1][e] * dv[2][e] - du[2][e] * dv[1][e];
+        double c1 = du[2][e] * dv[0][e] - du[0][e] * dv[2][e];
+        double c2 = du[0][e] * dv[1][e] - du[1][e] * dv[0][e];
+        target[e] += (c0 * dw[0][e] + c1 * dw[1][e] + c2 * dw[2][e]) * 8.0;
+      }
+    }
+    double minJ[BLOCK];
+    for (int e = 0; e < BLOCK; ++e)
+      minJ[e] = DBL_MAX;
+    for (int i = 0; i < 4; ++i)
+      for (int j = 0; j < 4 - i; ++j)
+        for (int k = 0; k < 4 - i - j; ++k) {
+          double coeff = double(factorial(3)) /
+            double(factorial(i) * factorial(j) * factorial(k) *
+                   factorial(3 - i - j - k));
+          for (int e = 0; e < BLOCK; ++e) {
+            double c = jac[i][j][k][e] / coeff;
+            minJ[e] = c < minJ[e] ? c : minJ[e];
+          }
+        }
+    /* the linear quality, unless either measure says invalid */
+    for (int e = 0; e < BLOCK; ++e) {
+      double r = minJ[e] <= 0 ? minJ[e] : q[e];
+      q[e] = q[e] <= 0 ? q[e] : r;
+    }
+  }
+};
+
+static void measureLinearQualities(int nodes, int n, double const* xyz,
+    double const* Q, double* q)
+{
+  QualityBlock b;
+  for (int first = 0; first < n; first += BLOCK) {
+    int count = std::min(n - first, int(BLOCK));
+    b.load(nodes * 3, n, xyz, first, count, b.x);
+    if (Q) {
+      b.load(9, n, Q, first, count, b.Q);
+      b.transform(nodes);
+    }
+    b.measureLinear(nodes);
+    for (int e = 0; e < count; ++e)
+      q[first + e] = b.q[e];
+  }
+}
+
+void measureLinearTetQualities(int n, double const* xyz, double const* Q,
+    double* q)
+{
+  measureLinearQualities(4, n, xyz, Q, q);
+}
+
+void measureLinearTriQualities(int n, double const* xyz, double const* Q,
+    double* q)
+{
+  measureLinearQualities(3, n, xyz, Q, q);
+}
+
+void measureQuadraticTetQualities(int n, double const* xyz, double* q)
+{
+  QualityBlock b;
+  for (int first = 0; first < n; first += BLOCK) {
+    int count = std::min(n - first, int(BLOCK));
+    b.load(30, n, xyz, first, count, b.x);
+    b.measureQuadraticTets();
+    for (int e = 0; e < count; ++e)
+      q[first + e] = b.q[e];
+  }
+}
+
+void measureElementQualities(Mesh* m, SizeField* f, Entity** es, int n,
+    double* q)
+{
+  QualityBlock b;
+  int count;
+  for (int first = 0; first < n; first += count) {
+    count = std::min(n - first, int(BLOCK));
+    int type = m->getType(es[first]);
+    /* a block holds one type of element */
+    for (int e = 1; e < count; ++e)
+      if (m->getType(es[first + e]) != type) {
+        count = e;
+        break;
+      }
+    PCU_ALWAYS_ASSERT(type == apf::Mesh::TRIANGLE ||
+                      type == apf::Mesh::TET);
+    int nodes = 0;
+    for (int e = 0; e < count; ++e) {
+      Entity* elem = es[first + e];
+      Downward dv;
+      nodes = m->getDownward(elem, 0, dv);
+      for (int i = 0; i < nodes; ++i) {
+        Vector p;
+        m->getPoint(dv[i], 0, p);
+        b.setPoint(i, e, p);
+      }
+      Matrix Q = getMetricWithMaxJacobean(m, f, elem);
+      for (int i = 0; i < 3; ++i)
+        for (int j = 0; j < 3; ++j)
+          b.Q[3 * i + j][e] = Q[i][j];
+    }
+    b.pad(nodes * 3, count, b.x);
+    b.pad(9, count, b.Q);
+    b.transform(nodes);
+    b.measureLinear(nodes);
+    for (int e = 0; e < count; ++e)
+      q[first + e] = b.q[e];
+  }
+}
+
+void measureQuadraticTetQualities(Mesh* m, Entity** tets, int n, double* q)
+{
+  QualityBlock b;
+  for (int first = 0; first < n; first += BLOCK) {
+    int count = std::min(n - first, int(BLOCK));
+    for (int e = 0; e < count; ++e) {
+      Entity* tet = tets[first + e];
+      PCU_ALWAYS_ASSERT(m->getType(tet) == apf::Mesh::TET);
+      Entity* v[4];
+      m->getDownward(tet, 0, v);
+      for (int i = 0; i < 4; ++i) {
+        Vector p;
+        m->getPoint(v[i], 0, p);
+        b.setPoint(i, e, p);
+      }
+      Entity* ed[6];
+      m->getDownward(tet, 1, ed);
+      for (int i = 0; i < 6; ++i) {
+        Vector p;
+        m->getPoint(ed[i], 0, p);
+        b.setPoint(4 + i, e, p);
+      }
+    }
+    b.pad(30, count, b.x);
+    b.measureQuadraticTets();
+    for (int e = 0; e < count; ++e)
+      q[first + e] = b.q[e];
+  }
+}
+
 static int unrotate_prism_diagonal_code(int code, int rot)
 {
   static int const shift_table[6] = {0,1,2,2,0,1};
@@ -86,6 +86,14 @@ struct IsBadQuality : public Predicate
   {
     return a->shape->getQuality(e) < a->input->goodQuality;
   }
+  size_t getBatchSize() {return QUALITY_CHUNK;}
+  void evaluate(Entity** e, size_t n, bool* answers)
+  {
+    double quality[QUALITY_CHUNK];
+    a->shape->getQualities(e, n, quality);
+    for (size_t i = 0; i < n; ++i)
+      answers[i] = quality[i] < a->input->goodQuality;
+  }
   Adapt* a;
 };
 
@@ -147,6 +155,7 @@ class ShortEdgeFixer : public Operator
     {
     }
     virtual int getTargetDimension() {return mesh->getDimension();}
+    virtual int getTargetFlag() {return BAD_QUALITY;}
     virtual bool shouldApply(Entity* e)
     {
       if ( ! getFlag(adapter,e,BAD_QUALITY))
@@ -424,6 +433,7 @@ class LargeAngleTetFixer : public Operator
     {
     }
     virtual int getTargetDimension() {return 3;}
+    virtual int getTargetFlag() {return BAD_QUALITY;}
     enum { EDGE_EDGE, FACE_VERT };
     virtual bool shouldApply(Entity* e)
     {
@@ -477,6 +487,7 @@ class LargeAngleTetAligner : public Operator
     {
     }
     virtual int getTargetDimension() {return 3;}
+    virtual int getTargetFlag() {return BAD_QUALITY;}
     virtual bool shouldApply(Entity* e)
     {
       if ( ! getFlag(adapter,e,BAD_QUALITY))
@@ -531,6 +542,7 @@ class LargeAngleTriFixer : public Operator
       delete edgeSwap;
     }
     virtual int getTargetDimension() {return 2;}
+    virtual int getTargetFlag() {return BAD_QUALITY;}
     virtual bool shouldApply(Entity* e)
     {
       if ( ! getFlag(adapter,e,BAD_QUALITY))
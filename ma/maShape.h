@@ -31,6 +31,29 @@ double measureElementQuality(Mesh* m, SizeField* f, Entity* e, bool useMax=true)
 double measureLinearTetQuality(Vector xyz[4]);
 double measureQuadraticTetQuality(Mesh* m, Entity* tet);
 
+/* batch versions of the measures above for n elements at once,
+ * vectorized over the elements. Coordinate d of node i of element e
+ * is xyz[(3*i+d)*n+e], and entry (i,j) of the size field transform
+ * chosen for element e, as measureTetQuality(useMax) would,
+ * is Q[(3*i+j)*n+e]. Q may be null to measure in real space.
+ */
+void measureLinearTetQualities(int n, double const* xyz, double const* Q,
+    double* q);
+void measureLinearTriQualities(int n, double const* xyz, double const* Q,
+    double* q);
+/* quadratic tets have their 4 vertices followed by their 6 edge nodes */
+void measureQuadraticTetQualities(int n, double const* xyz, double* q);
+/* packs the elements of a linear mesh and measures them in batches,
+ * agreeing with measureElementQuality up to roundoff
+ */
+void measureElementQualities(Mesh* m, SizeField* f, Entity** e, int n,
+    double* q);
+void measureQuadraticTetQualities(Mesh* m, Entity** tets, int n, double* q);
+
+/* the cavities seen by the operators are small, so they
+   are measured in chunks of this many elements on the stack */
+enum { QUALITY_CHUNK = 64 };
+
 double getWorstQuality(Adapt* a, EntityArray& e);
 double getWorstQuality(Adapt* a, Entity** e, size_t n);
 
@@ -28,6 +28,10 @@ class LinearHandler : public ShapeHandler
     {
       return measureElementQuality(mesh, sizeField, e);
     }
+    virtual void getQualities(Entity** e, size_t n, double* q)
+    {
+      measureElementQualities(mesh, sizeField, e, n, q);
+    }
     virtual bool hasNodesOn(int dimension)
     {
       return dimension == 0;
@@ -63,6 +67,10 @@ class QuadraticHandler : public ShapeHandler
       PCU_ALWAYS_ASSERT( mesh->getType(e) == apf::Mesh::TET );
       return measureQuadraticTetQuality(mesh,e);
     }
+    virtual void getQualities(Entity** e, size_t n, double* q)
+    {
+      measureQuadraticTetQualities(mesh, e, n, q);
+    }
     virtual bool hasNodesOn(int dimension)
     {
       return st->hasNodesOn(dimension);
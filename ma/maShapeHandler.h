@@ -11,6 +11,13 @@ class ShapeHandler : public SolutionTransfer
 {
   public:
     virtual double getQuality(Entity* e) = 0;
+    /* measures n elements at once, handlers that can
+       vectorize over elements override this */
+    virtual void getQualities(Entity** e, size_t n, double* q)
+    {
+      for (size_t i = 0; i < n; ++i)
+        q[i] = getQuality(e[i]);
+    }
 };
 
 ShapeHandler* getShapeHandler(Adapt* a);
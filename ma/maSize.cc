@@ -11,6 +11,7 @@
 #include "maSize.h"
 #include "apfMatrix.h"
 #include <apfShape.h>
+#include <apfIntegrate.h>
 #include <cstdlib>
 #include <pcu_util.h>
 
@@ -20,6 +21,10 @@ SizeField::~SizeField()
 {
 }
 
+void SizeField::cacheEdgeLengths(bool)
+{
+}
+
 IdentitySizeField::IdentitySizeField(Mesh* m):
   mesh(m)
 {
@@ -177,15 +182,140 @@ class SizeFieldIntegrator : public apf::Integrator
     int dimension;
 };
 
+/* the values of the linear Lagrange shape functions at xi,
+   which for simplices need no allocation. returns the
+   number of vertices, or zero for other types */
+static int getLinearValues(int type, Vector const& xi, double* N)
+{
+  switch (type) {
+    case apf::Mesh::VERTEX:
+      N[0] = 1;
+      return 1;
+    case apf::Mesh::EDGE:
+      N[0] = (1 - xi[0]) / 2;
+      N[1] = (1 + xi[0]) / 2;
+      return 2;
+    case apf::Mesh::TRIANGLE:
+      N[0] = 1 - xi[0] - xi[1];
+      N[1] = xi[0];
+      N[2] = xi[1];
+      return 3;
+    case apf::Mesh::TET:
+      N[0] = 1 - xi[0] - xi[1] - xi[2];
+      N[1] = xi[0];
+      N[2] = xi[1];
+      N[3] = xi[2];
+      return 4;
+  }
+  return 0;
+}
+
+static bool isSameEdge(double const* cached, Vector const* x)
+{
+  for (int i = 0; i < 2; ++i)
+  for (int j = 0; j < 3; ++j)
+    if (cached[1 + i * 3 + j] != x[i][j])
+      return false;
+  return true;
+}
+
+/* metric size fields whose values live on the vertices with
+   linear Lagrange shapes can be evaluated straight from the
+   vertex values, without building field elements. */
 struct MetricSizeField : public SizeField
 {
+  MetricSizeField():
+    mesh(0),
+    linearValues(false),
+    lengthTag(0)
+  {
+  }
+  ~MetricSizeField()
+  {
+    cacheEdgeLengths(false);
+  }
+  /* the transform at a point given the values
+     of the vertex shape functions there */
+  virtual void getVertexTransform(int n, Entity* const* verts,
+      double const* N, Matrix& Q) = 0;
+  bool getVertexWeights(apf::MeshElement* me, Vector const& xi,
+      apf::Downward verts, int& n, double* N)
+  {
+    if (!linearValues)
+      return false;
+    Entity* e = apf::getMeshEntity(me);
+    n = getLinearValues(mesh->getType(e), xi, N);
+    if (!n)
+      return false;
+    if (n == 1)
+      verts[0] = e;
+    else
+      mesh->getDownward(e, 0, verts);
+    return true;
+  }
+  bool isStraightSimplex(int type)
+  {
+    return linearValues &&
+           type != apf::Mesh::VERTEX &&
+           apf::isSimplex(type) &&
+           mesh->getShape()->getOrder() == 1;
+  }
+  /* straight-sided simplices have a constant Jacobian,
+     so only the transform changes between points */
+  double measureSimplex(int type, Entity* const* verts, Vector const* x)
+  {
+    int dimension = apf::Mesh::typeDimension[type];
+    Matrix J(0,0,0,
+             0,0,0,
+             0,0,0);
+    if (type == apf::Mesh::EDGE)
+      J[0] = (x[1] - x[0]) / 2;
+    else
+      for (int i = 0; i < dimension; ++i)
+        J[i] = x[i + 1] - x[0];
+    apf::Integration const* in = apf::getIntegration(type)->getAccurate(2);
+    int np = in->countPoints();
+    double measurement = 0;
+    for (int p = 0; p < np; ++p) {
+      apf::IntegrationPoint const* ip = in->getPoint(p);
+      double N[4];
+      int n = getLinearValues(type, ip->param, N);
+      Matrix Q;
+      getVertexTransform(n, verts, N, Q);
+      measurement += ip->weight * apf::getJacobianDeterminant(J * Q, dimension);
+    }
+    return measurement;
+  }
   double measure(Entity* e)
   {
-    SizeFieldIntegrator sFI(this); 
-    apf::MeshElement* me = apf::createMeshElement(mesh, e);
-    sFI.process(me);
-    apf::destroyMeshElement(me);
-    return sFI.measurement;
+    int type = mesh->getType(e);
+    if (!isStraightSimplex(type)) {
+      SizeFieldIntegrator sFI(this);
+      apf::MeshElement* me = apf::createMeshElement(mesh, e);
+      sFI.process(me);
+      apf::destroyMeshElement(me);
+      return sFI.measurement;
+    }
+    apf::Downward verts;
+    int n = mesh->getDownward(e, 0, verts);
+    Vector x[4];
+    for (int i = 0; i < n; ++i)
+      mesh->getPoint(verts[i], 0, x[i]);
+    if (type != apf::Mesh::EDGE || !lengthTag)
+      return measureSimplex(type, verts, x);
+    /* the length followed by the endpoint coordinates it was
+       computed with, so moving a vertex invalidates it */
+    double cached[7];
+    if (mesh->hasTag(e, lengthTag)) {
+      mesh->getDoubleTag(e, lengthTag, cached);
+      if (isSameEdge(cached, x))
+        return cached[0];
+    }
+    cached[0] = measureSimplex(type, verts, x);
+    x[0].toArray(cached + 1);
+    x[1].toArray(cached + 4);
+    mesh->setDoubleTag(e, lengthTag, cached);
+    return cached[0];
   }
   bool shouldSplit(Entity* edge)
   {
@@ -200,7 +330,30 @@ struct MetricSizeField : public SizeField
     /* parentMeasure is used to normalize */
     return measure(e) / parentMeasure[mesh->getType(e)];
   }
+  void cacheEdgeLengths(bool on)
+  {
+    if (on && !lengthTag)
+      lengthTag = mesh->createDoubleTag("ma_edge_length", 7);
+    if (!on && lengthTag) {
+      apf::removeTagFromDimension(mesh, lengthTag, 1);
+      mesh->destroyTag(lengthTag);
+      lengthTag = 0;
+    }
+  }
+  /* called when the size at a vertex changes */
+  void forgetLengths(Entity* vert)
+  {
+    if (!lengthTag)
+      return;
+    apf::Adjacent edges;
+    mesh->getAdjacent(vert, 1, edges);
+    for (size_t i = 0; i < edges.getSize(); ++i)
+      if (mesh->hasTag(edges[i], lengthTag))
+        mesh->removeTag(edges[i], lengthTag);
+  }
   Mesh* mesh;
+  bool linearValues;
+  Tag* lengthTag;
 };
 
 AnisotropicFunction::~AnisotropicFunction()
@@ -228,6 +381,44 @@ struct IsoWrapper : public AnisotropicFunction
   IsotropicFunction* function;
 };
 
+/* the vertex a thread last evaluated a function at.
+   It is kept per thread rather than per function so that
+   operators applied on worker threads, see Input::workerThreads,
+   don't share it. */
+struct VertexCache
+{
+  void const* owner;
+  Entity* vert;
+  double values[12];
+};
+
+static __thread VertexCache vertexCache = {0, 0, {0}};
+
+static bool isCached(void const* owner, Entity* v)
+{
+  return vertexCache.owner == owner && vertexCache.vert == v;
+}
+
+static void setCached(void const* owner, Entity* v)
+{
+  vertexCache.owner = owner;
+  vertexCache.vert = v;
+}
+
+static void cacheMatrix(Matrix const& m, double* values)
+{
+  for (int i = 0; i < 3; ++i)
+    for (int j = 0; j < 3; ++j)
+      values[i * 3 + j] = m[i][j];
+}
+
+static void getCachedMatrix(double const* values, Matrix& m)
+{
+  for (int i = 0; i < 3; ++i)
+    for (int j = 0; j < 3; ++j)
+      m[i][j] = values[i * 3 + j];
+}
+
 struct BothEval
 {
   BothEval()
@@ -236,28 +427,28 @@ struct BothEval
   BothEval(AnisotropicFunction* f)
   {
     function = f;
-    cachedVert = 0;
   }
   void updateCache(Entity* v)
   {
-    if (v == cachedVert)
+    if (isCached(this, v))
       return;
-    function->getValue(v, cachedFrame, cachedSizes);
-    cachedVert = v;
+    Matrix frame;
+    Vector sizes;
+    function->getValue(v, frame, sizes);
+    sizes.toArray(vertexCache.values);
+    cacheMatrix(frame, vertexCache.values + 3);
+    setCached(this, v);
   }
   void getSizes(Entity* v, Vector& s)
   {
     updateCache(v);
-    s = cachedSizes;
+    s = Vector(vertexCache.values);
   }
   void getFrame(Entity* v, Matrix& f)
   {
     updateCache(v);
-    f = cachedFrame;
+    getCachedMatrix(vertexCache.values + 3, f);
   }
-  Entity* cachedVert;
-  Vector cachedSizes;
-  Matrix cachedFrame;
   AnisotropicFunction* function;
 };
 
@@ -303,11 +494,10 @@ struct LogMEval : public apf::Function
   LogMEval(AnisotropicFunction* f)
   {
     function = f;
-    cachedVert = 0;
   }
   void updateCache(Entity* v)
   {
-    if (v == cachedVert)
+    if (isCached(this, v))
       return;
     Matrix R;
     Vector h;
@@ -315,21 +505,19 @@ struct LogMEval : public apf::Function
     Matrix S( -2*log(h[0]),0,0,
               0,-2*log(h[1]),0,
               0,0,-2*log(h[2]));
-    cachedLogM = R*S*transpose(R);
-    cachedVert = v;
+    cacheMatrix(R*S*transpose(R), vertexCache.values);
+    setCached(this, v);
   }
   void getLogM(Entity* v, Matrix& f)
   {
     updateCache(v);
-    f = cachedLogM;
+    getCachedMatrix(vertexCache.values, f);
   }
   void eval(Entity* e, double* result)
   {
     Matrix* f = (Matrix*) result;
     getLogM(e, *f);
   }
-  Entity* cachedVert;
-  Matrix cachedLogM;
   AnisotropicFunction* function;
 };
 
@@ -348,6 +536,7 @@ struct AnisoSizeField : public MetricSizeField
         apf::getLagrange(1), &sizesEval);
     rField = apf::createUserField(m, "ma_frame", apf::MATRIX,
         apf::getLagrange(1), &frameEval);
+    linearValues = true;
   }
   ~AnisoSizeField()
   {
@@ -359,41 +548,81 @@ struct AnisoSizeField : public MetricSizeField
     mesh = m;
     hField = sizes;
     rField = frames;
+    linearValues = apf::getShape(sizes) == apf::getLagrange(1) &&
+                   apf::getShape(frames) == apf::getLagrange(1);
+  }
+  void getVertexValues(int n, Entity* const* verts, double const* N,
+      Vector& h, Matrix& R)
+  {
+    h = Vector(0,0,0);
+    R = Matrix(0,0,0,
+               0,0,0,
+               0,0,0);
+    for (int i = 0; i < n; ++i) {
+      Vector vh;
+      Matrix vR;
+      apf::getVector(hField,verts[i],0,vh);
+      apf::getMatrix(rField,verts[i],0,vR);
+      h = h + vh * N[i];
+      R = R + vR * N[i];
+    }
+    orthogonalizeR(R);
   }
-  void getTransform(
+  void getValues(
       apf::MeshElement* me,
       Vector const& xi,
-      Matrix& Q)
-  {
+      Vector& h,
+      Matrix& R)
+  {
+    apf::Downward verts;
+    int n;
+    double N[4];
+    if (getVertexWeights(me,xi,verts,n,N)) {
+      getVertexValues(n,verts,N,h,R);
+      return;
+    }
     apf::Element* hElement = apf::createElement(hField,me);
     apf::Element* rElement = apf::createElement(rField,me);
-    Vector h;
-    Matrix R;
     apf::getVector(hElement,xi,h);
     apf::getMatrix(rElement,xi,R);
     apf::destroyElement(hElement);
     apf::destroyElement(rElement);
     orthogonalizeR(R);
+  }
+  static void makeTransform(Vector const& h, Matrix const& R, Matrix& Q)
+  {
     Matrix S(1/h[0],0,0,
              0,1/h[1],0,
              0,0,1/h[2]);
     Q = R*S;
   }
+  void getVertexTransform(int n, Entity* const* verts, double const* N,
+      Matrix& Q)
+  {
+    Vector h;
+    Matrix R;
+    getVertexValues(n,verts,N,h,R);
+    makeTransform(h,R,Q);
+  }
+  void getTransform(
+      apf::MeshElement* me,
+      Vector const& xi,
+      Matrix& Q)
+  {
+    Vector h;
+    Matrix R;
+    getValues(me,xi,h,R);
+    makeTransform(h,R,Q);
+  }
   void interpolate(
       apf::MeshElement* parent,
       Vector const& xi,
       Entity* newVert)
   {
-    apf::Element* rElement = apf::createElement(rField,parent);
-    apf::Element* hElement = apf::createElement(hField,parent);
     Vector h;
-    apf::getVector(hElement,xi,h);
     Matrix R;
-    apf::getMatrix(rElement,xi,R);
-    orthogonalizeR(R);
+    getValues(parent,xi,h,R);
     this->setValue(newVert,R,h);
-    apf::destroyElement(hElement);
-    apf::destroyElement(rElement);
   }
   void setValue(
       Entity* vert,
@@ -402,6 +631,7 @@ struct AnisoSizeField : public MetricSizeField
   {
     apf::setMatrix(rField,vert,0,r);
     apf::setVector(hField,vert,0,h);
+    forgetLengths(vert);
   }
   void setIsotropicValue(
       Entity* vert,
@@ -431,6 +661,7 @@ struct LogAnisoSizeField : public MetricSizeField
     mesh = m;
     logMField = apf::createUserField(m, "ma_logM", apf::MATRIX,
         apf::getLagrange(1), &logMEval);
+    linearValues = true;
   }
   ~LogAnisoSizeField()
   {
@@ -440,6 +671,7 @@ struct LogAnisoSizeField : public MetricSizeField
   {
     mesh = m;
     logMField = apf::createFieldOn(m, "ma_logM", apf::MATRIX);
+    linearValues = apf::getShape(logMField) == apf::getLagrange(1);
     Entity* v;
     Iterator* it = m->begin(0);
     while ( (v = m->iterate(it)) ) {
@@ -454,15 +686,52 @@ struct LogAnisoSizeField : public MetricSizeField
       apf::setMatrix(logMField, v, 0, f * S * transpose(f));
     }
   }
-  void getTransform(
+  void getVertexLogM(int n, Entity* const* verts, double const* N,
+      Matrix& logM)
+  {
+    logM = Matrix(0,0,0,
+                  0,0,0,
+                  0,0,0);
+    for (int i = 0; i < n; ++i) {
+      Matrix vLogM;
+      apf::getMatrix(logMField,verts[i],0,vLogM);
+      logM = logM + vLogM * N[i];
+    }
+  }
+  void getLogM(
       apf::MeshElement* me,
       Vector const& xi,
-      Matrix& Q)
+      Matrix& logM)
   {
+    apf::Downward verts;
+    int n;
+    double N[4];
+    if (getVertexWeights(me,xi,verts,n,N)) {
+      getVertexLogM(n,verts,N,logM);
+      return;
+    }
     apf::Element* logMElement = apf::createElement(logMField,me);
-    Matrix logM;
     apf::getMatrix(logMElement,xi,logM);
     apf::destroyElement(logMElement);
+  }
+  void getVertexTransform(int n, Entity* const* verts, double const* N,
+      Matrix& Q)
+  {
+    Matrix logM;
+    getVertexLogM(n,verts,N,logM);
+    makeTransform(logM,Q);
+  }
+  void getTransform(
+      apf::MeshElement* me,
+      Vector const& xi,
+      Matrix& Q)
+  {
+    Matrix logM;
+    getLogM(me,xi,logM);
+    makeTransform(logM,Q);
+  }
+  static void makeTransform(Matrix const& logM, Matrix& Q)
+  {
     Vector v;
     Matrix R;
     orthogonalEigenDecompForSymmetricMatrix(logM, v, R);
@@ -476,17 +745,16 @@ struct LogAnisoSizeField : public MetricSizeField
       Vector const& xi,
       Entity* newVert)
   {
-    apf::Element* logMElement = apf::createElement(logMField,parent);
     Matrix logM;
-    apf::getMatrix(logMElement,xi,logM);
+    getLogM(parent,xi,logM);
     this->setValue(newVert,logM);
-    apf::destroyElement(logMElement);
   }
   void setValue(
       Entity* vert,
       Matrix const& logM)
   {
     apf::setMatrix(logMField,vert,0,logM);
+    forgetLengths(vert);
   }
   void setIsotropicValue(
       Entity* vert,
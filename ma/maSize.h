@@ -36,6 +36,12 @@ class SizeField
         Vector const& xi,
         Matrix& t) = 0;
     virtual double getWeight(Entity* e) = 0;
+    /** \brief keep the lengths of edges in a tag until one
+      of their vertices moves or is given a new size.
+      \details ma::Adapt turns this on for the length of a run
+      if ma::Input::shouldCacheEdgeLengths is set. Size fields
+      that can not cache lengths ignore it. */
+    virtual void cacheEdgeLengths(bool on);
 };
 
 struct IdentitySizeField : public SizeField
@@ -619,6 +619,7 @@ class SnapAll : public Operator
       vert = 0;
     }
     int getTargetDimension() {return 0;}
+    int getTargetFlag() {return SNAP;}
     bool shouldApply(Entity* e)
     {
       if ( ! getFlag(adapter, e, SNAP))
@@ -669,6 +670,7 @@ class SnapMatched : public Operator
       vert = 0;
     }
     int getTargetDimension() {return 0;}
+    int getTargetFlag() {return SNAP;}
     bool shouldApply(Entity* e)
     {
       if ( ! getFlag(adapter, e, SNAP))
@@ -6,7 +6,7 @@
 #include "maLayer.h"
 #include <apfNumbering.h>
 #include <apfShape.h>
-#include <apfCavityOp.h>
+#include "maOperator.h"
 #include "maShape.h"
 #include <pcu_util.h>
 
@@ -419,9 +419,9 @@ struct UnsafePrismOverride : public apf::CavityOp
 static void overrideDiagonalsForUnsafeElements(Adapt* a)
 {
   UnsafePyramidOverride op(a);
-  op.applyToDimension(3);
+  applyCavityOp(a, op, 3);
   UnsafePrismOverride op2(a);
-  op2.applyToDimension(3);
+  applyCavityOp(a, op2, 3);
   clearFlagFromDimension(a, CHECKED, 2);
   clearFlagFromDimension(a, CHECKED, 3);
 }
@@ -0,0 +1,411 @@
+/******************************************************************************
+
+  Copyright 2013 Scientific Computation Research Center,
+      Rensselaer Polytechnic Institute. All rights reserved.
+
+  The LICENSE file included with this distribution describes the terms
+  of the SCOREC Non-Commercial License this program is distributed under.
+
+*******************************************************************************/
+#include <PCU.h>
+#include "maOperator.h"
+#include "maAdapt.h"
+#include "maProfile.h"
+#include "maWorklist.h"
+#include <apfMDS.h>
+#include <pcu_util.h>
+#include <pthread.h>
+#include <algorithm>
+
+namespace ma {
+
+/* An operator on an edge only changes the elements around its two
+   vertices, and every vertex of those elements shares an edge with
+   one of them. Operators whose "claims", the two vertices and their
+   neighbors, don't overlap touch disjoint entities and adjacencies,
+   so they can run at the same time through apf::MdsBuffer.
+
+   Like findIndependentSet in maCoarsen.cc, which picks vertices that
+   can collapse without interfering across parts, the targets are
+   split into sets of independent claims: a greedy coloring gives
+   each target the first color none of its claimed vertices has.
+   Each color is a batch. Earlier batches change the mesh, so before
+   one runs its targets are checked again and those whose new claims
+   overlap wait for the next batch. The batch is split among the
+   workers, each with its own buffer of entity slots, and their work
+   is merged into the mesh, the callbacks and the profile once all
+   of them are done. */
+
+/* colors are the bits of a long tag on the vertices */
+static long getColorBit(int c)
+{
+  return long(1UL << c);
+}
+
+class Worker;
+
+/* the worker the current thread runs, if any */
+static __thread Worker* threadWorker = 0;
+
+class Worker
+{
+  public:
+    Worker()
+    {
+      op = 0;
+      buffer = 0;
+      targets = 0;
+      count = 0;
+      examined = 0;
+      applied = 0;
+      destroyedElements = 0;
+    }
+    Operator* op;
+    apf::MdsBuffer* buffer;
+    Entity* const* targets;
+    size_t count;
+    size_t examined;
+    size_t applied;
+    size_t destroyedElements;
+    std::vector<Entity*> built;
+    std::vector<Entity*> destroyed;
+};
+
+static void* runWorker(void* p)
+{
+  Worker* w = static_cast<Worker*>(p);
+  threadWorker = w;
+  apf::useMdsBuffer(w->buffer);
+  for (size_t i = 0; i < w->count; ++i) {
+    ++(w->examined);
+    if ( ! w->op->shouldApply(w->targets[i]))
+      continue;
+    w->op->apply();
+    ++(w->applied);
+  }
+  apf::useMdsBuffer(0);
+  threadWorker = 0;
+  return 0;
+}
+
+/* record what the workers build and destroy, to be passed on
+   to the callbacks of the adapt once they are done */
+class WorkerBuilds : public apf::BuildCallback
+{
+  public:
+    void call(Entity* e)
+    {
+      threadWorker->built.push_back(e);
+    }
+};
+
+class WorkerDeletes : public DeleteCallback
+{
+  public:
+    WorkerDeletes(Adapt* a):
+      DeleteCallback(a)
+    {
+    }
+    void call(Entity* e)
+    {
+      Worker* w = threadWorker;
+      w->destroyed.push_back(e);
+      Mesh* m = adapt->mesh;
+      if (getDimension(m, e) == m->getDimension())
+        ++(w->destroyedElements);
+    }
+};
+
+class OperatorThreads
+{
+  public:
+    OperatorThreads(Adapt* a, Operator** o, int n):
+      adapt(a),
+      mesh(a->mesh),
+      ops(o),
+      threads(n)
+    {
+      colorTag = mesh->createLongTag("ma_colors", 1);
+      batchTag = mesh->createIntTag("ma_batch", 1);
+      targetTag = mesh->createIntTag("ma_target", 1);
+      batch = 0;
+      rounds = 0;
+      examined = 0;
+      applied = 0;
+      destroyedElements = 0;
+    }
+    ~OperatorThreads()
+    {
+      apf::removeTagFromDimension(mesh, colorTag, 0);
+      apf::removeTagFromDimension(mesh, batchTag, 0);
+      apf::removeTagFromDimension(mesh, targetTag,
+          ops[0]->getTargetDimension());
+      mesh->destroyTag(colorTag);
+      mesh->destroyTag(batchTag);
+      mesh->destroyTag(targetTag);
+    }
+    /* the vertices of the edge and their neighbors, false if
+       any of them is shared, since only unshared entities
+       can be modified through buffers */
+    bool getClaim(Entity* edge)
+    {
+      claim.clear();
+      Entity* v[2];
+      mesh->getDownward(edge, 0, v);
+      for (int i = 0; i < 2; ++i) {
+        claim.push_back(v[i]);
+        apf::Up edges;
+        mesh->getUp(v[i], edges);
+        for (int j = 0; j < edges.n; ++j)
+          claim.push_back(getEdgeVertOppositeVert(mesh, edges.e[j], v[i]));
+      }
+      for (size_t i = 0; i < claim.size(); ++i)
+        if (mesh->isShared(claim[i]))
+          return false;
+      return true;
+    }
+    /* a bound on the entities applying an operator to the edge
+       creates: each element around its vertices may be rebuilt
+       with one of them replaced, which makes the entities of
+       the element that contain that vertex. */
+    void addCost(Entity* edge, long* cost)
+    {
+      int dim = mesh->getDimension();
+      Entity* v[2];
+      mesh->getDownward(edge, 0, v);
+      long elements = 0;
+      for (int i = 0; i < 2; ++i) {
+        apf::Adjacent adjacent;
+        mesh->getAdjacent(v[i], dim, adjacent);
+        elements += adjacent.getSize();
+      }
+      cost[apf::Mesh::EDGE] += dim * elements;
+      if (dim == 3) {
+        cost[apf::Mesh::TRIANGLE] += 3 * elements;
+        cost[apf::Mesh::TET] += elements;
+      } else
+        cost[apf::Mesh::TRIANGLE] += elements;
+    }
+    void getTargets(std::vector<Entity*>& out)
+    {
+      int d = ops[0]->getTargetDimension();
+      int flag = ops[0]->getTargetFlag();
+      Worklist* w = adapt->worklist;
+      if (w && (w->getTargets(d) & flag)) {
+        w->getTargeted(flag, d, out);
+        return;
+      }
+      Iterator* it = mesh->begin(d);
+      Entity* e;
+      while ((e = mesh->iterate(it)))
+        out.push_back(e);
+      mesh->end(it);
+    }
+    void color()
+    {
+      std::vector<Entity*> targets;
+      getTargets(targets);
+      for (size_t i = 0; i < targets.size(); ++i) {
+        Entity* e = targets[i];
+        if ( ! ops[0]->shouldApply(e))
+          continue;
+        if ( ! getClaim(e))
+          continue;
+        long used = 0;
+        for (size_t j = 0; j < claim.size(); ++j)
+          if (mesh->hasTag(claim[j], colorTag)) {
+            long mask;
+            mesh->getLongTag(claim[j], colorTag, &mask);
+            used |= mask;
+          }
+        if (used == ~0L)
+          continue;
+        int c = 0;
+        while (used & getColorBit(c))
+          ++c;
+        for (size_t j = 0; j < claim.size(); ++j) {
+          long mask = 0;
+          if (mesh->hasTag(claim[j], colorTag))
+            mesh->getLongTag(claim[j], colorTag, &mask);
+          mask |= getColorBit(c);
+          mesh->setLongTag(claim[j], colorTag, &mask);
+        }
+        mesh->setIntTag(e, targetTag, &c);
+        if (colors.size() <= size_t(c))
+          colors.resize(c + 1);
+        colors[c].push_back(e);
+      }
+    }
+    /* picks the targets of color c that are still alive and
+       whose claims don't overlap, passing the rest to the next
+       color. New entities don't carry the target tag and
+       destroyed ones lose it, so a reused slot isn't mistaken
+       for a target. */
+    void gather(size_t c, std::vector<Entity*>& out,
+        std::vector<long>& costs)
+    {
+      ++batch;
+      std::vector<Entity*> targets;
+      targets.swap(colors[c]);
+      std::vector<Entity*> later;
+      for (size_t i = 0; i < targets.size(); ++i) {
+        Entity* e = targets[i];
+        if ( ! mesh->hasTag(e, targetTag))
+          continue;
+        if (( ! ops[0]->shouldApply(e)) || ( ! getClaim(e))) {
+          mesh->removeTag(e, targetTag);
+          continue;
+        }
+        bool isFree = true;
+        for (size_t j = 0; j < claim.size(); ++j)
+          if (mesh->hasTag(claim[j], batchTag)) {
+            int b;
+            mesh->getIntTag(claim[j], batchTag, &b);
+            if (b == batch)
+              isFree = false;
+          }
+        if ( ! isFree) {
+          later.push_back(e);
+          continue;
+        }
+        for (size_t j = 0; j < claim.size(); ++j)
+          mesh->setIntTag(claim[j], batchTag, &batch);
+        mesh->removeTag(e, targetTag);
+        out.push_back(e);
+        size_t k = costs.size();
+        costs.resize(k + apf::Mesh::TYPES, 0);
+        addCost(e, &costs[k]);
+      }
+      if (later.empty())
+        return;
+      if (colors.size() <= c + 1)
+        colors.resize(c + 2);
+      colors[c + 1].insert(colors[c + 1].end(), later.begin(), later.end());
+    }
+    void run(std::vector<Entity*>& targets, std::vector<long>& costs)
+    {
+      size_t n = std::min(size_t(threads), targets.size());
+      std::vector<Worker> workers(n);
+      for (size_t i = 0; i < n; ++i) {
+        Worker& w = workers[i];
+        size_t first = targets.size() * i / n;
+        size_t stop = targets.size() * (i + 1) / n;
+        w.op = ops[i];
+        w.targets = &targets[first];
+        w.count = stop - first;
+        long count[apf::Mesh::TYPES] = {};
+        for (size_t j = first; j < stop; ++j)
+          for (int t = 0; t < apf::Mesh::TYPES; ++t)
+            count[t] += costs[j * apf::Mesh::TYPES + t];
+        w.buffer = apf::createMdsBuffer(mesh);
+        apf::reserveMdsEntities(w.buffer, count);
+      }
+      Worklist* worklist = adapt->worklist;
+      Profile* profile = adapt->profile;
+      apf::BuildCallback* built = adapt->buildCallback;
+      adapt->worklist = 0;
+      adapt->profile = 0;
+      {
+        WorkerBuilds builds;
+        WorkerDeletes deletes(adapt);
+        adapt->buildCallback = &builds;
+        std::vector<pthread_t> ids(n);
+        for (size_t i = 1; i < n; ++i)
+          PCU_ALWAYS_ASSERT( ! pthread_create(&ids[i], NULL, runWorker,
+                &workers[i]));
+        runWorker(&workers[0]);
+        for (size_t i = 1; i < n; ++i)
+          pthread_join(ids[i], NULL);
+      }
+      adapt->buildCallback = built;
+      adapt->profile = profile;
+      adapt->worklist = worklist;
+      for (size_t i = 0; i < n; ++i)
+        merge(workers[i]);
+      ++rounds;
+    }
+    void merge(Worker& w)
+    {
+      apf::destroyMdsBuffer(w.buffer);
+      examined += w.examined;
+      applied += w.applied;
+      destroyedElements += w.destroyedElements;
+      if ( ! adapt->buildCallback)
+        return;
+      /* entities built and destroyed again by a worker,
+         for example by cancelled collapses, are not passed on */
+      std::sort(w.destroyed.begin(), w.destroyed.end());
+      for (size_t i = 0; i < w.built.size(); ++i)
+        if ( ! std::binary_search(w.destroyed.begin(), w.destroyed.end(),
+              w.built[i]))
+          adapt->buildCallback->call(w.built[i]);
+    }
+    void apply()
+    {
+      color();
+      for (size_t c = 0; c < colors.size(); ++c) {
+        std::vector<Entity*> targets;
+        std::vector<long> costs;
+        gather(c, targets, costs);
+        if (targets.size())
+          run(targets, costs);
+      }
+      if ( ! adapt->profile)
+        return;
+      apf::CavityOpCounts counts;
+      counts.examined = examined;
+      counts.applied = applied;
+      counts.rounds = rounds;
+      counts.pulls = 0;
+      counts.migrated = 0;
+      adapt->profile->add(counts);
+      adapt->profile->destroyed += destroyedElements;
+    }
+  private:
+    Adapt* adapt;
+    Mesh* mesh;
+    Operator** ops;
+    int threads;
+    Tag* colorTag;
+    Tag* batchTag;
+    Tag* targetTag;
+    std::vector<std::vector<Entity*> > colors;
+    std::vector<Entity*> claim;
+    int batch;
+    size_t rounds;
+    size_t examined;
+    size_t applied;
+    size_t destroyedElements;
+};
+
+int getOperatorThreads(Adapt* a)
+{
+  Mesh* m = a->mesh;
+  if (a->input->workerThreads < 2)
+    return 1;
+  if (a->hasLayer || m->hasMatching() || a->deleteCallback)
+    return 1;
+  if (m->getDimension() < 2)
+    return 1;
+  Cavity cavity;
+  cavity.init(a);
+  if (cavity.shouldTransfer || cavity.shouldFit)
+    return 1;
+  apf::MdsBuffer* b = apf::createMdsBuffer(m);
+  if ( ! b)
+    return 1;
+  apf::destroyMdsBuffer(b);
+  return a->input->workerThreads;
+}
+
+void applyOperators(Adapt* a, Operator** ops, int n)
+{
+  if (n > 1) {
+    PCU_ALWAYS_ASSERT(ops[0]->getTargetDimension() == 1);
+    OperatorThreads threads(a, ops, n);
+    threads.apply();
+  }
+  applyOperator(a, ops[0]);
+}
+
+}
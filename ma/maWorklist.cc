@@ -0,0 +1,234 @@
+/******************************************************************************
+
+  Copyright 2013 Scientific Computation Research Center,
+      Rensselaer Polytechnic Institute. All rights reserved.
+
+  The LICENSE file included with this distribution describes the terms
+  of the SCOREC Non-Commercial License this program is distributed under.
+
+*******************************************************************************/
+#include <PCU.h>
+#include "maWorklist.h"
+#include "maAdapt.h"
+#include <pcu_util.h>
+
+#include <algorithm>
+
+namespace ma {
+
+/* set while reading a list to drop repeated entries */
+enum { SEEN = (1<<30) };
+
+/* the visit counts, in the order they are reported */
+enum { COLLAPSE_VISITS, SPLIT_VISITS, QUALITY_VISITS, TARGET_VISITS,
+       ALL_VISITS };
+
+static int getVisitIndex(int flag)
+{
+  if (flag == DONT_COLLAPSE)
+    return COLLAPSE_VISITS;
+  if (flag == DONT_SPLIT)
+    return SPLIT_VISITS;
+  return QUALITY_VISITS;
+}
+
+Worklist::Worklist(Adapt* a)
+{
+  next = 0;
+  adapt = a;
+  mesh = a->mesh;
+  tag = mesh->createIntTag("ma_worklist",1);
+  for (int i = 0; i < ALL_VISITS; ++i)
+    visited[i] = 0;
+  for (int d = 0; d < 4; ++d) {
+    stale[d] = false;
+    seeded[d] = 0;
+  }
+}
+
+Worklist::~Worklist()
+{
+  for (int d = 0; d <= mesh->getDimension(); ++d)
+    if (getTracked(d) | getTargets(d))
+      apf::removeTagFromDimension(mesh, tag, d);
+  mesh->destroyTag(tag);
+}
+
+int Worklist::getTracked(int dimension)
+{
+  int flags = 0;
+  if (dimension == 1)
+    flags |= DONT_COLLAPSE | DONT_SPLIT;
+  if (dimension == mesh->getDimension())
+    flags |= OK_QUALITY;
+  return flags;
+}
+
+int Worklist::getTargets(int dimension)
+{
+  int flags = 0;
+  if (dimension == 0)
+    flags |= COLLAPSE | SNAP;
+  if (dimension == 1)
+    flags |= COLLAPSE;
+  if (dimension == mesh->getDimension())
+    flags |= BAD_QUALITY;
+  return flags;
+}
+
+int Worklist::getListed(Entity* e)
+{
+  if ( ! mesh->hasTag(e,tag))
+    return 0;
+  int flags;
+  mesh->getIntTag(e,tag,&flags);
+  return flags;
+}
+
+void Worklist::list(int flags, Entity* e)
+{
+  if ( ! flags)
+    return;
+  int listed = getListed(e);
+  if ((listed | flags) == listed)
+    return;
+  /* entities are listed as long as they carry the tag */
+  if ( ! listed)
+    lists[getDimension(mesh,e)].push_back(e);
+  listed |= flags;
+  mesh->setIntTag(e,tag,&listed);
+}
+
+void Worklist::put(int flags, Entity* e)
+{
+  /* until the first pass for a flag, which visits everything,
+     there is nothing to remember */
+  list(flags & seeded[getDimension(mesh,e)], e);
+}
+
+void Worklist::target(int flags, Entity* e)
+{
+  list(flags & getTargets(getDimension(mesh,e)), e);
+}
+
+void Worklist::migrated()
+{
+  for (int d = 0; d < 4; ++d)
+    stale[d] = true;
+}
+
+void Worklist::rescan(int dimension)
+{
+  std::vector<Entity*>& list = lists[dimension];
+  list.clear();
+  Iterator* it = mesh->begin(dimension);
+  Entity* e;
+  while ((e = mesh->iterate(it)))
+    if (mesh->hasTag(e,tag))
+      list.push_back(e);
+  mesh->end(it);
+}
+
+/* reads the list of a dimension once, moving the entities listed
+   for flag to out. keep decides whether an entity stays listed
+   for flag after that. */
+void Worklist::read(int flag, int dimension, bool keep,
+    std::vector<Entity*>& out)
+{
+  if (stale[dimension]) {
+    rescan(dimension);
+    stale[dimension] = false;
+  }
+  std::vector<Entity*>& list = lists[dimension];
+  size_t kept = 0;
+  for (size_t i = 0; i < list.size(); ++i) {
+    Entity* e = list[i];
+    int listed = getListed(e);
+    if (( ! listed) || (listed & SEEN))
+      continue;
+    if (listed & flag) {
+      if (keep && ! getFlag(adapt,e,flag))
+        listed &= ~flag;
+      else {
+        out.push_back(e);
+        if ( ! keep)
+          listed &= ~flag;
+      }
+    }
+    if (listed) {
+      listed |= SEEN;
+      mesh->setIntTag(e,tag,&listed);
+      list[kept++] = e;
+    } else
+      mesh->removeTag(e,tag);
+  }
+  list.resize(kept);
+  for (size_t i = 0; i < list.size(); ++i) {
+    int listed = getListed(list[i]) & ~SEEN;
+    mesh->setIntTag(list[i],tag,&listed);
+  }
+}
+
+bool Worklist::take(int flag, int dimension, std::vector<Entity*>& out)
+{
+  PCU_ALWAYS_ASSERT(getTracked(dimension) & flag);
+  if ( ! (seeded[dimension] & flag)) {
+    seeded[dimension] |= flag;
+    return false;
+  }
+  read(flag, dimension, false, out);
+  visited[getVisitIndex(flag)] += out.size();
+  return true;
+}
+
+/* the order of a mesh iterator, for MDS at least */
+struct IterationOrder
+{
+  IterationOrder(Mesh* m):mesh(m) {}
+  bool operator()(Entity* a, Entity* b)
+  {
+    int ta = mesh->getType(a);
+    int tb = mesh->getType(b);
+    if (ta != tb)
+      return ta < tb;
+    return a < b;
+  }
+  Mesh* mesh;
+};
+
+void Worklist::getTargeted(int flag, int dimension,
+    std::vector<Entity*>& out)
+{
+  PCU_ALWAYS_ASSERT(getTargets(dimension) & flag);
+  read(flag, dimension, true, out);
+  std::sort(out.begin(), out.end(), IterationOrder(mesh));
+  visited[TARGET_VISITS] += out.size();
+}
+
+void Worklist::report(const char* when)
+{
+  long counts[ALL_VISITS + 2];
+  for (int i = 0; i < ALL_VISITS; ++i)
+    counts[i] = visited[i];
+  int dim = mesh->getDimension();
+  counts[ALL_VISITS] = apf::countOwned(mesh, 1);
+  counts[ALL_VISITS + 1] = apf::countOwned(mesh, dim);
+  PCU_Add_Longs(counts, ALL_VISITS + 2);
+  print("%s: visited %ld edges to collapse, %ld edges to split, "
+        "%ld elements for quality and %ld operator targets, "
+        "out of %ld edges and %ld elements",
+        when, counts[COLLAPSE_VISITS], counts[SPLIT_VISITS],
+        counts[QUALITY_VISITS], counts[TARGET_VISITS],
+        counts[ALL_VISITS], counts[ALL_VISITS + 1]);
+  for (int i = 0; i < ALL_VISITS; ++i)
+    visited[i] = 0;
+}
+
+void Worklist::call(Entity* e)
+{
+  put(getTracked(getDimension(mesh,e)), e);
+  if (next)
+    next->call(e);
+}
+
+}
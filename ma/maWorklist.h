@@ -0,0 +1,89 @@
+/******************************************************************************
+
+  Copyright 2013 Scientific Computation Research Center,
+      Rensselaer Polytechnic Institute. All rights reserved.
+
+  The LICENSE file included with this distribution describes the terms
+  of the SCOREC Non-Commercial License this program is distributed under.
+
+*******************************************************************************/
+#ifndef MA_WORKLIST_H
+#define MA_WORKLIST_H
+
+#include "maMesh.h"
+#include <vector>
+
+namespace ma {
+
+class Adapt;
+
+/* markEntities caches negative answers with a "false" flag
+   (DONT_COLLAPSE, DONT_SPLIT, OK_QUALITY) and skips those entities
+   in later passes.  The worklist keeps the entities that have no
+   cached answer yet, so a pass can visit just those instead of the
+   whole mesh.  Nothing is listed before the first pass for a flag,
+   which visits the whole dimension; after it, entities get listed
+   by being built, by having their false flag cleared, or by being
+   marked true.
+
+   The CavityOps of adapt only apply to entities with a "target"
+   flag (COLLAPSE, SNAP, BAD_QUALITY) set, so the worklist also
+   lists the entities a target flag is set on, and applyCavityOp
+   gives just those to the op.
+
+   An int tag holds the flags an entity is still listed for.
+   Since MDS removes tags from destroyed entities, stale or repeated
+   list entries are recognized and dropped when the list is read.
+
+   Migration moves the tag but not the lists, so after the mesh
+   migrates the lists are rebuilt from the tag, once per dimension.
+   Every migration during adapt has to be followed by a call to
+   migrated(); ma does this for its CavityOps, balancing and layer
+   collapse.
+
+   The worklist is installed as the Adapt build callback and passes
+   calls on to the callback set by setBuildCallback. */
+class Worklist : public apf::BuildCallback
+{
+  public:
+    Worklist(Adapt* a);
+    ~Worklist();
+    /* the false flags whose passes can use the worklist */
+    int getTracked(int dimension);
+    /* the target flags whose CavityOps can use the worklist */
+    int getTargets(int dimension);
+    /* lists the entity for the given false flags */
+    void put(int flags, Entity* e);
+    /* lists the entity for the given target flags */
+    void target(int flags, Entity* e);
+    /* moves the entities of this dimension listed for this
+       false flag to out, or returns false if this is the first
+       pass for the flag, which has to visit the whole dimension */
+    bool take(int flag, int dimension, std::vector<Entity*>& out);
+    /* gives the entities of this dimension that have this target
+       flag set, in iteration order */
+    void getTargeted(int flag, int dimension, std::vector<Entity*>& out);
+    /* the mesh has migrated, so the lists must be rebuilt */
+    void migrated();
+    /* prints and resets the counts of entities visited */
+    void report(const char* when);
+    virtual void call(Entity* e);
+    apf::BuildCallback* next;
+  private:
+    int getListed(Entity* e);
+    void list(int flags, Entity* e);
+    void read(int flag, int dimension, bool keep,
+        std::vector<Entity*>& out);
+    void rescan(int dimension);
+    Adapt* adapt;
+    Mesh* mesh;
+    Tag* tag;
+    std::vector<Entity*> lists[4];
+    long visited[5];
+    bool stale[4];
+    int seeded[4]; //false flags whose first pass has begun
+};
+
+}
+
+#endif
@@ -44,6 +44,8 @@ set(SOURCES
   maExtrude.cc
   maDBG.cc
   maStats.cc
+  maWorklist.cc
+  maProfile.cc
 )
 
 set(HEADERS
@@ -11,6 +11,7 @@
 #include <PCU.h>
 #include "apfMDS.h"
 #include "mds_apf.h"
+#include "mds_map.h"
 #include "apfPM.h"
 #include <apfMesh2.h>
 #include <apfConvert.h>
@@ -84,21 +85,25 @@ static mds_id fromEnt(MeshEntity* e)
   return (reinterpret_cast<char*>(e) - ((char*)1));
 }
 
-static MeshIterator* makeIter()
+/* an iterator holds the next entity and the entity to stop at,
+   which is MDS_NONE unless it iterates over a range */
+static MeshIterator* makeIter(mds_id stop = MDS_NONE)
 {
-  mds_id* p = new mds_id;
+  mds_id* p = new mds_id[2];
+  p[1] = stop;
   return reinterpret_cast<MeshIterator*>(p);
 }
 
 static void freeIter(MeshIterator* it)
 {
   mds_id* p = reinterpret_cast<mds_id*>(it);
-  delete p;
+  delete [] p;
 }
 
 static void toIter(mds_id id, MeshIterator* it)
 {
-  *(reinterpret_cast<mds_id*>(it)) = id;
+  mds_id* p = reinterpret_cast<mds_id*>(it);
+  p[0] = (id == p[1]) ? MDS_NONE : id;
 }
 
 static mds_id fromIter(MeshIterator* it)
@@ -136,6 +141,22 @@ static int apf2mds(int t_apf)
   return table[t_apf];
 }
 
+class MeshMDS;
+
+struct MdsBuffer
+{
+  MeshMDS* mesh;
+  mds_buffer buffer;
+  /* the residence of entities created through the buffer,
+     whose reference counts are added when it is destroyed */
+  PME* residence;
+  long built;
+  std::vector<PME*> released;
+};
+
+/* the buffer this thread creates and destroys entities through */
+static __thread MdsBuffer* threadBuffer = 0;
+
 class MeshMDS : public Mesh2
 {
   public:
@@ -236,7 +257,7 @@ class MeshMDS : public Mesh2
     }
     bool isShared(MeshEntity* e)
     {
-      return mds_get_copies(&mesh->remotes, fromEnt(e));
+      return mds_count_copies(&mesh->remotes, fromEnt(e));
     }
     bool isGhost(MeshEntity* e)
     {
@@ -273,8 +294,16 @@ class MeshMDS : public Mesh2
 
     void getAdjacent(MeshEntity* e, int dimension, Adjacent& adjacent)
     {
-      mds_set s;
       mds_id id = fromEnt(e);
+      mds_id const* frozen;
+      int n = mds_get_frozen(&(mesh->mds),id,dimension,&frozen);
+      if (n >= 0) {
+        adjacent.setSize(n);
+        for (int i = 0; i < n; ++i)
+          adjacent[i] = toEnt(frozen[i]);
+        return;
+      }
+      mds_set s;
       mds_get_adjacent(&(mesh->mds),id,dimension,&s);
       adjacent.setSize(s.n);
       for (int i = 0; i < s.n; ++i)
@@ -292,15 +321,27 @@ class MeshMDS : public Mesh2
     }
     int countUpward(MeshEntity* e)
     {
-      mds_set s;
       mds_id id = fromEnt(e);
+      mds_id const* frozen;
+      int n = mds_get_frozen(&(mesh->mds),id,mds_dim[mds_type(id)] + 1,
+          &frozen);
+      if (n >= 0)
+        return n;
+      mds_set s;
       mds_get_adjacent(&(mesh->mds),id,mds_dim[mds_type(id)] + 1,&s);
       return s.n;
     }
     MeshEntity* getUpward(MeshEntity* e, int i)
     {
-      mds_set s;
       mds_id id = fromEnt(e);
+      mds_id const* frozen;
+      int n = mds_get_frozen(&(mesh->mds),id,mds_dim[mds_type(id)] + 1,
+          &frozen);
+      if (n >= 0) {
+        PCU_ALWAYS_ASSERT(i < n);
+        return toEnt(frozen[i]);
+      }
+      mds_set s;
       mds_get_adjacent(&(mesh->mds),id,mds_dim[mds_type(id)] + 1,&s);
       PCU_ALWAYS_ASSERT(i < s.n);
       return toEnt(s.e[i]);
@@ -314,6 +355,24 @@ class MeshMDS : public Mesh2
       for (int i = 0; i < s.n; ++i)
         up.e[i] = toEnt(s.e[i]);
     }
+    void freeze()
+    {
+      mds_freeze(&(mesh->mds));
+      mds_freeze_net(&mesh->remotes, &mesh->mds);
+      mds_freeze_net(&mesh->ghosts, &mesh->mds);
+      mds_freeze_net(&mesh->matches, &mesh->mds);
+    }
+    void thaw()
+    {
+      mds_thaw(&(mesh->mds));
+      mds_thaw_net(&mesh->remotes, &mesh->mds);
+      mds_thaw_net(&mesh->ghosts, &mesh->mds);
+      mds_thaw_net(&mesh->matches, &mesh->mds);
+    }
+    bool isFrozen()
+    {
+      return mesh->mds.frozen != 0;
+    }
     bool hasUp(MeshEntity* e)
     {
       return mds_has_up(&(mesh->mds),fromEnt(e));
@@ -348,22 +407,24 @@ class MeshMDS : public Mesh2
     }
     void getRemotes(MeshEntity* e, Copies& remotes)
     {
-      if (!isShared(e))
-        return;
-      mds_copies* c = mds_get_copies(&mesh->remotes, fromEnt(e));
-      PCU_ALWAYS_ASSERT(c != NULL);
-      for (int i = 0; i < c->n; ++i)
-        remotes[c->c[i].p] = toEnt(c->c[i].e);
+      mds_id id = fromEnt(e);
+      int n = mds_count_copies(&mesh->remotes, id);
+      for (int i = 0; i < n; ++i) {
+        mds_copy c = mds_get_copy(&mesh->remotes, id, i);
+        remotes[c.p] = toEnt(c.e);
+      }
     }
 
 // seol
     int getGhosts(MeshEntity* e, Copies& ghosts)
     {
-      mds_copies* c = mds_get_copies(&mesh->ghosts, fromEnt(e));
-      if (c==NULL) return 0;
-      for (int i = 0; i < c->n; ++i)
-        ghosts[c->c[i].p] = toEnt(c->c[i].e);
-      return c->n;
+      mds_id id = fromEnt(e);
+      int n = mds_count_copies(&mesh->ghosts, id);
+      for (int i = 0; i < n; ++i) {
+        mds_copy c = mds_get_copy(&mesh->ghosts, id, i);
+        ghosts[c.p] = toEnt(c.e);
+      }
+      return n;
     }
 
     void getResidence(MeshEntity* e, Parts& residence)
@@ -653,6 +714,14 @@ class MeshMDS : public Mesh2
         for (int i = 0; i < s.n; ++i)
           s.e[i] = fromEnt(down[i]);
       }
+      MdsBuffer* b = threadBuffer;
+      if (b && b->mesh == this) {
+        mds_id id = mds_apf_create_buffered(
+            mesh, &b->buffer, t, reinterpret_cast<gmi_ent*>(c), s.e);
+        mds_set_part(mesh, id, b->residence);
+        ++(b->built);
+        return toEnt(id);
+      }
       mds_id id = mds_apf_create_entity(
           mesh, t, reinterpret_cast<gmi_ent*>(c), s.e);
       MeshEntity* e = toEnt(id);
@@ -666,6 +735,12 @@ class MeshMDS : public Mesh2
       mds_id id = fromEnt(e);
       void* ovp = mds_get_part(mesh, id);
       PME* op = static_cast<PME*>(ovp);
+      MdsBuffer* b = threadBuffer;
+      if (b && b->mesh == this) {
+        b->released.push_back(op);
+        mds_apf_destroy_buffered(mesh, &b->buffer, id);
+        return;
+      }
       putPME(parts, op);
       mds_apf_destroy_entity(mesh,id);
     }
@@ -680,15 +755,13 @@ class MeshMDS : public Mesh2
     }
     void getMatches(MeshEntity* e, Matches& m)
     {
-      mds_copies* c = mds_get_copies(&mesh->matches, fromEnt(e));
-      if (!c) {
-        m.setSize(0);
-        return;
-      }
-      m.setSize(c->n);
-      for (int i = 0; i < c->n; ++i) {
-        m[i].entity = toEnt(c->c[i].e);
-        m[i].peer = c->c[i].p;
+      mds_id id = fromEnt(e);
+      int n = mds_count_copies(&mesh->matches, id);
+      m.setSize(n);
+      for (int i = 0; i < n; ++i) {
+        mds_copy c = mds_get_copy(&mesh->matches, id, i);
+        m[i].entity = toEnt(c.e);
+        m[i].peer = c.p;
       }
     }
     void getDgCopies(MeshEntity* e, DgCopies& dgCopies, ModelEntity* me)
@@ -728,6 +801,89 @@ class MeshMDS : public Mesh2
       };
       return table[type];
     }
+    int iterateBatch(MeshIterator* it, MeshEntity** es, int n)
+    {
+      mds_id id = fromIter(it);
+      int i;
+      for (i = 0; i < n && id != MDS_NONE; ++i) {
+        es[i] = toEnt(id);
+        toIter(mds_next(&(mesh->mds),id),it);
+        id = fromIter(it);
+      }
+      return i;
+    }
+    int getDownwardBatch(MeshEntity* const* es, int n,
+        int dimension, MeshEntity** adjacent)
+    {
+      if (!n)
+        return 0;
+      mds* m = &(mesh->mds);
+      int t = mds_type(fromEnt(es[0]));
+      if (dimension >= mds_dim[t] || !m->mrm[mds_dim[t]][dimension])
+        return Mesh::getDownwardBatch(es, n, dimension, adjacent);
+      int degree = mds_degree[t][dimension];
+      mds_id const* down = m->down[dimension][t];
+      for (int i = 0; i < n; ++i) {
+        mds_id id = fromEnt(es[i]);
+        PCU_ALWAYS_ASSERT(mds_type(id) == t);
+        mds_id const* d = down + mds_index(id) * degree;
+        for (int j = 0; j < degree; ++j)
+          adjacent[i * degree + j] = toEnt(d[j]);
+      }
+      return degree;
+    }
+    void getPointBatch(MeshEntity* const* es, int n, double* points)
+    {
+      if (!hasNativeCoordinates())
+        return Mesh::getPointBatch(es, n, points);
+      for (int i = 0; i < n; ++i)
+        memcpy(points + 3 * i, mds_apf_point(mesh,fromEnt(es[i])),
+            3 * sizeof(double));
+    }
+    void getTagBatch(MeshEntity* const* es, int n, MeshTag* t, void* data)
+    {
+      mds_tag* tag = reinterpret_cast<mds_tag*>(t);
+      char* p = static_cast<char*>(data);
+      for (int i = 0; i < n; ++i) {
+        mds_id id = fromEnt(es[i]);
+        if (!mds_has_tag(tag,id)) {
+          fprintf(stderr, "expected tag \"%s\" on entity type %d\n",
+              tag->name, mds_type(id));
+          abort();
+        }
+        memcpy(p + i * tag->bytes, mds_get_tag(tag,id), tag->bytes);
+      }
+    }
+    void getIntTagBatch(MeshEntity* const* es, int n,
+        MeshTag* tag, int* data)
+    {
+      getTagBatch(es, n, tag, data);
+    }
+    void getDoubleTagBatch(MeshEntity* const* es, int n,
+        MeshTag* tag, double* data)
+    {
+      getTagBatch(es, n, tag, data);
+    }
+    void toModelBatch(MeshEntity* const* es, int n, ModelEntity** models)
+    {
+      for (int i = 0; i < n; ++i)
+        models[i] = reinterpret_cast<ModelEntity*>(
+            mds_apf_model(mesh, fromEnt(es[i])));
+    }
+    void getOwnerBatch(MeshEntity* const* es, int n, int* owners)
+    {
+      for (int i = 0; i < n; ++i)
+        owners[i] = static_cast<PME*>(
+            mds_get_part(mesh, fromEnt(es[i])))->owner;
+    }
+    long getIndex(MeshEntity* e)
+    {
+      return mds_index(fromEnt(e));
+    }
+    long countIndices(int type)
+    {
+      return mesh->mds.end[apf2mds(type)];
+    }
     mds_apf* mesh;
     PM parts;
     bool isMatched;
@@ -776,6 +932,8 @@ void reorderMdsMesh(Mesh2* mesh, MeshTag* t)
 {
   double t0 = PCU_Time();
   MeshMDS* m = static_cast<MeshMDS*>(mesh);
+  m->requireUnfrozen();
+  ++m->changeCount;
   mds_tag* vert_nums;
   if (t) {
     PCU_ALWAYS_ASSERT(mesh->getTagType(t) == Mesh::INT);
@@ -788,6 +946,59 @@ void reorderMdsMesh(Mesh2* mesh, MeshTag* t)
     printf("mesh reordered in %f seconds\n", PCU_Time()-t0);
 }
 
+MeshTag* numberMdsHilbert(Mesh2* in)
+{
+  MeshMDS* m = static_cast<MeshMDS*>(in);
+  return reinterpret_cast<MeshTag*>(mds_number_verts_hilbert(m->mesh));
+}
+
+void compactMdsMesh(Mesh2* in, bool order, MeshTag* t)
+{
+  double t0 = PCU_Time();
+  MeshMDS* m = static_cast<MeshMDS*>(in);
+  m->requireUnfrozen();
+  ++m->changeCount;
+  mds_tag* vert_nums = 0;
+  if (order && t) {
+    PCU_ALWAYS_ASSERT(in->getTagType(t) == Mesh::INT);
+    vert_nums = reinterpret_cast<mds_tag*>(t);
+  } else if (order) {
+    vert_nums = mds_number_verts_bfs(m->mesh);
+  }
+  mds_compact(m->mesh, vert_nums);
+  if (order && !t)
+    mds_destroy_tag(&m->mesh->tags, vert_nums);
+  if (!PCU_Comm_Self())
+    printf("mesh compacted in %f seconds\n", PCU_Time()-t0);
+}
+
+double getMdsFill(Mesh2* in)
+{
+  MeshMDS* m = static_cast<MeshMDS*>(in);
+  return mds_fill(&m->mesh->mds);
+}
+
+size_t getMdsBytes(Mesh2* in, size_t idBytes)
+{
+  MeshMDS* m = static_cast<MeshMDS*>(in);
+  return mds_apf_bytes(m->mesh, idBytes);
+}
+
+long getMdsMaxEntities(int type)
+{
+  return mds_max_cap(apf2mds(type));
+}
+
+void setMdsArena(bool on)
+{
+  mds_set_arena(on);
+}
+
+void setMdsGroupSize(int n)
+{
+  mds_set_smb_group(n);
+}
+
 Mesh2* expandMdsMesh(Mesh2* m, gmi_model* g, int inputPartCount)
 {
   double t0 = PCU_Time();
@@ -994,6 +1205,17 @@ int getMdsIndex(Mesh2* in, MeshEntity* e)
   return i;
 }
 
+MeshIterator* beginMdsRange(Mesh2* in, int dimension, int part, int parts)
+{
+  MeshMDS* m = static_cast<MeshMDS*>(in);
+  mds_id first;
+  mds_id stop;
+  mds_range(&(m->mesh->mds), dimension, part, parts, &first, &stop);
+  MeshIterator* it = makeIter(stop);
+  toIter(first, it);
+  return it;
+}
+
 MeshEntity* getMdsEntity(Mesh2* in, int dimension, int index)
 {
   MeshMDS* m = static_cast<MeshMDS*>(in);
@@ -1026,6 +1248,45 @@ void hackMdsAdjacency(Mesh2* in, MeshEntity* up, int i, MeshEntity* down)
   mds_hack_adjacent(&m->mesh->mds, fromEnt(up), i, fromEnt(down));
 }
 
+MdsBuffer* createMdsBuffer(Mesh2* in)
+{
+  MeshMDS* m = dynamic_cast<MeshMDS*>(in);
+  if (!m)
+    return 0;
+  MdsBuffer* b = new MdsBuffer();
+  b->mesh = m;
+  mds_init_buffer(&b->buffer);
+  Parts self;
+  self.insert(m->getId());
+  b->residence = getPME(m->parts, self);
+  b->built = 0;
+  return b;
+}
+
+void reserveMdsEntities(MdsBuffer* b, long const* counts)
+{
+  mds_id c[MDS_TYPES];
+  for (int t = 0; t < Mesh::TYPES; ++t)
+    c[apf2mds(t)] = counts[t];
+  mds_apf_reserve(b->mesh->mesh, &b->buffer, c);
+}
+
+void useMdsBuffer(MdsBuffer* b)
+{
+  threadBuffer = b;
+}
+
+void destroyMdsBuffer(MdsBuffer* b)
+{
+  MeshMDS* m = b->mesh;
+  mds_unreserve(&m->mesh->mds, &b->buffer);
+  b->residence->refs += b->built;
+  for (size_t i = 0; i < b->released.size(); ++i)
+    putPME(m->parts, b->released[i]);
+  putPME(m->parts, b->residence);
+  delete b;
+}
+
 Mesh2* loadMdsPart(gmi_model* model, const char* meshfile)
 {
   MeshMDS* m = new MeshMDS();
@@ -31,6 +31,7 @@
   \brief Interface to the compact Mesh Data Structure */
 
 #include <map>
+#include <cstddef>
 
 struct gmi_model;
 
@@ -40,6 +41,7 @@ class Mesh;
 class Mesh2;
 class MeshTag;
 class MeshEntity;
+class MeshIterator;
 class Migration;
 
 /** \brief create an empty MDS part
@@ -91,6 +93,61 @@ Mesh2* createMdsMesh(gmi_model* model, Mesh* from);
            there are no gaps in the MDS arrays after this */
 void reorderMdsMesh(Mesh2* mesh, MeshTag* t = 0);
 
+/** \brief number the vertices along a Hilbert space-filling curve
+  \details returns an integer tag on the vertices for apf::reorderMdsMesh
+           or apf::compactMdsMesh, which then order the other entities
+           by their vertices.
+           This sorts keys computed from the vertex coordinates, so it
+           is O(n log n) and gives good locality even when the input
+           order has none.
+           apf::reorderMdsMesh consumes the tag, while after
+           apf::compactMdsMesh it should be removed and destroyed. */
+MeshTag* numberMdsHilbert(Mesh2* in);
+
+/** \brief close the gaps left in the MDS arrays by destroyed entities
+  \details unlike apf::reorderMdsMesh, this renumbers the entities
+           in place rather than building a new mesh, so the peak
+           memory use stays near the size of the mesh itself.
+           By default the entities keep their relative order.
+           If (order) is true they are sorted as apf::reorderMdsMesh
+           would sort them, using (t) or a breadth-first numbering.
+           This is collective, since remote copies are updated.
+           All MeshEntity pointers held before this call are invalid
+           afterwards, though tags and fields move with their entities. */
+void compactMdsMesh(Mesh2* in, bool order = false, MeshTag* t = 0);
+
+/** \brief return the fraction of the MDS array slots holding entities
+  \details this is 1 after compaction and decreases as entities are
+           destroyed, see apf::compactMdsMesh */
+double getMdsFill(Mesh2* in);
+
+/** \brief return the bytes held by the arrays of an MDS mesh
+  \details this counts the adjacency, coordinate, classification,
+           tag and remote copy arrays, but not heap overhead.
+           Given (idBytes), it returns the bytes the same arrays would
+           hold with entity ids of that size, which compares builds
+           with different MDS_ID_TYPE without rebuilding. */
+size_t getMdsBytes(Mesh2* in, size_t idBytes = 0);
+
+/** \brief return the most entities of one type an MDS part can hold
+  \details this is limited by the size of MDS_ID_TYPE, which is an
+           int unless lion is configured with -DMDS_ID_TYPE=long.
+           Parts that are too large fail when they grow or are read. */
+long getMdsMaxEntities(int type);
+
+/** \brief allocate new MDS arrays as page mappings instead of on the heap
+  \details mapped arrays grow by remapping their pages, which avoids
+           copying them and needing room for both copies while they grow.
+           This affects meshes created after the call. */
+void setMdsArena(bool on);
+
+/** \brief set how many consecutive ranks share one file
+           when writing or reading a path prefixed by "agg:"
+  \details the default is 64. Group leaders hold two of the
+           part files of their group in memory at a time, and
+           reading needs the same group size as writing. */
+void setMdsGroupSize(int n);
+
 Mesh2* repeatMdsMesh(Mesh2* m, gmi_model* g, Migration* plan, int factor);
 Mesh2* expandMdsMesh(Mesh2* m, gmi_model* g, int inputPartCount);
 
@@ -153,6 +210,44 @@ int getMdsIndex(Mesh2* in, MeshEntity* e);
   so call apf::reorderMdsMesh after any mesh modification. */
 MeshEntity* getMdsEntity(Mesh2* in, int dimension, int index);
 
+/** \brief begin iterating over one of (parts) ranges of entities
+  \details the entities of one dimension are split into (parts)
+  contiguous ranges of their array slots, and this returns an
+  iterator over range (part), to be used with apf::Mesh::iterate
+  and freed with apf::Mesh::end. Together the ranges visit each
+  entity once, in iteration order. Each thread may iterate over
+  its own range at the same time as the others, since read-only
+  queries on an MDS mesh are thread safe, see apf::Mesh. */
+MeshIterator* beginMdsRange(Mesh2* in, int dimension, int part, int parts);
+
+/** \brief a thread's share of the free entity slots of an MDS mesh */
+struct MdsBuffer;
+
+/** \brief create a buffer to modify an MDS mesh from threads
+  \details returns null if the mesh is not MDS.
+  While a thread uses a buffer, see apf::useMdsBuffer,
+  apf::Mesh2::createEntity and apf::Mesh2::destroy on that thread
+  only touch the entities they create or destroy and the
+  adjacencies of their closure, so several threads may modify
+  disjoint parts of the mesh at the same time.
+  Entities created or destroyed this way must not be shared,
+  and nothing may create entities without a buffer
+  until all buffers are destroyed. */
+MdsBuffer* createMdsBuffer(Mesh2* in);
+
+/** \brief set aside slots for entities the buffer will create
+  \details counts is indexed by apf::Mesh::Type.
+  Call this before the threads start, since it may grow the mesh. */
+void reserveMdsEntities(MdsBuffer* b, long const* counts);
+
+/** \brief create and destroy entities on this thread through b
+  \details pass null to stop */
+void useMdsBuffer(MdsBuffer* b);
+
+/** \brief merge the changes made through a buffer into the mesh
+  \details call this once no thread uses the buffer. */
+void destroyMdsBuffer(MdsBuffer* b);
+
 Mesh2* loadMdsFromGmsh(gmi_model* g, const char* filename);
 
 Mesh2* loadMdsFromUgrid(gmi_model* g, const char* filename);
@@ -9,6 +9,7 @@
 *******************************************************************************/
 
 #include "mds.h"
+#include "mds_map.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -16,14 +17,14 @@
 #include <PCU.h>
 #include <reel.h>
 
-static void* mds_realloc(void* p, size_t n)
+void* mds_realloc(void* p, size_t n)
 {
   if ((!p)&&(!n))
     return NULL;
   if (n)
-    p = realloc(p,n);
+    p = mds_map_realloc(p,n);
   else {
-    free(p);
+    mds_map_free(p);
     p = NULL;
   }
   if ((!p) && (n))
@@ -233,6 +234,7 @@ static void alloc_adjacency(struct mds* m, int from_dim, int to_dim)
 void mds_remove_adjacency(struct mds* m, int from_dim, int to_dim)
 {
   mds_id zero_cap[MDS_TYPES] = {0};
+  mds_thaw(m);
   resize_adjacency(m,from_dim,to_dim,m->cap,zero_cap);
   m->mrm[from_dim][to_dim] = 0;
 }
@@ -253,6 +255,46 @@ static void resize_free(struct mds* m)
     REALLOC(m->free[t],m->cap[t]);
 }
 
+mds_id mds_max_cap(int t)
+{
+  int d;
+  mds_id deg = 1;
+  for (d = 0; d < 4; ++d)
+    if (mds_degree[t][d] > deg)
+      deg = mds_degree[t][d];
+  return (MDS_ID_MAX - MDS_TYPES) / (MDS_TYPES * deg);
+}
+
+size_t mds_bytes(struct mds* m, size_t id_bytes)
+{
+  size_t ids = 0;
+  int from, to, t;
+  for (t = 0; t < MDS_TYPES; ++t)
+    ids += m->cap[t];
+  for (from = 0; from <= 3; ++from)
+  for (to = 0; to <= 3; ++to) {
+    if (from == to || !m->mrm[from][to])
+      continue;
+    for (t = 0; t < MDS_TYPES; ++t) {
+      if (from < to && mds_dim[t] == to)
+        ids += (size_t)m->cap[t] * mds_degree[t][from];
+      else if (from < to && mds_dim[t] == from)
+        ids += m->cap[t];
+      else if (from > to && mds_dim[t] == from)
+        ids += (size_t)m->cap[t] * mds_degree[t][to];
+    }
+  }
+  return ids * id_bytes;
+}
+
+static void check_cap(int t, mds_id cap)
+{
+  if (cap > mds_max_cap(t))
+    reel_fail("MDS: a part can hold at most %ld entities of type %d"
+        " with %d byte ids,\nrebuild with -DMDS_ID_TYPE=long\n",
+        (long)mds_max_cap(t), t, (int)sizeof(mds_id));
+}
+
 static void resize(struct mds* m, mds_id old_cap[MDS_TYPES])
 {
   resize_adjacencies(m,old_cap);
@@ -265,8 +307,10 @@ void mds_create(struct mds* m, int d, mds_id cap[MDS_TYPES])
   mds_id zero_cap[MDS_TYPES] = {0};
   ZERO(*m);
   m->d = d;
-  for (i = 0; i < MDS_TYPES; ++i)
+  for (i = 0; i < MDS_TYPES; ++i) {
+    check_cap(i, cap[i]);
     m->cap[i] = cap[i];
+  }
   for (i = 0; i <= d; ++i)
   for (j = 0; j <= d; ++j)
     if (abs(i-j)==1)
@@ -280,6 +324,7 @@ void mds_destroy(struct mds* m)
 {
   int i;
   mds_id old_cap[MDS_TYPES];
+  mds_thaw(m);
   for (i = 0; i < MDS_TYPES; ++i)
     old_cap[i] = m->cap[i];
   ZERO(m->cap);
@@ -505,16 +550,27 @@ static mds_id common_down(struct mds* m, mds_id a, mds_id b, int d)
   return MDS_NONE;
 }
 
-static void grow(struct mds* m, int t)
+/* grows the capacity of type t to at least cap */
+static void grow_to(struct mds* m, int t, mds_id cap)
 {
   int i;
   mds_id old_cap[MDS_TYPES];
   for (i = 0; i < MDS_TYPES; ++i)
     old_cap[i] = m->cap[i];
+  check_cap(t, cap);
   m->cap[t] = ((old_cap[t] + 2) * 3) / 2;
+  if (m->cap[t] < cap)
+    m->cap[t] = cap;
+  if (m->cap[t] > mds_max_cap(t))
+    m->cap[t] = mds_max_cap(t);
   resize(m,old_cap);
 }
 
+static void grow(struct mds* m, int t)
+{
+  grow_to(m, t, m->cap[t] + 1);
+}
+
 static mds_id fill_hole(struct mds* m, int t)
 {
   mds_id *head;
@@ -534,12 +590,6 @@ static mds_id alloc_ent(struct mds* m, int t)
   if (m->n[t] == m->cap[t])
     grow(m,t);
   ++(m->n[t]);
-  if ((sizeof(mds_id) < 8) && (m->n[t] == 10 * 1000 * 1000)) {
-    fprintf(stderr, "your mesh over %ld entities of type %d but sizeof(mds_id) = %zu !\n",
-        ((long)(m->n[t])), t, sizeof(mds_id));
-    fprintf(stderr, "INTEGER OVERFLOW COULD OCCUR SOON\n");
-    fprintf(stderr, "please recompile with -DMDS_ID_TYPE=long\n");
-  }
   if (m->first_free[t] == MDS_NONE)
     id = ID(t,m->n[t] - 1);
   else
@@ -602,12 +652,109 @@ static void unrelate_ent(struct mds* m, mds_id e)
 
 void mds_destroy_entity(struct mds* m, mds_id e)
 {
+  mds_thaw(m);
   check_ent(m,e);
   if (TYPE(e) != MDS_VERTEX)
     unrelate_ent(m,e);
   free_ent(m,e);
 }
 
+void mds_init_buffer(struct mds_buffer* b)
+{
+  int t;
+  for (t = 0; t < MDS_TYPES; ++t) {
+    b->reserved[t] = MDS_NONE;
+    b->freed[t] = MDS_NONE;
+    b->n[t] = 0;
+  }
+}
+
+/* moves the chain of slots starting at i onto the list at head */
+static void push_chain(struct mds* m, int t, mds_id i, mds_id* head)
+{
+  mds_id next;
+  while (i != MDS_NONE) {
+    next = m->free[t][i];
+    m->free[t][i] = *head;
+    *head = i;
+    i = next;
+  }
+}
+
+void mds_reserve(struct mds* m, struct mds_buffer* b,
+    mds_id count[MDS_TYPES])
+{
+  int t;
+  mds_id k;
+  mds_id i;
+  mds_thaw(m);
+  for (t = 0; t < MDS_TYPES; ++t) {
+    k = count[t];
+    for (; k && m->first_free[t] != MDS_NONE; --k) {
+      i = m->first_free[t];
+      m->first_free[t] = m->free[t][i];
+      m->free[t][i] = b->reserved[t];
+      b->reserved[t] = i;
+    }
+    if (!k)
+      continue;
+    if (m->end[t] + k > m->cap[t])
+      grow_to(m, t, m->end[t] + k);
+    for (; k; --k) {
+      i = m->end[t]++;
+      m->free[t][i] = b->reserved[t];
+      b->reserved[t] = i;
+    }
+  }
+}
+
+mds_id mds_create_buffered(struct mds* m, struct mds_buffer* b,
+    int type, mds_id* from)
+{
+  mds_id i;
+  mds_id id;
+  PCU_ALWAYS_ASSERT(!m->frozen);
+  i = b->reserved[type];
+  if (i == MDS_NONE)
+    reel_fail("MDS: a buffer ran out of reserved entities of type %d\n",
+        type);
+  b->reserved[type] = m->free[type][i];
+  m->free[type][i] = MDS_LIVE;
+  ++(b->n[type]);
+  id = ID(type,i);
+  if (type != MDS_VERTEX)
+    relate_both(m,from,id);
+  return id;
+}
+
+void mds_destroy_buffered(struct mds* m, struct mds_buffer* b, mds_id e)
+{
+  int t;
+  mds_id i;
+  PCU_ALWAYS_ASSERT(!m->frozen);
+  check_ent(m,e);
+  t = TYPE(e);
+  i = INDEX(e);
+  if (t != MDS_VERTEX)
+    unrelate_ent(m,e);
+  m->free[t][i] = b->freed[t];
+  b->freed[t] = i;
+  --(b->n[t]);
+}
+
+void mds_unreserve(struct mds* m, struct mds_buffer* b)
+{
+  int t;
+  for (t = 0; t < MDS_TYPES; ++t) {
+    push_chain(m, t, b->reserved[t], &m->first_free[t]);
+    push_chain(m, t, b->freed[t], &m->first_free[t]);
+    b->reserved[t] = MDS_NONE;
+    b->freed[t] = MDS_NONE;
+    m->n[t] += b->n[t];
+    b->n[t] = 0;
+  }
+}
+
 void mds_hack_adjacent(struct mds* m, mds_id up, int i, mds_id down)
 {
   int ut;
@@ -616,6 +763,7 @@ void mds_hack_adjacent(struct mds* m, mds_id up, int i, mds_id down)
   int deg;
   mds_id x;
   mds_id od;
+  mds_thaw(m);
   check_ent(m, up);
   check_ent(m, down);
   ut = TYPE(up);
@@ -669,6 +817,7 @@ static void convert_down(struct mds* m,
 
 mds_id mds_create_entity(struct mds* m, int t, mds_id* from)
 {
+  mds_thaw(m);
   PCU_ALWAYS_ASSERT(0 <= t);
   PCU_ALWAYS_ASSERT(t < MDS_TYPES);
   if (t == MDS_VERTEX)
@@ -724,11 +873,19 @@ static void get_down(struct mds* m, mds_id e, int d, struct mds_set* out)
 void mds_get_adjacent(struct mds* m, mds_id e, int d, struct mds_set* s)
 {
   int e_dim;
+  mds_id const* frozen;
+  int i;
   if (d > m->d) {
     s->n = 0;
     return;
   }
   check_ent(m,e);
+  s->n = mds_get_frozen(m,e,d,&frozen);
+  if (s->n >= 0) {
+    for (i = 0; i < s->n; ++i)
+      s->e[i] = frozen[i];
+    return;
+  }
   e_dim = mds_dim[TYPE(e)];
   if ((e_dim == d) || m->mrm[e_dim][d]) {
     look(m,e,d,s);
@@ -774,10 +931,45 @@ mds_id mds_next(struct mds* m, mds_id e)
   return skip(m,ID(TYPE(e),INDEX(e) + 1));
 }
 
+/* the slot-th array slot of dimension d, counting through the types
+   of that dimension in iteration order, or MDS_NONE past the end */
+static mds_id find_slot(struct mds* m, int d, mds_id slot)
+{
+  int t;
+  for (t = 0; t < MDS_TYPES; ++t)
+    if (mds_dim[t] == d) {
+      if (slot < m->end[t])
+        return ID(t,slot);
+      slot -= m->end[t];
+    }
+  return MDS_NONE;
+}
+
+/* splits the array slots of dimension d into parts contiguous
+   ranges of nearly equal size. Iterating with mds_next from *first
+   until reaching *stop visits the live entities in range part,
+   so the ranges together visit each entity once, in order. */
+void mds_range(struct mds* m, int d, int part, int parts,
+    mds_id* first, mds_id* stop)
+{
+  int t;
+  long slots = 0;
+  mds_id a;
+  mds_id b;
+  for (t = 0; t < MDS_TYPES; ++t)
+    if (mds_dim[t] == d)
+      slots += m->end[t];
+  a = find_slot(m, d, (mds_id)((slots * part) / parts));
+  b = find_slot(m, d, (mds_id)((slots * (part + 1)) / parts));
+  *first = (a == MDS_NONE) ? MDS_NONE : skip(m, a);
+  *stop = (b == MDS_NONE) ? MDS_NONE : skip(m, b);
+}
+
 void mds_add_adjacency(struct mds* m, int from_dim, int to_dim)
 {
   mds_id e;
   struct mds_set adj;
+  mds_thaw(m);
   alloc_adjacency(m,from_dim,to_dim);
   if (from_dim < to_dim)
     for (e = mds_begin(m,to_dim);
@@ -835,3 +1027,18 @@ void mds_change_dimension(struct mds* m, int d)
   while (m->d > d)
     decrease_dimension(m);
 }
+
+/* the fraction of array slots holding live entities */
+double mds_fill(struct mds* m)
+{
+  int t;
+  double n = 0;
+  double end = 0;
+  for (t = 0; t < MDS_TYPES; ++t) {
+    n += m->n[t];
+    end += m->end[t];
+  }
+  if (!end)
+    return 1;
+  return n / end;
+}
@@ -12,6 +12,7 @@
 #define MDS_H
 
 #include "mds_config.h"
+#include <stddef.h>
 
 enum {
   MDS_VERTEX,
@@ -27,9 +28,14 @@ enum {
 
 typedef MDS_ID_TYPE mds_id;
 
+/* the largest mds_id, for any signed MDS_ID_TYPE */
+#define MDS_ID_MAX ((((mds_id)1 << (sizeof(mds_id) * 8 - 2)) - 1) * 2 + 1)
+
 #define MDS_NONE -1
 #define MDS_LIVE -2
 
+struct mds_csr;
+
 struct mds {
   int d;
   mds_id n[MDS_TYPES];
@@ -41,6 +47,7 @@ struct mds {
   mds_id* first_up[4][MDS_TYPES];
   mds_id* free[MDS_TYPES];
   mds_id first_free[MDS_TYPES];
+  struct mds_csr* frozen;
 };
 
 struct mds_set {
@@ -52,6 +59,9 @@ extern int const mds_dim[MDS_TYPES];
 extern int const mds_degree[MDS_TYPES][4];
 extern int const* mds_types[MDS_TYPES][4];
 
+/* realloc for MDS arrays, which fails instead of returning NULL */
+void* mds_realloc(void* p, size_t n);
+
 void mds_create(struct mds* m, int d, mds_id cap[MDS_TYPES]);
 void mds_destroy(struct mds* m);
 mds_id mds_create_entity(struct mds* m, int type, mds_id *from);
@@ -62,14 +72,66 @@ mds_id mds_identify(int type, mds_id idx);
 void mds_get_adjacent(struct mds* m, mds_id e, int dim, struct mds_set* s);
 mds_id mds_begin(struct mds* m, int dim);
 mds_id mds_next(struct mds* m, mds_id);
+void mds_range(struct mds* m, int d, int part, int parts,
+    mds_id* first, mds_id* stop);
 
 void mds_add_adjacency(struct mds* m, int from_dim, int to_dim);
 void mds_remove_adjacency(struct mds* m, int from_dim, int to_dim);
 
 int mds_has_up(struct mds* m, mds_id e);
 
+/* new indices for all entities, see mds_renumber */
+struct mds_renumber {
+  mds_id* to[MDS_TYPES]; /* new index by old index, MDS_NONE for holes */
+  mds_id n[MDS_TYPES]; /* live entities, the new end */
+  mds_id end[MDS_TYPES]; /* the old end */
+  int in_order; /* entities keep their order, so rows only move down */
+};
+
+double mds_fill(struct mds* m);
+/* the most entities of type t a part can hold before their ids,
+   or the ids of their adjacency list entries, overflow mds_id */
+mds_id mds_max_cap(int t);
+/* bytes held by the entity arrays, or the bytes they would hold
+   if mds_id had id_bytes bytes. Frozen tables are not counted. */
+size_t mds_bytes(struct mds* m, size_t id_bytes);
+mds_id mds_renumbered(struct mds_renumber* r, mds_id e);
+void* mds_renumber_rows(struct mds_renumber* r, int t, void* a,
+    size_t bytes, mds_id cap);
+void mds_renumber(struct mds* m, struct mds_renumber* r);
+
+void mds_freeze(struct mds* m);
+void mds_thaw(struct mds* m);
+int mds_get_frozen(struct mds* m, mds_id e, int d, mds_id const** adj);
+
 void mds_change_dimension(struct mds* m, int d);
 
+/* a thread's share of the free entity slots.
+   Creating and destroying entities through a buffer only touches
+   the slots of those entities and the adjacencies of their closure,
+   so threads with their own buffers can modify parts of the mesh
+   whose closures are disjoint at the same time.
+   The slots are chained through m->free like the shared free list,
+   and the mesh counts are only updated by mds_unreserve. */
+struct mds_buffer {
+  mds_id reserved[MDS_TYPES]; /* slots set aside for creation */
+  mds_id freed[MDS_TYPES]; /* slots of entities destroyed so far */
+  mds_id n[MDS_TYPES]; /* entities created minus destroyed */
+};
+
+void mds_init_buffer(struct mds_buffer* b);
+/* sets aside count[t] more slots of each type t, from the free
+   list first and then past the end, which may grow the arrays */
+void mds_reserve(struct mds* m, struct mds_buffer* b,
+    mds_id count[MDS_TYPES]);
+mds_id mds_create_buffered(struct mds* m, struct mds_buffer* b,
+    int type, mds_id* from);
+void mds_destroy_buffered(struct mds* m, struct mds_buffer* b, mds_id e);
+/* returns the unused reserved slots and the slots freed through
+   the buffer, and updates the mesh counts. Until then freed slots
+   are not reused, so their ids stay unique among live entities. */
+void mds_unreserve(struct mds* m, struct mds_buffer* b);
+
 void mds_hack_adjacent(struct mds* m, mds_id up, int i, mds_id down);
 
 #endif
@@ -9,7 +9,9 @@
 *******************************************************************************/
 
 #include "mds_apf.h"
+#include "mds_map.h"
 #include <stdlib.h>
+#include <string.h>
 #include <pcu_util.h>
 #include <PCU.h>
 
@@ -23,13 +25,16 @@ struct mds_apf* mds_apf_create(struct gmi_model* model, int d,
   m = malloc(sizeof(*m));
   mds_create(&(m->mds),d,cap);
   mds_create_tags(&(m->tags));
-  m->point = malloc(cap[MDS_VERTEX] * sizeof(*(m->point)));
-  m->param = malloc(cap[MDS_VERTEX] * sizeof(*(m->param)));
+  m->point = mds_map_realloc(NULL, cap[MDS_VERTEX] * sizeof(*(m->point)));
+  m->param = mds_map_realloc(NULL, cap[MDS_VERTEX] * sizeof(*(m->param)));
   for (t = 0; t < MDS_TYPES; ++t)
-    m->model[t] = malloc(cap[t] * sizeof(*(m->model[t])));
+    m->model[t] = mds_map_realloc(NULL, cap[t] * sizeof(*(m->model[t])));
   m->user_model = model;
-  for (t = 0; t < MDS_TYPES; ++t)
-    m->parts[t] = calloc(cap[t], sizeof(*(m->parts[t])));
+  for (t = 0; t < MDS_TYPES; ++t) {
+    m->parts[t] = mds_map_realloc(NULL, cap[t] * sizeof(*(m->parts[t])));
+    if (m->parts[t])
+      memset(m->parts[t], 0, cap[t] * sizeof(*(m->parts[t])));
+  }
   mds_create_net(&m->remotes);
 //seol
   mds_create_net(&m->ghosts);
@@ -45,16 +50,72 @@ void mds_apf_destroy(struct mds_apf* m)
   mds_destroy_net(&m->ghosts, &m->mds);
   mds_destroy_net(&m->remotes, &m->mds);
   for (t = 0; t < MDS_TYPES; ++t)
-    free(m->model[t]);
+    mds_map_free(m->model[t]);
   for (t = 0; t < MDS_TYPES; ++t)
-    free(m->parts[t]);
-  free(m->point);
-  free(m->param);
+    mds_map_free(m->parts[t]);
+  mds_map_free(m->point);
+  mds_map_free(m->param);
   mds_destroy_tags(&(m->tags));
   mds_destroy(&(m->mds));
   free(m);
 }
 
+static size_t round_up(size_t bytes, size_t align)
+{
+  return ((bytes + align - 1) / align) * align;
+}
+
+static size_t net_bytes(struct mds_net* net, struct mds* m, size_t id_bytes)
+{
+  size_t align = id_bytes > sizeof(int) ? id_bytes : sizeof(int);
+  size_t copy = round_up(id_bytes + sizeof(int), align);
+  size_t bytes = 0;
+  struct mds_frozen_net* f = net->frozen;
+  struct mds_copies* cs;
+  int t;
+  mds_id i;
+  for (t = 0; t < MDS_TYPES; ++t) {
+    if (f && f->offsets[t]) {
+      bytes += (f->n[t] + 1 + f->np[t] + 1) * id_bytes;
+      bytes += f->np[t] * sizeof(int);
+      bytes += f->offsets[t][f->n[t]] * 3 * id_bytes;
+    }
+    if (!net->data[t])
+      continue;
+    bytes += m->cap[t] * sizeof(*(net->data[t]));
+    for (i = 0; i < m->end[t]; ++i) {
+      cs = net->data[t][i];
+      if (cs)
+        bytes += align + cs->n * copy;
+    }
+  }
+  return bytes;
+}
+
+size_t mds_apf_bytes(struct mds_apf* m, size_t id_bytes)
+{
+  size_t bytes;
+  struct mds_tag* tag;
+  int t;
+  if (!id_bytes)
+    id_bytes = sizeof(mds_id);
+  bytes = mds_bytes(&m->mds, id_bytes);
+  bytes += m->mds.cap[MDS_VERTEX] * (sizeof(*(m->point)) +
+      sizeof(*(m->param)));
+  for (t = 0; t < MDS_TYPES; ++t)
+    bytes += m->mds.cap[t] * (sizeof(*(m->model[t])) +
+        sizeof(*(m->parts[t])));
+  for (tag = m->tags.first; tag; tag = tag->next)
+    for (t = 0; t < MDS_TYPES; ++t)
+      if (tag->has[t])
+        bytes += (m->mds.cap[t] / 8) + 1 +
+          (size_t)tag->bytes * m->mds.cap[t];
+  bytes += net_bytes(&m->remotes, &m->mds, id_bytes);
+  bytes += net_bytes(&m->ghosts, &m->mds, id_bytes);
+  bytes += net_bytes(&m->matches, &m->mds, id_bytes);
+  return bytes;
+}
+
 double* mds_apf_point(struct mds_apf* m, mds_id e)
 {
   return m->point[mds_index(e)];
@@ -75,39 +136,56 @@ void mds_apf_set_model(struct mds_apf* m, mds_id e, struct gmi_ent* model)
   m->model[mds_type(e)][mds_index(e)] = model;
 }
 
-mds_id mds_apf_create_entity(
-    struct mds_apf* m, int type, struct gmi_ent* model, mds_id* from)
+/* grows the arrays of types whose capacity changed from old_cap */
+static void grow_arrays(struct mds_apf* m, mds_id old_cap[MDS_TYPES])
 {
   int t;
-  mds_id old_cap[MDS_TYPES];
-  mds_id e;
-  mds_id i;
-  old_cap[type] = m->mds.cap[type];
-  e = mds_create_entity(&(m->mds),type,from);
-  i = mds_index(e);
-  if (m->mds.cap[type] != old_cap[type]) {
-    for (t = 0; t < MDS_TYPES; ++t)
-      if (t != type)
-        old_cap[t] = m->mds.cap[t];
-    mds_grow_tags(&(m->tags),&(m->mds),old_cap);
-    if (type == MDS_VERTEX) {
-      m->point = realloc(m->point,m->mds.cap[type] * sizeof(*(m->point)));
-      m->param = realloc(m->param,m->mds.cap[type] * sizeof(*(m->param)));
+  mds_grow_tags(&(m->tags),&(m->mds),old_cap);
+  for (t = 0; t < MDS_TYPES; ++t) {
+    if (m->mds.cap[t] == old_cap[t])
+      continue;
+    if (t == MDS_VERTEX) {
+      m->point = mds_map_realloc(m->point,
+          m->mds.cap[t] * sizeof(*(m->point)));
+      m->param = mds_map_realloc(m->param,
+          m->mds.cap[t] * sizeof(*(m->param)));
     }
-    m->model[type] = realloc(m->model[type],
-        m->mds.cap[type] * sizeof(*(m->model[type])));
-    m->parts[type] = realloc(m->parts[type],
-        m->mds.cap[type] * sizeof(*(m->parts[type])));
-    mds_grow_net(&m->remotes, &m->mds, old_cap); 
-    mds_grow_net(&m->ghosts, &m->mds, old_cap); //seol
-    mds_grow_net(&m->matches, &m->mds, old_cap);
+    m->model[t] = mds_map_realloc(m->model[t],
+        m->mds.cap[t] * sizeof(*(m->model[t])));
+    m->parts[t] = mds_map_realloc(m->parts[t],
+        m->mds.cap[t] * sizeof(*(m->parts[t])));
   }
+  mds_grow_net(&m->remotes, &m->mds, old_cap); 
+  mds_grow_net(&m->ghosts, &m->mds, old_cap); //seol
+  mds_grow_net(&m->matches, &m->mds, old_cap);
+}
+
+static void init_entity(struct mds_apf* m, mds_id e, struct gmi_ent* model)
+{
+  int type;
+  mds_id i;
+  type = mds_type(e);
+  i = mds_index(e);
   m->model[type][i] = model;
   m->parts[type][i] = NULL;
   if (type == MDS_VERTEX) {
     m->point[i][0] = m->point[i][1] = m->point[i][2] = 0;
     m->param[i][0] = m->param[i][1] = 0;
   }
+}
+
+mds_id mds_apf_create_entity(
+    struct mds_apf* m, int type, struct gmi_ent* model, mds_id* from)
+{
+  int t;
+  mds_id old_cap[MDS_TYPES];
+  mds_id e;
+  for (t = 0; t < MDS_TYPES; ++t)
+    old_cap[t] = m->mds.cap[t];
+  e = mds_create_entity(&(m->mds),type,from);
+  if (m->mds.cap[type] != old_cap[type])
+    grow_arrays(m, old_cap);
+  init_entity(m, e, model);
   return e;
 }
 
@@ -123,6 +201,48 @@ void mds_apf_destroy_entity(struct mds_apf* m, mds_id e)
   mds_destroy_entity(&(m->mds),e);
 }
 
+void mds_apf_reserve(struct mds_apf* m, struct mds_buffer* b,
+    mds_id count[MDS_TYPES])
+{
+  int t;
+  mds_id old_cap[MDS_TYPES];
+  for (t = 0; t < MDS_TYPES; ++t)
+    old_cap[t] = m->mds.cap[t];
+  mds_reserve(&(m->mds), b, count);
+  for (t = 0; t < MDS_TYPES; ++t)
+    if (m->mds.cap[t] != old_cap[t]) {
+      grow_arrays(m, old_cap);
+      break;
+    }
+  mds_thaw_net(&m->remotes, &m->mds);
+  mds_thaw_net(&m->ghosts, &m->mds);
+  mds_thaw_net(&m->matches, &m->mds);
+}
+
+mds_id mds_apf_create_buffered(struct mds_apf* m, struct mds_buffer* b,
+    int type, struct gmi_ent* model, mds_id* from)
+{
+  mds_id e;
+  e = mds_create_buffered(&(m->mds), b, type, from);
+  init_entity(m, e, model);
+  return e;
+}
+
+void mds_apf_destroy_buffered(struct mds_apf* m, struct mds_buffer* b,
+    mds_id e)
+{
+  struct mds_tag* t;
+  for (t = m->tags.first; t; t = t->next)
+    if (mds_has_tag(t,e))
+      mds_take_tag(t,e);
+  /* changing the nets is not thread safe, and entities
+     destroyed through buffers are not shared */
+  PCU_ALWAYS_ASSERT(!mds_get_copies(&m->remotes, e));
+  PCU_ALWAYS_ASSERT(!mds_get_copies(&m->ghosts, e));
+  PCU_ALWAYS_ASSERT(!mds_get_copies(&m->matches, e));
+  mds_destroy_buffered(&(m->mds), b, e);
+}
+
 void* mds_get_part(struct mds_apf* m, mds_id e)
 {
   return m->parts[mds_type(e)][mds_index(e)];
@@ -269,6 +389,7 @@ static int align_copies(struct mds_net* net, struct mds* m)
   mds_id e;
   struct mds_copies* c;
   int did_change = 0;
+  mds_thaw_net(net, m);
   PCU_Comm_Begin();
   for (d = 1; d < m->d; ++d)
     for (e = mds_begin(m, d); e != MDS_NONE; e = mds_next(m, e)) {
@@ -319,7 +440,6 @@ void mds_derive_model(struct mds_apf* m)
   int i;
   mds_id de;
   struct mds_set s;
-  struct mds_copies* c;
   struct gmi_ent* interior = mds_find_model(m, m->mds.d, 0);
   struct gmi_ent* boundary = mds_find_model(m, m->mds.d - 1, 0);
   /* first classify everything to the interior */
@@ -334,8 +454,7 @@ void mds_derive_model(struct mds_apf* m)
        e != MDS_NONE;
        e = mds_next(&m->mds, e)) {
     mds_get_adjacent(&m->mds, e, m->mds.d, &s);
-    c = mds_get_copies(&m->remotes, e);
-    if (c || s.n == 2)
+    if (mds_count_copies(&m->remotes, e) || s.n == 2)
       continue;
     for (d = 0; d < m->mds.d; ++d) {
       mds_get_adjacent(&m->mds, e, d, &s);
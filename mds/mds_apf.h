@@ -50,11 +50,24 @@ void mds_apf_set_model(struct mds_apf* m, mds_id e, struct gmi_ent* model);
 mds_id mds_apf_create_entity(
     struct mds_apf* m, int type, struct gmi_ent* model, mds_id* from);
 void mds_apf_destroy_entity(struct mds_apf* m, mds_id e);
+/* see mds_reserve. The entities must not be shared or matched */
+void mds_apf_reserve(struct mds_apf* m, struct mds_buffer* b,
+    mds_id count[MDS_TYPES]);
+mds_id mds_apf_create_buffered(struct mds_apf* m, struct mds_buffer* b,
+    int type, struct gmi_ent* model, mds_id* from);
+void mds_apf_destroy_buffered(struct mds_apf* m, struct mds_buffer* b,
+    mds_id e);
 
 void* mds_get_part(struct mds_apf* m, mds_id e);
 void mds_set_part(struct mds_apf* m, mds_id e, void* p);
 
+/* like mds_bytes, adding coordinates, classification, tags and
+   copies. Zero id_bytes means sizeof(mds_id) */
+size_t mds_apf_bytes(struct mds_apf* m, size_t id_bytes);
+
 struct mds_tag* mds_number_verts_bfs(struct mds_apf* m);
+struct mds_tag* mds_number_verts_hilbert(struct mds_apf* m);
+void mds_compact(struct mds_apf* m, struct mds_tag* vert_numbers);
 struct mds_apf* mds_reorder(struct mds_apf* m, int ignore_peers,
     struct mds_tag* vert_numbers);
 
@@ -66,6 +79,7 @@ struct mds_apf* mds_read_smb(struct gmi_model* model, const char* pathname,
     int ignore_peers, void* apf_mesh);
 struct mds_apf* mds_write_smb(struct mds_apf* m, const char* pathname,
     int ignore_peers, void* apf_mesh);
+void mds_set_smb_group(int n);
 
 void mds_verify(struct mds_apf* m);
 void mds_verify_residence(struct mds_apf* m, mds_id e);
@@ -0,0 +1,119 @@
+/****************************************************************************** 
+
+  Copyright 2014 Scientific Computation Research Center, 
+      Rensselaer Polytechnic Institute. All rights reserved.
+  
+  This work is open source software, licensed under the terms of the
+  BSD license as described in the LICENSE file in the top-level directory.
+
+*******************************************************************************/
+
+#include "mds.h"
+#include <stdlib.h>
+#include <reel.h>
+
+#define REALLOC(p,n) ((p)=mds_realloc(p,(n)*sizeof(*(p))))
+
+/* A frozen mesh answers adjacency queries from contiguous tables
+   instead of walking the upward lists and converting downward sets.
+   For each dimension d and type t, the entities of dimension d
+   adjacent to entity i of type t are
+     ids[d][t][offsets[d][t][i]] to ids[d][t][offsets[d][t][i + 1] - 1]
+   in the order mds_get_adjacent gives them.
+   Stored one-level downward adjacency is contiguous already,
+   so it has no table. Any change to the topology thaws the mesh. */
+
+struct mds_csr {
+  mds_id* offsets[4][MDS_TYPES];
+  mds_id* ids[4][MDS_TYPES];
+};
+
+static int has_table(struct mds* m, int t, int d)
+{
+  int e_dim = mds_dim[t];
+  if (d == e_dim || d > m->d)
+    return 0;
+  return !(d < e_dim && m->mrm[e_dim][d]);
+}
+
+static void freeze_table(struct mds* m, struct mds_csr* c, int t, int d)
+{
+  mds_id* offsets = NULL;
+  mds_id* ids = NULL;
+  mds_id size = 0;
+  mds_id cap = 0;
+  mds_id i;
+  int j;
+  struct mds_set s;
+  REALLOC(offsets, m->end[t] + 1);
+  offsets[0] = 0;
+  for (i = 0; i < m->end[t]; ++i) {
+    s.n = 0;
+    if (m->free[t][i] == MDS_LIVE)
+      mds_get_adjacent(m, mds_identify(t, i), d, &s);
+    if (size + s.n > cap) {
+      cap = ((size + s.n) * 3) / 2 + 16;
+      REALLOC(ids, cap);
+    }
+    for (j = 0; j < s.n; ++j)
+      ids[size++] = s.e[j];
+    offsets[i + 1] = size;
+  }
+  REALLOC(ids, size);
+  c->offsets[d][t] = offsets;
+  c->ids[d][t] = ids;
+}
+
+void mds_freeze(struct mds* m)
+{
+  struct mds_csr* c;
+  int t;
+  int d;
+  mds_thaw(m);
+  c = calloc(1, sizeof(*c));
+  if (!c)
+    reel_fail("MDS ran out of memory!\n");
+  for (t = 0; t < MDS_TYPES; ++t)
+    for (d = 0; d <= m->d; ++d)
+      if (has_table(m, t, d) && m->end[t])
+        freeze_table(m, c, t, d);
+  m->frozen = c;
+}
+
+void mds_thaw(struct mds* m)
+{
+  int t;
+  int d;
+  if (!m->frozen)
+    return;
+  for (d = 0; d < 4; ++d)
+    for (t = 0; t < MDS_TYPES; ++t) {
+      REALLOC(m->frozen->offsets[d][t], 0);
+      REALLOC(m->frozen->ids[d][t], 0);
+    }
+  free(m->frozen);
+  m->frozen = NULL;
+}
+
+/* returns the number of entities of dimension d adjacent to e
+   and points adj at them, or returns -1 if the mesh is not frozen
+   or d is the dimension of e */
+int mds_get_frozen(struct mds* m, mds_id e, int d, mds_id const** adj)
+{
+  int t;
+  mds_id i;
+  mds_id const* offsets;
+  if (!m->frozen || d > m->d)
+    return -1;
+  t = mds_type(e);
+  i = mds_index(e);
+  if (d == mds_dim[t])
+    return -1;
+  if (!has_table(m, t, d)) {
+    *adj = m->down[d][t] + i * mds_degree[t][d];
+    return mds_degree[t][d];
+  }
+  offsets = m->frozen->offsets[d][t];
+  *adj = m->frozen->ids[d][t] + offsets[i];
+  return offsets[i + 1] - offsets[i];
+}
@@ -0,0 +1,193 @@
+/****************************************************************************** 
+
+  Copyright 2014 Scientific Computation Research Center, 
+      Rensselaer Polytechnic Institute. All rights reserved.
+  
+  This work is open source software, licensed under the terms of the
+  BSD license as described in the LICENSE file in the top-level directory.
+
+*******************************************************************************/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* for mremap */
+#endif
+#include "mds_map.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <reel.h>
+
+struct mapping {
+  void* p;
+  size_t size;
+  int anonymous; /* an arena array rather than part of a file */
+};
+
+static struct mapping* mappings = NULL;
+static int nmappings = 0;
+static int cap_mappings = 0;
+static int arena = 0;
+/* guards the record, which the threads of threaded PCU share */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int find(void* p)
+{
+  int i;
+  if (!p)
+    return -1;
+  for (i = 0; i < nmappings; ++i)
+    if (mappings[i].p == p)
+      return i;
+  return -1;
+}
+
+static void forget(int i)
+{
+  if (munmap(mappings[i].p, mappings[i].size))
+    reel_fail("MDS: munmap failed\n");
+  mappings[i] = mappings[--nmappings];
+  if (!nmappings) {
+    free(mappings);
+    mappings = NULL;
+    cap_mappings = 0;
+  }
+}
+
+static void remember(void* p, size_t size, int anonymous)
+{
+  if (nmappings == cap_mappings) {
+    cap_mappings = (cap_mappings + 16) * 2;
+    mappings = realloc(mappings, cap_mappings * sizeof(*mappings));
+  }
+  mappings[nmappings].p = p;
+  mappings[nmappings].size = size;
+  mappings[nmappings].anonymous = anonymous;
+  ++nmappings;
+}
+
+void* mds_map(int fd, size_t offset, size_t size)
+{
+  void* p;
+  if (!size)
+    return NULL;
+  p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd,
+      (off_t)offset);
+  if (p == MAP_FAILED)
+    reel_fail("MDS: could not map %lu bytes at offset %lu\n",
+        (unsigned long)size, (unsigned long)offset);
+  pthread_mutex_lock(&lock);
+  remember(p, size, 0);
+  pthread_mutex_unlock(&lock);
+  return p;
+}
+
+void mds_set_arena(int on)
+{
+  arena = on;
+}
+
+int mds_get_arena(void)
+{
+  return arena;
+}
+
+static size_t round_to_pages(size_t size)
+{
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  return ((size + page - 1) / page) * page;
+}
+
+static void* arena_alloc(size_t size)
+{
+  void* p;
+  size = round_to_pages(size);
+  p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED)
+    return NULL;
+  remember(p, size, 1);
+  return p;
+}
+
+static void* arena_resize(int i, size_t size)
+{
+  void* q;
+  size = round_to_pages(size);
+  if (size == mappings[i].size)
+    return mappings[i].p;
+#ifdef MREMAP_MAYMOVE
+  q = mremap(mappings[i].p, mappings[i].size, size, MREMAP_MAYMOVE);
+  if (q == MAP_FAILED)
+    return NULL;
+  mappings[i].p = q;
+  mappings[i].size = size;
+#else
+  q = arena_alloc(size);
+  if (!q)
+    return NULL;
+  memcpy(q, mappings[i].p, size < mappings[i].size ? size : mappings[i].size);
+  forget(i);
+#endif
+  return q;
+}
+
+int mds_is_mapped(void* p)
+{
+  int i;
+  pthread_mutex_lock(&lock);
+  i = find(p);
+  pthread_mutex_unlock(&lock);
+  return i != -1;
+}
+
+static void* realloc_mapped(void* p, int i, size_t size)
+{
+  void* q;
+  if (i != -1 && mappings[i].anonymous) {
+    if (size)
+      return arena_resize(i, size);
+    forget(i);
+    return NULL;
+  }
+  /* a new arena array, or a file mapping moving to memory */
+  q = NULL;
+  if (size) {
+    q = arena ? arena_alloc(size) : malloc(size);
+    if (!q)
+      return NULL;
+    if (p)
+      memcpy(q, p, size < mappings[i].size ? size : mappings[i].size);
+  }
+  if (p)
+    forget(i);
+  return q;
+}
+
+void* mds_map_realloc(void* p, size_t size)
+{
+  void* q;
+  int i;
+  pthread_mutex_lock(&lock);
+  i = find(p);
+  if (i == -1 && (p || !arena)) {
+    pthread_mutex_unlock(&lock);
+    return realloc(p, size);
+  }
+  q = realloc_mapped(p, i, size);
+  pthread_mutex_unlock(&lock);
+  return q;
+}
+
+void mds_map_free(void* p)
+{
+  int i;
+  pthread_mutex_lock(&lock);
+  i = find(p);
+  if (i != -1)
+    forget(i);
+  pthread_mutex_unlock(&lock);
+  if (i == -1)
+    free(p);
+}
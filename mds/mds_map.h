@@ -0,0 +1,50 @@
+/****************************************************************************** 
+
+  Copyright 2014 Scientific Computation Research Center, 
+      Rensselaer Polytechnic Institute. All rights reserved.
+  
+  This work is open source software, licensed under the terms of the
+  BSD license as described in the LICENSE file in the top-level directory.
+
+*******************************************************************************/
+
+#ifndef MDS_MAP_H
+#define MDS_MAP_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* MDS arrays are usually on the heap, but arrays loaded from a
+   mapped SMB file are mapped from the file instead. Writes to a
+   mapped array change only this process's copy of the pages they
+   touch, and resizing or freeing it goes through these functions,
+   which move it to the heap or unmap it.
+   The record of mapped arrays is shared by all threads
+   and guarded by a lock, so threads may load, resize, and destroy
+   their own meshes at the same time. */
+
+/* maps size bytes of the file at offset, which must be a multiple of
+   the page size. returns NULL for zero bytes */
+void* mds_map(int fd, size_t offset, size_t size);
+int mds_is_mapped(void* p);
+/* like realloc and free, for heap or mapped arrays */
+void* mds_map_realloc(void* p, size_t size);
+void mds_map_free(void* p);
+
+/* While the arena is on, new arrays are anonymous mappings of whole
+   pages instead of heap blocks, and they keep being mappings until
+   freed. Growing one remaps its pages with mremap rather than copying
+   them, so a huge array never needs room for two copies of itself
+   while it grows. Arrays allocated before the arena was turned on
+   stay on the heap. */
+void mds_set_arena(int on);
+int mds_get_arena(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -9,6 +9,7 @@
 *******************************************************************************/
 
 #include "mds_net.h"
+#include "mds_map.h"
 #include <PCU.h>
 #include <string.h>
 #include <stdlib.h>
@@ -19,15 +20,31 @@ void mds_create_net(struct mds_net* net)
   memset(net, 0, sizeof(*net));
 }
 
+static void free_frozen(struct mds_frozen_net* f)
+{
+  int t;
+  for (t = 0; t < MDS_TYPES; ++t) {
+    free(f->offsets[t]);
+    free(f->slots[t]);
+    free(f->peers[t]);
+    free(f->starts[t]);
+    free(f->local[t]);
+    free(f->remote[t]);
+  }
+  free(f);
+}
+
 void mds_destroy_net(struct mds_net* net, struct mds* m)
 {
   int t;
   mds_id i;
+  if (net->frozen)
+    free_frozen(net->frozen);
   for (t = 0; t < MDS_TYPES; ++t) {
     if (net->data[t])
       for (i = 0; i < m->cap[t]; ++i)
         free(net->data[t][i]);
-    free(net->data[t]);
+    mds_map_free(net->data[t]);
   }
 }
 
@@ -45,12 +62,15 @@ void mds_set_copies(struct mds_net* net, struct mds* m, mds_id e,
   struct mds_copies** p;
   int t;
   mds_id i;
+  mds_thaw_net(net, m);
   t = mds_type(e);
   i = mds_index(e);
   if (!net->data[t]) {
-    if (c)
-      net->data[t] = calloc(m->cap[t], sizeof(*(net->data[t])));
-    else
+    if (c) {
+      net->data[t] = mds_map_realloc(NULL,
+          m->cap[t] * sizeof(*(net->data[t])));
+      memset(net->data[t], 0, m->cap[t] * sizeof(*(net->data[t])));
+    } else
       return;
   }
   p = &net->data[t][i];
@@ -62,7 +82,7 @@ void mds_set_copies(struct mds_net* net, struct mds* m, mds_id e,
   free(*p);
   *p = c;
   if (!net->n[t]) {
-    free(net->data[t]);
+    mds_map_free(net->data[t]);
     net->data[t] = NULL;
   }
 }
@@ -70,11 +90,189 @@ void mds_set_copies(struct mds_net* net, struct mds* m, mds_id e,
 struct mds_copies* mds_get_copies(struct mds_net* net, mds_id e)
 {
   int t = mds_type(e);
+  PCU_ALWAYS_ASSERT(!net->frozen);
   if (!net->data[t])
     return NULL;
   return net->data[t][mds_index(e)];
 }
 
+/* the copy at position pos of the entity slots */
+static struct mds_copy frozen_copy(struct mds_frozen_net* f, int t,
+    mds_id pos)
+{
+  struct mds_copy c;
+  mds_id s = f->slots[t][pos];
+  int lo = 0;
+  int hi = f->np[t] - 1;
+  int mid;
+  /* find the last block starting at or before s */
+  while (lo < hi) {
+    mid = (lo + hi + 1) / 2;
+    if (f->starts[t][mid] <= s)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+  c.e = f->remote[t][s];
+  c.p = f->peers[t][lo];
+  return c;
+}
+
+int mds_count_copies(struct mds_net* net, mds_id e)
+{
+  struct mds_frozen_net* f = net->frozen;
+  struct mds_copies* cs;
+  int t = mds_type(e);
+  mds_id i = mds_index(e);
+  if (f) {
+    if (!f->offsets[t] || i >= f->n[t])
+      return 0;
+    return f->offsets[t][i + 1] - f->offsets[t][i];
+  }
+  cs = mds_get_copies(net, e);
+  return cs ? cs->n : 0;
+}
+
+struct mds_copy mds_get_copy(struct mds_net* net, mds_id e, int i)
+{
+  struct mds_frozen_net* f = net->frozen;
+  int t = mds_type(e);
+  if (f)
+    return frozen_copy(f, t, f->offsets[t][mds_index(e)] + i);
+  return mds_get_copies(net, e)->c[i];
+}
+
+static int lower_peer(int const* peers, int np, int p)
+{
+  int lo = 0;
+  int hi = np;
+  int mid;
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    if (peers[mid] < p)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+static void freeze_type(struct mds_net* net, struct mds* m, int t,
+    struct mds_frozen_net* f)
+{
+  struct mds_copies* cs;
+  mds_id* offsets;
+  mds_id* counts = NULL;
+  int* peers = NULL;
+  int np = 0;
+  mds_id n = 0;
+  mds_id i;
+  mds_id s;
+  int j;
+  int b;
+  offsets = malloc((m->end[t] + 1) * sizeof(mds_id));
+  /* count the copies on each peer */
+  for (i = 0; i < m->end[t]; ++i) {
+    offsets[i] = n;
+    cs = net->data[t][i];
+    if (!cs)
+      continue;
+    for (j = 0; j < cs->n; ++j) {
+      b = lower_peer(peers, np, cs->c[j].p);
+      if (b == np || peers[b] != cs->c[j].p) {
+        peers = realloc(peers, (np + 1) * sizeof(int));
+        counts = realloc(counts, (np + 1) * sizeof(mds_id));
+        memmove(peers + b + 1, peers + b, (np - b) * sizeof(int));
+        memmove(counts + b + 1, counts + b, (np - b) * sizeof(mds_id));
+        peers[b] = cs->c[j].p;
+        counts[b] = 0;
+        ++np;
+      }
+      ++counts[b];
+    }
+    n += cs->n;
+  }
+  offsets[m->end[t]] = n;
+  f->n[t] = m->end[t];
+  f->offsets[t] = offsets;
+  f->np[t] = np;
+  f->peers[t] = peers;
+  f->starts[t] = malloc((np + 1) * sizeof(mds_id));
+  f->starts[t][0] = 0;
+  for (b = 0; b < np; ++b) {
+    f->starts[t][b + 1] = f->starts[t][b] + counts[b];
+    /* counts become fill positions */
+    counts[b] = f->starts[t][b];
+  }
+  f->slots[t] = malloc(n * sizeof(mds_id));
+  f->local[t] = malloc(n * sizeof(mds_id));
+  f->remote[t] = malloc(n * sizeof(mds_id));
+  /* entities go in index order, so each block is sorted */
+  for (i = 0; i < m->end[t]; ++i) {
+    cs = net->data[t][i];
+    if (!cs)
+      continue;
+    for (j = 0; j < cs->n; ++j) {
+      b = lower_peer(peers, np, cs->c[j].p);
+      s = counts[b]++;
+      f->local[t][s] = i;
+      f->remote[t][s] = cs->c[j].e;
+      f->slots[t][offsets[i] + j] = s;
+    }
+  }
+  free(counts);
+}
+
+/* packs the copies into per-peer blocks and frees the per-entity
+   arrays, see struct mds_frozen_net */
+void mds_freeze_net(struct mds_net* net, struct mds* m)
+{
+  struct mds_frozen_net* f;
+  int t;
+  mds_id i;
+  if (net->frozen || mds_net_empty(net))
+    return;
+  f = calloc(1, sizeof(*f));
+  for (t = 0; t < MDS_TYPES; ++t) {
+    if (!net->data[t])
+      continue;
+    freeze_type(net, m, t, f);
+    for (i = 0; i < m->cap[t]; ++i)
+      free(net->data[t][i]);
+    mds_map_free(net->data[t]);
+    net->data[t] = NULL;
+  }
+  net->frozen = f;
+}
+
+void mds_thaw_net(struct mds_net* net, struct mds* m)
+{
+  struct mds_frozen_net* f = net->frozen;
+  struct mds_copies* cs;
+  int t;
+  mds_id i;
+  int j;
+  if (!f)
+    return;
+  for (t = 0; t < MDS_TYPES; ++t) {
+    if (!f->offsets[t])
+      continue;
+    net->data[t] = mds_map_realloc(NULL,
+        m->cap[t] * sizeof(*(net->data[t])));
+    memset(net->data[t], 0, m->cap[t] * sizeof(*(net->data[t])));
+    for (i = 0; i < f->n[t]; ++i) {
+      if (f->offsets[t][i] == f->offsets[t][i + 1])
+        continue;
+      cs = mds_make_copies(f->offsets[t][i + 1] - f->offsets[t][i]);
+      for (j = 0; j < cs->n; ++j)
+        cs->c[j] = frozen_copy(f, t, f->offsets[t][i] + j);
+      net->data[t][i] = cs;
+    }
+  }
+  net->frozen = NULL;
+  free_frozen(f);
+}
+
 void mds_grow_net(
     struct mds_net* net,
     struct mds* m,
@@ -84,13 +282,27 @@ void mds_grow_net(
   mds_id i;
   for (t = 0; t < MDS_TYPES; ++t)
     if (net->data[t]) {
-      net->data[t] = realloc(net->data[t],
+      net->data[t] = mds_map_realloc(net->data[t],
           m->cap[t] * sizeof(struct mds_copies*));
       for (i = old_cap[t]; i < m->cap[t]; ++i)
         net->data[t][i] = NULL;
     }
 }
 
+/* moves the copies of each entity to its new index. The copies
+   themselves are ids on other parts, see mds_compact */
+void mds_renumber_net(
+    struct mds_net* net,
+    struct mds* m,
+    struct mds_renumber* r)
+{
+  int t;
+  mds_thaw_net(net, m);
+  for (t = 0; t < MDS_TYPES; ++t)
+    net->data[t] = mds_renumber_rows(r, t, net->data[t],
+        sizeof(*(net->data[t])), m->cap[t]);
+}
+
 static int find_place(struct mds_copies* cs, int p)
 {
   int i;
@@ -107,6 +319,7 @@ void mds_add_copy(struct mds_net* net, struct mds* m, mds_id e,
   int t;
   int p;
   mds_id i;
+  mds_thaw_net(net, m);
   t = mds_type(e);
   i = mds_index(e);
   cs = mds_get_copies(net, e);
@@ -144,8 +357,8 @@ static int insert_peer(struct mds_links* ln, int p)
   i = ln->np;
   ++(ln->np);
   ln->p = realloc(ln->p, ln->np * sizeof(unsigned));
-  ln->n = realloc(ln->n, ln->np * sizeof(unsigned));
-  ln->l = realloc(ln->l, ln->np * sizeof(unsigned*));
+  ln->n = realloc(ln->n, ln->np * sizeof(mds_id));
+  ln->l = realloc(ln->l, ln->np * sizeof(mds_id*));
   ln->p[i] = p;
   ln->n[i] = 0;
   ln->l[i] = NULL;
@@ -163,14 +376,14 @@ static void for_type_net(struct mds_net* net, struct mds* m,
     int t, void (*f)(mds_id i, struct mds_copy c, void* u), void* u)
 {
   mds_id i;
+  mds_id e;
   int j;
-  struct mds_copies* cs;
+  int n;
   for (i = 0; i < m->end[t]; ++i) {
-    cs = mds_get_copies(net, mds_identify(t, i));
-    if (!cs)
-      continue;
-    for (j = 0; j < cs->n; ++j)
-      f(i, cs->c[j], u);
+    e = mds_identify(t, i);
+    n = mds_count_copies(net, e);
+    for (j = 0; j < n; ++j)
+      f(i, mds_get_copy(net, e, j), u);
   }
 }
 
@@ -186,7 +399,7 @@ static void alloc_links(struct mds_links* ln)
 {
   unsigned i;
   for (i = 0; i < ln->np; ++i)
-    ln->l[i] = malloc(ln->n[i] * sizeof(unsigned));
+    ln->l[i] = malloc(ln->n[i] * sizeof(mds_id));
 }
 
 static void take_remote_link(mds_id i, struct mds_copy c, void* u)
@@ -214,7 +427,7 @@ static void recv_links(struct mds_links* ln)
   int from;
   mds_id* tmp;
   int pi;
-  unsigned i;
+  mds_id i;
   from = PCU_Comm_Sender();
   pi = find_peer(ln, from);
   tmp = PCU_Comm_Extract(ln->n[pi] * sizeof(mds_id));
@@ -248,8 +461,8 @@ void mds_set_type_links(struct mds_net* net, struct mds* m,
     int t, struct mds_links* ln)
 {
   unsigned i;
-  unsigned j;
-  unsigned* in;
+  mds_id j;
+  mds_id* in;
   struct mds_copy c;
   PCU_Comm_Begin();
   for (i = 0; i < ln->np; ++i) {
@@ -262,7 +475,7 @@ void mds_set_type_links(struct mds_net* net, struct mds* m,
     c.p = PCU_Comm_Sender();
     PCU_ALWAYS_ASSERT(c.p != PCU_Comm_Self());
     i = find_peer(ln, c.p);
-    in = PCU_Comm_Extract(ln->n[i] * sizeof(unsigned));
+    in = PCU_Comm_Extract(ln->n[i] * sizeof(mds_id));
     for (j = 0; j < ln->n[i]; ++j) {
       c.e = mds_identify(t, in[j]);
       mds_add_copy(net, m, mds_identify(t, ln->l[i][j]), c);
@@ -283,6 +496,8 @@ void mds_free_links(struct mds_links* ln)
 int mds_net_empty(struct mds_net* net)
 {
   int t;
+  if (net->frozen)
+    return 0;
   for (t = 0; t < MDS_TYPES; ++t)
     if (net->data[t])
       return 0;
@@ -324,8 +539,8 @@ void mds_get_local_matches(struct mds_net* net, struct mds* m,
     return;
   other = find_peer(ln, PCU_Comm_Peers());
   PCU_ALWAYS_ASSERT(ln->n[self] == ln->n[other]);
-  ln->l[self] = malloc(ln->n[self] * sizeof(unsigned));
-  ln->l[other] = malloc(ln->n[other] * sizeof(unsigned));
+  ln->l[self] = malloc(ln->n[self] * sizeof(mds_id));
+  ln->l[other] = malloc(ln->n[other] * sizeof(mds_id));
   ln->n[self] = 0;
   ln->n[other] = 0;
   for_type_net(net, m, t, take_local_link, ln);
@@ -335,7 +550,7 @@ void mds_set_local_matches(struct mds_net* net, struct mds* m,
                          int t, struct mds_links* ln)
 {
   int self, other;
-  unsigned i;
+  mds_id i;
   mds_id a, b;
   struct mds_copy c;
   c.p = PCU_Comm_Self();
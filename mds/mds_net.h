@@ -23,16 +23,35 @@ struct mds_copies {
   struct mds_copy c[1];
 };
 
+/* A frozen net keeps the copies of each type in one block per peer,
+   block b holding the (local index, remote id) pairs on peers[b]
+   sorted by local index, from local[starts[b]] to local[starts[b+1]-1].
+   Entity i finds its copies through the positions
+   slots[offsets[i]] to slots[offsets[i+1]-1] in those blocks,
+   sorted by peer. Entities indexed from n onward have no copies.
+   Any change to the copies thaws the net back to per-entity arrays. */
+struct mds_frozen_net {
+  mds_id n[MDS_TYPES];
+  mds_id* offsets[MDS_TYPES];
+  mds_id* slots[MDS_TYPES];
+  int np[MDS_TYPES];
+  int* peers[MDS_TYPES];
+  mds_id* starts[MDS_TYPES];
+  mds_id* local[MDS_TYPES];
+  mds_id* remote[MDS_TYPES];
+};
+
 struct mds_net {
   mds_id n[MDS_TYPES];
   struct mds_copies** data[MDS_TYPES];
+  struct mds_frozen_net* frozen;
 };
 
 struct mds_links {
   unsigned np;
-  unsigned* n;
+  mds_id* n;
   unsigned* p;
-  unsigned** l;
+  mds_id** l;
 };
 #define MDS_LINKS_INIT {0,0,0,0}
 
@@ -41,11 +60,21 @@ void mds_destroy_net(struct mds_net* net, struct mds* m);
 struct mds_copies* mds_make_copies(int n);
 void mds_set_copies(struct mds_net* net, struct mds* m, mds_id e,
     struct mds_copies* c);
+/* the per-entity copies of a net that is not frozen */
 struct mds_copies* mds_get_copies(struct mds_net* net, mds_id e);
+/* these work on frozen nets as well */
+int mds_count_copies(struct mds_net* net, mds_id e);
+struct mds_copy mds_get_copy(struct mds_net* net, mds_id e, int i);
+void mds_freeze_net(struct mds_net* net, struct mds* m);
+void mds_thaw_net(struct mds_net* net, struct mds* m);
 void mds_grow_net(
     struct mds_net* net,
     struct mds* m,
     mds_id old_cap[MDS_TYPES]);
+void mds_renumber_net(
+    struct mds_net* net,
+    struct mds* m,
+    struct mds_renumber* r);
 
 void mds_add_copy(struct mds_net* net, struct mds* m, mds_id e,
     struct mds_copy c);
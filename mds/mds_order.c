@@ -127,13 +127,140 @@ struct mds_tag* mds_number_verts_bfs(struct mds_apf* m)
   tag = mds_create_tag(&m->tags, "mds_number", sizeof(int), 1);
   label = 0;
   v = find_seed(m);
-  number_connected_verts(&m->mds, v, tag, &label);
+  if (v != MDS_NONE)
+    number_connected_verts(&m->mds, v, tag, &label);
   for (v = mds_begin(&m->mds, 0); v != MDS_NONE; v = mds_next(&m->mds, v))
     number_connected_verts(&m->mds, v, tag, &label);
   PCU_ALWAYS_ASSERT(label == m->mds.n[MDS_VERTEX]);
   return tag;
 }
 
+enum { HILBERT_BITS = 21 };
+
+/* converts grid coordinates into the transposed form of their
+   distance along a 3D Hilbert curve, see John Skilling,
+   "Programming the Hilbert curve", AIP Conf. Proc. 707, 2004 */
+static void hilbert_transpose(unsigned x[3])
+{
+  unsigned m = 1u << (HILBERT_BITS - 1);
+  unsigned p, q, t;
+  int i;
+  for (q = m; q > 1; q >>= 1) {
+    p = q - 1;
+    for (i = 0; i < 3; ++i) {
+      if (x[i] & q) {
+        x[0] ^= p;
+      } else {
+        t = (x[0] ^ x[i]) & p;
+        x[0] ^= t;
+        x[i] ^= t;
+      }
+    }
+  }
+  for (i = 1; i < 3; ++i)
+    x[i] ^= x[i - 1];
+  t = 0;
+  for (q = m; q > 1; q >>= 1)
+    if (x[2] & q)
+      t ^= q - 1;
+  for (i = 0; i < 3; ++i)
+    x[i] ^= t;
+}
+
+static unsigned long long hilbert_key(unsigned x[3])
+{
+  unsigned long long key = 0;
+  int b, i;
+  hilbert_transpose(x);
+  for (b = HILBERT_BITS - 1; b >= 0; --b)
+    for (i = 0; i < 3; ++i)
+      key = (key << 1) | ((x[i] >> b) & 1);
+  return key;
+}
+
+struct keyed {
+  unsigned long long key;
+  mds_id e;
+};
+
+static int compare_keyed(const void* a, const void* b)
+{
+  const struct keyed* ka = a;
+  const struct keyed* kb = b;
+  if (ka->key != kb->key)
+    return ka->key < kb->key ? -1 : 1;
+  if (ka->e != kb->e)
+    return ka->e < kb->e ? -1 : 1;
+  return 0;
+}
+
+static void get_box(struct mds_apf* m, double lo[3], double* size)
+{
+  double hi[3];
+  double* x;
+  mds_id v;
+  int i;
+  for (i = 0; i < 3; ++i) {
+    lo[i] = 0;
+    hi[i] = 0;
+  }
+  v = mds_begin(&m->mds, 0);
+  if (v != MDS_NONE)
+    for (i = 0; i < 3; ++i)
+      lo[i] = hi[i] = mds_apf_point(m, v)[i];
+  for (; v != MDS_NONE; v = mds_next(&m->mds, v)) {
+    x = mds_apf_point(m, v);
+    for (i = 0; i < 3; ++i) {
+      if (x[i] < lo[i])
+        lo[i] = x[i];
+      if (x[i] > hi[i])
+        hi[i] = x[i];
+    }
+  }
+  *size = 0;
+  for (i = 0; i < 3; ++i)
+    if (hi[i] - lo[i] > *size)
+      *size = hi[i] - lo[i];
+}
+
+/* numbers the vertices by their distance along a Hilbert curve
+   through the bounding box, by sorting their keys */
+struct mds_tag* mds_number_verts_hilbert(struct mds_apf* m)
+{
+  struct mds_tag* tag;
+  struct keyed* keys;
+  double lo[3];
+  double size;
+  double scale;
+  double* x;
+  unsigned q[3];
+  mds_id v;
+  mds_id n;
+  mds_id i;
+  int j;
+  PCU_ALWAYS_ASSERT(m->mds.n[MDS_VERTEX] < INT_MAX);
+  tag = mds_create_tag(&m->tags, "mds_hilbert", sizeof(int), 1);
+  get_box(m, lo, &size);
+  scale = size > 0 ? ((1u << HILBERT_BITS) - 1) / size : 0;
+  keys = malloc(m->mds.n[MDS_VERTEX] * sizeof(*keys));
+  n = 0;
+  for (v = mds_begin(&m->mds, 0); v != MDS_NONE; v = mds_next(&m->mds, v)) {
+    x = mds_apf_point(m, v);
+    for (j = 0; j < 3; ++j)
+      q[j] = (x[j] - lo[j]) * scale;
+    keys[n].key = hilbert_key(q);
+    keys[n].e = v;
+    ++n;
+  }
+  qsort(keys, n, sizeof(*keys), compare_keyed);
+  for (i = 0; i < n; ++i) {
+    mds_give_tag(tag, &m->mds, keys[i].e);
+    *((int*)mds_get_tag(tag, keys[i].e)) = i;
+  }
+  free(keys);
+  return tag;
+}
+
 static mds_id* sort_verts(struct mds_apf* m, struct mds_tag* tag)
 {
   mds_id v;
@@ -194,20 +321,21 @@ static void rebuild_net(struct mds_net* net,
   mds_id ne;
   mds_id ce;
   mds_id nce;
-  struct mds_copies* cs;
   struct mds_copy c;
   int i;
+  int n;
   PCU_Comm_Begin();
   for (d = 0; d <= m->d; ++d)
     for (e = mds_begin(m, d); e != MDS_NONE; e = mds_next(m, e)) {
-      cs = mds_get_copies(net, e);
-      if (!cs)
+      n = mds_count_copies(net, e);
+      if (!n)
         continue;
       ne = lookup(new_of, e);
-      for (i = 0; i < cs->n; ++i) {
-        ce = cs->c[i].e;
-        PCU_COMM_PACK(cs->c[i].p, ce);
-        PCU_COMM_PACK(cs->c[i].p, ne);
+      for (i = 0; i < n; ++i) {
+        c = mds_get_copy(net, e, i);
+        ce = c.e;
+        PCU_COMM_PACK(c.p, ce);
+        PCU_COMM_PACK(c.p, ne);
       }
     }
   PCU_Comm_Send();
@@ -416,3 +544,136 @@ struct mds_apf* mds_reorder(struct mds_apf* m, int ignore_peers,
   mds_apf_destroy(m);
   return m2;
 }
+
+static void number_in_order(struct mds* m, struct mds_renumber* r)
+{
+  int t;
+  mds_id i;
+  mds_id n;
+  for (t = 0; t < MDS_TYPES; ++t) {
+    n = 0;
+    for (i = 0; i < m->end[t]; ++i)
+      r->to[t][i] = (m->free[t][i] == MDS_LIVE) ? n++ : MDS_NONE;
+  }
+  r->in_order = 1;
+}
+
+static void number_by_tag(struct mds_apf* m, struct mds_tag* vert_numbers,
+    struct mds_renumber* r)
+{
+  struct mds_tag* tag;
+  int t;
+  mds_id i;
+  mds_id e;
+  tag = mds_create_tag(&m->tags, "mds_compact", sizeof(int), 1);
+  for (e = mds_begin(&m->mds, 0); e != MDS_NONE; e = mds_next(&m->mds, e)) {
+    mds_give_tag(tag, &m->mds, e);
+    memcpy(mds_get_tag(tag, e), mds_get_tag(vert_numbers, e), sizeof(int));
+  }
+  number_other_ents(m, tag);
+  for (t = 0; t < MDS_TYPES; ++t)
+    for (i = 0; i < m->mds.end[t]; ++i) {
+      e = mds_identify(t, i);
+      r->to[t][i] = mds_has_tag(tag, e) ? lookup(tag, e) : MDS_NONE;
+      if (r->to[t][i] != MDS_NONE)
+        r->to[t][i] = mds_index(r->to[t][i]);
+    }
+  mds_destroy_tag(&m->tags, tag);
+  r->in_order = 0;
+}
+
+/* each copy is an id on another part. Tell that part our new id,
+   and mark the copies we update with negative ids so that a new id
+   is not mistaken for an old one, see rebuild_net */
+static void renumber_copies(struct mds_apf* m, struct mds_renumber* r)
+{
+  struct mds_net* nets[3];
+  struct mds_copies* cs;
+  int k;
+  int t;
+  int i;
+  mds_id j;
+  mds_id e;
+  mds_id ids[3];
+  nets[0] = &m->remotes;
+  nets[1] = &m->ghosts;
+  nets[2] = &m->matches;
+  for (k = 0; k < 3; ++k)
+    mds_thaw_net(nets[k], &m->mds);
+  PCU_Comm_Begin();
+  for (k = 0; k < 3; ++k)
+    for (t = 0; t < MDS_TYPES; ++t)
+      for (j = 0; j < r->end[t]; ++j) {
+        e = mds_identify(t, j);
+        cs = mds_get_copies(nets[k], e);
+        if (!cs)
+          continue;
+        for (i = 0; i < cs->n; ++i) {
+          ids[0] = cs->c[i].e;
+          ids[1] = e;
+          ids[2] = mds_renumbered(r, e);
+          PCU_COMM_PACK(cs->c[i].p, k);
+          PCU_Comm_Pack(cs->c[i].p, ids, sizeof(ids));
+        }
+      }
+  PCU_Comm_Send();
+  while (PCU_Comm_Receive()) {
+    PCU_COMM_UNPACK(k);
+    PCU_Comm_Unpack(ids, sizeof(ids));
+    cs = mds_get_copies(nets[k], ids[0]);
+    PCU_ALWAYS_ASSERT(cs);
+    for (i = 0; i < cs->n; ++i)
+      if (cs->c[i].p == PCU_Comm_Sender() && cs->c[i].e == ids[1]) {
+        cs->c[i].e = -3 - ids[2];
+        break;
+      }
+    PCU_ALWAYS_ASSERT(i < cs->n);
+  }
+  for (k = 0; k < 3; ++k)
+    for (t = 0; t < MDS_TYPES; ++t)
+      for (j = 0; j < r->end[t]; ++j) {
+        cs = mds_get_copies(nets[k], mds_identify(t, j));
+        if (cs)
+          for (i = 0; i < cs->n; ++i)
+            if (cs->c[i].e < MDS_LIVE)
+              cs->c[i].e = -3 - cs->c[i].e;
+      }
+}
+
+/* closes the holes left by destroyed entities, renumbering all
+   entities in place instead of building a new mesh like mds_reorder.
+   With vert_numbers the entities are sorted as mds_reorder would,
+   otherwise they keep their order and no arrays are copied.
+   This is collective, since remote copies learn the new ids. */
+void mds_compact(struct mds_apf* m, struct mds_tag* vert_numbers)
+{
+  struct mds_renumber r;
+  int t;
+  for (t = 0; t < MDS_TYPES; ++t) {
+    r.to[t] = malloc(m->mds.end[t] * sizeof(mds_id));
+    r.n[t] = m->mds.n[t];
+    r.end[t] = m->mds.end[t];
+  }
+  if (vert_numbers)
+    number_by_tag(m, vert_numbers, &r);
+  else
+    number_in_order(&m->mds, &r);
+  renumber_copies(m, &r);
+  m->point = mds_renumber_rows(&r, MDS_VERTEX, m->point,
+      sizeof(*(m->point)), m->mds.cap[MDS_VERTEX]);
+  m->param = mds_renumber_rows(&r, MDS_VERTEX, m->param,
+      sizeof(*(m->param)), m->mds.cap[MDS_VERTEX]);
+  for (t = 0; t < MDS_TYPES; ++t) {
+    m->model[t] = mds_renumber_rows(&r, t, m->model[t],
+        sizeof(*(m->model[t])), m->mds.cap[t]);
+    m->parts[t] = mds_renumber_rows(&r, t, m->parts[t],
+        sizeof(*(m->parts[t])), m->mds.cap[t]);
+  }
+  mds_renumber_tags(&m->tags, &m->mds, &r);
+  mds_renumber_net(&m->remotes, &m->mds, &r);
+  mds_renumber_net(&m->ghosts, &m->mds, &r);
+  mds_renumber_net(&m->matches, &m->mds, &r);
+  mds_renumber(&m->mds, &r);
+  for (t = 0; t < MDS_TYPES; ++t)
+    free(r.to[t]);
+}
@@ -0,0 +1,135 @@
+/****************************************************************************** 
+
+  Copyright 2014 Scientific Computation Research Center, 
+      Rensselaer Polytechnic Institute. All rights reserved.
+  
+  This work is open source software, licensed under the terms of the
+  BSD license as described in the LICENSE file in the top-level directory.
+
+*******************************************************************************/
+
+#include "mds.h"
+#include "mds_map.h"
+#include <string.h>
+#include <pcu_util.h>
+
+mds_id mds_renumbered(struct mds_renumber* r, mds_id e)
+{
+  if (e < 0)
+    return e;
+  return mds_identify(mds_type(e), r->to[mds_type(e)][mds_index(e)]);
+}
+
+/* entity i of type t has rows of bytes in array a, which has room for
+   cap entities. Moves each row to the new index of its entity and
+   zeros the rows past the new end. Entities that keep their order only
+   move down, so their rows move within the array, otherwise they move
+   to a new array and the old one is freed. */
+void* mds_renumber_rows(struct mds_renumber* r, int t, void* a,
+    size_t bytes, mds_id cap)
+{
+  char* from = a;
+  char* to;
+  mds_id i;
+  mds_id j;
+  if (!a)
+    return a;
+  to = from;
+  if (!r->in_order)
+    to = mds_map_realloc(NULL, cap * bytes);
+  for (i = 0; i < r->end[t]; ++i) {
+    j = r->to[t][i];
+    if (j != MDS_NONE && (to != from || j != i))
+      memmove(to + j * bytes, from + i * bytes, bytes);
+  }
+  memset(to + r->n[t] * bytes, 0, (cap - r->n[t]) * bytes);
+  if (to != from)
+    mds_map_free(from);
+  return to;
+}
+
+/* the new id of an entry in the upward lists of entities of dimension d,
+   which is the j'th downward entity of the user u it belongs to */
+static mds_id renumber_use(struct mds_renumber* r, mds_id x, int d)
+{
+  int t;
+  int deg;
+  mds_id u;
+  if (x < 0)
+    return x;
+  t = mds_type(x);
+  deg = mds_degree[t][d];
+  u = mds_index(x) / deg;
+  return mds_identify(t, r->to[t][u] * deg + mds_index(x) % deg);
+}
+
+static void renumber_down(struct mds* m, struct mds_renumber* r,
+    int from, int to)
+{
+  int t;
+  int deg;
+  mds_id i;
+  mds_id* a;
+  for (t = 0; t < MDS_TYPES; ++t)
+    if (mds_dim[t] == from) {
+      deg = mds_degree[t][to];
+      a = mds_renumber_rows(r, t, m->down[to][t],
+          deg * sizeof(mds_id), m->cap[t]);
+      for (i = 0; i < r->n[t] * deg; ++i)
+        a[i] = mds_renumbered(r, a[i]);
+      m->down[to][t] = a;
+    }
+}
+
+static void renumber_up(struct mds* m, struct mds_renumber* r,
+    int from, int to)
+{
+  int t;
+  int deg;
+  mds_id i;
+  mds_id* a;
+  for (t = 0; t < MDS_TYPES; ++t)
+    if (mds_dim[t] == to) {
+      deg = mds_degree[t][from];
+      a = mds_renumber_rows(r, t, m->up[from][t],
+          deg * sizeof(mds_id), m->cap[t]);
+      for (i = 0; i < r->n[t] * deg; ++i)
+        a[i] = renumber_use(r, a[i], from);
+      m->up[from][t] = a;
+    } else if (mds_dim[t] == from) {
+      a = mds_renumber_rows(r, t, m->first_up[to][t],
+          sizeof(mds_id), m->cap[t]);
+      for (i = 0; i < r->n[t]; ++i)
+        a[i] = renumber_use(r, a[i], from);
+      for (; i < m->cap[t]; ++i)
+        a[i] = MDS_NONE;
+      m->first_up[to][t] = a;
+    }
+}
+
+/* moves every entity to its new index, leaving no holes.
+   The adjacency arrays are renumbered one at a time, so this needs
+   memory for at most one more array, or none if r->in_order. */
+void mds_renumber(struct mds* m, struct mds_renumber* r)
+{
+  int i;
+  int j;
+  int t;
+  mds_id k;
+  mds_thaw(m);
+  for (i = 0; i <= 3; ++i)
+  for (j = 0; j <= 3; ++j)
+    if (m->mrm[i][j]) {
+      if (i < j)
+        renumber_up(m, r, i, j);
+      else if (i > j)
+        renumber_down(m, r, i, j);
+    }
+  for (t = 0; t < MDS_TYPES; ++t) {
+    PCU_ALWAYS_ASSERT(r->n[t] == m->n[t]);
+    for (k = 0; k < m->n[t]; ++k)
+      m->free[t][k] = MDS_LIVE;
+    m->end[t] = m->n[t];
+    m->first_free[t] = MDS_NONE;
+  }
+}
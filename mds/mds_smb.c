@@ -9,9 +9,12 @@
 *******************************************************************************/
 
 #include "mds_apf.h"
+#include "mds_smb.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <stdint.h>
+#include <limits.h>
 #include <string.h>
 #include <pcu_util.h>
 #include <PCU.h>
@@ -21,35 +24,6 @@
 #include <sys/stat.h> /*using POSIX mkdir call for SMB "foo/" path*/
 #include <errno.h> /* for checking the error from mkdir */
 
-enum { SMB_VERSION = 5 };
-
-enum {
-  SMB_VERT,
-  SMB_EDGE,
-  SMB_TRI,
-  SMB_QUAD,
-  SMB_HEX,
-  SMB_PRIS,
-  SMB_PYR,
-  SMB_TET,
-  SMB_TYPES
-};
-
-enum {
-  SMB_INT,
-  SMB_DBL
-};
-
-/* these limits are just for sanity checking
-   of the input file contents.
-   they do not reflect hard limitations anywhere
-   else in the MDS source code,
-   so feel free to increase them slightly if you
-   have a strange application. */
-#define MAX_ENTITIES (100*1000*1000)
-#define MAX_PEERS (10*1000)
-#define MAX_TAGS (100)
-
 static int smb2mds(int smb_type)
 {
   int const table[SMB_TYPES] =
@@ -83,7 +57,112 @@ static int down_degree(int t)
   return mds_degree[t][mds_dim[t] - 1];
 }
 
-static void read_links(struct pcu_file* f, struct mds_links* l)
+static int is_wide(unsigned version)
+{
+  return version == SMB_WIDE_VERSION || version == SMB_MAPPED_WIDE_VERSION;
+}
+
+int smb_needs_wide(struct mds_apf* m)
+{
+  int t;
+  for (t = 0; t < MDS_TYPES; ++t)
+    if ((uint64_t)m->mds.end[t] > UINT_MAX)
+      return 1;
+  return 0;
+}
+
+static void id_overflow(void)
+{
+  reel_fail("MDS: smb file has more entities than %d byte ids can hold,\n"
+      "rebuild with -DMDS_ID_TYPE=long\n", (int)sizeof(mds_id));
+}
+
+/* ids that need converting go through a buffer of this many */
+enum { ID_CHUNK = 1024 };
+
+/* reads n entity counts or indices, widening them in place
+   when mds_id is wider than the file's integers */
+static void read_ids(struct pcu_file* f, int wide, mds_id* p, size_t n)
+{
+  unsigned* u;
+  uint64_t w[ID_CHUNK];
+  size_t i, j, c;
+  if (!wide) {
+    PCU_ALWAYS_ASSERT(sizeof(mds_id) >= sizeof(unsigned));
+    u = (unsigned*)p;
+    pcu_read_unsigneds(f, u, n);
+    for (i = n; i-- > 0;) {
+      if ((uint64_t)u[i] > (uint64_t)MDS_ID_MAX)
+        id_overflow();
+      p[i] = u[i];
+    }
+  } else if (sizeof(mds_id) == sizeof(uint64_t)) {
+    pcu_read_uint64s(f, (uint64_t*)p, n);
+    for (i = 0; i < n; ++i)
+      if (p[i] < 0)
+        id_overflow();
+  } else {
+    for (i = 0; i < n; i += c) {
+      c = n - i < ID_CHUNK ? n - i : ID_CHUNK;
+      pcu_read_uint64s(f, w, c);
+      for (j = 0; j < c; ++j) {
+        if (w[j] > (uint64_t)MDS_ID_MAX)
+          id_overflow();
+        p[i + j] = w[j];
+      }
+    }
+  }
+}
+
+static void write_ids(struct pcu_file* f, int wide, mds_id* p, size_t n)
+{
+  unsigned u[ID_CHUNK];
+  uint64_t w[ID_CHUNK];
+  size_t i, j, c;
+  if (!wide && sizeof(mds_id) == sizeof(unsigned)) {
+    pcu_write_unsigneds(f, (unsigned*)p, n);
+    return;
+  }
+  if (wide && sizeof(mds_id) == sizeof(uint64_t)) {
+    pcu_write_uint64s(f, (uint64_t*)p, n);
+    return;
+  }
+  for (i = 0; i < n; i += c) {
+    c = n - i < ID_CHUNK ? n - i : ID_CHUNK;
+    if (!wide) {
+      for (j = 0; j < c; ++j)
+        u[j] = p[i + j];
+      pcu_write_unsigneds(f, u, c);
+    } else {
+      for (j = 0; j < c; ++j)
+        w[j] = p[i + j];
+      pcu_write_uint64s(f, w, c);
+    }
+  }
+}
+
+void smb_read_counts(struct pcu_file* f, int wide, mds_id counts[MDS_TYPES])
+{
+  mds_id n[SMB_TYPES];
+  int t;
+  read_ids(f, wide, n, SMB_TYPES);
+  for (t = 0; t < MDS_TYPES; ++t) {
+    if (n[mds2smb(t)] > mds_max_cap(t))
+      id_overflow();
+    counts[t] = n[mds2smb(t)];
+  }
+}
+
+void smb_write_counts(struct pcu_file* f, struct mds_apf* m, int wide)
+{
+  mds_id n[SMB_TYPES] = {0};
+  int t;
+  for (t = 0; t < MDS_TYPES; ++t)
+    n[mds2smb(t)] = m->mds.end[t];
+  write_ids(f, wide, n, SMB_TYPES);
+}
+
+static void read_links(struct pcu_file* f, struct mds_links* l, int wide)
 {
   unsigned i;
   PCU_READ_UNSIGNED(f, l->np);
@@ -92,36 +171,41 @@ static void read_links(struct pcu_file* f, struct mds_links* l)
   PCU_ALWAYS_ASSERT(l->np < MAX_PEERS); /* reasonable limit on number of peers */
   l->p = malloc(l->np * sizeof(unsigned));
   pcu_read_unsigneds(f, l->p, l->np);
-  l->n = malloc(l->np * sizeof(unsigned));
-  l->l = malloc(l->np * sizeof(unsigned*));
-  pcu_read_unsigneds(f, l->n, l->np);
+  l->n = malloc(l->np * sizeof(mds_id));
+  l->l = malloc(l->np * sizeof(mds_id*));
+  read_ids(f, wide, l->n, l->np);
   for (i = 0; i < l->np; ++i) {
     if (sizeof(mds_id) == 4) PCU_ALWAYS_ASSERT(l->n[i] < MAX_ENTITIES);
-    l->l[i] = malloc(l->n[i] * sizeof(unsigned));
-    pcu_read_unsigneds(f, l->l[i], l->n[i]);
+    l->l[i] = malloc(l->n[i] * sizeof(mds_id));
+    read_ids(f, wide, l->l[i], l->n[i]);
   }
 }
 
-static void write_links(struct pcu_file* f, struct mds_links* l)
+static void write_links(struct pcu_file* f, struct mds_links* l, int wide)
 {
   unsigned i;
   PCU_WRITE_UNSIGNED(f, l->np);
   if (!l->np)
     return;
   pcu_write_unsigneds(f, l->p, l->np);
-  pcu_write_unsigneds(f, l->n, l->np);
+  write_ids(f, wide, l->n, l->np);
   PCU_ALWAYS_ASSERT(l->l != 0);
   for (i = 0; i < l->np; ++i)
-    pcu_write_unsigneds(f, l->l[i], l->n[i]);
+    write_ids(f, wide, l->l[i], l->n[i]);
 }
 
-static void read_header(struct pcu_file* f, unsigned* version, unsigned* dim,
-    int ignore_peers)
+static void read_header(struct pcu_file* f, unsigned* magic,
+    unsigned* version, unsigned* dim, int ignore_peers)
 {
-  unsigned magic, np;
-  PCU_READ_UNSIGNED(f, magic);
+  unsigned np;
+  PCU_READ_UNSIGNED(f, *magic);
   PCU_READ_UNSIGNED(f, *version);
-  PCU_ALWAYS_ASSERT(*version <= SMB_VERSION);
+  if (*magic == SMB_MAPPED)
+    PCU_ALWAYS_ASSERT(*version == SMB_MAPPED_VERSION ||
+                      *version == SMB_MAPPED_WIDE_VERSION);
+  else
+    PCU_ALWAYS_ASSERT(*version <= SMB_VERSION ||
+                      *version == SMB_WIDE_VERSION);
   PCU_READ_UNSIGNED(f, *dim);
   PCU_READ_UNSIGNED(f, np);
   if (*version >= 1 && (!ignore_peers))
@@ -130,11 +214,9 @@ static void read_header(struct pcu_file* f, unsigned* version, unsigned* dim,
         "the # of mesh partitions != the # of MPI ranks");
 }
 
-static void write_header(struct pcu_file* f, unsigned dim,
-    int ignore_peers)
+void smb_write_header(struct pcu_file* f, unsigned magic,
+    unsigned version, unsigned dim, int ignore_peers)
 {
-  unsigned magic = 0;
-  unsigned version = SMB_VERSION;
   unsigned np;
   PCU_WRITE_UNSIGNED(f, magic);
   PCU_WRITE_UNSIGNED(f, version);
@@ -153,9 +235,9 @@ static void make_verts(struct mds_apf* m)
     mds_create_entity(&m->mds, MDS_VERTEX, NULL);
 }
 
-static void read_conn(struct pcu_file* f, struct mds_apf* m)
+static void read_conn(struct pcu_file* f, struct mds_apf* m, int wide)
 {
-  unsigned* conn;
+  mds_id* conn;
   struct mds_set down;
   int const* dt;
   mds_id cap;
@@ -171,7 +253,7 @@ static void read_conn(struct pcu_file* f, struct mds_apf* m)
     dt = mds_types[type_mds][mds_dim[type_mds] - 1];
     size = down.n * cap;
     conn = malloc(size * sizeof(*conn));
-    pcu_read_unsigneds(f, conn, size);
+    read_ids(f, wide, conn, size);
     for (j = 0; j < cap; ++j) {
       for (k = 0; k < down.n; ++k)
         down.e[k] = mds_identify(dt[k], conn[j * down.n + k]);
@@ -182,9 +264,9 @@ static void read_conn(struct pcu_file* f, struct mds_apf* m)
   }
 }
 
-static void write_conn(struct pcu_file* f, struct mds_apf* m)
+static void write_conn(struct pcu_file* f, struct mds_apf* m, int wide)
 {
-  unsigned* conn;
+  mds_id* conn;
   struct mds_set down;
   mds_id end;
   size_t size;
@@ -204,32 +286,32 @@ static void write_conn(struct pcu_file* f, struct mds_apf* m)
       for (k = 0; k < down.n; ++k)
         conn[j * down.n + k] = mds_index(down.e[k]);
     }
-    pcu_write_unsigneds(f, conn, size);
+    write_ids(f, wide, conn, size);
     free(conn);
   }
 }
 
-static void read_remotes(struct pcu_file* f, struct mds_apf* m,
-    int ignore_peers)
+void smb_read_remotes(struct pcu_file* f, struct mds_apf* m,
+    int ignore_peers, int wide)
 {
   struct mds_links ln = MDS_LINKS_INIT;
-  read_links(f, &ln);
+  read_links(f, &ln, wide);
   if (!ignore_peers)
     mds_set_type_links(&m->remotes, &m->mds, MDS_VERTEX, &ln);
   mds_free_links(&ln);
 }
 
-static void write_remotes(struct pcu_file* f, struct mds_apf* m,
-    int ignore_peers)
+void smb_write_remotes(struct pcu_file* f, struct mds_apf* m,
+    int ignore_peers, int wide)
 {
   struct mds_links ln = MDS_LINKS_INIT;
   if (!ignore_peers)
     mds_get_type_links(&m->remotes, &m->mds, MDS_VERTEX, &ln);
-  write_links(f, &ln);
+  write_links(f, &ln, wide);
   mds_free_links(&ln);
 }
 
-static void read_class(struct pcu_file* f, struct mds_apf* m)
+void smb_read_class(struct pcu_file* f, struct mds_apf* m)
 {
   mds_id cap;
   size_t size;
@@ -251,7 +333,7 @@ static void read_class(struct pcu_file* f, struct mds_apf* m)
   }
 }
 
-static void write_class(struct pcu_file* f, struct mds_apf* m)
+void smb_write_class(struct pcu_file* f, struct mds_apf* m)
 {
   mds_id end;
   size_t size;
@@ -274,7 +356,7 @@ static void write_class(struct pcu_file* f, struct mds_apf* m)
   }
 }
 
-static struct mds_tag* read_tag_header(struct pcu_file* f, struct mds_apf* m)
+struct mds_tag* smb_read_tag_header(struct pcu_file* f, struct mds_apf* m)
 {
   unsigned type, count;
   char* name;
@@ -295,7 +377,7 @@ static struct mds_tag* read_tag_header(struct pcu_file* f, struct mds_apf* m)
   return t;
 }
 
-static void write_tag_header(struct pcu_file* f, struct mds_tag* t)
+void smb_write_tag_header(struct pcu_file* f, struct mds_tag* t)
 {
   unsigned type, count;
   int type_smb[2];
@@ -312,12 +394,12 @@ static void write_tag_header(struct pcu_file* f, struct mds_tag* t)
 }
 
 static void read_int_tag(struct pcu_file* f, struct mds_apf* m,
-                         struct mds_tag* tag, unsigned count, int t)
+    struct mds_tag* tag, mds_id count, int t, int wide)
 {
-  unsigned* ids;
+  mds_id* ids;
   unsigned* tmp;
   int size;
-  unsigned i;
+  mds_id i;
   int j;
   mds_id e;
   int* p;
@@ -325,7 +407,7 @@ static void read_int_tag(struct pcu_file* f, struct mds_apf* m,
   ids = malloc(count * sizeof(*ids));
   size = tag->bytes / sizeof(int);
   tmp = malloc(size * count * sizeof(*tmp));
-  pcu_read_unsigneds(f, ids, count);
+  read_ids(f, wide, ids, count);
   pcu_read_unsigneds(f, tmp, size * count);
   for (i = 0; i < count; ++i) {
     e = mds_identify(t, ids[i]);
@@ -350,14 +432,14 @@ static mds_id count_tagged(struct mds_apf* m, struct mds_tag* tag, int t)
 }
 
 static void write_int_tag(struct pcu_file* f, struct mds_apf* m,
-                          struct mds_tag* tag, unsigned count, int t)
+    struct mds_tag* tag, mds_id count, int t, int wide)
 {
-  unsigned* ids;
+  mds_id* ids;
   unsigned* tmp;
   int size;
-  unsigned i;
+  mds_id i;
   int j;
-  unsigned k;
+  mds_id k;
   mds_id e;
   int* p;
   unsigned* q;
@@ -365,7 +447,7 @@ static void write_int_tag(struct pcu_file* f, struct mds_apf* m,
   size = tag->bytes / sizeof(int);
   tmp = malloc(size * count * sizeof(*tmp));
   k = 0;
-  for (i = 0; i < (unsigned)(m->mds.end[t]); ++i) {
+  for (i = 0; i < m->mds.end[t]; ++i) {
     e = mds_identify(t, i);
     if (!mds_has_tag(tag, e))
       continue;
@@ -377,26 +459,26 @@ static void write_int_tag(struct pcu_file* f, struct mds_apf* m,
     ++k;
   }
   PCU_ALWAYS_ASSERT(k == count);
-  pcu_write_unsigneds(f, ids, count);
+  write_ids(f, wide, ids, count);
   pcu_write_unsigneds(f, tmp, size * count);
   free(tmp);
   free(ids);
 }
 
 static void read_dbl_tag(struct pcu_file* f, struct mds_apf* m,
-    struct mds_tag* tag, unsigned count, int t)
+    struct mds_tag* tag, mds_id count, int t, int wide)
 {
-  unsigned* ids;
+  mds_id* ids;
   double* tmp;
   int size;
-  unsigned i;
+  mds_id i;
   mds_id e;
   double* p;
   double* q;
   ids = malloc(count * sizeof(*ids));
   size = tag->bytes / sizeof(double);
   tmp = malloc(size * count * sizeof(*tmp));
-  pcu_read_unsigneds(f, ids, count);
+  read_ids(f, wide, ids, count);
   pcu_read_doubles(f, tmp, size * count);
   for (i = 0; i < count; ++i) {
     e = mds_identify(t, ids[i]);
@@ -410,14 +492,14 @@ static void read_dbl_tag(struct pcu_file* f, struct mds_apf* m,
 }
 
 static void write_dbl_tag(struct pcu_file* f, struct mds_apf* m,
-                          struct mds_tag* tag, unsigned count, int t)
+    struct mds_tag* tag, mds_id count, int t, int wide)
 {
-  unsigned* ids;
+  mds_id* ids;
   double* tmp;
   int size;
-  unsigned i;
+  mds_id i;
   int j;
-  unsigned k;
+  mds_id k;
   mds_id e;
   double* p;
   double* q;
@@ -425,7 +507,7 @@ static void write_dbl_tag(struct pcu_file* f, struct mds_apf* m,
   size = tag->bytes / sizeof(double);
   tmp = malloc(size * count * sizeof(*tmp));
   k = 0;
-  for (i = 0; i < (unsigned)(m->mds.end[t]); ++i) {
+  for (i = 0; i < m->mds.end[t]; ++i) {
     e = mds_identify(t, i);
     if (!mds_has_tag(tag, e))
       continue;
@@ -437,16 +519,16 @@ static void write_dbl_tag(struct pcu_file* f, struct mds_apf* m,
     ++k;
   }
   PCU_ALWAYS_ASSERT(k == count);
-  pcu_write_unsigneds(f, ids, count);
+  write_ids(f, wide, ids, count);
   pcu_write_doubles(f, tmp, size * count);
   free(tmp);
   free(ids);
 }
 
-static void read_tags(struct pcu_file* f, struct mds_apf* m)
+static void read_tags(struct pcu_file* f, struct mds_apf* m, int wide)
 {
   unsigned n;
-  unsigned* sizes;
+  mds_id* sizes;
   struct mds_tag** tags;
   unsigned i,j;
   int type_mds;
@@ -455,26 +537,26 @@ static void read_tags(struct pcu_file* f, struct mds_apf* m)
   tags = malloc(n * sizeof(*tags));
   sizes = malloc(n * sizeof(*sizes));
   for (i = 0; i < n; ++i)
-    tags[i] = read_tag_header(f, m);
+    tags[i] = smb_read_tag_header(f, m);
   for (i = 0; i < SMB_TYPES; ++i) {
-    pcu_read_unsigneds(f, sizes, n);
+    read_ids(f, wide, sizes, n);
     type_mds = smb2mds(i);
     for (j = 0; j < n; ++j) {
       if (sizeof(mds_id) == 4) PCU_ALWAYS_ASSERT(sizes[j] < MAX_ENTITIES);
       if (tags[j]->user_type == mds_apf_int)
-        read_int_tag(f, m, tags[j], sizes[j], type_mds);
+        read_int_tag(f, m, tags[j], sizes[j], type_mds, wide);
       else
-        read_dbl_tag(f, m, tags[j], sizes[j], type_mds);
+        read_dbl_tag(f, m, tags[j], sizes[j], type_mds, wide);
     }
   }
   free(tags);
   free(sizes);
 }
 
-static void write_tags(struct pcu_file* f, struct mds_apf* m)
+static void write_tags(struct pcu_file* f, struct mds_apf* m, int wide)
 {
   unsigned n;
-  unsigned* sizes;
+  mds_id* sizes;
   struct mds_tag* t;
   int i,j;
   int type_mds;
@@ -486,7 +568,7 @@ static void write_tags(struct pcu_file* f, struct mds_apf* m)
   sizes = malloc(n * sizeof(*sizes));
   for (t = m->tags.first; t; t = t->next)
     if (t->user_type != mds_apf_long)
-      write_tag_header(f, t);
+      smb_write_tag_header(f, t);
   for (i = 0; i < SMB_TYPES; ++i) {
     type_mds = smb2mds(i);
     j = 0;
@@ -495,23 +577,23 @@ static void write_tags(struct pcu_file* f, struct mds_apf* m)
         continue;
       sizes[j++] = count_tagged(m, t, type_mds);
     }
-    pcu_write_unsigneds(f, sizes, n);
+    write_ids(f, wide, sizes, n);
     j = 0;
     for (t = m->tags.first; t; t = t->next) {
       if (t->user_type == mds_apf_int)
-        write_int_tag(f, m, t, sizes[j++], type_mds);
+        write_int_tag(f, m, t, sizes[j++], type_mds, wide);
       else if (t->user_type == mds_apf_double)
-        write_dbl_tag(f, m, t, sizes[j++], type_mds);
+        write_dbl_tag(f, m, t, sizes[j++], type_mds, wide);
     }
   }
   free(sizes);
 }
 
 static void read_type_matches(struct pcu_file* f, struct mds_apf* m, int t,
-    int ignore_peers)
+    int ignore_peers, int wide)
 {
   struct mds_links ln = MDS_LINKS_INIT;
-  read_links(f, &ln);
+  read_links(f, &ln, wide);
   if (!ignore_peers)
     mds_set_local_matches(&m->matches, &m->mds, t, &ln);
   mds_free_local_links(&ln);
@@ -521,14 +603,14 @@ static void read_type_matches(struct pcu_file* f, struct mds_apf* m, int t,
 }
 
 static void write_type_matches(struct pcu_file* f, struct mds_apf* m, int t,
-    int ignore_peers)
+    int ignore_peers, int wide)
 {
   struct mds_links ln = MDS_LINKS_INIT;
   if (!ignore_peers) {
     mds_get_type_links(&m->matches, &m->mds, t, &ln);
     mds_get_local_matches(&m->matches, &m->mds, t, &ln);
   }
-  write_links(f, &ln);
+  write_links(f, &ln, wide);
   mds_free_links(&ln);
 }
 
@@ -537,63 +619,86 @@ static void read_matches_old(struct pcu_file* f, struct mds_apf* m,
 {
   int t;
   for (t = 0; t < MDS_HEXAHEDRON; ++t)
-    read_type_matches(f, m, t, ignore_peers);
+    read_type_matches(f, m, t, ignore_peers, 0);
 }
 
-static void read_matches_new(struct pcu_file* f, struct mds_apf* m,
-    int ignore_peers)
+void smb_read_matches(struct pcu_file* f, struct mds_apf* m,
+    int ignore_peers, int wide)
 {
   int t;
   for (t = 0; t < SMB_TYPES; ++t)
-    read_type_matches(f, m, smb2mds(t), ignore_peers);
+    read_type_matches(f, m, smb2mds(t), ignore_peers, wide);
 }
 
-static void write_matches(struct pcu_file* f, struct mds_apf* m,
-    int ignore_peers)
+void smb_write_matches(struct pcu_file* f, struct mds_apf* m,
+    int ignore_peers, int wide)
 {
   int t;
   for (t = 0; t < SMB_TYPES; ++t)
-    write_type_matches(f, m, smb2mds(t), ignore_peers);
+    write_type_matches(f, m, smb2mds(t), ignore_peers, wide);
+}
+
+/* with aggregation, each group of this many consecutive
+   ranks shares one file, see pcu_fopen_aggregate */
+static int smb_group = 64;
+
+void mds_set_smb_group(int n)
+{
+  if (n < 1)
+    reel_fail("MDS: invalid smb group size %d\n", n);
+  smb_group = n;
+}
+
+static struct pcu_file* open_smb(const char* filename, int write,
+    int zip, int agg)
+{
+  if (agg)
+    return pcu_fopen_aggregate(filename, write, zip, smb_group);
+  return pcu_fopen(filename, write, zip);
 }
 
 static struct mds_apf* read_smb(struct gmi_model* model, const char* filename,
-    int zip, int ignore_peers, void* apf_mesh)
+    int zip, int agg, int ignore_peers, void* apf_mesh)
 {
   struct mds_apf* m;
   struct pcu_file* f;
+  unsigned magic;
   unsigned version;
   unsigned dim;
-  unsigned n[SMB_TYPES];
+  int wide;
   mds_id cap[MDS_TYPES];
-  int i;
-  unsigned tmp;
-  unsigned pi, pj;
-  f = pcu_fopen(filename, 0, zip);
+  mds_id pi;
+  int pj;
+  f = open_smb(filename, 0, zip, agg);
   PCU_ALWAYS_ASSERT(f);
-  read_header(f, &version, &dim, ignore_peers);
-  pcu_read_unsigneds(f, n, SMB_TYPES);
-  for (i = 0; i < MDS_TYPES; ++i) {
-    tmp = n[mds2smb(i)];
-    if (sizeof(mds_id) == 4) PCU_ALWAYS_ASSERT(tmp < MAX_ENTITIES);
-    cap[i] = tmp;
+  read_header(f, &magic, &version, &dim, ignore_peers);
+  wide = is_wide(version);
+  if (magic == SMB_MAPPED) {
+    if (zip || agg)
+      reel_fail("MDS: mapped smb file \"%s\" can not be compressed"
+          " or aggregated\n", filename);
+    m = smb_read_mapped(f, filename, model, dim, ignore_peers, wide, apf_mesh);
+    pcu_fclose(f);
+    return m;
   }
+  smb_read_counts(f, wide, cap);
   m = mds_apf_create(model, dim, cap);
   make_verts(m);
-  read_conn(f, m);
-  pcu_read_doubles(f, &m->point[0][0], 3 * n[SMB_VERT]);
+  read_conn(f, m, wide);
+  pcu_read_doubles(f, &m->point[0][0], 3 * cap[MDS_VERTEX]);
   if (version >= 2) {
-    pcu_read_doubles(f, &m->param[0][0], 2 * n[SMB_VERT]);
+    pcu_read_doubles(f, &m->param[0][0], 2 * cap[MDS_VERTEX]);
   } else {
 /* initialize parameteric coordinates to zero if they are not in the file */
-    for (pi = 0; pi < n[SMB_VERT]; ++pi) {
+    for (pi = 0; pi < cap[MDS_VERTEX]; ++pi) {
       for (pj = 0; pj < 2; ++pj) m->param[pi][pj] = 0.0;
     }
   }
-  read_remotes(f, m, ignore_peers);
-  read_class(f, m);
-  read_tags(f, m);
+  smb_read_remotes(f, m, ignore_peers, wide);
+  smb_read_class(f, m);
+  read_tags(f, m, wide);
   if (version >= 4)
-    read_matches_new(f, m, ignore_peers);
+    smb_read_matches(f, m, ignore_peers, wide);
   else if (version >= 3)
     read_matches_old(f, m, ignore_peers);
   if (version >= 5)
@@ -612,23 +717,27 @@ static void write_coords(struct pcu_file* f, struct mds_apf* m)
 }
 
 static void write_smb(struct mds_apf* m, const char* filename,
-    int zip, int ignore_peers, void* apf_mesh)
+    int zip, int agg, int map, int ignore_peers, void* apf_mesh)
 {
   struct pcu_file* f;
-  unsigned n[SMB_TYPES] = {0};
-  int i;
-  f = pcu_fopen(filename, 1, zip);
+  int wide;
+  f = open_smb(filename, 1, zip, agg);
   PCU_ALWAYS_ASSERT(f);
-  write_header(f, m->mds.d, ignore_peers);
-  for (i = 0; i < MDS_TYPES; ++i)
-    n[mds2smb(i)] = m->mds.end[i];
-  pcu_write_unsigneds(f, n, SMB_TYPES);
-  write_conn(f, m);
+  if (map) {
+    smb_write_mapped(f, m, ignore_peers, apf_mesh);
+    pcu_fclose(f);
+    return;
+  }
+  wide = smb_needs_wide(m);
+  smb_write_header(f, SMB_MAGIC, wide ? SMB_WIDE_VERSION : SMB_VERSION,
+      m->mds.d, ignore_peers);
+  smb_write_counts(f, m, wide);
+  write_conn(f, m, wide);
   write_coords(f, m);
-  write_remotes(f, m, ignore_peers);
-  write_class(f, m);
-  write_tags(f, m);
-  write_matches(f, m, ignore_peers);
+  smb_write_remotes(f, m, ignore_peers, wide);
+  smb_write_class(f, m);
+  write_tags(f, m, wide);
+  smb_write_matches(f, m, ignore_peers, wide);
   mds_write_smb_meta(f, apf_mesh);
   pcu_fclose(f);
 }
@@ -685,10 +794,17 @@ static void safe_mkdir(const char* path, mode_t mode)
     reel_fail("MDS: could not create directory \"%s\"\n", path);
 }
 
+/* the "bz2:" prefix compresses files and the "agg:" prefix
+   aggregates the files of groups of ranks, in either order.
+   Aggregated files are named after the first rank of their group.
+   The "map:" prefix writes mapped files, which can not be compressed
+   or aggregated. Readers tell mapped files by their header. */
 static char* handle_path(const char* in, int is_write, int* zip,
-    int ignore_peers)
+    int* agg, int* map, int ignore_peers)
 {
   static const char* zippre = "bz2:";
+  static const char* aggpre = "agg:";
+  static const char* mappre = "map:";
   static const char* smbext = ".smb";
   size_t bufsize;
   char* path;
@@ -697,14 +813,32 @@ static char* handle_path(const char* in, int is_write, int* zip,
   bufsize = strlen(in) + 256;
   path = malloc(bufsize);
   strcpy(path, in);
-  if (starts_with(path, zippre)) {
-    *zip = 1;
-    remove_prefix(path, zippre);
-  } else {
-    *zip = 0;
+  *zip = 0;
+  *agg = 0;
+  *map = 0;
+  for (;;) {
+    if (starts_with(path, zippre)) {
+      *zip = 1;
+      remove_prefix(path, zippre);
+    } else if (starts_with(path, aggpre)) {
+      *agg = 1;
+      remove_prefix(path, aggpre);
+    } else if (starts_with(path, mappre)) {
+      *map = 1;
+      remove_prefix(path, mappre);
+    } else {
+      break;
+    }
   }
-  if (ignore_peers)
+  if (*map && (*zip || *agg))
+    reel_fail("MDS: mapped smb files can not be compressed"
+        " or aggregated\n");
+  if (ignore_peers) {
+    *agg = 0;
     return path;
+  }
+  if (*agg)
+    self -= self % smb_group;
   if (ends_with(path, "/")) {
     if (is_write) {
       if (!self)
@@ -733,9 +867,11 @@ struct mds_apf* mds_read_smb(struct gmi_model* model, const char* pathname,
 {
   char* filename;
   int zip;
+  int agg;
+  int map;
   struct mds_apf* m;
-  filename = handle_path(pathname, 0, &zip, ignore_peers);
-  m = read_smb(model, filename, zip, ignore_peers, apf_mesh);
+  filename = handle_path(pathname, 0, &zip, &agg, &map, ignore_peers);
+  m = read_smb(model, filename, zip, agg, ignore_peers, apf_mesh);
   free(filename);
   return m;
 }
@@ -755,6 +891,8 @@ struct mds_apf* mds_write_smb(struct mds_apf* m, const char* pathname,
   const char* reorderWarning ="MDS: reordering before writing smb files\n";
   char* filename;
   int zip;
+  int agg;
+  int map;
   if (ignore_peers && (!is_compact(m))) {
     if(!PCU_Comm_Self()) fprintf(stderr, "%s", reorderWarning);
     m = mds_reorder(m, 1, mds_number_verts_bfs(m));
@@ -763,8 +901,8 @@ struct mds_apf* mds_write_smb(struct mds_apf* m, const char* pathname,
     if(!PCU_Comm_Self()) fprintf(stderr, "%s", reorderWarning);
     m = mds_reorder(m, 0, mds_number_verts_bfs(m));
   }
-  filename = handle_path(pathname, 1, &zip, ignore_peers);
-  write_smb(m, filename, zip, ignore_peers, apf_mesh);
+  filename = handle_path(pathname, 1, &zip, &agg, &map, ignore_peers);
+  write_smb(m, filename, zip, agg, map, ignore_peers, apf_mesh);
   free(filename);
   return m;
 }
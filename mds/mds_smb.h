@@ -0,0 +1,85 @@
+/****************************************************************************** 
+
+  Copyright 2014 Scientific Computation Research Center, 
+      Rensselaer Polytechnic Institute. All rights reserved.
+  
+  This work is open source software, licensed under the terms of the
+  BSD license as described in the LICENSE file in the top-level directory.
+
+*******************************************************************************/
+
+#ifndef MDS_SMB_H
+#define MDS_SMB_H
+
+#include "mds_apf.h"
+
+struct pcu_file;
+
+enum { SMB_VERSION = 5 };
+
+/* mapped files have their own magic number and a version
+   that readers of unmapped files reject */
+enum { SMB_MAGIC = 0, SMB_MAPPED = 1, SMB_MAPPED_VERSION = 6 };
+
+/* wide files are like those of the versions above, but hold entity
+   counts and indices as 64-bit integers instead of unsigned.
+   They are only written for parts that need them, so the files of
+   ordinary parts can still be read by older code */
+enum { SMB_WIDE_VERSION = 7, SMB_MAPPED_WIDE_VERSION = 8 };
+
+enum {
+  SMB_VERT,
+  SMB_EDGE,
+  SMB_TRI,
+  SMB_QUAD,
+  SMB_HEX,
+  SMB_PRIS,
+  SMB_PYR,
+  SMB_TET,
+  SMB_TYPES
+};
+
+enum {
+  SMB_INT,
+  SMB_DBL
+};
+
+/* these limits are just for sanity checking
+   of the input file contents.
+   they do not reflect hard limitations anywhere
+   else in the MDS source code,
+   so feel free to increase them slightly if you
+   have a strange application. */
+#define MAX_ENTITIES (100*1000*1000)
+#define MAX_PEERS (10*1000)
+#define MAX_TAGS (100)
+
+/* pieces of the smb format shared by mds_smb.c and mds_smb_map.c */
+
+void smb_write_header(struct pcu_file* f, unsigned magic,
+    unsigned version, unsigned dim, int ignore_peers);
+int smb_needs_wide(struct mds_apf* m);
+/* entity counts of each type, in MDS type order */
+void smb_read_counts(struct pcu_file* f, int wide, mds_id counts[MDS_TYPES]);
+void smb_write_counts(struct pcu_file* f, struct mds_apf* m, int wide);
+struct mds_tag* smb_read_tag_header(struct pcu_file* f, struct mds_apf* m);
+void smb_write_tag_header(struct pcu_file* f, struct mds_tag* t);
+void smb_read_remotes(struct pcu_file* f, struct mds_apf* m,
+    int ignore_peers, int wide);
+void smb_write_remotes(struct pcu_file* f, struct mds_apf* m,
+    int ignore_peers, int wide);
+void smb_read_class(struct pcu_file* f, struct mds_apf* m);
+void smb_write_class(struct pcu_file* f, struct mds_apf* m);
+void smb_read_matches(struct pcu_file* f, struct mds_apf* m,
+    int ignore_peers, int wide);
+void smb_write_matches(struct pcu_file* f, struct mds_apf* m,
+    int ignore_peers, int wide);
+
+/* mapped files, after the header */
+void smb_write_mapped(struct pcu_file* f, struct mds_apf* m,
+    int ignore_peers, void* apf_mesh);
+struct mds_apf* smb_read_mapped(struct pcu_file* f, const char* filename,
+    struct gmi_model* model, unsigned dim, int ignore_peers, int wide,
+    void* apf_mesh);
+
+#endif
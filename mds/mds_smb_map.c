@@ -0,0 +1,276 @@
+/****************************************************************************** 
+
+  Copyright 2014 Scientific Computation Research Center, 
+      Rensselaer Polytechnic Institute. All rights reserved.
+  
+  This work is open source software, licensed under the terms of the
+  BSD license as described in the LICENSE file in the top-level directory.
+
+*******************************************************************************/
+
+#include "mds_smb.h"
+#include "mds_map.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pcu_util.h>
+#include <pcu_io.h>
+#include <reel.h>
+#include <fcntl.h> /* open and close for mapped files */
+#include <unistd.h>
+
+/* A mapped smb file holds the arrays of the in-memory mesh
+   as they are, so that a reader can map them instead of reading
+   and rebuilding them. After the usual header and entity counts
+   comes a prologue:
+     sizeof(mds_id), section alignment, a byte order mark,
+     the adjacencies kept (mrm), the tag headers and the
+     entity types each tag has data for (unsigned)
+   then the sections, each starting at a multiple of the alignment:
+     free lists, adjacency arrays, coordinates, parameters,
+     and for each tag and type its bits and data (native bytes)
+   and then remotes, classification, matches, and meta data
+   as in other smb files. */
+
+enum { SMB_BYTE_ORDER = 0x01020304 };
+
+struct section {
+  void** p;
+  size_t bytes;
+};
+
+static int max_sections(unsigned ntags)
+{
+  return MDS_TYPES * (1 + 4 * 4 * 2) + 2 + ntags * MDS_TYPES * 2;
+}
+
+static void add_section(struct section* s, int* n, void* p, size_t bytes)
+{
+  s[*n].p = p;
+  s[*n].bytes = bytes;
+  ++(*n);
+}
+
+static void get_adjacency_sections(struct mds* m, int from, int to,
+    struct section* s, int* n)
+{
+  int t;
+  for (t = 0; t < MDS_TYPES; ++t) {
+    if (from < to && mds_dim[t] == to)
+      add_section(s, n, &m->up[from][t],
+          m->end[t] * mds_degree[t][from] * sizeof(mds_id));
+    else if (from < to && mds_dim[t] == from)
+      add_section(s, n, &m->first_up[to][t], m->end[t] * sizeof(mds_id));
+    else if (from > to && mds_dim[t] == from)
+      add_section(s, n, &m->down[to][t],
+          m->end[t] * mds_degree[t][to] * sizeof(mds_id));
+  }
+}
+
+/* the same list for the writer and the reader, which has
+   set up the counts, adjacencies, and tags of the mesh */
+static int get_sections(struct mds_apf* m, struct mds_tag** tags,
+    unsigned* has, unsigned ntags, struct section* s)
+{
+  struct mds* mds = &m->mds;
+  int n = 0;
+  int i, j, t;
+  unsigned k;
+  for (t = 0; t < MDS_TYPES; ++t)
+    add_section(s, &n, &mds->free[t], mds->end[t] * sizeof(mds_id));
+  for (i = 0; i <= 3; ++i)
+  for (j = 0; j <= 3; ++j)
+    if (i != j && mds->mrm[i][j])
+      get_adjacency_sections(mds, i, j, s, &n);
+  add_section(s, &n, &m->point, mds->end[MDS_VERTEX] * sizeof(*m->point));
+  add_section(s, &n, &m->param, mds->end[MDS_VERTEX] * sizeof(*m->param));
+  for (k = 0; k < ntags; ++k)
+    for (t = 0; t < MDS_TYPES; ++t)
+      if (has[k] & (1 << t)) {
+        add_section(s, &n, &tags[k]->has[t], (mds->end[t] / 8) + 1);
+        add_section(s, &n, &tags[k]->data[t],
+            (size_t)tags[k]->bytes * mds->end[t]);
+      }
+  PCU_ALWAYS_ASSERT(n <= max_sections(ntags));
+  return n;
+}
+
+static size_t align_offset(size_t offset, size_t alignment)
+{
+  return ((offset + alignment - 1) / alignment) * alignment;
+}
+
+static void write_zeros(struct pcu_file* f, size_t bytes)
+{
+  static const char zeros[4096] = {0};
+  size_t n;
+  while (bytes) {
+    n = bytes < sizeof(zeros) ? bytes : sizeof(zeros);
+    pcu_write(f, zeros, n);
+    bytes -= n;
+  }
+}
+
+void smb_write_mapped(struct pcu_file* f, struct mds_apf* m,
+    int ignore_peers, void* apf_mesh)
+{
+  int wide = smb_needs_wide(m);
+  unsigned ntags = 0;
+  struct mds_tag** tags;
+  unsigned* has;
+  struct mds_tag* tag;
+  struct section* sections;
+  int nsections;
+  unsigned prologue[2];
+  unsigned mrm[4][4];
+  uint32_t order = SMB_BYTE_ORDER;
+  size_t offset, start;
+  unsigned k;
+  int i, j;
+  smb_write_header(f, SMB_MAPPED,
+      wide ? SMB_MAPPED_WIDE_VERSION : SMB_MAPPED_VERSION,
+      m->mds.d, ignore_peers);
+  smb_write_counts(f, m, wide);
+  prologue[0] = sizeof(mds_id);
+  prologue[1] = sysconf(_SC_PAGESIZE);
+  pcu_write_unsigneds(f, prologue, 2);
+  pcu_write(f, (const char*)&order, sizeof(order));
+  for (i = 0; i <= 3; ++i)
+  for (j = 0; j <= 3; ++j)
+    mrm[i][j] = m->mds.mrm[i][j];
+  pcu_write_unsigneds(f, &mrm[0][0], 16);
+  for (tag = m->tags.first; tag; tag = tag->next)
+    if (tag->user_type != mds_apf_long)
+      ++ntags;
+  tags = malloc(ntags * sizeof(*tags));
+  has = malloc(ntags * sizeof(*has));
+  k = 0;
+  for (tag = m->tags.first; tag; tag = tag->next) {
+    if (tag->user_type == mds_apf_long)
+      continue;
+    tags[k] = tag;
+    has[k] = 0;
+    for (i = 0; i < MDS_TYPES; ++i)
+      if (tag->has[i] && m->mds.end[i])
+        has[k] |= (1 << i);
+    ++k;
+  }
+  PCU_WRITE_UNSIGNED(f, ntags);
+  for (k = 0; k < ntags; ++k)
+    smb_write_tag_header(f, tags[k]);
+  pcu_write_unsigneds(f, has, ntags);
+  sections = malloc(max_sections(ntags) * sizeof(*sections));
+  nsections = get_sections(m, tags, has, ntags, sections);
+  offset = pcu_ftell(f);
+  for (i = 0; i < nsections; ++i) {
+    if (!sections[i].bytes)
+      continue;
+    start = align_offset(offset, prologue[1]);
+    write_zeros(f, start - offset);
+    pcu_write(f, *(sections[i].p), sections[i].bytes);
+    offset = start + sections[i].bytes;
+  }
+  free(sections);
+  free(has);
+  free(tags);
+  smb_write_remotes(f, m, ignore_peers, wide);
+  smb_write_class(f, m);
+  smb_write_matches(f, m, ignore_peers, wide);
+  mds_write_smb_meta(f, apf_mesh);
+}
+
+/* maps the sections if the alignment they were written with suits
+   this machine's pages, and reads them otherwise */
+static void read_sections(struct pcu_file* f, const char* filename,
+    struct section* sections, int nsections, size_t alignment)
+{
+  size_t page = sysconf(_SC_PAGESIZE);
+  int can_map = (alignment % page == 0);
+  size_t offset, start;
+  int fd = -1;
+  int i;
+  if (can_map) {
+    fd = open(filename, O_RDONLY);
+    if (fd < 0)
+      reel_fail("MDS: could not open \"%s\" to map it\n", filename);
+  }
+  offset = pcu_ftell(f);
+  for (i = 0; i < nsections; ++i) {
+    if (!sections[i].bytes)
+      continue;
+    start = align_offset(offset, alignment);
+    if (can_map) {
+      *(sections[i].p) = mds_map(fd, start, sections[i].bytes);
+    } else {
+      *(sections[i].p) = malloc(sections[i].bytes);
+      pcu_fseek(f, start);
+      pcu_read(f, *(sections[i].p), sections[i].bytes);
+    }
+    offset = start + sections[i].bytes;
+  }
+  if (can_map)
+    close(fd);
+  pcu_fseek(f, offset);
+}
+
+struct mds_apf* smb_read_mapped(struct pcu_file* f, const char* filename,
+    struct gmi_model* model, unsigned dim, int ignore_peers, int wide,
+    void* apf_mesh)
+{
+  struct mds_apf* m;
+  mds_id n[MDS_TYPES];
+  mds_id cap[MDS_TYPES] = {0};
+  unsigned prologue[2];
+  unsigned mrm[4][4];
+  uint32_t order;
+  unsigned ntags;
+  struct mds_tag** tags;
+  unsigned* has;
+  struct section* sections;
+  int nsections;
+  unsigned k;
+  int i, j, t;
+  smb_read_counts(f, wide, n);
+  pcu_read_unsigneds(f, prologue, 2);
+  pcu_read(f, (char*)&order, sizeof(order));
+  if (prologue[0] != sizeof(mds_id))
+    reel_fail("MDS: \"%s\" was written with %u byte ids, MDS uses %u\n",
+        filename, prologue[0], (unsigned)sizeof(mds_id));
+  if (order != SMB_BYTE_ORDER)
+    reel_fail("MDS: \"%s\" was written with another byte order\n",
+        filename);
+  m = mds_apf_create(model, dim, cap);
+  for (t = 0; t < MDS_TYPES; ++t) {
+    m->mds.n[t] = m->mds.cap[t] = m->mds.end[t] = n[t];
+    m->model[t] = mds_map_realloc(m->model[t],
+        m->mds.cap[t] * sizeof(*(m->model[t])));
+    m->parts[t] = mds_map_realloc(m->parts[t],
+        m->mds.cap[t] * sizeof(*(m->parts[t])));
+    if (m->parts[t])
+      memset(m->parts[t], 0, m->mds.cap[t] * sizeof(*(m->parts[t])));
+  }
+  mds_map_free(m->point);
+  mds_map_free(m->param);
+  pcu_read_unsigneds(f, &mrm[0][0], 16);
+  for (i = 0; i <= 3; ++i)
+  for (j = 0; j <= 3; ++j)
+    m->mds.mrm[i][j] = mrm[i][j];
+  PCU_READ_UNSIGNED(f, ntags);
+  PCU_ALWAYS_ASSERT(ntags < MAX_TAGS);
+  tags = malloc(ntags * sizeof(*tags));
+  has = malloc(ntags * sizeof(*has));
+  for (k = 0; k < ntags; ++k)
+    tags[k] = smb_read_tag_header(f, m);
+  pcu_read_unsigneds(f, has, ntags);
+  sections = malloc(max_sections(ntags) * sizeof(*sections));
+  nsections = get_sections(m, tags, has, ntags, sections);
+  read_sections(f, filename, sections, nsections, prologue[1]);
+  free(sections);
+  free(has);
+  free(tags);
+  smb_read_remotes(f, m, ignore_peers, wide);
+  smb_read_class(f, m);
+  smb_read_matches(f, m, ignore_peers, wide);
+  mds_read_smb_meta(f, m, apf_mesh);
+  return m;
+}
@@ -9,8 +9,15 @@
 *******************************************************************************/
 
 #include "mds_tag.h"
+#include "mds_map.h"
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
+
+/* guards the first allocation of a tag's arrays. The bits of
+   has are set and cleared atomically, since the threads creating
+   and destroying entities through mds_buffers share their bytes */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
 
 void mds_create_tags(struct mds_tags* ts)
 {
@@ -36,10 +43,10 @@ static void grow_tag(
       continue;
     has[0] = (old_cap[t] / 8) + 1;
     has[1] = (m->cap[t] / 8) + 1;
-    tag->has[t] = realloc(tag->has[t], has[1]);
+    tag->has[t] = mds_map_realloc(tag->has[t], has[1]);
     for (i = has[0]; i < has[1]; ++i)
       tag->has[t][i] = 0;
-    tag->data[t] = realloc(tag->data[t],
+    tag->data[t] = mds_map_realloc(tag->data[t],
         tag->bytes * m->cap[t]);
   }
 }
@@ -54,6 +61,44 @@ void mds_grow_tags(
     grow_tag(t,m,old_cap);
 }
 
+static void renumber_tag(
+    struct mds_tag* tag,
+    struct mds* m,
+    struct mds_renumber* r)
+{
+  int t;
+  mds_id i;
+  mds_id j;
+  mds_id bytes;
+  unsigned char* has;
+  for (t = 0; t < MDS_TYPES; ++t) {
+    if ( ! tag->has[t])
+      continue;
+    bytes = (m->cap[t] / 8) + 1;
+    has = mds_map_realloc(NULL, bytes);
+    memset(has, 0, bytes);
+    for (i = 0; i < r->end[t]; ++i) {
+      j = r->to[t][i];
+      if (j != MDS_NONE && (tag->has[t][i / 8] & (1 << (i % 8))))
+        has[j / 8] |= (1 << (j % 8));
+    }
+    mds_map_free(tag->has[t]);
+    tag->has[t] = has;
+    tag->data[t] = mds_renumber_rows(r, t, tag->data[t],
+        tag->bytes, m->cap[t]);
+  }
+}
+
+void mds_renumber_tags(
+    struct mds_tags* ts,
+    struct mds* m,
+    struct mds_renumber* r)
+{
+  struct mds_tag* t;
+  for (t = ts->first; t; t = t->next)
+    renumber_tag(t,m,r);
+}
+
 struct mds_tag* mds_create_tag(
     struct mds_tags* ts,
     const char* name,
@@ -80,9 +125,9 @@ void mds_destroy_tag(struct mds_tags* ts, struct mds_tag* t)
   for (p = &(ts->first); *p != t; p = &((*p)->next));
   *p = (*p)->next;
   for (i = 0; i < MDS_TYPES; ++i)
-    free(t->data[i]);
+    mds_map_free(t->data[i]);
   for (i = 0; i < MDS_TYPES; ++i)
-    free(t->has[i]);
+    mds_map_free(t->has[i]);
   free(t->name);
   free(t);
 }
@@ -108,13 +153,15 @@ int mds_has_tag(struct mds_tag* tag, mds_id e)
   mds_id c;
   int b;
   unsigned char v;
+  unsigned char* has;
   t = mds_type(e);
-  if ( ! tag->has[t])
+  has = __atomic_load_n(&tag->has[t], __ATOMIC_ACQUIRE);
+  if ( ! has)
     return 0;
   i = mds_index(e);
   c = i / 8;
   b = i % 8;
-  v = tag->has[t][c] & (1 << b);
+  v = __atomic_load_n(has + c, __ATOMIC_RELAXED) & (1 << b);
   return v != 0;
 }
 
@@ -126,15 +173,21 @@ void mds_give_tag(struct mds_tag* tag, struct mds* m, mds_id e)
   int b;
   unsigned char* has;
   t = mds_type(e);
-  if ( ! tag->has[t]) {
-    tag->has[t] = calloc((m->cap[t] / 8) + 1, 1);
-    tag->data[t] = malloc(tag->bytes * m->cap[t]);
+  if ( ! __atomic_load_n(&tag->has[t], __ATOMIC_ACQUIRE)) {
+    pthread_mutex_lock(&lock);
+    if ( ! tag->has[t]) {
+      tag->data[t] = mds_map_realloc(NULL, tag->bytes * m->cap[t]);
+      has = mds_map_realloc(NULL, (m->cap[t] / 8) + 1);
+      memset(has, 0, (m->cap[t] / 8) + 1);
+      __atomic_store_n(&tag->has[t], has, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&lock);
   }
   i = mds_index(e);
   c = i / 8;
   b = i % 8;
   has = tag->has[t] + c;
-  *has |= (1<<b);
+  __atomic_fetch_or(has, (unsigned char)(1 << b), __ATOMIC_RELAXED);
 }
 
 void mds_take_tag(struct mds_tag* tag, mds_id e)
@@ -148,10 +201,11 @@ void mds_take_tag(struct mds_tag* tag, mds_id e)
   i = mds_index(e);
   c = i / 8;
   b = i % 8;
-  if (!tag->has[t])
+  has = __atomic_load_n(&tag->has[t], __ATOMIC_ACQUIRE);
+  if (!has)
     return;
-  has = tag->has[t] + c;
-  *has &= ~(1 << b);
+  has += c;
+  __atomic_fetch_and(has, (unsigned char)~(1 << b), __ATOMIC_RELAXED);
 }
 
 void mds_rename_tag(struct mds_tag* tag, const char* newName)
@@ -32,6 +32,10 @@ void mds_grow_tags(
     struct mds_tags* ts,
     struct mds* m,
     mds_id old_cap[MDS_TYPES]);
+void mds_renumber_tags(
+    struct mds_tags* ts,
+    struct mds* m,
+    struct mds_renumber* r);
 struct mds_tag* mds_create_tag(
     struct mds_tags* ts,
     const char* name,
@@ -11,9 +11,13 @@ include_directories(${CMAKE_CURRENT_BINARY_DIR})
 set(MDS_SOURCES
   mds.c
   mds_apf.c
+  mds_freeze.c
+  mds_map.c
   mds_net.c
   mds_order.c
+  mds_renumber.c
   mds_smb.c
+  mds_smb_map.c
   mds_tag.c
   apfMDS.cc
   apfPM.cc
@@ -35,6 +35,8 @@ int PCU_Comm_Peers(void);
 
 /*recommended message passing API*/
 void PCU_Comm_Begin(void);
+void PCU_Comm_Begin_At(const char* file, int line);
+#define PCU_Comm_Begin() PCU_Comm_Begin_At(__FILE__,__LINE__)
 int PCU_Comm_Pack(int to_rank, const void* data, size_t size);
 #define PCU_COMM_PACK(to_rank,object)\
 PCU_Comm_Pack(to_rank,&(object),sizeof(object))
@@ -47,10 +49,35 @@ int PCU_Comm_Unpack(void* data, size_t size);
 #define PCU_COMM_UNPACK(object)\
 PCU_Comm_Unpack(&(object),sizeof(object))
 
+/*zero-copy receive API: pointers into the current received buffer*/
+void* PCU_Comm_Extract(size_t size);
+#define PCU_COMM_EXTRACT(type,count)\
+((type*)PCU_Comm_Extract(sizeof(type)*(count)))
+size_t PCU_Comm_Remaining(void);
+/*counts of buffers reused across phases, for diagnostics*/
+void PCU_Comm_Pool(size_t* reused, size_t* allocations, size_t* pooled);
+
 /*turns deterministic ordering for the
   above API on/off*/
 void PCU_Comm_Order(bool on);
 
+/*declares a fixed, symmetric set of neighbors,
+  making later phases skip termination detection*/
+void PCU_Comm_Neighbors(const int* ranks, int n);
+void PCU_Comm_Clear_Neighbors(void);
+
+/*optional compression of large messages*/
+typedef struct pcu_codec_struct
+{
+  size_t (*bound)(size_t size);
+  size_t (*compress)(void* to, size_t to_size, const void* from, size_t size);
+  size_t (*decompress)(void* to, size_t to_size, const void* from, size_t size);
+} PCU_Codec;
+void PCU_Comm_Compress(const PCU_Codec* codec, size_t threshold);
+
+/*records the cost of each phase, written out by PCU_Comm_Free*/
+void PCU_Comm_Profile(const char* prefix);
+
 /*collective operations*/
 void PCU_Barrier(void);
 void PCU_Add_Doubles(double* p, size_t n);
@@ -84,6 +111,12 @@ int PCU_And(int c);
 int PCU_Proc_Self(void);
 int PCU_Proc_Peers(void);
 
+/*thread-hybrid mode: each thread of each process is a rank*/
+typedef void* PCU_Thrd_Func(void*);
+int PCU_Thrd_Run(int nthreads, PCU_Thrd_Func function, void** in_out);
+int PCU_Thrd_Self(void);
+int PCU_Thrd_Peers(void);
+
 /*IPComMan replacement API*/
 int PCU_Comm_Write(int to_rank, const void* data, size_t size);
 #define PCU_COMM_WRITE(to,data) \
@@ -104,7 +137,6 @@ bool PCU_Comm_Initialized(void);
 int PCU_Comm_Packed(int to_rank, size_t* size);
 int PCU_Comm_From(int* from_rank);
 int PCU_Comm_Received(size_t* size);
-void* PCU_Comm_Extract(size_t size);
 int PCU_Comm_Rank(int* rank);
 int PCU_Comm_Size(int* size);
 
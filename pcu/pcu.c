@@ -15,6 +15,7 @@
   PCU provides three things to users:
     1. A hybrid phased message passing system
     2. Hybrid collective operations
+    3. A hybrid MPI + threads execution mode, see PCU_Thrd_Run
 
   Phased message passing is similar to Bulk Synchronous Parallel.
   All messages are exchanged in a phase, which is a collective operation
@@ -31,10 +32,13 @@
 
 #include <string.h>
 #include <stdarg.h>
+#include <stdlib.h>
 #include "PCU.h"
 #include "pcu_msg.h"
 #include "pcu_pmpi.h"
 #include "pcu_order.h"
+#include "pcu_thread.h"
+#include "pcu_tmpi.h"
 #include "noto_malloc.h"
 #include "reel.h"
 #include <sys/types.h> /*required for mode_t for mkdir on some systems*/
@@ -44,9 +48,12 @@
 enum state { uninit, init };
 static enum state global_state = uninit;
 static pcu_msg global_pmsg;
+static pcu_msg* thread_pmsgs = NULL;
 
 static pcu_msg* get_msg()
 {
+  if (pcu_threads_running())
+    return thread_pmsgs + pcu_thread_rank();
   return &global_pmsg;
 }
 
@@ -67,6 +74,11 @@ int PCU_Comm_Init(void)
      PCU_Comm_Order(false) after PCU_Comm_Init
      to disable this */
   PCU_Comm_Order(true);
+  /* the PCU_PROFILE environment variable profiles
+     programs without changing them */
+  const char* profile = getenv("PCU_PROFILE");
+  if (profile && *profile)
+    PCU_Comm_Profile(profile);
   return PCU_SUCCESS;
 }
 
@@ -78,8 +90,12 @@ int PCU_Comm_Free(void)
 {
   if (global_state == uninit)
     reel_fail("Comm_Free called before Comm_Init");
+  if (pcu_threads_running())
+    reel_fail("Comm_Free called inside Thrd_Run");
   if (global_pmsg.order)
     pcu_order_free(global_pmsg.order);
+  if (global_pmsg.prof)
+    pcu_prof_write(global_pmsg.prof,pcu_pmpi_comm());
   pcu_free_msg(&global_pmsg);
   pcu_pmpi_finalize();
   global_state = uninit;
@@ -118,12 +134,25 @@ int PCU_Comm_Peers(void)
   at the beginning of each phase of communication.
   After calling this function, each thread may call functions like
   PCU_Comm_Pack or PCU_Comm_Write.
+  PCU.h makes this a macro that calls PCU_Comm_Begin_At with
+  the caller's file and line, which the phase profiler records.
 */
-void PCU_Comm_Begin(void)
+void (PCU_Comm_Begin)(void)
+{
+  PCU_Comm_Begin_At(NULL,0);
+}
+
+/** \brief Begins a PCU communication phase started at \a file : \a line.
+  \details See PCU_Comm_Begin and PCU_Comm_Profile.
+ */
+void PCU_Comm_Begin_At(const char* file, int line)
 {
   if (global_state == uninit)
     reel_fail("Comm_Begin called before Comm_Init");
-  pcu_msg_start(get_msg());
+  pcu_msg* m = get_msg();
+  if (m->prof)
+    pcu_prof_site(m->prof,file,line);
+  pcu_msg_start(m);
 }
 
 /** \brief Packs data to be sent to \a to_rank.
@@ -239,6 +268,93 @@ void PCU_Comm_Order(bool on)
   }
 }
 
+/** \brief Declares the \a n ranks in \a ranks as this rank's neighbors.
+  \details This function must be called by all ranks at the same time,
+  between communication phases, and the neighbor relation must be
+  symmetric: if rank a lists rank b, rank b must list rank a.
+  One communication phase is used to check this.
+
+  Until PCU_Comm_Clear_Neighbors is called, ranks may only pack to
+  their neighbors, and each phase exchanges exactly one message with
+  each neighbor.
+  Since every rank knows what it will receive, these phases skip the
+  termination detection and the initial barrier of normal phases,
+  which makes them cheaper when the communication graph is fixed,
+  as in repeated field synchronization over a fixed partition
+  (apf::getPeers gives the neighbors of a part).
+  Receiving works as usual, except that a neighbor that packed
+  nothing is not received from.
+ */
+void PCU_Comm_Neighbors(const int* ranks, int n)
+{
+  if (global_state == uninit)
+    reel_fail("Comm_Neighbors called before Comm_Init");
+  for (int i = 0; i < n; ++i)
+    if ((ranks[i] < 0)||(ranks[i] >= pcu_mpi_size()))
+      reel_fail("Invalid rank in Comm_Neighbors");
+  pcu_msg_set_neighbors(get_msg(), ranks, n);
+}
+
+/** \brief Goes back to normal communication phases.
+  \details Undoes PCU_Comm_Neighbors. This function must be called
+  by all ranks at the same time, between communication phases.
+ */
+void PCU_Comm_Clear_Neighbors(void)
+{
+  if (global_state == uninit)
+    reel_fail("Comm_Clear_Neighbors called before Comm_Init");
+  pcu_msg_clear_neighbors(get_msg());
+}
+
+/** \brief Records the cost of each communication phase.
+  \details This function must be called by all ranks at the same time,
+  between communication phases.
+  From then on, PCU records for each phase the call site of
+  PCU_Comm_Begin, the number of peers and bytes packed, and the time
+  spent packing, sending, receiving and waiting on barriers.
+  PCU_Comm_Free then writes the phases of all ranks to
+  \a prefix.csv and the messages and bytes each rank sent to each
+  peer to \a prefix_peers.csv. Rank 0 writes the totals by call site
+  to \a prefix_summary.csv and prints the most expensive ones.
+  Call sites are recorded for code compiled with this PCU.h,
+  and phases run inside PCU_Thrd_Run are not recorded.
+  Calling this again discards what was recorded, and a NULL
+  \a prefix stops recording.
+  Setting the PCU_PROFILE environment variable to a prefix
+  calls this from PCU_Comm_Init.
+ */
+void PCU_Comm_Profile(const char* prefix)
+{
+  if (global_state == uninit)
+    reel_fail("Comm_Profile called before Comm_Init");
+  if (pcu_threads_running())
+    reel_fail("Comm_Profile called inside Thrd_Run");
+  pcu_msg* m = get_msg();
+  if (m->prof)
+    pcu_prof_free(m->prof);
+  m->prof = prefix ? pcu_prof_new(prefix) : NULL;
+}
+
+/** \brief Compresses messages of at least \a threshold bytes with \a codec.
+  \details This function must be called by all ranks at the same time,
+  between communication phases, with the same threshold.
+  Until it is called again with a NULL \a codec, packed buffers that
+  reach the threshold are compressed by PCU_Comm_Send and decompressed
+  before PCU_Comm_Receive hands them to the user, so the rest of the
+  API is unchanged.
+  Buffers that do not shrink are sent as they are.
+  \a codec->bound gives the most bytes \a codec->compress can produce
+  from a given size, and \a codec->compress and \a codec->decompress
+  return how many bytes they wrote, compress returning zero on failure.
+  The codec is not copied and must outlive its use.
+ */
+void PCU_Comm_Compress(const PCU_Codec* codec, size_t threshold)
+{
+  if (global_state == uninit)
+    reel_fail("Comm_Compress called before Comm_Init");
+  pcu_msg_compress(get_msg(),codec,threshold);
+}
+
 /** \brief Blocking barrier over all threads. */
 void PCU_Barrier(void)
 {
@@ -502,6 +618,68 @@ int PCU_Proc_Peers(void)
   return pcu_pmpi_size();
 }
 
+/** \brief Runs \a function on \a nthreads threads in each process.
+  \details This function must be called by all MPI processes with the
+  same \a nthreads, after PCU_Comm_Init.
+  The calling thread becomes thread 0 and \a in_out[i], if \a in_out is
+  not NULL, is the argument given to thread i and is replaced by its
+  return value.
+  While \a function runs, each thread is a PCU rank with its own
+  communication phases, so PCU_Comm_Self and PCU_Comm_Peers count threads
+  (see PCU_Comm_Self for the numbering) and all PCU communication and
+  collectives are over threads.
+  Messages between threads of the same process are handed off in memory
+  and only messages between processes use MPI.
+  If there is more than one process, MPI must have been initialized by
+  MPI_Init_thread with MPI_THREAD_MULTIPLE.
+ */
+int PCU_Thrd_Run(int nthreads, PCU_Thrd_Func function, void** in_out)
+{
+  if (global_state == uninit)
+    reel_fail("Thrd_Run called before Comm_Init");
+  if (pcu_threads_running())
+    reel_fail("nested calls to Thrd_Run");
+  NOTO_MALLOC(thread_pmsgs,nthreads);
+  for (int i = 0; i < nthreads; ++i) {
+    pcu_make_msg(thread_pmsgs + i);
+    if (global_pmsg.order)
+      thread_pmsgs[i].order = pcu_order_new();
+  }
+  pcu_tmpi_init(nthreads);
+  pcu_set_mpi(&pcu_tmpi);
+  pcu_run_threads(nthreads, function, in_out);
+  pcu_set_mpi(&pcu_pmpi);
+  pcu_tmpi_finalize();
+  for (int i = 0; i < nthreads; ++i) {
+    if (thread_pmsgs[i].order)
+      pcu_order_free(thread_pmsgs[i].order);
+    pcu_free_msg(thread_pmsgs + i);
+  }
+  noto_free(thread_pmsgs);
+  thread_pmsgs = NULL;
+  return PCU_SUCCESS;
+}
+
+/** \brief Returns the rank of the calling thread within its process.
+  \details Outside of PCU_Thrd_Run this is always zero.
+ */
+int PCU_Thrd_Self(void)
+{
+  if (global_state == uninit)
+    reel_fail("Thrd_Self called before Comm_Init");
+  return pcu_thread_rank();
+}
+
+/** \brief Returns the number of threads per process.
+  \details Outside of PCU_Thrd_Run this is always one.
+ */
+int PCU_Thrd_Peers(void)
+{
+  if (global_state == uninit)
+    reel_fail("Thrd_Peers called before Comm_Init");
+  return pcu_thread_size();
+}
+
 /** \brief Similar to PCU_Comm_Self, returns the rank as an argument.
  */
 int PCU_Comm_Rank(int* rank)
@@ -701,7 +879,11 @@ int PCU_Comm_Received(size_t* size)
   \details This function should be called after a successful PCU_Comm_Receive.
   The next \a size bytes of the current received buffer are unpacked,
   and an internal pointer to that data is returned.
-  The returned pointer must not be freed by the user.
+  The returned pointer must not be freed by the user, and is valid
+  until the next call to PCU_Comm_Receive or PCU_Comm_Listen.
+  This avoids the copy made by PCU_Comm_Unpack.
+  The PCU_COMM_EXTRACT(type,count) macro returns a typed pointer to
+  \a count objects, whose alignment is up to how they were packed.
  */
 void* PCU_Comm_Extract(size_t size)
 {
@@ -713,6 +895,41 @@ void* PCU_Comm_Extract(size_t size)
   return pcu_msg_unpack(m,size);
 }
 
+/** \brief Returns the number of bytes left to unpack from the
+  current received buffer.
+  \details This function should be called after a successful
+  PCU_Comm_Receive. Together with PCU_Comm_Extract it allows viewing
+  the rest of a received buffer without copying it.
+ */
+size_t PCU_Comm_Remaining(void)
+{
+  if (global_state == uninit)
+    reel_fail("Comm_Remaining called before Comm_Init");
+  pcu_msg* m = get_msg();
+  if (m->order)
+    return pcu_order_remaining(m->order);
+  return pcu_msg_remaining(m);
+}
+
+/** \brief Reports how this thread's messenger got its buffers.
+  \details \a reused counts buffers taken from the pool of buffers
+  freed by earlier phases, \a allocations counts buffers the system
+  had to allocate or grow instead, and \a pooled is the memory
+  currently held by the pool, in bytes. Any of them may be NULL.
+ */
+void PCU_Comm_Pool(size_t* reused, size_t* allocations, size_t* pooled)
+{
+  if (global_state == uninit)
+    reel_fail("Comm_Pool called before Comm_Init");
+  pcu_pool* p = &(get_msg()->pool);
+  if (reused)
+    *reused = p->reused;
+  if (allocations)
+    *allocations = p->allocations;
+  if (pooled)
+    *pooled = p->bytes;
+}
+
 /** \brief Reinitializes PCU with a new MPI communicator.
  \details All of PCU's logic is based off two duplicates
  of this communicator, so you can safely get PCU to act
@@ -724,6 +941,9 @@ void PCU_Switch_Comm(MPI_Comm new_comm)
 {
   if (global_state == uninit)
     reel_fail("Switch_Comm called before Comm_Init");
+  if (pcu_threads_running())
+    reel_fail("Switch_Comm called inside Thrd_Run");
+  pcu_msg_clear_neighbors(get_msg());
   pcu_pmpi_switch(new_comm);
 }
 
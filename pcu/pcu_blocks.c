@@ -0,0 +1,321 @@
+/******************************************************************************
+
+  Copyright 2011 Scientific Computation Research Center,
+      Rensselaer Polytechnic Institute. All rights reserved.
+
+  This work is open source software, licensed under the terms of the
+  BSD license as described in the LICENSE file in the top-level directory.
+
+*******************************************************************************/
+#ifdef PCU_BZIP
+
+#include "pcu_blocks.h"
+#include "noto_malloc.h"
+#include "reel.h"
+#include <bzlib.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+enum { version = 1, codec_bzip2 = 1 };
+enum { block_size = 1 << 20 };
+
+enum { slot_free, slot_decoding, slot_ready };
+
+typedef struct
+{
+  int state;
+  char* in; //compressed
+  unsigned in_size;
+  char* out; //decompressed
+  unsigned out_size;
+} slot;
+
+struct pcu_blocks
+{
+  FILE* f;
+  bool write;
+  unsigned block_size;
+  unsigned in_capacity;
+  slot* slots;
+  int nslots;
+  /* the rest is for reading */
+  pthread_t* threads;
+  int nthreads;
+  pthread_mutex_t lock;
+  pthread_cond_t changed;
+  long read; //blocks read from the file
+  long used; //blocks fully given to the caller
+  size_t at; //position in the block being used
+  bool current; //whether slot used is ready and being used
+  bool end; //whether the last block was read
+  bool stop;
+};
+
+static void put_u32(unsigned char* p, uint32_t x)
+{
+  p[0] = x >> 24;
+  p[1] = x >> 16;
+  p[2] = x >> 8;
+  p[3] = x;
+}
+
+static uint32_t get_u32(const unsigned char* p)
+{
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+         ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static void write_u32s(FILE* f, const uint32_t* x, int n)
+{
+  unsigned char p[16];
+  for (int i = 0; i < n; ++i)
+    put_u32(p + 4 * i, x[i]);
+  if (fwrite(p, 4, n, f) != (size_t)n)
+    reel_fail("pcu_blocks: write failed");
+}
+
+static void read_u32s(FILE* f, uint32_t* x, int n)
+{
+  unsigned char p[16];
+  if (fread(p, 4, n, f) != (size_t)n)
+    reel_fail("pcu_blocks: unexpected end of file");
+  for (int i = 0; i < n; ++i)
+    x[i] = get_u32(p + 4 * i);
+}
+
+static unsigned compress_bound(unsigned size)
+{
+  /* from the bzip2 manual */
+  return size + size / 100 + 600;
+}
+
+static pcu_blocks* make_blocks(FILE* f, bool write, unsigned size, int nslots)
+{
+  pcu_blocks* b;
+  NOTO_MALLOC(b, 1);
+  memset(b, 0, sizeof(*b));
+  b->f = f;
+  b->write = write;
+  b->block_size = size;
+  b->in_capacity = compress_bound(size);
+  b->nslots = nslots;
+  NOTO_MALLOC(b->slots, nslots);
+  for (int i = 0; i < nslots; ++i) {
+    b->slots[i].state = slot_free;
+    NOTO_MALLOC(b->slots[i].in, b->in_capacity);
+    NOTO_MALLOC(b->slots[i].out, size);
+    b->slots[i].in_size = b->slots[i].out_size = 0;
+  }
+  return b;
+}
+
+static void free_blocks(pcu_blocks* b)
+{
+  for (int i = 0; i < b->nslots; ++i) {
+    noto_free(b->slots[i].in);
+    noto_free(b->slots[i].out);
+  }
+  noto_free(b->slots);
+  noto_free(b);
+}
+
+pcu_blocks* pcu_blocks_open_write(FILE* f)
+{
+  pcu_blocks* b = make_blocks(f, true, block_size, 1);
+  if (fwrite(PCU_BLOCKS_MAGIC, 1, 4, f) != 4)
+    reel_fail("pcu_blocks: write failed");
+  uint32_t header[3] = {version, codec_bzip2, block_size};
+  write_u32s(f, header, 3);
+  return b;
+}
+
+static void write_block(pcu_blocks* b)
+{
+  slot* s = b->slots;
+  if (!s->out_size)
+    return;
+  unsigned size = b->in_capacity;
+  int rv = BZ2_bzBuffToBuffCompress(s->in, &size, s->out, s->out_size,
+      9, 0, 30);
+  if (rv != BZ_OK)
+    reel_fail("BZ2_bzBuffToBuffCompress failed with code %d", rv);
+  uint32_t sizes[2] = {s->out_size, size};
+  write_u32s(b->f, sizes, 2);
+  if (fwrite(s->in, 1, size, b->f) != size)
+    reel_fail("pcu_blocks: write failed");
+  s->out_size = 0;
+}
+
+void pcu_blocks_write(pcu_blocks* b, const void* data, size_t size)
+{
+  const char* p = data;
+  slot* s = b->slots;
+  while (size) {
+    size_t n = b->block_size - s->out_size;
+    if (n > size)
+      n = size;
+    memcpy(s->out + s->out_size, p, n);
+    s->out_size += n;
+    p += n;
+    size -= n;
+    if (s->out_size == b->block_size)
+      write_block(b);
+  }
+}
+
+/* reads the next compressed block into s,
+   returns false at the end of the blocks */
+static bool read_block(pcu_blocks* b, slot* s)
+{
+  uint32_t sizes[2];
+  read_u32s(b->f, sizes, 2);
+  if (!sizes[0])
+    return false;
+  if (sizes[0] > b->block_size || sizes[1] > b->in_capacity)
+    reel_fail("pcu_blocks: corrupt block sizes %u %u", sizes[0], sizes[1]);
+  s->out_size = sizes[0];
+  s->in_size = sizes[1];
+  if (fread(s->in, 1, s->in_size, b->f) != s->in_size)
+    reel_fail("pcu_blocks: unexpected end of file");
+  return true;
+}
+
+static void decode_block(slot* s)
+{
+  unsigned size = s->out_size;
+  int rv = BZ2_bzBuffToBuffDecompress(s->out, &size, s->in, s->in_size,
+      0, 0);
+  if (rv != BZ_OK || size != s->out_size)
+    reel_fail("BZ2_bzBuffToBuffDecompress failed with code %d", rv);
+}
+
+static slot* slot_of(pcu_blocks* b, long block)
+{
+  return b->slots + block % b->nslots;
+}
+
+/* each decoding thread reads the next block from the file while
+   holding the lock, so blocks are read in order, and decodes
+   it without the lock */
+static void* decode_blocks(void* in)
+{
+  pcu_blocks* b = in;
+  pthread_mutex_lock(&b->lock);
+  for (;;) {
+    while (!b->stop &&
+           (b->end || slot_of(b, b->read)->state != slot_free))
+      pthread_cond_wait(&b->changed, &b->lock);
+    if (b->stop)
+      break;
+    slot* s = slot_of(b, b->read);
+    if (!read_block(b, s)) {
+      b->end = true;
+      pthread_cond_broadcast(&b->changed);
+      continue;
+    }
+    ++b->read;
+    s->state = slot_decoding;
+    pthread_mutex_unlock(&b->lock);
+    decode_block(s);
+    pthread_mutex_lock(&b->lock);
+    s->state = slot_ready;
+    pthread_cond_broadcast(&b->changed);
+  }
+  pthread_mutex_unlock(&b->lock);
+  return NULL;
+}
+
+pcu_blocks* pcu_blocks_open_read(FILE* f, int threads)
+{
+  uint32_t header[3];
+  read_u32s(f, header, 3);
+  if (header[0] != version || header[1] != codec_bzip2)
+    reel_fail("pcu_blocks: unknown version %u or codec %u",
+        header[0], header[1]);
+  if (!header[2] || header[2] > (1u << 30))
+    reel_fail("pcu_blocks: bad block size %u", header[2]);
+  if (threads < 0)
+    threads = 0;
+  /* enough slots that every thread can decode one block
+     while the caller uses another and the next is ready */
+  pcu_blocks* b = make_blocks(f, false, header[2], threads ? threads + 2 : 1);
+  b->nthreads = threads;
+  if (!threads)
+    return b;
+  pthread_mutex_init(&b->lock, NULL);
+  pthread_cond_init(&b->changed, NULL);
+  NOTO_MALLOC(b->threads, threads);
+  for (int i = 0; i < threads; ++i)
+    if (pthread_create(b->threads + i, NULL, decode_blocks, b))
+      reel_fail("pthread_create failed");
+  return b;
+}
+
+/* makes the next block the current one, returns false at the end */
+static bool next_block(pcu_blocks* b)
+{
+  if (!b->nthreads) {
+    b->current = read_block(b, b->slots);
+    if (b->current)
+      decode_block(b->slots);
+    b->at = 0;
+    return b->current;
+  }
+  pthread_mutex_lock(&b->lock);
+  if (b->current) {
+    slot_of(b, b->used)->state = slot_free;
+    ++b->used;
+    b->current = false;
+    pthread_cond_broadcast(&b->changed);
+  }
+  while (slot_of(b, b->used)->state != slot_ready &&
+         !(b->end && b->used == b->read))
+    pthread_cond_wait(&b->changed, &b->lock);
+  b->current = (b->used < b->read);
+  pthread_mutex_unlock(&b->lock);
+  b->at = 0;
+  return b->current;
+}
+
+void pcu_blocks_read(pcu_blocks* b, void* data, size_t size)
+{
+  char* p = data;
+  while (size) {
+    slot* s = slot_of(b, b->used);
+    if (!b->current || b->at == s->out_size) {
+      if (!next_block(b))
+        reel_fail("pcu_blocks: read past the end of the file");
+      continue;
+    }
+    size_t n = s->out_size - b->at;
+    if (n > size)
+      n = size;
+    memcpy(p, s->out + b->at, n);
+    b->at += n;
+    p += n;
+    size -= n;
+  }
+}
+
+void pcu_blocks_close(pcu_blocks* b)
+{
+  if (b->write) {
+    write_block(b);
+    uint32_t end[2] = {0, 0};
+    write_u32s(b->f, end, 2);
+  } else if (b->nthreads) {
+    pthread_mutex_lock(&b->lock);
+    b->stop = true;
+    pthread_cond_broadcast(&b->changed);
+    pthread_mutex_unlock(&b->lock);
+    for (int i = 0; i < b->nthreads; ++i)
+      pthread_join(b->threads[i], NULL);
+    noto_free(b->threads);
+    pthread_cond_destroy(&b->changed);
+    pthread_mutex_destroy(&b->lock);
+  }
+  free_blocks(b);
+}
+
+#endif
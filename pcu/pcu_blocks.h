@@ -0,0 +1,38 @@
+/******************************************************************************
+
+  Copyright 2011 Scientific Computation Research Center,
+      Rensselaer Polytechnic Institute. All rights reserved.
+
+  This work is open source software, licensed under the terms of the
+  BSD license as described in the LICENSE file in the top-level directory.
+
+*******************************************************************************/
+#ifndef PCU_BLOCKS_H
+#define PCU_BLOCKS_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+/* the PCU block container (pcu_blocks) stores a compressed stream
+   as independently compressed blocks, so that a reader can decode
+   the blocks ahead of its position on a pool of threads while
+   the caller parses the blocks already decoded.
+   The file is a header:
+     "PCUB", version, codec, block size
+   and blocks, each:
+     uncompressed size, compressed size, compressed bytes
+   ending with a block of zero sizes. Sizes are 4 byte big-endian.
+   Blocks are compressed with bzip2, the only codec so far. */
+
+#define PCU_BLOCKS_MAGIC "PCUB"
+
+typedef struct pcu_blocks pcu_blocks;
+
+/* the magic bytes have been read from f already */
+pcu_blocks* pcu_blocks_open_read(FILE* f, int threads);
+pcu_blocks* pcu_blocks_open_write(FILE* f);
+void pcu_blocks_read(pcu_blocks* b, void* data, size_t size);
+void pcu_blocks_write(pcu_blocks* b, const void* data, size_t size);
+void pcu_blocks_close(pcu_blocks* b);
+
+#endif
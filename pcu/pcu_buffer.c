@@ -8,6 +8,7 @@
 
 *******************************************************************************/
 #include <stdlib.h>
+#include <string.h>
 #include "pcu_buffer.h"
 #include "noto_malloc.h"
 #include "reel.h"
@@ -17,6 +18,7 @@ void pcu_make_buffer(pcu_buffer* b)
   b->start = NULL;
   b->size = 0;
   b->capacity = 0;
+  b->allocated = 0;
 }
 
 void pcu_free_buffer(pcu_buffer* b)
@@ -24,17 +26,25 @@ void pcu_free_buffer(pcu_buffer* b)
   noto_free(b->start);
 }
 
+static size_t grown_capacity(pcu_buffer* b)
+{
+  //this growth formula is from git's cache.h alloc_nr
+  size_t min_growth = ((b->capacity + 16)*3)/2;
+  if (min_growth > b->size)
+    return min_growth;
+  return b->size;
+}
+
 void* pcu_push_buffer(pcu_buffer* b, size_t size)
 {
   b->size += size;
   if (b->size > b->capacity)
   {
-    //this growth formula is from git's cache.h alloc_nr
-    size_t min_growth = ((b->capacity + 16)*3)/2;
-    b->capacity = b->size;
-    if (min_growth > b->capacity)
-      b->capacity = min_growth;
-    b->start = noto_realloc(b->start, b->capacity);
+    b->capacity = grown_capacity(b);
+    if (b->capacity > b->allocated) {
+      b->start = noto_realloc(b->start, b->capacity);
+      b->allocated = b->capacity;
+    }
   }
   return b->start + b->size - size;
 }
@@ -61,13 +71,146 @@ bool pcu_buffer_walked(pcu_buffer* b)
 void pcu_resize_buffer(pcu_buffer* b, size_t size)
 {
   if (b->size == size && b->capacity == size) return;
-  b->size = b->capacity = size;
+  b->size = b->capacity = b->allocated = size;
   b->start = noto_realloc(b->start,size);
 }
 
+/* like pcu_resize_buffer, but keeps the memory if it is big enough
+   and does not keep the contents, for buffers received into */
+void pcu_fit_buffer(pcu_buffer* b, size_t size)
+{
+  if (size > b->allocated) {
+    noto_free(b->start);
+    b->start = noto_malloc(size);
+    b->allocated = size;
+  }
+  b->size = b->capacity = size;
+}
+
 void pcu_set_buffer(pcu_buffer* b, void* p, size_t size)
 {
   b->start = p;
-  b->size = b->capacity = size;
+  b->size = b->capacity = b->allocated = size;
+}
+
+
+/* the pool keeps at most this many bytes, larger
+   buffers go back to the system when given back */
+#define POOL_BYTES ((size_t)1 << 28)
+
+static int floor_class(size_t n)
+{
+  int r = 0;
+  while ((n >>= 1)) ++r;
+  return r;
+}
+
+void pcu_make_pool(pcu_pool* p)
+{
+  for (int i = 0; i < PCU_POOL_CLASSES; ++i) {
+    p->buffers[i] = NULL;
+    p->counts[i] = 0;
+    p->capacities[i] = 0;
+  }
+  p->bytes = 0;
+  p->reused = 0;
+  p->allocations = 0;
+}
+
+void pcu_free_pool(pcu_pool* p)
+{
+  for (int i = 0; i < PCU_POOL_CLASSES; ++i) {
+    for (int j = 0; j < p->counts[i]; ++j)
+      pcu_free_buffer(p->buffers[i] + j);
+    noto_free(p->buffers[i]);
+  }
+  pcu_make_pool(p);
 }
 
+static void pop_pooled(pcu_pool* p, int i, int j, pcu_buffer* b)
+{
+  *b = p->buffers[i][j];
+  p->buffers[i][j] = p->buffers[i][--(p->counts[i])];
+  p->bytes -= b->allocated;
+  b->size = 0;
+  b->capacity = b->allocated;
+  ++(p->reused);
+}
+
+/* pops a pooled buffer with at least size bytes allocated.
+   Buffers in the class of size itself may be big enough, which
+   lets a phase reuse the buffers of an equal phase before it. */
+static bool find_pooled(pcu_pool* p, size_t size, pcu_buffer* b)
+{
+  int i = floor_class(size);
+  for (int j = p->counts[i] - 1; j >= 0; --j)
+    if (p->buffers[i][j].allocated >= size) {
+      pop_pooled(p, i, j, b);
+      return true;
+    }
+  for (++i; i < PCU_POOL_CLASSES; ++i)
+    if (p->counts[i]) {
+      pop_pooled(p, i, p->counts[i] - 1, b);
+      return true;
+    }
+  return false;
+}
+
+/* makes b an empty buffer with a capacity of at least size bytes,
+   from the pool if possible. b must be empty already. */
+void pcu_pool_take(pcu_pool* p, pcu_buffer* b, size_t size)
+{
+  if (find_pooled(p, size, b))
+    return;
+  pcu_make_buffer(b);
+  b->capacity = b->allocated = size;
+  b->start = noto_malloc(size);
+  ++(p->allocations);
+}
+
+/* puts the memory of b in the pool and makes b empty */
+void pcu_pool_give(pcu_pool* p, pcu_buffer* b)
+{
+  if (!b->start || !b->allocated ||
+      p->bytes + b->allocated > POOL_BYTES) {
+    pcu_free_buffer(b);
+    pcu_make_buffer(b);
+    return;
+  }
+  int i = floor_class(b->allocated);
+  if (p->counts[i] == p->capacities[i]) {
+    p->capacities[i] = (p->capacities[i] + 4) * 2;
+    p->buffers[i] = noto_realloc(p->buffers[i],
+        p->capacities[i] * sizeof(pcu_buffer));
+  }
+  p->buffers[i][(p->counts[i])++] = *b;
+  p->bytes += b->allocated;
+  pcu_make_buffer(b);
+}
+
+/* like pcu_push_buffer, but grows into pooled buffers when possible */
+void* pcu_push_pooled(pcu_pool* p, pcu_buffer* b, size_t size)
+{
+  size_t old_size = b->size;
+  b->size += size;
+  if (b->size > b->capacity)
+  {
+    size_t capacity = grown_capacity(b);
+    pcu_buffer bigger;
+    if (capacity <= b->allocated) {
+      b->capacity = capacity;
+    } else if (find_pooled(p, capacity, &bigger)) {
+      if (old_size)
+        memcpy(bigger.start, b->start, old_size);
+      bigger.size = b->size;
+      b->size = old_size;
+      pcu_pool_give(p, b);
+      *b = bigger;
+    } else {
+      b->capacity = b->allocated = capacity;
+      b->start = noto_realloc(b->start, b->capacity);
+      ++(p->allocations);
+    }
+  }
+  return b->start + b->size - size;
+}
@@ -18,6 +18,7 @@ typedef struct
   char* start;
   size_t size;
   size_t capacity;
+  size_t allocated; //bytes at start, at least capacity
 } pcu_buffer;
 
 void pcu_make_buffer(pcu_buffer* b);
@@ -27,6 +28,31 @@ void pcu_begin_buffer(pcu_buffer* b);
 void* pcu_walk_buffer(pcu_buffer* b, size_t size);
 bool pcu_buffer_walked(pcu_buffer* b);
 void pcu_resize_buffer(pcu_buffer* b, size_t size);
+void pcu_fit_buffer(pcu_buffer* b, size_t size);
 void pcu_set_buffer(pcu_buffer* b, void* p, size_t size);
 
+/* a pool of unused buffer memory, so that a messenger can
+   reuse its buffers from one communication phase to the next
+   instead of going back to malloc and free.
+   Buffers are kept in power-of-two size classes: a buffer
+   in class k has at least 2^k bytes allocated. */
+
+#define PCU_POOL_CLASSES 48
+
+typedef struct
+{
+  pcu_buffer* buffers[PCU_POOL_CLASSES]; //stack of buffers per class
+  int counts[PCU_POOL_CLASSES];
+  int capacities[PCU_POOL_CLASSES];
+  size_t bytes; //total capacity of pooled buffers
+  size_t reused; //buffers handed out from the pool
+  size_t allocations; //buffers allocated or grown by the system instead
+} pcu_pool;
+
+void pcu_make_pool(pcu_pool* p);
+void pcu_free_pool(pcu_pool* p);
+void pcu_pool_take(pcu_pool* p, pcu_buffer* b, size_t size);
+void pcu_pool_give(pcu_pool* p, pcu_buffer* b);
+void* pcu_push_pooled(pcu_pool* p, pcu_buffer* b, size_t size);
+
 #endif
@@ -9,6 +9,7 @@
 *******************************************************************************/
 #include "pcu_coll.h"
 #include "pcu_pmpi.h"
+#include "noto_malloc.h"
 #include "reel.h"
 #include <string.h>
 
@@ -124,14 +125,80 @@ void pcu_add_longs(void* local, void* incoming, size_t size)
     a[i] += b[i];
 }
 
+/* the two-level operations are used when nodes
+   hold more than one rank but not all of them */
+static bool use_nodes(void)
+{
+  int node_size = pcu_mpi_node_size();
+  return 1 < node_size && node_size < pcu_mpi_size();
+}
+
+static void make_group(pcu_group* g, int kind)
+{
+  int rank = pcu_mpi_rank();
+  g->kind = kind;
+  g->ranks = pcu_mpi_size();
+  g->node_size = MAX(pcu_mpi_node_size(), 1);
+  int node = rank / g->node_size;
+  int nodes = (g->ranks + g->node_size - 1) / g->node_size;
+  g->first = node * g->node_size;
+  int node_ranks = MIN(g->node_size, g->ranks - g->first);
+  int tail = g->first + node_ranks - 1;
+  switch (kind) {
+    case pcu_all_group:
+      g->size = g->ranks;
+      g->self = rank;
+      break;
+    case pcu_node_group:
+      g->size = node_ranks;
+      g->self = rank - g->first;
+      break;
+    case pcu_tail_node_group:
+      g->size = node_ranks;
+      g->self = tail - rank;
+      break;
+    case pcu_later_node_group:
+      g->size = node_ranks;
+      g->self = node ? rank - g->first : -1;
+      break;
+    case pcu_leader_group:
+      g->size = nodes;
+      g->self = (rank == g->first) ? node : -1;
+      break;
+    case pcu_tail_group:
+      g->size = nodes;
+      g->self = (rank == tail) ? node : -1;
+      break;
+    default:
+      reel_fail("PCU unknown collective group %d", kind);
+  }
+}
+
+static int group_rank(pcu_group* g, int member)
+{
+  switch (g->kind) {
+    case pcu_node_group:
+    case pcu_later_node_group:
+      return g->first + member;
+    case pcu_tail_node_group:
+      return g->first + g->size - 1 - member;
+    case pcu_leader_group:
+      return member * g->node_size;
+    case pcu_tail_group:
+      return MIN((member + 1) * g->node_size, g->ranks) - 1;
+  }
+  return member;
+}
+
 /* initiates non-blocking calls for this
    communication step */
 static void begin_coll_step(pcu_coll* c)
 {
-  int action = c->pattern->action(c->bit);
+  pcu_group* g = &(c->group);
+  int action = c->pattern->action(g,c->bit);
   if (action == pcu_coll_idle)
     return;
-  c->message.peer = c->pattern->peer(c->bit);
+  c->message.peer = group_rank(g,c->pattern->peer(g,c->bit));
   if (action == pcu_coll_send)
     pcu_mpi_send(&(c->message),pcu_coll_comm);
 }
@@ -142,14 +209,15 @@ static void begin_coll_step(pcu_coll* c)
    if necessary, and returns true */
 static bool end_coll_step(pcu_coll* c)
 {
-  int action = c->pattern->action(c->bit);
+  pcu_group* g = &(c->group);
+  int action = c->pattern->action(g,c->bit);
   if (action == pcu_coll_idle)
     return true;
   if (action == pcu_coll_send)
     return pcu_mpi_done(&(c->message));
   pcu_message incoming;
   pcu_make_message(&incoming);
-  incoming.peer = c->pattern->peer(c->bit);
+  incoming.peer = group_rank(g,c->pattern->peer(g,c->bit));
   if ( ! pcu_mpi_receive(&incoming,pcu_coll_comm))
     return false;
   if (c->message.buffer.size != incoming.buffer.size)
@@ -160,12 +228,6 @@ static bool end_coll_step(pcu_coll* c)
   return true;
 }
 
-void pcu_make_coll(pcu_coll* c, pcu_pattern* p, pcu_merge* m)
-{
-  c->pattern = p;
-  c->merge = m;
-}
-
 /* the abstract algorithm for a collective communication
    pattern is as follows:
    for (bit = begin_bit; ! end_bit(bit); bit = shift(bit))
@@ -177,67 +239,109 @@ void pcu_make_coll(pcu_coll* c, pcu_pattern* p, pcu_merge* m)
    pcu_coll will return "not yet done" after begin_step
    and will pick up at end_step when called to progress again
 
+   an operation runs the patterns of its stages one after
+   the other, skipping the stages this rank has nothing to do in.
    this becomes messy considering in some cases begin_step
-   is not called at all, see pcu_begin_coll and pcu_progress_coll
+   is not called at all, see begin_stage and pcu_progress_coll
    below:
 */
 
+static void finish_coll(pcu_coll* c)
+{
+  if ( ! c->temporary)
+    return;
+  /* ranks after the first node add the prefix of the previous nodes */
+  if (c->scan && pcu_mpi_rank() >= c->group.node_size)
+    c->op(c->data,c->temporary,c->size);
+  noto_free(c->temporary);
+  c->temporary = NULL;
+}
+
+/* begins the next stage this rank has something to do in,
+   or finishes the operation after the last stage */
+static void begin_stage(pcu_coll* c)
+{
+  for (; c->stage < c->stages->count; ++(c->stage)) {
+    pcu_stage* s = c->stages->stages + c->stage;
+    make_group(&(c->group),s->group);
+    if (c->group.self == -1)
+      continue;
+    c->pattern = s->pattern;
+    c->merge = s->assign ? pcu_merge_assign : c->op;
+    pcu_set_buffer(&(c->message.buffer),
+        s->temporary ? c->temporary : c->data, c->size);
+    c->bit = c->pattern->begin_bit(&(c->group));
+    if (c->pattern->end_bit(&(c->group),c->bit))
+      continue;
+    begin_coll_step(c);
+    return;
+  }
+  finish_coll(c);
+}
+
 /* begins a non-blocking collective.
-   The collective operation should be set with pcu_make_coll first.
    data[0..size] is the input/output local data */
-void pcu_begin_coll(pcu_coll* c, void* data, size_t size)
+static void begin_coll(pcu_coll* c, pcu_stages* stages, pcu_merge* m,
+    void* data, size_t size)
 {
-  pcu_set_buffer(&(c->message.buffer),data,size);
-  c->bit = c->pattern->begin_bit();
-  if (c->pattern->end_bit(c->bit))
-    return;
-  begin_coll_step(c);
+  c->stages = stages;
+  c->stage = 0;
+  c->op = m;
+  c->data = data;
+  c->temporary = NULL;
+  c->size = size;
+  c->scan = false;
+  begin_stage(c);
 }
 
 /* makes progress on a collective operation
-   started by pcu_begin_coll.
+   started by one of the pcu_begin_ functions.
    returns false if its done. */
 bool pcu_progress_coll(pcu_coll* c)
 {
-  if (c->pattern->end_bit(c->bit))
+  if (c->stage == c->stages->count)
     return false;
   if (end_coll_step(c))
   {
     c->bit = c->pattern->shift(c->bit);
-    if (c->pattern->end_bit(c->bit))
-      return false;
+    if (c->pattern->end_bit(&(c->group),c->bit))
+    {
+      ++(c->stage);
+      begin_stage(c);
+      return c->stage != c->stages->count;
+    }
     begin_coll_step(c);
   }
   return true;
 }
 
-/* reduce merges odd ranks into even ones,
+/* reduce merges odd members into even ones,
    then odd multiples of 2 into even ones, etc...
-   until rank 0 has all inputs merged */
+   until member 0 has all inputs merged */
 
-static int reduce_begin_bit(void)
+static int reduce_begin_bit(pcu_group* g)
 {
+  (void)g;
   return 1;
 }
 
-static bool reduce_end_bit(int bit)
+static bool reduce_end_bit(pcu_group* g, int bit)
 {
-  int rank = pcu_mpi_rank();
-  if (rank==0)
-    return bit >= pcu_mpi_size();
-  return (bit>>1) & rank;
+  if (g->self==0)
+    return bit >= g->size;
+  return (bit>>1) & g->self;
 }
 
-static int reduce_peer(int bit)
+static int reduce_peer(pcu_group* g, int bit)
 {
-  return pcu_mpi_rank() ^ bit;
+  return g->self ^ bit;
 }
 
-static int reduce_action(int bit)
+static int reduce_action(pcu_group* g, int bit)
 {
-  if (reduce_peer(bit) >= pcu_mpi_size())
+  if (reduce_peer(g,bit) >= g->size)
     return pcu_coll_idle;
-  if (bit & pcu_mpi_rank())
+  if (bit & g->self)
     return pcu_coll_send;
   return pcu_coll_recv;
 }
@@ -260,31 +364,31 @@ static pcu_pattern reduce =
    the pattern runs backwards and send/recv
    are flipped. */
 
-static int bcast_begin_bit(void)
+static int bcast_begin_bit(pcu_group* g)
 {
-  int rank = pcu_mpi_rank();
-  if (rank == 0)
-    return 1 << ceil_log2(pcu_mpi_size());
+  if (g->self == 0)
+    return 1 << ceil_log2(g->size);
   int bit = 1;
-  while ( ! (bit & rank)) bit <<= 1;
+  while ( ! (bit & g->self)) bit <<= 1;
   return bit;
 }
 
-static bool bcast_end_bit(int bit)
+static bool bcast_end_bit(pcu_group* g, int bit)
 {
+  (void)g;
   return bit == 0;
 }
 
-static int bcast_peer(int bit)
+static int bcast_peer(pcu_group* g, int bit)
 {
-  return pcu_mpi_rank() ^ bit;
+  return g->self ^ bit;
 }
 
-static int bcast_action(int bit)
+static int bcast_action(pcu_group* g, int bit)
 {
-  if (bcast_peer(bit) >= pcu_mpi_size())
+  if (bcast_peer(g,bit) >= g->size)
     return pcu_coll_idle;
-  if (bit & pcu_mpi_rank())
+  if (bit & g->self)
     return pcu_coll_recv;
   return pcu_coll_send;
 }
@@ -310,14 +414,15 @@ static pcu_pattern bcast =
    "Parallel Prefix (Scan) Algorithms for MPI".
 */
 
-static int scan_up_begin_bit(void)
+static int scan_up_begin_bit(pcu_group* g)
 {
+  (void)g;
   return 1;
 }
 
-static bool scan_up_end_bit(int bit)
+static bool scan_up_end_bit(pcu_group* g, int bit)
 {
-  return bit == (1 << floor_log2(pcu_mpi_size()));
+  return bit == (1 << floor_log2(g->size));
 }
 
 static bool scan_up_could_receive(int rank, int bit)
@@ -336,28 +441,28 @@ static int scan_up_receiver_for(int rank, int bit)
   return rank + bit;
 }
 
-static int scan_up_action(int bit)
+static int scan_up_action(pcu_group* g, int bit)
 {
-  int rank = pcu_mpi_rank();
+  int rank = g->self;
   if ((scan_up_could_receive(rank,bit))&&
       (0 <= scan_up_sender_for(rank,bit)))
     return pcu_coll_recv;
   int receiver = scan_up_receiver_for(rank,bit);
-  if ((receiver < pcu_mpi_size())&&
+  if ((receiver < g->size)&&
       (scan_up_could_receive(receiver,bit)))
     return pcu_coll_send;
   return pcu_coll_idle;
 }
 
-static int scan_up_peer(int bit)
+static int scan_up_peer(pcu_group* g, int bit)
 {
-  int rank = pcu_mpi_rank();
+  int rank = g->self;
   int sender = scan_up_sender_for(rank,bit);
   if ((scan_up_could_receive(rank,bit))&&
       (0 <= sender))
     return sender;
   int receiver = scan_up_receiver_for(rank,bit);
-  if ((receiver < pcu_mpi_size())&&
+  if ((receiver < g->size)&&
       (scan_up_could_receive(receiver,bit)))
     return receiver;
   return -1;
@@ -377,13 +482,14 @@ static pcu_pattern scan_up =
   .shift = scan_up_shift,
 };
 
-static int scan_down_begin_bit(void)
+static int scan_down_begin_bit(pcu_group* g)
 {
-  return 1 << floor_log2(pcu_mpi_size());
+  return 1 << floor_log2(g->size);
 }
 
-static bool scan_down_end_bit(int bit)
+static bool scan_down_end_bit(pcu_group* g, int bit)
 {
+  (void)g;
   return bit == 1;
 }
 
@@ -403,11 +509,11 @@ static int scan_down_sender_for(int rank, int bit)
   return rank - (bit >> 1);
 }
 
-static int scan_down_action(int bit)
+static int scan_down_action(pcu_group* g, int bit)
 {
-  int rank = pcu_mpi_rank();
+  int rank = g->self;
   if ((scan_down_could_send(rank,bit))&&
-      (scan_down_receiver_for(rank,bit) < pcu_mpi_size()))
+      (scan_down_receiver_for(rank,bit) < g->size))
     return pcu_coll_send;
   int sender = scan_down_sender_for(rank,bit);
   if ((0 <= sender)&&
@@ -416,13 +522,13 @@ static int scan_down_action(int bit)
   return pcu_coll_idle;
 }
 
-static int scan_down_peer(int bit)
+static int scan_down_peer(pcu_group* g, int bit)
 {
-  int rank = pcu_mpi_rank();
+  int rank = g->self;
   if (scan_down_could_send(rank,bit))
   {
     int receiver = scan_down_receiver_for(rank,bit);
-    if (receiver < pcu_mpi_size())
+    if (receiver < g->size)
       return receiver;
   }
   int sender = scan_down_sender_for(rank,bit);
@@ -446,55 +552,172 @@ static pcu_pattern scan_down =
   .shift = scan_down_shift,
 };
 
+/* pass is a single step in which the last rank
+   of each node sends to the first rank of the next node */
+
+static int pass_begin_bit(pcu_group* g)
+{
+  (void)g;
+  return 1;
+}
+
+static bool pass_end_bit(pcu_group* g, int bit)
+{
+  (void)g;
+  return bit == 2;
+}
+
+static int pass_action(pcu_group* g, int bit)
+{
+  (void)bit;
+  int k = g->node_size;
+  if ((g->self % k == 0)&&(g->self > 0))
+    return pcu_coll_recv;
+  if ((g->self % k == k - 1)&&(g->self + 1 < g->size))
+    return pcu_coll_send;
+  return pcu_coll_idle;
+}
+
+static int pass_peer(pcu_group* g, int bit)
+{
+  if (pass_action(g,bit) == pcu_coll_recv)
+    return g->self - 1;
+  return g->self + 1;
+}
+
+static int pass_shift(int bit)
+{
+  return bit << 1;
+}
+
+static pcu_pattern pass =
+{
+  .begin_bit = pass_begin_bit,
+  .end_bit = pass_end_bit,
+  .action = pass_action,
+  .peer = pass_peer,
+  .shift = pass_shift,
+};
+
+#define STAGES(a) {a, sizeof(a) / sizeof(a[0])}
+
+static pcu_stage flat_reduce_stages[] = {
+  {&reduce, pcu_all_group, false, false}};
+static pcu_stages flat_reduce = STAGES(flat_reduce_stages);
+
+static pcu_stage node_reduce_stages[] = {
+  {&reduce, pcu_node_group, false, false},
+  {&reduce, pcu_leader_group, false, false}};
+static pcu_stages node_reduce = STAGES(node_reduce_stages);
+
+static pcu_stage flat_bcast_stages[] = {
+  {&bcast, pcu_all_group, false, true}};
+static pcu_stages flat_bcast = STAGES(flat_bcast_stages);
+
+static pcu_stage node_bcast_stages[] = {
+  {&bcast, pcu_leader_group, false, true},
+  {&bcast, pcu_node_group, false, true}};
+static pcu_stages node_bcast = STAGES(node_bcast_stages);
+
+static pcu_stage flat_allreduce_stages[] = {
+  {&reduce, pcu_all_group, false, false},
+  {&bcast, pcu_all_group, false, true}};
+static pcu_stages flat_allreduce = STAGES(flat_allreduce_stages);
+
+static pcu_stage node_allreduce_stages[] = {
+  {&reduce, pcu_node_group, false, false},
+  {&reduce, pcu_leader_group, false, false},
+  {&bcast, pcu_leader_group, false, true},
+  {&bcast, pcu_node_group, false, true}};
+static pcu_stages node_allreduce = STAGES(node_allreduce_stages);
+
+static pcu_stage flat_scan_stages[] = {
+  {&scan_up, pcu_all_group, false, false},
+  {&scan_down, pcu_all_group, false, false}};
+static pcu_stages flat_scan = STAGES(flat_scan_stages);
+
+/* the two-level scan reduces a copy of the data to the last rank
+   of each node while the node scans the data. The last ranks
+   then scan the node totals, and each passes its result to the
+   next node, which adds it to the data of all its ranks */
+static pcu_stage node_scan_stages[] = {
+  {&reduce, pcu_tail_node_group, true, false},
+  {&scan_up, pcu_node_group, false, false},
+  {&scan_down, pcu_node_group, false, false},
+  {&scan_up, pcu_tail_group, true, false},
+  {&scan_down, pcu_tail_group, true, false},
+  {&pass, pcu_all_group, true, true},
+  {&bcast, pcu_later_node_group, true, true}};
+static pcu_stages node_scan = STAGES(node_scan_stages);
+
+void pcu_begin_reduce(pcu_coll* c, pcu_merge* m, void* data, size_t size)
+{
+  begin_coll(c,use_nodes() ? &node_reduce : &flat_reduce,m,data,size);
+}
+
+void pcu_begin_bcast(pcu_coll* c, void* data, size_t size)
+{
+  begin_coll(c,use_nodes() ? &node_bcast : &flat_bcast,
+      pcu_merge_assign,data,size);
+}
+
+void pcu_begin_allreduce(pcu_coll* c, pcu_merge* m, void* data, size_t size)
+{
+  begin_coll(c,use_nodes() ? &node_allreduce : &flat_allreduce,
+      m,data,size);
+}
+
+void pcu_begin_scan(pcu_coll* c, pcu_merge* m, void* data, size_t size)
+{
+  if ( ! use_nodes()) {
+    begin_coll(c,&flat_scan,m,data,size);
+    return;
+  }
+  c->stages = &node_scan;
+  c->stage = 0;
+  c->op = m;
+  c->data = data;
+  c->size = size;
+  c->scan = true;
+  c->temporary = noto_malloc(MAX(size,1));
+  if (size)
+    memcpy(c->temporary,data,size);
+  begin_stage(c);
+}
+
 void pcu_reduce(pcu_coll* c, pcu_merge* m, void* data, size_t size)
 {
-  pcu_make_coll(c,&reduce,m);
-  pcu_begin_coll(c,data,size);
+  pcu_begin_reduce(c,m,data,size);
   while(pcu_progress_coll(c));
 }
 
 void pcu_bcast(pcu_coll* c, void* data, size_t size)
 {
-  pcu_make_coll(c,&bcast,pcu_merge_assign);
-  pcu_begin_coll(c,data,size);
+  pcu_begin_bcast(c,data,size);
   while(pcu_progress_coll(c));
 }
 
 void pcu_allreduce(pcu_coll* c, pcu_merge* m, void* data, size_t size)
 {
-  pcu_reduce(c,m,data,size);
-  pcu_bcast(c,data,size);
+  pcu_begin_allreduce(c,m,data,size);
+  while(pcu_progress_coll(c));
 }
 
 void pcu_scan(pcu_coll* c, pcu_merge* m, void* data, size_t size)
 {
-  pcu_make_coll(c,&scan_up,m);
-  pcu_begin_coll(c,data,size);
-  while(pcu_progress_coll(c));
-  pcu_make_coll(c,&scan_down,m);
-  pcu_begin_coll(c,data,size);
+  pcu_begin_scan(c,m,data,size);
   while(pcu_progress_coll(c));
 }
 
 /* a barrier is just an allreduce of nothing in particular */
 void pcu_begin_barrier(pcu_coll* c)
 {
-  pcu_make_coll(c,&reduce,pcu_merge_assign);
-  pcu_begin_coll(c,NULL,0);
+  pcu_begin_allreduce(c,pcu_merge_assign,NULL,0);
 }
 
 bool pcu_barrier_done(pcu_coll* c)
 {
-  if (c->pattern == &reduce)
-    if ( ! pcu_progress_coll(c))
-    {
-      pcu_make_coll(c,&bcast,pcu_merge_assign);
-      pcu_begin_coll(c,c->message.buffer.start,c->message.buffer.size);
-    }
-  if (c->pattern == &bcast)
-    if ( ! pcu_progress_coll(c))
-      return true;
-  return false;
+  return ! pcu_progress_coll(c);
 }
 
 void pcu_barrier(pcu_coll* c)
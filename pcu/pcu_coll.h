@@ -47,37 +47,92 @@ enum
   pcu_coll_idle
 };
 
+/* The collectives run their patterns over a group of ranks.
+   When ranks are laid out in blocks by shared-memory node
+   (see pcu_mpi_node_size), operations run in two levels:
+   first within each node, then over one rank per node,
+   so that only O(lg(nodes)) steps leave a node.
+   Group members are numbered from zero, and a rank that
+   is not a member of a stage's group skips that stage. */
+enum
+{
+  pcu_all_group, //all ranks
+  pcu_node_group, //the ranks of this node
+  pcu_tail_node_group, //the ranks of this node, last rank first
+  pcu_later_node_group, //the ranks of this node, except on the first node
+  pcu_leader_group, //the first rank of each node
+  pcu_tail_group //the last rank of each node
+};
+
+typedef struct
+{
+  int kind; //group enum
+  int ranks; //number of ranks overall
+  int node_size; //ranks per node
+  int first; //first rank of this node
+  int size; //number of members
+  int self; //member number of this rank, -1 if not a member
+} pcu_group;
+
 /* The pcu_pattern is an abstraction of a communication
-   pattern that takes O(lg(n)) steps for n peers,
-   and at each step (rank) communicates with (rank +- 2^k)
+   pattern that takes O(lg(n)) steps for n group members,
+   and at each step (member) communicates with (member +- 2^k)
    where k is some integer.
    The entire pattern state is encoded into this integer k, which
    for convenience is stored as bit=2^k=1<<k.
+   Peers are member numbers.
  */
 typedef struct
 {
-  int (*begin_bit)(void); //initialize state bit
-  bool (*end_bit)(int bit); //return true if bit is one past the last
-  int (*action)(int bit); //return action enum for this step
-  int (*peer)(int bit); //return the peer to communicate with
+  int (*begin_bit)(pcu_group* g); //initialize state bit
+  bool (*end_bit)(pcu_group* g, int bit); //true if bit is one past the last
+  int (*action)(pcu_group* g, int bit); //return action enum for this step
+  int (*peer)(pcu_group* g, int bit); //return the peer to communicate with
   int (*shift)(int bit); //shift the bit up or down
 } pcu_pattern;
 
+/* one pattern of a collective operation, run over a group
+   either on the caller's data or on a temporary copy */
+typedef struct
+{
+  pcu_pattern* pattern;
+  int group; //group enum
+  bool temporary; //operate on the temporary buffer
+  bool assign; //received data replaces local data instead of merging
+} pcu_stage;
+
+typedef struct
+{
+  pcu_stage* stages;
+  int count;
+} pcu_stages;
+
 /* The pcu_coll object stores the state of a non-blocking
    collective operation. */
 typedef struct
 {
+  pcu_stages* stages; //the stages of the operation
+  int stage; //current stage
+  pcu_group group; //group of the current stage
   pcu_pattern* pattern; //communication pattern controller
   pcu_merge* merge; //merge operation
-  pcu_message message; //local data being operated on
+  pcu_merge* op; //merge operation given by the user
+  void* data; //local data being operated on
+  void* temporary; //scratch copy of the data, if needed
+  size_t size; //size of the data
+  bool scan; //finish by merging the temporary into the data
+  pcu_message message; //buffer being sent or merged into
   int bit; //pattern's state bit
 } pcu_coll;
 
-void pcu_make_coll(pcu_coll* c, pcu_pattern* p, pcu_merge* m);
-void pcu_begin_coll(pcu_coll* c, void* data, size_t size);
 //returns false when done
 bool pcu_progress_coll(pcu_coll* c);
 
+void pcu_begin_reduce(pcu_coll* c, pcu_merge* m, void* data, size_t size);
+void pcu_begin_bcast(pcu_coll* c, void* data, size_t size);
+void pcu_begin_allreduce(pcu_coll* c, pcu_merge* m, void* data, size_t size);
+void pcu_begin_scan(pcu_coll* c, pcu_merge* m, void* data, size_t size);
+
 void pcu_reduce(pcu_coll* c, pcu_merge* m, void* data, size_t size);
 void pcu_bcast(pcu_coll* c, void* data, size_t size);
 void pcu_allreduce(pcu_coll* c, pcu_merge* m, void* data, size_t size);
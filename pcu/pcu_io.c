@@ -18,43 +18,94 @@
 #include "pcu_util.h"
 #include <sys/types.h>
 #include <limits.h>
+#include <unistd.h>
 
 #ifdef PCU_BZIP
 #include <bzlib.h>
+#include "pcu_blocks.h"
 #endif
 
 typedef struct pcu_file {
   FILE* f;
 #ifdef PCU_BZIP
-  BZFILE* bzf;
+  BZFILE* bzf; //for files that are one bzip2 stream
+  pcu_blocks* blocks; //for block containers
 #endif
   bool write;
   bool compress;
+  int group_size; //ranks per aggregated file, 0 if not aggregated
+  char* path; //aggregated file
+  char* memory; //this rank's stream of an aggregated file
+  size_t memory_size;
 } pcu_file;
 
+static int io_threads = -1;
+
+/** \brief set the number of threads decoding each compressed file
+  \details a negative number (the default) takes the number from the
+  PCU_IO_THREADS environment variable if it is set, and otherwise
+  uses the cores of this node left over by its ranks, up to 8.
+  Counting those needs the ranks of each node to be known
+  (see pcu_mpi_node_size); when they are not, files are decoded on
+  the reading thread. Zero always decodes on the reading thread. */
+void pcu_set_io_threads(int n)
+{
+  io_threads = n;
+}
+
 #ifdef PCU_BZIP
 
+static int count_io_threads(void)
+{
+  const char* env;
+  long cores;
+  int node_size;
+  int threads;
+  if (io_threads >= 0)
+    return io_threads;
+  env = getenv("PCU_IO_THREADS");
+  if (env && *env) {
+    threads = atoi(env);
+    return threads > 0 ? threads : 0;
+  }
+  /* a node size of one is also what an unknown layout looks like,
+     in which case other ranks may be using every core */
+  node_size = pcu_mpi_node_size();
+  if (node_size == 1 && pcu_mpi_size() > 1)
+    return 0;
+  cores = sysconf(_SC_NPROCESSORS_ONLN);
+  threads = cores / node_size - 1;
+  if (threads < 0)
+    threads = 0;
+  return threads < 8 ? threads : 8;
+}
+
+/* compressed files are block containers, except for those
+   written before them, which are one bzip2 stream */
 static void open_compressed_read(pcu_file* pf)
 {
   int bzerror;
   int verbosity = 0;
   int small = 0;
-  void* unused = NULL;
-  int nUnused = 0;
-  pf->bzf = BZ2_bzReadOpen(&bzerror, pf->f, verbosity, small, unused, nUnused);
+  char magic[4];
+  int nmagic;
+  pf->bzf = NULL;
+  pf->blocks = NULL;
+  nmagic = fread(magic, 1, 4, pf->f);
+  if (nmagic == 4 && !memcmp(magic, PCU_BLOCKS_MAGIC, 4)) {
+    pf->blocks = pcu_blocks_open_read(pf->f, count_io_threads());
+    return;
+  }
+  pf->bzf = BZ2_bzReadOpen(&bzerror, pf->f, verbosity, small,
+      magic, nmagic);
   if (bzerror != BZ_OK)
     reel_fail("BZ2_bzReadOpen failed with code %d", bzerror);
 }
 
 static void open_compressed_write(pcu_file* pf)
 {
-  int bzerror;
-  int verbosity = 0;
-  int blockSize100k = 9;
-  int workFactor = 30;
-  pf->bzf = BZ2_bzWriteOpen(&bzerror, pf->f, blockSize100k, verbosity, workFactor);
-  if (bzerror != BZ_OK)
-    reel_fail("BZ2_bzWriteOpen failed with code %d", bzerror);
+  pf->bzf = NULL;
+  pf->blocks = pcu_blocks_open_write(pf->f);
 }
 
 static void open_compressed(pcu_file* pf)
@@ -70,6 +121,10 @@ static void compressed_read(pcu_file* pf, void* data, size_t size)
   int bzerror;
   int len;
   int rv;
+  if (pf->blocks) {
+    pcu_blocks_read(pf->blocks, data, size);
+    return;
+  }
   PCU_ALWAYS_ASSERT(size < INT_MAX);
   len = size;
   rv = BZ2_bzRead(&bzerror, pf->bzf, data, len);
@@ -80,20 +135,16 @@ static void compressed_read(pcu_file* pf, void* data, size_t size)
 
 static void compressed_write(pcu_file* pf, void const* data, size_t size)
 {
-  int bzerror;
-  int len;
-  void* bzip2_is_not_const_correct;
-  PCU_ALWAYS_ASSERT(size < INT_MAX);
-  len = size;
-  bzip2_is_not_const_correct = (void*)data;
-  BZ2_bzWrite(&bzerror, pf->bzf, bzip2_is_not_const_correct, len);
-  if (bzerror != BZ_OK)
-    reel_fail("BZ2_bzWrite failed with code %d", bzerror);
+  pcu_blocks_write(pf->blocks, data, size);
 }
 
 static void close_compressed_read(pcu_file* pf)
 {
   int bzerror;
+  if (pf->blocks) {
+    pcu_blocks_close(pf->blocks);
+    return;
+  }
   BZ2_bzReadClose(&bzerror, pf->bzf);
   if (bzerror != BZ_OK)
     reel_fail("BZ2_readClose failed with code %d", bzerror);
@@ -101,13 +152,7 @@ static void close_compressed_read(pcu_file* pf)
 
 static void close_compressed_write(pcu_file* pf)
 {
-  int bzerror;
-  int abandon = 0;
-  unsigned* nbytes_in = NULL;
-  unsigned* nbytes_out = NULL;
-  BZ2_bzWriteClose(&bzerror, pf->bzf, abandon, nbytes_in, nbytes_out);
-  if (bzerror != BZ_OK)
-    reel_fail("BZ2_writeClose failed with code %d", bzerror);
+  pcu_blocks_close(pf->blocks);
 }
 
 static void close_compressed(pcu_file* pf)
@@ -186,6 +231,7 @@ pcu_file* pcu_fopen(const char* name, bool write, bool compress)
   pcu_file* pf = (pcu_file*) malloc(sizeof(pcu_file));
   pf->compress = compress;
   pf->write = write;
+  pf->group_size = 0;
   pf->f = pcu_group_open(name, write);
   if (!pf->f) {
     perror("pcu_fopen");
@@ -196,11 +242,19 @@ pcu_file* pcu_fopen(const char* name, bool write, bool compress)
   return pf;
 }
 
+static void write_aggregate(pcu_file* pf);
+
 void pcu_fclose(pcu_file* pf)
 {
   if (pf->compress)
     close_compressed(pf);
   fclose(pf->f);
+  if (pf->group_size) {
+    if (pf->write)
+      write_aggregate(pf);
+    free(pf->memory);
+    free(pf->path);
+  }
   free(pf);
 }
 
@@ -228,6 +282,30 @@ void pcu_fread(void* p, size_t size, size_t nmemb, pcu_file * f)
   }
 }
 
+static void check_seekable(pcu_file* f, const char* name)
+{
+  if (f->compress || f->group_size)
+    reel_fail("%s: compressed and aggregated files are not seekable",
+        name);
+}
+
+size_t pcu_ftell(pcu_file* f)
+{
+  long offset;
+  check_seekable(f, "pcu_ftell");
+  offset = ftell(f->f);
+  if (offset < 0)
+    reel_fail("pcu_ftell: ftell failed");
+  return (size_t)offset;
+}
+
+void pcu_fseek(pcu_file* f, size_t offset)
+{
+  check_seekable(f, "pcu_fseek");
+  if (fseek(f->f, (long)offset, SEEK_SET))
+    reel_fail("pcu_fseek: fseek to %lu failed", (unsigned long)offset);
+}
+
 void pcu_read(pcu_file* f, char* p, size_t n)
 {
   pcu_fread(p,1,n,f);
@@ -277,6 +355,12 @@ void pcu_swap_unsigneds(unsigned* p, size_t n)
     pcu_swap_32(p++);
 }
 
+void pcu_swap_uint64s(uint64_t* p, size_t n)
+{
+  for (size_t i=0; i < n; ++i)
+    pcu_swap_64((uint32_t*)(p++));
+}
+
 void pcu_swap_doubles(double* p, size_t n)
 {
   PCU_ALWAYS_ASSERT(sizeof(double)==8);
@@ -300,6 +384,22 @@ void pcu_write_unsigneds(pcu_file* f, unsigned* p, size_t n)
   }
 }
 
+void pcu_write_uint64s(pcu_file* f, uint64_t* p, size_t n)
+{
+  uint64_t* tmp;
+  if (n)
+    PCU_ALWAYS_ASSERT(p != 0);
+  if (PCU_ENDIANNESS != PCU_ENCODED_ENDIAN) {
+    tmp = malloc(n * sizeof(uint64_t));
+    memcpy(tmp, p, n * sizeof(uint64_t));
+    pcu_swap_uint64s(tmp, n);
+    pcu_fwrite(tmp,sizeof(uint64_t),n,f);
+    free(tmp);
+  } else {
+    pcu_fwrite(p,sizeof(uint64_t),n,f);
+  }
+}
+
 void pcu_write_doubles(pcu_file* f, double* p, size_t n)
 {
   double* tmp;
@@ -323,6 +423,13 @@ void pcu_read_unsigneds(pcu_file* f, unsigned* p, size_t n)
     pcu_swap_unsigneds(p,n);
 }
 
+void pcu_read_uint64s(pcu_file* f, uint64_t* p, size_t n)
+{
+  pcu_fread(p,sizeof(uint64_t),n,f);
+  if (PCU_ENDIANNESS != PCU_ENCODED_ENDIAN)
+    pcu_swap_uint64s(p,n);
+}
+
 void pcu_read_doubles(pcu_file* f, double* p, size_t n)
 {
   pcu_fread(p,sizeof(double),n,f);
@@ -362,3 +469,207 @@ FILE* pcu_open_parallel(const char* prefix, const char* ext)
   noto_free(path);
   return file;
 }
+
+/* An aggregated file holds the streams of a group of consecutive
+   ranks, so that a parallel file system sees one open per group
+   instead of one per rank. Each rank reads and writes its stream in
+   memory, and the first rank of each group, its leader, exchanges
+   the streams with the group in one PCU phase and does the file I/O.
+   The file is a header, an index of the streams, and the streams:
+     magic, version, first rank, number of ranks, (unsigned)
+     offsets of the streams and of the end (2 unsigneds each) */
+
+enum { aggregate_magic = 0x50434147, aggregate_version = 1 };
+
+static int group_leader(int group_size)
+{
+  int self = PCU_Comm_Self();
+  return self - self % group_size;
+}
+
+static int group_ranks(int group_size)
+{
+  int leader = group_leader(group_size);
+  int ranks = PCU_Comm_Peers() - leader;
+  return ranks < group_size ? ranks : group_size;
+}
+
+static void wrap_file(pcu_file* pf, FILE* f, bool write)
+{
+  pf->f = f;
+  pf->write = write;
+  pf->compress = false;
+  pf->group_size = 0;
+}
+
+static void write_offset(pcu_file* pf, size_t offset)
+{
+  unsigned v[2];
+  v[0] = (unsigned)(((uint64_t)offset) >> 32);
+  v[1] = (unsigned)(offset & 0xFFFFFFFF);
+  pcu_write_unsigneds(pf, v, 2);
+}
+
+static size_t read_offset(pcu_file* pf)
+{
+  unsigned v[2];
+  pcu_read_unsigneds(pf, v, 2);
+  return (size_t)((((uint64_t)v[0]) << 32) | v[1]);
+}
+
+/* streams move between a leader and its group one rank at a time,
+   so the leader holds at most two of them: while one is in flight
+   it writes the one before or reads the one after */
+static void write_aggregate(pcu_file* pf)
+{
+  int self = PCU_Comm_Self();
+  int leader = group_leader(pf->group_size);
+  int ranks = group_ranks(pf->group_size);
+  /* the index comes first, so the leader gathers the sizes first */
+  size_t* sizes = NULL;
+  if (self == leader)
+    sizes = noto_malloc(ranks * sizeof(size_t));
+  PCU_Comm_Begin();
+  PCU_COMM_PACK(leader, pf->memory_size);
+  PCU_Comm_Send();
+  while (PCU_Comm_Receive())
+    PCU_COMM_UNPACK(sizes[PCU_Comm_Sender() - leader]);
+  pcu_file out;
+  if (self == leader) {
+    FILE* f = fopen(pf->path, "w");
+    if (!f)
+      reel_fail("pcu: could not open \"%s\" for writing", pf->path);
+    wrap_file(&out, f, true);
+    unsigned header[4] =
+    {aggregate_magic, aggregate_version, (unsigned)leader, (unsigned)ranks};
+    pcu_write_unsigneds(&out, header, 4);
+    size_t offset = 0;
+    for (int i = 0; i < ranks; ++i) {
+      write_offset(&out, offset);
+      offset += sizes[i];
+    }
+    write_offset(&out, offset);
+    noto_free(sizes);
+  }
+  pcu_buffer pending;
+  pcu_make_buffer(&pending);
+  for (int i = 0; i < pf->group_size; ++i) {
+    PCU_Comm_Begin();
+    if (self == leader + i)
+      PCU_Comm_Pack(leader, pf->memory, pf->memory_size);
+    PCU_Comm_Send();
+    if (pending.size)
+      pcu_write(&out, pending.start, pending.size);
+    while (PCU_Comm_Receive()) {
+      size_t size = PCU_Comm_Remaining();
+      pcu_fit_buffer(&pending, size);
+      if (size)
+        memcpy(pending.start, PCU_Comm_Extract(size), size);
+    }
+  }
+  if (self == leader) {
+    if (pending.size)
+      pcu_write(&out, pending.start, pending.size);
+    fclose(out.f);
+  }
+  pcu_free_buffer(&pending);
+}
+
+static void read_stream(pcu_file* in, size_t* offsets, int i,
+    pcu_buffer* b)
+{
+  size_t size = offsets[i + 1] - offsets[i];
+  pcu_fit_buffer(b, size);
+  if (size)
+    pcu_read(in, b->start, size);
+}
+
+/* the leader sends each rank of its group its stream */
+static void read_aggregate(pcu_file* pf)
+{
+  int self = PCU_Comm_Self();
+  int leader = group_leader(pf->group_size);
+  int ranks = group_ranks(pf->group_size);
+  pcu_file in;
+  size_t* offsets = NULL;
+  pcu_buffer next;
+  pcu_make_buffer(&next);
+  if (self == leader) {
+    FILE* f = fopen(pf->path, "r");
+    if (!f)
+      reel_fail("pcu: could not open \"%s\" for reading", pf->path);
+    wrap_file(&in, f, false);
+    unsigned header[4];
+    pcu_read_unsigneds(&in, header, 4);
+    if (header[0] != aggregate_magic || header[1] != aggregate_version)
+      reel_fail("pcu: \"%s\" is not an aggregated file", pf->path);
+    if (header[2] != (unsigned)leader || header[3] != (unsigned)ranks)
+      reel_fail("pcu: \"%s\" holds ranks %u to %u, but this group"
+          " is ranks %d to %d", pf->path, header[2],
+          header[2] + header[3] - 1, leader, leader + ranks - 1);
+    offsets = noto_malloc((ranks + 1) * sizeof(size_t));
+    for (int i = 0; i <= ranks; ++i)
+      offsets[i] = read_offset(&in);
+    read_stream(&in, offsets, 0, &next);
+  }
+  pf->memory = NULL;
+  pf->memory_size = 0;
+  for (int i = 0; i < pf->group_size; ++i) {
+    PCU_Comm_Begin();
+    if (self == leader && i < ranks)
+      PCU_Comm_Pack(leader + i, next.start, next.size);
+    PCU_Comm_Send();
+    if (self == leader && i + 1 < ranks)
+      read_stream(&in, offsets, i + 1, &next);
+    while (PCU_Comm_Receive()) {
+      pf->memory_size = PCU_Comm_Remaining();
+      pf->memory = malloc(pf->memory_size);
+      if (pf->memory_size)
+        memcpy(pf->memory, PCU_Comm_Extract(pf->memory_size),
+            pf->memory_size);
+    }
+  }
+  if (self == leader) {
+    noto_free(offsets);
+    fclose(in.f);
+  }
+  pcu_free_buffer(&next);
+  if (!pf->memory_size)
+    reel_fail("pcu: rank %d has no stream in \"%s\"",
+        PCU_Comm_Self(), pf->path);
+}
+
+/** \brief collectively opens the aggregated file of this rank's group
+  \details ranks are grouped by group_size consecutive ranks, and all
+  ranks of a group give the same path. Each rank reads or writes
+  its own stream as if it had its own file, but only the first rank
+  of each group opens a file, when this is called for reading and
+  when pcu_fclose is called for writing, which is also collective.
+  The streams move to or from the leader in group_size phases, one
+  rank of each group per phase, so leaders hold two streams at most.
+  Reading needs the same number of ranks and group size as writing. */
+pcu_file* pcu_fopen_aggregate(const char* path, bool write, bool compress,
+    int group_size)
+{
+  if (group_size < 1)
+    reel_fail("pcu_fopen_aggregate: invalid group size %d", group_size);
+  pcu_file* pf = (pcu_file*) malloc(sizeof(pcu_file));
+  pf->compress = compress;
+  pf->write = write;
+  pf->group_size = group_size;
+  pf->path = malloc(strlen(path) + 1);
+  strcpy(pf->path, path);
+  if (write) {
+    pf->memory = NULL;
+    pf->memory_size = 0;
+    pf->f = open_memstream(&pf->memory, &pf->memory_size);
+  } else {
+    read_aggregate(pf);
+    pf->f = fmemopen(pf->memory, pf->memory_size, "r");
+  }
+  if (!pf->f)
+    reel_fail("pcu_fopen_aggregate: could not open a memory stream");
+  if (compress)
+    open_compressed(pf);
+  return pf;
+}
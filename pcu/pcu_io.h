@@ -11,6 +11,8 @@
 #define PCU_IO_H
 
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 #include <cstdio>
 extern "C" {
@@ -22,13 +24,21 @@ extern "C" {
 struct pcu_file;
 
 struct pcu_file* pcu_fopen(const char* path, bool write, bool compress);
+struct pcu_file* pcu_fopen_aggregate(const char* path, bool write,
+    bool compress, int group_size);
 void pcu_fclose (struct pcu_file * pf);
+void pcu_set_io_threads(int n);
+/* offsets in uncompressed, unaggregated files only */
+size_t pcu_ftell(struct pcu_file* f);
+void pcu_fseek(struct pcu_file* f, size_t offset);
 void pcu_read(struct pcu_file* f, char* p, size_t n);
 void pcu_write(struct pcu_file* f, const char* p, size_t n);
 void pcu_read_unsigneds(struct pcu_file* f, unsigned* p, size_t n);
 #define PCU_READ_UNSIGNED(f,p) pcu_read_unsigneds(f,&(p),1);
 void pcu_write_unsigneds(struct pcu_file* f, unsigned* p, size_t n);
 #define PCU_WRITE_UNSIGNED(f,p) pcu_write_unsigneds(f,&(p),1);
+void pcu_read_uint64s(struct pcu_file* f, uint64_t* p, size_t n);
+void pcu_write_uint64s(struct pcu_file* f, uint64_t* p, size_t n);
 void pcu_read_doubles(struct pcu_file* f, double* p, size_t n);
 void pcu_write_doubles(struct pcu_file* f, double* p, size_t n);
 void pcu_read_string(struct pcu_file* f, char** p);
@@ -39,6 +49,7 @@ FILE* pcu_group_open(const char* path, bool write);
 
 void pcu_swap_doubles(double* p, size_t n);
 void pcu_swap_unsigneds(unsigned* p, size_t n);
+void pcu_swap_uint64s(uint64_t* p, size_t n);
 
 #ifdef __cplusplus
 } /* extern "C" */
@@ -42,6 +42,13 @@ int pcu_mpi_rank(void)
   return global_mpi->rank();
 }
 
+/* ranks r with the same r / pcu_mpi_node_size() share a node,
+   a node size of one means nothing is known about the layout */
+int pcu_mpi_node_size(void)
+{
+  return global_mpi->node_size();
+}
+
 static void check_rank(int rank)
 {
   (void)rank;
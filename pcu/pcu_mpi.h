@@ -27,6 +27,7 @@ typedef struct
 {
   int (*size)(void);
   int (*rank)(void);
+  int (*node_size)(void);
   void (*send)(pcu_message* m, MPI_Comm comm);
   bool (*done)(pcu_message* m);
   bool (*receive)(pcu_message* m, MPI_Comm comm);
@@ -36,6 +37,7 @@ void pcu_set_mpi(pcu_mpi* m);
 pcu_mpi* pcu_get_mpi(void);
 int pcu_mpi_size(void);
 int pcu_mpi_rank(void);
+int pcu_mpi_node_size(void);
 void pcu_mpi_send(pcu_message* m, MPI_Comm comm);
 bool pcu_mpi_done(pcu_message* m);
 bool pcu_mpi_receive(pcu_message* m, MPI_Comm comm);
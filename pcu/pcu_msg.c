@@ -9,9 +9,11 @@
 *******************************************************************************/
 #include "pcu_msg.h"
 #include "pcu_pmpi.h"
+#include "PCU.h"
 #include "noto_malloc.h"
 #include "reel.h"
 #include <string.h>
+#include <stdint.h>
 
 /* the pcu_msg algorithm for a communication phase
    is as follows:
@@ -50,6 +52,30 @@
    If another rank is notified first and quickly goes on to
    a new phase, it may be able to send a message that is
    received by the slow rank out-of-phase.
+
+   When the user declares a fixed set of neighbors, a neighbor
+   phase replaces the algorithm above with:
+
+1  barrier, only if the last phase was global
+2  pack data to be sent, only to neighbors
+3  requests = send one message to each neighbor, even if empty
+4  receive one message from each neighbor, in order per neighbor
+5  while (requests not done)
+6    wait
+
+   Each rank knows how many messages it will receive, so there
+   is no termination detection and no barrier.
+   Receiving from specific neighbors keeps phases apart:
+   a neighbor cannot finish phase k and send its phase k+1 message
+   until this rank has received its phase k message, and messages
+   from one sender are received in the order they were sent.
+   Line 1 is still needed after a global phase, whose receives
+   accept messages from any rank.
+
+   When a codec is set, buffers of at least the threshold size
+   are compressed just before line 3 and every received buffer is
+   restored before it is given to the user, so the algorithm
+   itself does not change.
 */
 
 //enumeration for pcu_msg.state
@@ -60,31 +86,153 @@ enum {
   recv_state //sends are done, still receiving
 };
 
-static void make_comm(pcu_msg* m)
+/* ranks up to this many get a dense peer index,
+   costing this many ints per messenger */
+#define DENSE_PEERS (1<<14)
+
+static void make_peers(pcu_msg_peers* t)
 {
-  pcu_make_aa(&(m->peers));
-  pcu_make_message(&(m->received));
-  m->state = idle_state;
+  t->messages = NULL;
+  t->count = 0;
+  t->capacity = 0;
+  t->index = NULL;
+  t->index_size = 0;
+  t->dense = false;
+  t->last = -1;
 }
 
-void pcu_make_msg(pcu_msg* m)
+static void fill_index(pcu_msg_peers* t)
 {
-  make_comm(m);
-  m->file = NULL;
-  m->order = NULL;
+  for (int i = 0; i < t->index_size; ++i)
+    t->index[i] = -1;
 }
 
-static void free_peers(pcu_aa_tree* t)
+static void make_index(pcu_msg_peers* t, int size, bool dense)
 {
-  if (pcu_aa_empty(*t))
-    return;
-  free_peers(&((*t)->left));
-  free_peers(&((*t)->right));
-  pcu_msg_peer* peer;
-  peer = (pcu_msg_peer*) *t;
-  pcu_free_message(&(peer->message));
-  noto_free(peer);
-  pcu_make_aa(t);
+  noto_free(t->index);
+  t->index_size = size;
+  t->dense = dense;
+  NOTO_MALLOC(t->index,size);
+  fill_index(t);
+}
+
+/* called at the start of each phase, since the
+   number of ranks can change in between phases */
+static void fit_index(pcu_msg_peers* t)
+{
+  int ranks = pcu_mpi_size();
+  if (ranks <= DENSE_PEERS) {
+    if (!(t->dense && t->index_size == ranks))
+      make_index(t, ranks, true);
+  } else if (t->dense || !t->index) {
+    make_index(t, 16, false);
+  }
+}
+
+static int hash_slot(pcu_msg_peers* t, int id)
+{
+  return (int)(((unsigned)id * 2654435761u) & (unsigned)(t->index_size - 1));
+}
+
+/* returns the index slot of peer id, which
+   is empty if id has not been packed to */
+static int find_slot(pcu_msg_peers* t, int id)
+{
+  if (t->dense)
+    return id;
+  int slot = hash_slot(t, id);
+  while (t->index[slot] != -1 && t->messages[t->index[slot]].peer != id)
+    slot = (slot + 1) & (t->index_size - 1);
+  return slot;
+}
+
+static void grow_hash(pcu_msg_peers* t)
+{
+  make_index(t, t->index_size * 2, false);
+  for (int i = 0; i < t->count; ++i)
+    t->index[find_slot(t, t->messages[i].peer)] = i;
+}
+
+static pcu_message* find_peer(pcu_msg_peers* t, int id)
+{
+  if (t->last != -1 && t->messages[t->last].peer == id)
+    return t->messages + t->last;
+  int at = t->index[find_slot(t, id)];
+  if (at == -1)
+    return NULL;
+  t->last = at;
+  return t->messages + at;
+}
+
+static pcu_message* add_peer(pcu_msg_peers* t, int id)
+{
+  if (t->count == t->capacity) {
+    t->capacity = (t->capacity + 4) * 2;
+    t->messages = noto_realloc(t->messages,
+        t->capacity * sizeof(pcu_message));
+  }
+  if (!t->dense && (t->count + 1) * 2 > t->index_size)
+    grow_hash(t);
+  int at = t->count++;
+  pcu_message* peer = t->messages + at;
+  pcu_make_message(peer);
+  peer->peer = id;
+  t->index[find_slot(t, id)] = at;
+  t->last = at;
+  return peer;
+}
+
+/* pools this phase's buffers, keeping the index for the next phase */
+static void clear_peers(pcu_msg_peers* t, pcu_pool* pool)
+{
+  for (int i = 0; i < t->count; ++i) {
+    pcu_message* peer = t->messages + i;
+    if (t->dense)
+      t->index[peer->peer] = -1;
+    pcu_pool_give(pool, &(peer->buffer));
+  }
+  if (!t->dense && t->count)
+    fill_index(t);
+  t->count = 0;
+  t->last = -1;
+}
+
+static void free_peers(pcu_msg_peers* t, pcu_pool* pool)
+{
+  clear_peers(t, pool);
+  noto_free(t->messages);
+  noto_free(t->index);
+  make_peers(t);
+}
+
+static void make_neighbors(pcu_msg_neighbors* n)
+{
+  n->ranks = NULL;
+  n->count = 0;
+  n->received = NULL;
+  n->pending = 0;
+}
+
+static void free_neighbors(pcu_msg_neighbors* n)
+{
+  noto_free(n->ranks);
+  noto_free(n->received);
+  make_neighbors(n);
+}
+
+void pcu_make_msg(pcu_msg* m)
+{
+  make_peers(&(m->peers));
+  pcu_make_message(&(m->received));
+  m->state = idle_state;
+  make_neighbors(&(m->neighbors));
+  m->after_global = false;
+  m->codec = NULL;
+  m->threshold = 0;
+  m->prof = NULL;
+  pcu_make_pool(&(m->pool));
+  m->file = NULL;
+  m->order = NULL;
 }
 
 void pcu_msg_start(pcu_msg* m)
@@ -94,83 +242,202 @@ void pcu_msg_start(pcu_msg* m)
   /* this barrier ensures no one starts a new superstep
      while others are receiving in the past superstep.
      It is the only blocking call in the pcu_msg system. */
-  pcu_barrier(&(m->coll));
+  pcu_msg_neighbors* n = &(m->neighbors);
+  if (m->prof)
+    pcu_prof_begin(m->prof);
+  if (!n->ranks || m->after_global) {
+    if (m->prof)
+      pcu_prof_wait(m->prof);
+    pcu_barrier(&(m->coll));
+    if (m->prof)
+      pcu_prof_waited(m->prof);
+  }
+  m->after_global = !n->ranks;
+  fit_index(&(m->peers));
+  if (n->ranks) {
+    for (int i = 0; i < n->count; ++i) {
+      add_peer(&(m->peers),n->ranks[i]);
+      n->received[i] = false;
+    }
+    n->pending = n->count;
+  }
   m->state = pack_state;
 }
 
-static bool peer_less(pcu_aa_node* a, pcu_aa_node* b)
-{
-  return ((pcu_msg_peer*)a)->message.peer
-       < ((pcu_msg_peer*)b)->message.peer;
-}
-
-static pcu_msg_peer* find_peer(pcu_aa_tree t, int id)
+/* declares the neighbors of this rank, which must be
+   symmetric over all ranks. One global phase checks this. */
+void pcu_msg_set_neighbors(pcu_msg* m, const int* ranks, int count)
 {
-  pcu_msg_peer key;
-  key.message.peer = id;
-  return (pcu_msg_peer*) pcu_aa_find(&(key.node),t,peer_less);
+  if (m->state != idle_state)
+    reel_fail("PCU_Comm_Neighbors called at the wrong time");
+  pcu_msg_clear_neighbors(m);
+  pcu_msg_start(m);
+  for (int i = 0; i < count; ++i)
+    pcu_msg_pack(m,ranks[i],0);
+  pcu_msg_send(m);
+  int senders = 0;
+  while (pcu_msg_receive(m)) {
+    int from = pcu_msg_received_from(m);
+    int i;
+    for (i = 0; i < count; ++i)
+      if (ranks[i] == from)
+        break;
+    if (i == count)
+      reel_fail("PCU_Comm_Neighbors: rank %d is a neighbor of %d"
+                " but not the other way around",
+                pcu_mpi_rank(), from);
+    ++senders;
+  }
+  if (senders != count)
+    reel_fail("PCU_Comm_Neighbors: rank %d has repeated neighbors or"
+              " neighbors that do not list it back", pcu_mpi_rank());
+  pcu_msg_neighbors* n = &(m->neighbors);
+  n->count = count;
+  NOTO_MALLOC(n->ranks,count);
+  NOTO_MALLOC(n->received,count);
+  for (int i = 0; i < count; ++i)
+    n->ranks[i] = ranks[i];
+  /* a non-NULL rank array marks neighbor phases, even with no neighbors */
+  if (!n->ranks)
+    NOTO_MALLOC(n->ranks,1);
 }
 
-static pcu_msg_peer* make_peer(int id)
+void pcu_msg_clear_neighbors(pcu_msg* m)
 {
-  pcu_msg_peer* p;
-  NOTO_MALLOC(p,1);
-  pcu_make_message(&(p->message));
-  p->message.peer = id;
-  return p;
+  if (m->state != idle_state)
+    reel_fail("PCU_Comm_Neighbors called at the wrong time");
+  free_neighbors(&(m->neighbors));
 }
 
 void* pcu_msg_pack(pcu_msg* m, int id, size_t size)
 {
   if (m->state != pack_state)
     reel_fail("PCU_Comm_Pack called at the wrong time");
-  pcu_msg_peer* peer = find_peer(m->peers,id);
-  if (!peer)
-  {
-    peer = make_peer(id);
-    pcu_aa_insert(&(peer->node),&(m->peers),peer_less);
+  pcu_message* peer = find_peer(&(m->peers),id);
+  if (!peer) {
+    if (m->neighbors.ranks)
+      reel_fail("PCU_Comm_Pack to rank %d, which is not a neighbor", id);
+    peer = add_peer(&(m->peers),id);
   }
-  return pcu_push_buffer(&(peer->message.buffer),size);
+  return pcu_push_pooled(&(m->pool),&(peer->buffer),size);
 }
 
 size_t pcu_msg_packed(pcu_msg* m, int id)
 {
   if (m->state != pack_state)
     reel_fail("PCU_Comm_Packed called at the wrong time");
-  pcu_msg_peer* peer = find_peer(m->peers,id);
+  pcu_message* peer = find_peer(&(m->peers),id);
   if (!peer)
     reel_fail("PCU_Comm_Packed called but nothing was packed");
-  return peer->message.buffer.size;
+  return peer->buffer.size;
+}
+
+void pcu_msg_compress(pcu_msg* m,
+    const struct pcu_codec_struct* codec, size_t threshold)
+{
+  if (m->state != idle_state)
+    reel_fail("PCU_Comm_Compress called at the wrong time");
+  m->codec = codec;
+  m->threshold = threshold;
 }
 
-static void send_peers(pcu_aa_tree t)
+/* while a codec is set, every buffer sent ends in this trailer,
+   even small or empty ones, so the receiver can tell how to restore it.
+   Appending it does not move the packed data. */
+typedef struct
 {
-  if (pcu_aa_empty(t))
+  uint64_t size; //buffer size before compression
+  uint64_t compressed; //nonzero if the rest of the buffer is compressed
+} trailer;
+
+static void compress_buffer(pcu_msg* m, pcu_buffer* b)
+{
+  const PCU_Codec* codec = m->codec;
+  trailer t;
+  t.size = b->size;
+  t.compressed = 0;
+  if (b->size && b->size >= m->threshold) {
+    size_t bound = codec->bound(b->size);
+    pcu_buffer c;
+    pcu_pool_take(&(m->pool), &c, bound + sizeof(t));
+    size_t size = codec->compress(c.start, bound, b->start, b->size);
+    if (size && size < b->size) {
+      c.size = size;
+      pcu_pool_give(&(m->pool), b);
+      *b = c;
+      t.compressed = 1;
+    } else {
+      pcu_pool_give(&(m->pool), &c);
+    }
+  }
+  memcpy(pcu_push_pooled(&(m->pool), b, sizeof(t)), &t, sizeof(t));
+}
+
+/* strips the trailer off the received buffer, replacing
+   it by its decompressed contents if needed */
+static void decompress_received(pcu_msg* m)
+{
+  pcu_buffer* b = &(m->received.buffer);
+  trailer t;
+  if (b->capacity < sizeof(t))
+    reel_fail("PCU received a message without a compression trailer");
+  b->capacity -= sizeof(t);
+  b->size = b->capacity;
+  memcpy(&t, b->start + b->capacity, sizeof(t));
+  if (!t.compressed)
     return;
-  pcu_msg_peer* peer;
-  peer = (pcu_msg_peer*)t;
-  pcu_mpi_send(&(peer->message),pcu_user_comm);
-  send_peers(t->left);
-  send_peers(t->right);
+  pcu_buffer d;
+  pcu_pool_take(&(m->pool), &d, t.size);
+  size_t size = m->codec->decompress(d.start, t.size,
+      b->start, b->capacity);
+  if (size != t.size)
+    reel_fail("PCU could not decompress a message from rank %d",
+        m->received.peer);
+  pcu_pool_give(&(m->pool), b);
+  d.size = d.capacity = t.size;
+  *b = d;
+}
+
+static void profile_packed(pcu_msg* m)
+{
+  size_t bytes = 0;
+  size_t max_bytes = 0;
+  int peers = 0;
+  for (int i = 0; i < m->peers.count; ++i) {
+    size_t size = m->peers.messages[i].buffer.size;
+    bytes += size;
+    if (size > max_bytes)
+      max_bytes = size;
+    if (size) {
+      ++peers;
+      pcu_prof_peer(m->prof, m->peers.messages[i].peer, size);
+    }
+  }
+  pcu_prof_packed(m->prof, peers, bytes, max_bytes);
 }
 
 void pcu_msg_send(pcu_msg* m)
 {
   if (m->state != pack_state)
     reel_fail("PCU_Comm_Send called at the wrong time");
-  send_peers(m->peers);
+  if (m->prof)
+    profile_packed(m);
+  if (m->codec)
+    for (int i = 0; i < m->peers.count; ++i)
+      compress_buffer(m, &(m->peers.messages[i].buffer));
+  for (int i = 0; i < m->peers.count; ++i)
+    pcu_mpi_send(m->peers.messages + i,pcu_user_comm);
+  if (m->prof)
+    pcu_prof_sent(m->prof);
   m->state = send_recv_state;
 }
 
-static bool done_sending_peers(pcu_aa_tree t)
+static bool done_sending_peers(pcu_msg_peers* t)
 {
-  if (pcu_aa_empty(t))
-    return true;
-  pcu_msg_peer* peer;
-  peer = (pcu_msg_peer*)t;
-  return pcu_mpi_done(&(peer->message))
-    && done_sending_peers(t->left)
-    && done_sending_peers(t->right);
+  for (int i = 0; i < t->count; ++i)
+    if (!pcu_mpi_done(t->messages + i))
+      return false;
+  return true;
 }
 
 static bool receive_global(pcu_msg* m)
@@ -179,22 +446,45 @@ static bool receive_global(pcu_msg* m)
   while ( ! pcu_mpi_receive(&(m->received),pcu_user_comm))
   {
     if (m->state == send_recv_state)
-      if (done_sending_peers(m->peers))
+      if (done_sending_peers(&(m->peers)))
       {
+        if (m->prof)
+          pcu_prof_wait(m->prof);
         pcu_begin_barrier(&(m->coll));
         m->state = recv_state;
       }
     if (m->state == recv_state)
       if (pcu_barrier_done(&(m->coll)))
+      {
+        if (m->prof)
+          pcu_prof_waited(m->prof);
         return false;
+      }
   }
   return true;
 }
 
-static void free_comm(pcu_msg* m)
+/* empty messages from neighbors only mean nothing was packed,
+   so they are not handed to the user */
+static bool receive_neighbors(pcu_msg* m)
 {
-  free_peers(&(m->peers));
-  pcu_free_message(&(m->received));
+  pcu_msg_neighbors* n = &(m->neighbors);
+  while (n->pending)
+    for (int i = 0; i < n->count; ++i) {
+      if (n->received[i])
+        continue;
+      m->received.peer = n->ranks[i];
+      if ( ! pcu_mpi_receive(&(m->received),pcu_user_comm))
+        continue;
+      n->received[i] = true;
+      --(n->pending);
+      if (m->codec)
+        decompress_received(m);
+      if (m->received.buffer.capacity)
+        return true;
+    }
+  while ( ! done_sending_peers(&(m->peers)));
+  return false;
 }
 
 bool pcu_msg_receive(pcu_msg* m)
@@ -204,14 +494,25 @@ bool pcu_msg_receive(pcu_msg* m)
     reel_fail("PCU_Comm_Receive called at the wrong time");
   if ( ! pcu_msg_unpacked(m))
     reel_fail("PCU_Comm_Receive called before previous message unpacked");
-  if (receive_global(m))
+  bool received;
+  if (m->neighbors.ranks)
+    received = receive_neighbors(m);
+  else {
+    received = receive_global(m);
+    if (received && m->codec)
+      decompress_received(m);
+  }
+  if (received)
   {
     pcu_begin_buffer(&(m->received.buffer));
     return true;
   }
   m->state = idle_state;
-  free_comm(m);
-  make_comm(m);
+  if (m->prof)
+    pcu_prof_end(m->prof);
+  /* the last received buffer is kept, fully unpacked,
+     for the next phase to receive into */
+  clear_peers(&(m->peers),&(m->pool));
   return false;
 }
 
@@ -235,9 +536,19 @@ size_t pcu_msg_received_size(pcu_msg* m)
   return m->received.buffer.capacity;
 }
 
+size_t pcu_msg_remaining(pcu_msg* m)
+{
+  return m->received.buffer.capacity - m->received.buffer.size;
+}
+
 void pcu_free_msg(pcu_msg* m)
 {
-  free_comm(m);
+  free_peers(&(m->peers),&(m->pool));
+  free_neighbors(&(m->neighbors));
+  pcu_free_message(&(m->received));
+  pcu_free_pool(&(m->pool));
+  if (m->prof)
+    pcu_prof_free(m->prof);
   if (m->file)
     fclose(m->file);
 }
@@ -11,30 +11,60 @@
 #define PCU_MSG_H
 
 #include "pcu_coll.h"
-#include "pcu_aa.h"
 #include "pcu_io.h"
+#include "pcu_prof.h"
 
 /* the PCU Messenger (pcu_msg for short) system implements
    a non-blocking Bulk Synchronous Parallel communication model
    it is based on PCU non-blocking Collectives and pcu_mpi,
    so it also works in hybrid mode */
 
-/* a structure containing all data to be sent to a peer during
-   this communication phase. */
+/* the send buffers of a communication phase, indexed by peer.
+   Buffers are stored contiguously in the order their peers were
+   first packed to.
+   With few ranks the index is a dense array from rank to position,
+   otherwise it is an open-addressed hash table with linear probing.
+   Packing usually hits the same peer many times in a row, so the
+   last peer found is checked before the index. */
 typedef struct
 {
-  pcu_aa_node node; //binary tree node for lookup
-  pcu_message message; //send buffer and peer id
-} pcu_msg_peer;
+  pcu_message* messages; //send buffers and peer ids
+  int count; //number of peers this phase
+  int capacity; //allocated size of messages
+  int* index; //slot -> position in messages, -1 if empty
+  int index_size; //number of ranks if dense, else a power of two
+  bool dense; //index is a dense rank array, not a hash table
+  int last; //position of the last peer found, -1 if none
+} pcu_msg_peers;
+
+/* a fixed set of neighbors declared by the user.
+   While it is set, phases are neighbor phases: every rank
+   sends exactly one (possibly empty) message to each neighbor
+   and receives exactly one from each, so no termination
+   detection is needed. */
+typedef struct
+{
+  int* ranks; //neighbor ranks, NULL for global phases
+  int count; //number of neighbors
+  bool* received; //neighbors received from this phase
+  int pending; //neighbors not yet received from this phase
+} pcu_msg_neighbors;
 
 struct pcu_order_struct;
+struct pcu_codec_struct;
 
 struct pcu_msg_struct
 {
-  pcu_aa_tree peers; //binary tree of send buffers
+  pcu_msg_peers peers; //send buffers by peer
+  pcu_pool pool; //buffer memory reused across phases
   pcu_message received; //current received buffer
   pcu_coll coll; //collective operation object
   int state; //state within a communication phase
+  pcu_msg_neighbors neighbors; //fixed neighborhood, if any
+  bool after_global; //last phase was a global phase
+  const struct pcu_codec_struct* codec; //compresses large buffers, if set
+  size_t threshold; //smallest buffer size to compress
+  pcu_prof* prof; //records phase costs, if set
   /* below this point are variables that just need
      to be thread-specific but have been tacked onto
      pcu_msg. if this gets out of hand, create a
@@ -46,6 +76,10 @@ typedef struct pcu_msg_struct pcu_msg;
 
 void pcu_make_msg(pcu_msg* m);
 void pcu_msg_start(pcu_msg* b);
+void pcu_msg_set_neighbors(pcu_msg* m, const int* ranks, int count);
+void pcu_msg_clear_neighbors(pcu_msg* m);
+void pcu_msg_compress(pcu_msg* m,
+    const struct pcu_codec_struct* codec, size_t threshold);
 void* pcu_msg_pack(pcu_msg* m, int id, size_t size);
 #define PCU_MSG_PACK(m,id,o) \
 memcpy(pcu_msg_pack(m,id,sizeof(o)),&(o),sizeof(o))
@@ -58,6 +92,7 @@ memcpy(&(o),pcu_msg_unpack(m,sizeof(o)),sizeof(o))
 bool pcu_msg_unpacked(pcu_msg* m);
 int pcu_msg_received_from(pcu_msg* m);
 size_t pcu_msg_received_size(pcu_msg* m);
+size_t pcu_msg_remaining(pcu_msg* m);
 void pcu_free_msg(pcu_msg* m);
 
 #endif //PCU_MSG_H
@@ -44,33 +44,37 @@ pcu_order pcu_order_new(void)
   return o;
 }
 
-static void free_message(struct message* m)
+/* buffers go back to the messenger's pool if there is one */
+static void free_message(struct message* m, pcu_pool* pool)
 {
-  pcu_free_buffer(&m->buf);
+  if (pool)
+    pcu_pool_give(pool, &m->buf);
+  else
+    pcu_free_buffer(&m->buf);
   noto_free(m);
 }
 
-static void free_messages(pcu_aa_tree* t)
+static void free_messages(pcu_aa_tree* t, pcu_pool* pool)
 {
   if (pcu_aa_empty(*t))
     return;
-  free_messages(&((*t)->left));
-  free_messages(&((*t)->right));
+  free_messages(&((*t)->left), pool);
+  free_messages(&((*t)->right), pool);
   struct message* m;
   m = (struct message*) *t;
-  free_message(m);
+  free_message(m, pool);
   pcu_make_aa(t);
 }
 
-static void dtor_order(pcu_order o)
+static void dtor_order(pcu_order o, pcu_pool* pool)
 {
-  free_messages(&o->tree);
+  free_messages(&o->tree, pool);
   noto_free(o->array);
 }
 
 void pcu_order_free(pcu_order o)
 {
-  dtor_order(o);
+  dtor_order(o, NULL);
   noto_free(o);
 }
 
@@ -80,7 +84,10 @@ static struct message* take_message(pcu_msg* t)
   NOTO_MALLOC(m,1);
   m->from = t->received.peer;
   m->buf = t->received.buffer; /* steal the buffer */
-  pcu_make_buffer(&t->received.buffer);
+  /* and receive the next one into pooled memory of similar size,
+     which has nothing left to unpack yet */
+  pcu_pool_take(&t->pool, &t->received.buffer, m->buf.capacity);
+  t->received.buffer.size = t->received.buffer.capacity;
   return m;
 }
 
@@ -123,7 +130,7 @@ bool pcu_order_receive(pcu_order o, pcu_msg* m)
     prepare(o, m);
   o->at++;
   if (o->at == o->count) {
-    dtor_order(o);
+    dtor_order(o, &m->pool);
     init_order(o);
     return false;
   }
@@ -154,3 +161,8 @@ size_t pcu_order_received_size(pcu_order o)
   return o->array[o->at]->buf.capacity;
 }
 
+size_t pcu_order_remaining(pcu_order o)
+{
+  pcu_buffer* b = &o->array[o->at]->buf;
+  return b->capacity - b->size;
+}
@@ -22,5 +22,6 @@ void* pcu_order_unpack(pcu_order o, size_t size);
 bool pcu_order_unpacked(pcu_order o);
 int pcu_order_received_from(pcu_order o);
 size_t pcu_order_received_size(pcu_order o);
+size_t pcu_order_remaining(pcu_order o);
 
 #endif
@@ -15,6 +15,7 @@
 
 static int global_size;
 static int global_rank;
+static int global_node_size;
 
 MPI_Comm original_comm;
 MPI_Comm pcu_user_comm;
@@ -23,10 +24,35 @@ MPI_Comm pcu_coll_comm;
 pcu_mpi pcu_pmpi =
 { .size = pcu_pmpi_size,
   .rank = pcu_pmpi_rank,
+  .node_size = pcu_pmpi_node_size,
   .send = pcu_pmpi_send,
   .done = pcu_pmpi_done,
   .receive = pcu_pmpi_receive };
 
+/* the collectives can use the shared-memory nodes if they
+   are blocks of consecutive ranks, all of the same size except
+   maybe the last one. Otherwise the layout is ignored. */
+static int find_node_size(MPI_Comm comm)
+{
+  MPI_Comm node;
+  MPI_Comm_split_type(comm,MPI_COMM_TYPE_SHARED,global_rank,
+      MPI_INFO_NULL,&node);
+  int node_rank, node_size;
+  MPI_Comm_rank(node,&node_rank);
+  MPI_Comm_size(node,&node_size);
+  int first;
+  MPI_Allreduce(&global_rank,&first,1,MPI_INT,MPI_MIN,node);
+  MPI_Comm_free(&node);
+  int size;
+  MPI_Allreduce(&node_size,&size,1,MPI_INT,MPI_MAX,comm);
+  int last_size = global_size - first < size ? global_size - first : size;
+  int blocked = (node_rank == global_rank - first) &&
+                (first % size == 0) &&
+                (node_size == last_size);
+  MPI_Allreduce(MPI_IN_PLACE,&blocked,1,MPI_INT,MPI_LAND,comm);
+  return blocked ? size : 1;
+}
+
 void pcu_pmpi_init(MPI_Comm comm)
 {
   original_comm = comm;
@@ -34,6 +60,7 @@ void pcu_pmpi_init(MPI_Comm comm)
   MPI_Comm_dup(comm,&pcu_coll_comm);
   MPI_Comm_size(comm,&global_size);
   MPI_Comm_rank(comm,&global_rank);
+  global_node_size = find_node_size(comm);
 }
 
 void pcu_pmpi_finalize(void)
@@ -52,6 +79,11 @@ int pcu_pmpi_rank(void)
   return global_rank;
 }
 
+int pcu_pmpi_node_size(void)
+{
+  return global_node_size;
+}
+
 void pcu_pmpi_send(pcu_message* m, MPI_Comm comm)
 {
   pcu_pmpi_send2(m,0,comm);
@@ -95,7 +127,7 @@ bool pcu_pmpi_receive2(pcu_message* m, int tag, MPI_Comm comm)
   m->peer = status.MPI_SOURCE;
   int count;
   MPI_Get_count(&status,MPI_BYTE,&count);
-  pcu_resize_buffer(&(m->buffer),(size_t)count);
+  pcu_fit_buffer(&(m->buffer),(size_t)count);
   MPI_Recv(
       m->buffer.start,
       (int)(m->buffer.size),
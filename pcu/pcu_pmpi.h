@@ -18,6 +18,7 @@ void pcu_pmpi_init(MPI_Comm comm);
 void pcu_pmpi_finalize(void);
 int  pcu_pmpi_size(void);
 int  pcu_pmpi_rank(void);
+int  pcu_pmpi_node_size(void);
 void pcu_pmpi_send(pcu_message* m, MPI_Comm comm);
 bool pcu_pmpi_receive(pcu_message* m, MPI_Comm comm);
 void pcu_pmpi_send2(pcu_message* m, int tag, MPI_Comm comm);
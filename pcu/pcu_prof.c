@@ -0,0 +1,380 @@
+/******************************************************************************
+
+  Copyright 2011 Scientific Computation Research Center,
+      Rensselaer Polytechnic Institute. All rights reserved.
+
+  This work is open source software, licensed under the terms of the
+  BSD license as described in the LICENSE file in the top-level directory.
+
+*******************************************************************************/
+#include "pcu_prof.h"
+#include "pcu_buffer.h"
+#include "noto_malloc.h"
+#include "reel.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+pcu_prof* pcu_prof_new(const char* prefix)
+{
+  pcu_prof* p;
+  NOTO_MALLOC(p,1);
+  p->phases = NULL;
+  p->count = 0;
+  p->capacity = 0;
+  NOTO_MALLOC(p->prefix,strlen(prefix) + 1);
+  strcpy(p->prefix,prefix);
+  p->file = NULL;
+  p->line = 0;
+  p->origin = MPI_Wtime();
+  p->mark = p->origin;
+  p->barrier_mark = 0;
+  p->waiting = p->origin;
+  p->links = NULL;
+  p->link_count = 0;
+  return p;
+}
+
+void pcu_prof_free(pcu_prof* p)
+{
+  noto_free(p->phases);
+  noto_free(p->links);
+  noto_free(p->prefix);
+  noto_free(p);
+}
+
+void pcu_prof_site(pcu_prof* p, const char* file, int line)
+{
+  p->file = file;
+  p->line = line;
+}
+
+static pcu_prof_phase* current(pcu_prof* p)
+{
+  return p->phases + p->count - 1;
+}
+
+void pcu_prof_begin(pcu_prof* p)
+{
+  if (p->count == p->capacity) {
+    p->capacity = (p->capacity + 16) * 2;
+    p->phases = noto_realloc(p->phases,
+        p->capacity * sizeof(pcu_prof_phase));
+  }
+  pcu_prof_phase* r = p->phases + p->count++;
+  memset(r, 0, sizeof(*r));
+  r->file = p->file;
+  r->line = p->line;
+  p->file = NULL;
+  p->mark = MPI_Wtime();
+  p->barrier_mark = 0;
+  r->start = p->mark - p->origin;
+}
+
+void pcu_prof_wait(pcu_prof* p)
+{
+  p->waiting = MPI_Wtime();
+}
+
+void pcu_prof_waited(pcu_prof* p)
+{
+  current(p)->barrier += MPI_Wtime() - p->waiting;
+}
+
+/* time since the last event, other than barrier waits */
+static double lap(pcu_prof* p)
+{
+  pcu_prof_phase* r = current(p);
+  double now = MPI_Wtime();
+  double t = now - p->mark - (r->barrier - p->barrier_mark);
+  p->mark = now;
+  p->barrier_mark = r->barrier;
+  return t;
+}
+
+void pcu_prof_packed(pcu_prof* p, int peers, size_t bytes, size_t max_bytes)
+{
+  pcu_prof_phase* r = current(p);
+  r->pack = lap(p);
+  r->peers = peers;
+  r->bytes = bytes;
+  r->max_bytes = max_bytes;
+}
+
+void pcu_prof_peer(pcu_prof* p, int peer, size_t bytes)
+{
+  if (peer >= p->link_count) {
+    int count = (peer + 1) * 2;
+    p->links = noto_realloc(p->links, count * sizeof(pcu_prof_link));
+    memset(p->links + p->link_count, 0,
+        (count - p->link_count) * sizeof(pcu_prof_link));
+    p->link_count = count;
+  }
+  ++(p->links[peer].messages);
+  p->links[peer].bytes += bytes;
+}
+
+void pcu_prof_sent(pcu_prof* p)
+{
+  current(p)->send = lap(p);
+}
+
+void pcu_prof_end(pcu_prof* p)
+{
+  current(p)->receive = lap(p);
+}
+
+static const char* site_name(const char* file)
+{
+  if (!file)
+    return "unknown";
+  const char* slash = strrchr(file, '/');
+  return slash ? slash + 1 : file;
+}
+
+static void print_line(pcu_buffer* b, const char* format, ...)
+{
+  char line[512];
+  va_list ap;
+  va_start(ap, format);
+  int n = vsnprintf(line, sizeof(line), format, ap);
+  va_end(ap);
+  if (n < 0)
+    return;
+  if ((size_t)n >= sizeof(line))
+    n = sizeof(line) - 1;
+  memcpy(pcu_push_buffer(b, n), line, n);
+}
+
+/* every rank writes its part of one file, ordered by rank,
+   with collective MPI-IO. The bytes go in blocks so that the
+   counts given to MPI fit in an int. */
+static void write_ranks(MPI_Comm comm, const char* name, pcu_buffer* b)
+{
+  enum { block = 1 << 20 };
+  MPI_File f;
+  if (MPI_File_open(comm, name, MPI_MODE_WRONLY | MPI_MODE_CREATE,
+        MPI_INFO_NULL, &f) != MPI_SUCCESS)
+    reel_fail("PCU profiler could not open %s", name);
+  MPI_File_set_size(f, 0);
+  long long size = b->size;
+  long long offset = 0;
+  MPI_Exscan(&size, &offset, 1, MPI_LONG_LONG, MPI_SUM, comm);
+  int rank;
+  MPI_Comm_rank(comm, &rank);
+  if (!rank)
+    offset = 0;
+  MPI_Datatype type;
+  MPI_Type_contiguous(block, MPI_BYTE, &type);
+  MPI_Type_commit(&type);
+  size_t blocks = b->size / block;
+  size_t rest = b->size % block;
+  MPI_File_write_at_all(f, (MPI_Offset)offset, b->start, (int)blocks,
+      type, MPI_STATUS_IGNORE);
+  MPI_File_write_at_all(f, (MPI_Offset)(offset + blocks * block),
+      (char*)b->start + blocks * block, (int)rest, MPI_BYTE,
+      MPI_STATUS_IGNORE);
+  MPI_Type_free(&type);
+  MPI_File_close(&f);
+}
+
+static void write_timeline(pcu_prof* p, MPI_Comm comm, int rank)
+{
+  pcu_buffer b;
+  pcu_make_buffer(&b);
+  if (!rank)
+    print_line(&b, "rank,phase,site,line,start,pack,send,receive,"
+        "barrier,peers,bytes,max_peer_bytes\n");
+  for (int i = 0; i < p->count; ++i) {
+    pcu_prof_phase* r = p->phases + i;
+    print_line(&b, "%d,%d,%s,%d,%.9f,%.9f,%.9f,%.9f,%.9f,%d,%lu,%lu\n",
+        rank, i, site_name(r->file), r->line, r->start,
+        r->pack, r->send, r->receive, r->barrier, r->peers,
+        (unsigned long)r->bytes, (unsigned long)r->max_bytes);
+  }
+  char name[1024];
+  snprintf(name, sizeof(name), "%s.csv", p->prefix);
+  write_ranks(comm, name, &b);
+  pcu_free_buffer(&b);
+}
+
+/* one row for each peer a rank sent to, over all phases */
+static void write_links(pcu_prof* p, MPI_Comm comm, int rank)
+{
+  pcu_buffer b;
+  pcu_make_buffer(&b);
+  if (!rank)
+    print_line(&b, "rank,peer,messages,bytes\n");
+  for (int i = 0; i < p->link_count; ++i)
+    if (p->links[i].messages)
+      print_line(&b, "%d,%d,%lu,%lu\n", rank, i,
+          (unsigned long)p->links[i].messages,
+          (unsigned long)p->links[i].bytes);
+  char name[1024];
+  snprintf(name, sizeof(name), "%s_peers.csv", p->prefix);
+  write_ranks(comm, name, &b);
+  pcu_free_buffer(&b);
+}
+
+/* totals over the phases started at one call site */
+typedef struct
+{
+  const char* file;
+  int line;
+  int phases;
+  double pack; //sums over phases of the most any rank spent
+  double send;
+  double receive;
+  double barrier;
+  double imbalance; //sum over phases of the spread of barrier waits
+  double bytes; //over all ranks
+} site;
+
+static double site_time(const site* s)
+{
+  return s->pack + s->send + s->receive + s->barrier;
+}
+
+static int compare_sites(const void* a, const void* b)
+{
+  double ta = site_time(a);
+  double tb = site_time(b);
+  return (ta < tb) - (ta > tb);
+}
+
+enum { max_pack, max_send, max_receive, max_barrier, min_barrier, maxes };
+
+/* totals over the peers of all ranks */
+typedef struct
+{
+  double messages;
+  double links; //pairs of ranks that exchanged messages
+  struct { double bytes; int rank; } busiest; //the link with most bytes
+} traffic;
+
+static void write_sites(pcu_prof* p, site* sites, int count, int phases,
+    traffic* t)
+{
+  char name[1024];
+  snprintf(name, sizeof(name), "%s_summary.csv", p->prefix);
+  FILE* f = fopen(name, "w");
+  if (!f)
+    reel_fail("PCU profiler could not open %s", name);
+  fprintf(f, "site,line,phases,pack,send,receive,barrier,"
+      "barrier_imbalance,bytes\n");
+  for (int i = 0; i < count; ++i)
+    fprintf(f, "%s,%d,%d,%.9f,%.9f,%.9f,%.9f,%.9f,%.0f\n",
+        site_name(sites[i].file), sites[i].line, sites[i].phases,
+        sites[i].pack, sites[i].send, sites[i].receive,
+        sites[i].barrier, sites[i].imbalance, sites[i].bytes);
+  fclose(f);
+  printf("PCU profile: %d phases from %d call sites,"
+         " see %s.csv, %s_peers.csv and %s\n", phases, count,
+         p->prefix, p->prefix, name);
+  printf("%.0f messages over %.0f links, the busiest sending"
+         " %.3f MB from rank %d\n", t->messages, t->links,
+         t->busiest.bytes / (1024 * 1024), t->busiest.rank);
+  printf("%-32s %7s %10s %10s %10s %10s %10s %10s\n", "site", "phases",
+      "pack", "send", "receive", "barrier", "imbalance", "MB");
+  for (int i = 0; i < count && i < 10; ++i) {
+    char label[64];
+    snprintf(label, sizeof(label), "%s:%d",
+        site_name(sites[i].file), sites[i].line);
+    printf("%-32s %7d %10.6f %10.6f %10.6f %10.6f %10.6f %10.3f\n",
+        label, sites[i].phases, sites[i].pack, sites[i].send,
+        sites[i].receive, sites[i].barrier, sites[i].imbalance,
+        sites[i].bytes / (1024 * 1024));
+  }
+}
+
+/* phases are collective, so phase i is the same phase on
+   all ranks, and rank 0 can name them by its own call sites */
+static void count_traffic(pcu_prof* p, MPI_Comm comm, int rank,
+    traffic* t)
+{
+  double counts[2] = {0, 0};
+  t->busiest.bytes = 0;
+  t->busiest.rank = rank;
+  for (int i = 0; i < p->link_count; ++i)
+    if (p->links[i].messages) {
+      counts[0] += p->links[i].messages;
+      counts[1] += 1;
+      if (p->links[i].bytes > t->busiest.bytes)
+        t->busiest.bytes = p->links[i].bytes;
+    }
+  MPI_Allreduce(MPI_IN_PLACE, counts, 2, MPI_DOUBLE, MPI_SUM, comm);
+  MPI_Allreduce(MPI_IN_PLACE, &(t->busiest), 1, MPI_DOUBLE_INT,
+      MPI_MAXLOC, comm);
+  t->messages = counts[0];
+  t->links = counts[1];
+}
+
+static void write_summary(pcu_prof* p, MPI_Comm comm, int rank)
+{
+  traffic t;
+  count_traffic(p, comm, rank, &t);
+  int n;
+  MPI_Allreduce(&(p->count), &n, 1, MPI_INT, MPI_MIN, comm);
+  double* local;
+  NOTO_MALLOC(local, (maxes + 1) * n);
+  for (int i = 0; i < n; ++i) {
+    pcu_prof_phase* r = p->phases + i;
+    double* v = local + maxes * i;
+    v[max_pack] = r->pack;
+    v[max_send] = r->send;
+    v[max_receive] = r->receive;
+    v[max_barrier] = r->barrier;
+    v[min_barrier] = -r->barrier;
+    local[maxes * n + i] = r->bytes;
+  }
+  double* global = NULL;
+  if (!rank)
+    NOTO_MALLOC(global, (maxes + 1) * n);
+  MPI_Reduce(local, global, maxes * n, MPI_DOUBLE, MPI_MAX, 0, comm);
+  MPI_Reduce(local + maxes * n, global ? global + maxes * n : NULL,
+      n, MPI_DOUBLE, MPI_SUM, 0, comm);
+  noto_free(local);
+  if (rank)
+    return;
+  site* sites = NULL;
+  int count = 0;
+  for (int i = 0; i < n; ++i) {
+    pcu_prof_phase* r = p->phases + i;
+    int j;
+    for (j = 0; j < count; ++j)
+      if (sites[j].file == r->file && sites[j].line == r->line)
+        break;
+    if (j == count) {
+      sites = noto_realloc(sites, (count + 1) * sizeof(site));
+      memset(sites + count, 0, sizeof(site));
+      sites[count].file = r->file;
+      sites[count].line = r->line;
+      ++count;
+    }
+    double* v = global + maxes * i;
+    site* s = sites + j;
+    ++(s->phases);
+    s->pack += v[max_pack];
+    s->send += v[max_send];
+    s->receive += v[max_receive];
+    s->barrier += v[max_barrier];
+    s->imbalance += v[max_barrier] + v[min_barrier];
+    s->bytes += global[maxes * n + i];
+  }
+  qsort(sites, count, sizeof(site), compare_sites);
+  write_sites(p, sites, count, n, &t);
+  noto_free(sites);
+  noto_free(global);
+}
+
+/* collective over comm: writes the timeline of all ranks,
+   their messages to each peer and a summary by call site */
+void pcu_prof_write(pcu_prof* p, MPI_Comm comm)
+{
+  int rank;
+  MPI_Comm_rank(comm, &rank);
+  write_timeline(p, comm, rank);
+  write_links(p, comm, rank);
+  write_summary(p, comm, rank);
+}
@@ -0,0 +1,74 @@
+/******************************************************************************
+
+  Copyright 2011 Scientific Computation Research Center,
+      Rensselaer Polytechnic Institute. All rights reserved.
+
+  This work is open source software, licensed under the terms of the
+  BSD license as described in the LICENSE file in the top-level directory.
+
+*******************************************************************************/
+#ifndef PCU_PROF_H
+#define PCU_PROF_H
+
+#include <mpi.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* the PCU profiler (pcu_prof) records the cost of each
+   communication phase of a messenger. All times are in seconds,
+   and each phase is split into:
+     barrier: waiting in the barriers at its start and end
+     pack: from the first barrier to PCU_Comm_Send
+     send: in PCU_Comm_Send
+     receive: after PCU_Comm_Send, other than barrier waits */
+
+typedef struct
+{
+  const char* file; //call site of PCU_Comm_Begin, NULL if unknown
+  int line;
+  double start; //since profiling began
+  double pack;
+  double send;
+  double receive;
+  double barrier;
+  int peers; //ranks packed to
+  size_t bytes; //bytes packed to all peers
+  size_t max_bytes; //most bytes packed to one peer
+} pcu_prof_phase;
+
+/* the messages this rank sent to one peer over all phases */
+typedef struct
+{
+  size_t messages;
+  size_t bytes;
+} pcu_prof_link;
+
+typedef struct pcu_prof_struct
+{
+  pcu_prof_phase* phases;
+  int count;
+  int capacity;
+  char* prefix; //output file prefix
+  const char* file; //call site of the next phase
+  int line;
+  double origin; //time profiling began
+  double mark; //time of the last event in this phase
+  double barrier_mark; //barrier time of this phase at the mark
+  double waiting; //time a barrier wait began
+  pcu_prof_link* links; //indexed by peer rank
+  int link_count;
+} pcu_prof;
+
+pcu_prof* pcu_prof_new(const char* prefix);
+void pcu_prof_free(pcu_prof* p);
+void pcu_prof_site(pcu_prof* p, const char* file, int line);
+void pcu_prof_begin(pcu_prof* p);
+void pcu_prof_wait(pcu_prof* p);
+void pcu_prof_waited(pcu_prof* p);
+void pcu_prof_packed(pcu_prof* p, int peers, size_t bytes, size_t max_bytes);
+void pcu_prof_peer(pcu_prof* p, int peer, size_t bytes);
+void pcu_prof_sent(pcu_prof* p);
+void pcu_prof_end(pcu_prof* p);
+void pcu_prof_write(pcu_prof* p, MPI_Comm comm);
+
+#endif
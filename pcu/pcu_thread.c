@@ -0,0 +1,83 @@
+/******************************************************************************
+
+  Copyright 2011 Scientific Computation Research Center,
+      Rensselaer Polytechnic Institute. All rights reserved.
+
+  This work is open source software, licensed under the terms of the
+  BSD license as described in the LICENSE file in the top-level directory.
+
+*******************************************************************************/
+#include "pcu_thread.h"
+#include "noto_malloc.h"
+#include "reel.h"
+#include <pthread.h>
+
+static int global_size = 1;
+static bool global_running = false;
+static __thread int thread_rank = 0;
+
+typedef struct
+{
+  pcu_thread* function;
+  void* in_out;
+  int rank;
+} thread_start;
+
+static void* run_thread(void* in)
+{
+  thread_start* start = in;
+  thread_rank = start->rank;
+  start->in_out = start->function(start->in_out);
+  return NULL;
+}
+
+/* runs function on nthreads threads, the calling thread
+   becoming thread 0. in_out[i] is the argument to thread i
+   and is replaced by its return value. */
+void pcu_run_threads(int nthreads, pcu_thread* function, void** in_out)
+{
+  if (global_running)
+    reel_fail("nested calls to pcu_run_threads");
+  if (nthreads < 1)
+    reel_fail("pcu_run_threads needs at least one thread");
+  thread_start* starts;
+  NOTO_MALLOC(starts,nthreads);
+  pthread_t* threads;
+  NOTO_MALLOC(threads,nthreads);
+  for (int i = 0; i < nthreads; ++i) {
+    starts[i].function = function;
+    starts[i].in_out = in_out ? in_out[i] : NULL;
+    starts[i].rank = i;
+  }
+  global_size = nthreads;
+  global_running = true;
+  for (int i = 1; i < nthreads; ++i)
+    if (pthread_create(threads + i, NULL, run_thread, starts + i))
+      reel_fail("pthread_create failed");
+  run_thread(starts);
+  for (int i = 1; i < nthreads; ++i)
+    pthread_join(threads[i], NULL);
+  global_running = false;
+  global_size = 1;
+  thread_rank = 0;
+  if (in_out)
+    for (int i = 0; i < nthreads; ++i)
+      in_out[i] = starts[i].in_out;
+  noto_free(threads);
+  noto_free(starts);
+}
+
+bool pcu_threads_running(void)
+{
+  return global_running;
+}
+
+int pcu_thread_size(void)
+{
+  return global_size;
+}
+
+int pcu_thread_rank(void)
+{
+  return thread_rank;
+}
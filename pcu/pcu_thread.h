@@ -0,0 +1,28 @@
+/******************************************************************************
+
+  Copyright 2011 Scientific Computation Research Center,
+      Rensselaer Polytechnic Institute. All rights reserved.
+
+  This work is open source software, licensed under the terms of the
+  BSD license as described in the LICENSE file in the top-level directory.
+
+*******************************************************************************/
+#ifndef PCU_THREAD_H
+#define PCU_THREAD_H
+
+#include <stdbool.h>
+
+/* the PCU thread system (pcu_thread for short) runs a function
+   on a fixed number of POSIX threads per process and gives each
+   thread a process-local rank in thread-local storage.
+   Everything else about hybrid mode (message passing, collectives)
+   is built on pcu_tmpi, which only needs these ranks. */
+
+typedef void* pcu_thread(void*);
+
+void pcu_run_threads(int nthreads, pcu_thread* function, void** in_out);
+bool pcu_threads_running(void);
+int pcu_thread_size(void);
+int pcu_thread_rank(void);
+
+#endif
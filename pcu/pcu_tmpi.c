@@ -0,0 +1,257 @@
+/******************************************************************************
+
+  Copyright 2011 Scientific Computation Research Center,
+      Rensselaer Polytechnic Institute. All rights reserved.
+
+  This work is open source software, licensed under the terms of the
+  BSD license as described in the LICENSE file in the top-level directory.
+
+*******************************************************************************/
+#include "pcu_tmpi.h"
+#include "pcu_pmpi.h"
+#include "pcu_thread.h"
+#include "noto_malloc.h"
+#include "reel.h"
+#include <pthread.h>
+#include <string.h>
+#include <limits.h>
+
+/* messages to a thread of the same process are posted as
+   letters in its mailbox. The sender's message is not done
+   until the receiver has taken the letter out, which gives
+   the same guarantee as the MPI_Issend used between processes:
+   a completed send has been received. pcu_msg termination
+   detection depends on this. */
+
+/* the two MPI communicators PCU uses are kept apart by family */
+enum { user_family, coll_family, families };
+
+typedef struct
+{
+  pcu_message* message;
+  int from;
+  int family;
+} letter;
+
+typedef struct
+{
+  pthread_mutex_t mutex;
+  letter* letters;
+  int count;
+  int capacity;
+} mailbox;
+
+static int global_threads;
+static mailbox* global_boxes;
+/* between processes, each receiving thread gets its own duplicate
+   of each communicator and the MPI tag carries the sending thread,
+   so threads never probe or receive each other's messages */
+static MPI_Comm* global_comms[families];
+
+static int get_family(MPI_Comm comm)
+{
+  if (comm == pcu_coll_comm)
+    return coll_family;
+  return user_family;
+}
+
+static bool is_local(int rank)
+{
+  return rank / global_threads == pcu_pmpi_rank();
+}
+
+void pcu_tmpi_init(int nthreads)
+{
+  if (pcu_pmpi_size() > 1) {
+    int provided;
+    MPI_Query_thread(&provided);
+    if (provided < MPI_THREAD_MULTIPLE)
+      reel_fail("hybrid PCU needs MPI_Init_thread with MPI_THREAD_MULTIPLE");
+  }
+  global_threads = nthreads;
+  NOTO_MALLOC(global_boxes,nthreads);
+  for (int i = 0; i < nthreads; ++i) {
+    mailbox* b = global_boxes + i;
+    pthread_mutex_init(&b->mutex, NULL);
+    b->letters = NULL;
+    b->count = b->capacity = 0;
+  }
+  for (int f = 0; f < families; ++f) {
+    MPI_Comm comm = (f == coll_family) ? pcu_coll_comm : pcu_user_comm;
+    NOTO_MALLOC(global_comms[f],nthreads);
+    for (int i = 0; i < nthreads; ++i)
+      MPI_Comm_dup(comm, global_comms[f] + i);
+  }
+}
+
+void pcu_tmpi_finalize(void)
+{
+  for (int f = 0; f < families; ++f) {
+    for (int i = 0; i < global_threads; ++i)
+      MPI_Comm_free(global_comms[f] + i);
+    noto_free(global_comms[f]);
+  }
+  for (int i = 0; i < global_threads; ++i) {
+    mailbox* b = global_boxes + i;
+    if (b->count)
+      reel_fail("PCU thread %d has %d unreceived messages", i, b->count);
+    pthread_mutex_destroy(&b->mutex);
+    noto_free(b->letters);
+  }
+  noto_free(global_boxes);
+}
+
+int pcu_tmpi_size(void)
+{
+  return pcu_pmpi_size() * global_threads;
+}
+
+int pcu_tmpi_rank(void)
+{
+  return pcu_pmpi_rank() * global_threads + pcu_thread_rank();
+}
+
+/* the threads of the processes of a node share it */
+int pcu_tmpi_node_size(void)
+{
+  return pcu_pmpi_node_size() * global_threads;
+}
+
+static void post(mailbox* b, pcu_message* m, int family)
+{
+  pthread_mutex_lock(&b->mutex);
+  if (b->count == b->capacity) {
+    b->capacity = (b->capacity + 4) * 2;
+    b->letters = noto_realloc(b->letters, b->capacity * sizeof(letter));
+  }
+  letter* l = b->letters + b->count++;
+  l->message = m;
+  l->from = pcu_tmpi_rank();
+  l->family = family;
+  pthread_mutex_unlock(&b->mutex);
+}
+
+void pcu_tmpi_send(pcu_message* m, MPI_Comm comm)
+{
+  int family = get_family(comm);
+  int thread = m->peer % global_threads;
+  if (is_local(m->peer)) {
+    post(global_boxes + thread, m, family);
+    return;
+  }
+  if (m->buffer.size > (size_t)INT_MAX)
+    reel_fail("PCU message size exceeds INT_MAX");
+  MPI_Issend(
+      m->buffer.start,
+      (int)(m->buffer.size),
+      MPI_BYTE,
+      m->peer / global_threads,
+      pcu_thread_rank(),
+      global_comms[family][thread],
+      &(m->request));
+}
+
+static bool was_taken(mailbox* b, pcu_message* m)
+{
+  bool taken = true;
+  pthread_mutex_lock(&b->mutex);
+  for (int i = 0; i < b->count; ++i)
+    if (b->letters[i].message == m)
+      taken = false;
+  pthread_mutex_unlock(&b->mutex);
+  return taken;
+}
+
+bool pcu_tmpi_done(pcu_message* m)
+{
+  if (is_local(m->peer))
+    return was_taken(global_boxes + m->peer % global_threads, m);
+  int flag;
+  MPI_Test(&(m->request),&flag,MPI_STATUS_IGNORE);
+  return flag;
+}
+
+/* user messages own their buffers, so the receiver can swap
+   its buffer with the sender's instead of copying, and the sender
+   pools the receiver's old memory at the end of the phase.
+   Collective messages point to caller data and have to be copied. */
+static void hand_off(pcu_message* to, pcu_message* from, int family)
+{
+  if (family == user_family) {
+    pcu_buffer old = to->buffer;
+    to->buffer = from->buffer;
+    to->buffer.capacity = to->buffer.size;
+    from->buffer = old;
+    from->buffer.size = 0;
+  } else {
+    pcu_resize_buffer(&to->buffer, from->buffer.size);
+    if (from->buffer.size)
+      memcpy(to->buffer.start, from->buffer.start, from->buffer.size);
+  }
+}
+
+static bool take(mailbox* b, pcu_message* m, int family)
+{
+  bool found = false;
+  pthread_mutex_lock(&b->mutex);
+  for (int i = 0; i < b->count; ++i) {
+    letter* l = b->letters + i;
+    if (l->family != family)
+      continue;
+    if (m->peer != MPI_ANY_SOURCE && m->peer != l->from)
+      continue;
+    hand_off(m, l->message, family);
+    m->peer = l->from;
+    memmove(l, l + 1, (b->count - i - 1) * sizeof(letter));
+    --b->count;
+    found = true;
+    break;
+  }
+  pthread_mutex_unlock(&b->mutex);
+  return found;
+}
+
+bool pcu_tmpi_receive(pcu_message* m, MPI_Comm comm)
+{
+  int family = get_family(comm);
+  int thread = pcu_thread_rank();
+  if (take(global_boxes + thread, m, family))
+    return true;
+  if (pcu_pmpi_size() == 1)
+    return false;
+  int source = MPI_ANY_SOURCE;
+  int tag = MPI_ANY_TAG;
+  if (m->peer != MPI_ANY_SOURCE) {
+    if (is_local(m->peer))
+      return false;
+    source = m->peer / global_threads;
+    tag = m->peer % global_threads;
+  }
+  MPI_Comm thread_comm = global_comms[family][thread];
+  MPI_Status status;
+  int flag;
+  MPI_Iprobe(source,tag,thread_comm,&flag,&status);
+  if (!flag)
+    return false;
+  m->peer = status.MPI_SOURCE * global_threads + status.MPI_TAG;
+  int count;
+  MPI_Get_count(&status,MPI_BYTE,&count);
+  pcu_fit_buffer(&(m->buffer),(size_t)count);
+  MPI_Recv(
+      m->buffer.start,
+      count,
+      MPI_BYTE,
+      status.MPI_SOURCE,
+      status.MPI_TAG,
+      thread_comm,
+      MPI_STATUS_IGNORE);
+  return true;
+}
+
+pcu_mpi pcu_tmpi =
+{ .size = pcu_tmpi_size,
+  .rank = pcu_tmpi_rank,
+  .node_size = pcu_tmpi_node_size,
+  .send = pcu_tmpi_send,
+  .done = pcu_tmpi_done,
+  .receive = pcu_tmpi_receive };
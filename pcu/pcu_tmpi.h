@@ -0,0 +1,33 @@
+/******************************************************************************
+
+  Copyright 2011 Scientific Computation Research Center,
+      Rensselaer Polytechnic Institute. All rights reserved.
+
+  This work is open source software, licensed under the terms of the
+  BSD license as described in the LICENSE file in the top-level directory.
+
+*******************************************************************************/
+#ifndef PCU_TMPI_H
+#define PCU_TMPI_H
+
+#include "pcu_mpi.h"
+
+/* pcu_tmpi is the hybrid (MPI + threads) implementation of pcu_mpi.
+   Each thread of each process is a rank, and ranks are contiguous
+   within a process: thread t of process p is rank p*T+t.
+   Messages between threads of the same process are handed off
+   in memory, and only messages between processes go through MPI,
+   which must then have been initialized with MPI_THREAD_MULTIPLE. */
+
+void pcu_tmpi_init(int nthreads);
+void pcu_tmpi_finalize(void);
+int pcu_tmpi_size(void);
+int pcu_tmpi_rank(void);
+int pcu_tmpi_node_size(void);
+void pcu_tmpi_send(pcu_message* m, MPI_Comm comm);
+bool pcu_tmpi_done(pcu_message* m);
+bool pcu_tmpi_receive(pcu_message* m, MPI_Comm comm);
+
+extern pcu_mpi pcu_tmpi;
+
+#endif
@@ -35,13 +35,17 @@ include_directories("${PROJECT_BINARY_DIR}")
 set(SOURCES
    pcu.c
    pcu_aa.c
+  pcu_blocks.c
    pcu_coll.c
    pcu_io.c
    pcu_buffer.c
    pcu_mpi.c
    pcu_msg.c
    pcu_order.c
+   pcu_prof.c
    pcu_pmpi.c
+   pcu_thread.c
+   pcu_tmpi.c
    pcu_util.c
    noto/noto_malloc.c
    reel/reel.c
@@ -59,6 +63,9 @@ tribits_add_library(
    HEADERS ${HEADERS}
    SOURCES ${SOURCES})
 
+find_package(Threads REQUIRED)
+target_link_libraries(pcu ${CMAKE_THREAD_LIBS_INIT})
+
 if (PCU_COMPRESS)
   include_directories(${BZIP_INCLUDE_DIR})
   target_link_libraries(pcu ${BZIP2_LIBRARIES})
@@ -389,6 +389,37 @@ void ghost_sendEntities(Ghosting* plan, int entDim,
 
 #include "apfNumbering.h"
 #include "apfShape.h"
+// *********************************************************
+static void unfreezeFields(pMesh m, std::vector<apf::Field*>& frozen_fields,
+    std::vector<apf::Field*>& dense_fields)
+// *********************************************************
+{
+  // ghosting moves field data as tags, so array and dense fields
+  // go back to tags and remember which storage to return to
+  for (int i=0; i<m->countFields(); ++i)
+  {
+    pField f = m->getField(i);
+    if (apf::isDense(f))
+      dense_fields.push_back(f);
+    else if (apf::isFrozen(f))
+      frozen_fields.push_back(f);
+    else
+      continue;
+    apf::unfreeze(f);
+  }
+}
+
+// *********************************************************
+static void refreezeFields(std::vector<apf::Field*>& frozen_fields,
+    std::vector<apf::Field*>& dense_fields)
+// *********************************************************
+{
+  for (size_t i=0; i<frozen_fields.size(); ++i)
+    apf::freeze(frozen_fields[i]);
+  for (size_t i=0; i<dense_fields.size(); ++i)
+    apf::makeDense(dense_fields[i]);
+}
+
 // *********************************************************
 void pumi_ghost_create(pMesh m, Ghosting* plan)
 // *********************************************************
@@ -397,15 +428,8 @@ void pumi_ghost_create(pMesh m, Ghosting* plan)
  
   std::vector<apf::Field*> fields;
   std::vector<apf::Field*> frozen_fields;
-  for (int i=0; i<m->countFields(); ++i)
-  {
-    pField f = m->getField(i);
-    if (isFrozen(f))
-    {
-      frozen_fields.push_back(f); // turn field data from tag to array
-      apf::unfreeze(f);
-    }
-  }
+  std::vector<apf::Field*> dense_fields;
+  unfreezeFields(m, frozen_fields, dense_fields);
 
   double t0=PCU_Time();
 
@@ -432,8 +456,7 @@ void pumi_ghost_create(pMesh m, Ghosting* plan)
   // apf::freeze creates a new local numbering. 
   // local numbering has to be deleted after mesh modification and before freezing the field
   while (m->countNumberings()) destroyNumbering(m->getNumbering(0));
-  for (std::vector<apf::Field*>::iterator fit=frozen_fields.begin(); fit!=frozen_fields.end(); ++fit)
-    apf::freeze(*fit);    
+  refreezeFields(frozen_fields, dense_fields);
 
   if (!PCU_Comm_Self())
     printf("mesh ghosted in %f seconds\n", PCU_Time()-t0);
@@ -853,15 +876,8 @@ void pumi_ghost_delete (pMesh m)
   if (!tag) return;
 
   std::vector<apf::Field*> frozen_fields;
-  for (int i=0; i<m->countFields(); ++i)
-  {
-    pField f = m->getField(i);
-    if (isFrozen(f))
-    {
-      frozen_fields.push_back(f); // turn field data from tag to array
-      apf::unfreeze(f);
-    }
-  }
+  std::vector<apf::Field*> dense_fields;
+  unfreezeFields(m, frozen_fields, dense_fields);
 
   for (int d=3; d>=0; --d)
   {
@@ -896,8 +912,7 @@ void pumi_ghost_delete (pMesh m)
   // apf::freeze creates a new local numbering. 
   // local numbering has to be deleted after mesh modification and before freezing the field
   while (m->countNumberings()) destroyNumbering(m->getNumbering(0));
-  for (std::vector<apf::Field*>::iterator fit=frozen_fields.begin(); fit!=frozen_fields.end(); ++fit)
-    apf::freeze(*fit);    
+  refreezeFields(frozen_fields, dense_fields);
 }
 
 // *********************************************************
@@ -0,0 +1,143 @@
+#include <ma.h>
+#include <maShape.h>
+#include <gmi_mesh.h>
+#include <apfMDS.h>
+#include <apfBox.h>
+#include <apfMesh2.h>
+#include <apf.h>
+#include <PCU.h>
+#include <pcu_util.h>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+
+/* refines a box around a plane front and coarsens it near the
+   sides with and without incremental marking passes, and checks
+   that both give the same mesh with less work. In parallel the
+   collapses migrate the mesh, so the worklist has to follow those
+   migrations. */
+
+class Front : public ma::IsotropicFunction
+{
+  public:
+    Front(ma::Mesh* m, double h):mesh(m),background(h) {}
+    virtual double getValue(ma::Entity* v)
+    {
+      ma::Vector x = ma::getPosition(mesh, v);
+      double d = std::fabs(x[0] - 0.5);
+      if (d < 0.05)
+        return background / 2;
+      if (d > 0.35)
+        return background * 3;
+      return background;
+    }
+  private:
+    ma::Mesh* mesh;
+    double background;
+};
+
+static ma::Mesh* makeMesh(int n)
+{
+  ma::Mesh* m = apf::makeMdsBox(n, n, n, 1, 1, 1, true);
+  if (PCU_Comm_Self())
+    apf::clear(m);
+  apf::Migration* plan = new apf::Migration(m);
+  if (!PCU_Comm_Self()) {
+    apf::MeshIterator* it = m->begin(3);
+    apf::MeshEntity* e;
+    while ((e = m->iterate(it))) {
+      double y = apf::getLinearCentroid(m, e)[1];
+      plan->send(e, int(y * PCU_Comm_Peers()));
+    }
+    m->end(it);
+  }
+  m->migrate(plan);
+  return m;
+}
+
+struct Result
+{
+  long elements;
+  double worst;
+  double time;
+  unsigned long examined;
+};
+
+/* sums the examined column of a profile over all its phases */
+static unsigned long sumExamined(const char* filename)
+{
+  FILE* f = fopen(filename, "r");
+  PCU_ALWAYS_ASSERT(f);
+  char line[1024];
+  PCU_ALWAYS_ASSERT(fgets(line, sizeof(line), f));
+  PCU_ALWAYS_ASSERT(!strncmp(line, "phase,iteration,time_min", 24));
+  unsigned long sum = 0;
+  unsigned long examined;
+  while (fgets(line, sizeof(line), f)) {
+    int fields = sscanf(line, "%*[^,],%*d,%*f,%*f,%*f,%*u,%*u,%lu",
+        &examined);
+    PCU_ALWAYS_ASSERT(fields == 1);
+    sum += examined;
+  }
+  fclose(f);
+  return sum;
+}
+
+static Result run(int n, bool incremental)
+{
+  ma::Mesh* m = makeMesh(n);
+  Front sf(m, 1.5 / n);
+  ma::Input* in = ma::configure(m, &sf);
+  in->shouldAdaptIncrementally = incremental;
+  const char* profile = incremental ?
+    "ma_incremental_worklist.csv" : "ma_incremental_full.csv";
+  in->profileFile = profile;
+  double t0 = PCU_Time();
+  ma::adapt(in);
+  Result r;
+  r.time = PCU_Max_Double(PCU_Time() - t0);
+  r.examined = 0;
+  if (!PCU_Comm_Self())
+    r.examined = sumExamined(profile);
+  m->verify();
+  PCU_ALWAYS_ASSERT(!m->findTag("ma_worklist"));
+  r.elements = PCU_Add_Long(m->count(3));
+  ma::SizeField* f = ma::makeSizeField(m, &sf);
+  r.worst = 1;
+  apf::MeshIterator* it = m->begin(3);
+  apf::MeshEntity* e;
+  while ((e = m->iterate(it)))
+    r.worst = std::min(r.worst, ma::measureElementQuality(m, f, e));
+  m->end(it);
+  r.worst = PCU_Min_Double(r.worst);
+  delete f;
+  m->destroyNative();
+  apf::destroyMesh(m);
+  return r;
+}
+
+int main(int argc, char** argv)
+{
+  MPI_Init(&argc,&argv);
+  PCU_Comm_Init();
+  gmi_register_mesh();
+  int n = 12;
+  if (argc > 1)
+    n = atoi(argv[1]);
+  Result full = run(n, false);
+  Result incremental = run(n, true);
+  if (!PCU_Comm_Self()) {
+    printf("full passes: %ld tets, %lu examined in %f s\n",
+        full.elements, full.examined, full.time);
+    printf("incremental: %ld tets, %lu examined in %f s (%.2f of full)\n",
+        incremental.elements, incremental.examined, incremental.time,
+        incremental.time / full.time);
+    /* the worklist has to save work, not just match the result */
+    PCU_ALWAYS_ASSERT(incremental.examined < full.examined);
+  }
+  PCU_ALWAYS_ASSERT(full.elements == incremental.elements);
+  PCU_ALWAYS_ASSERT(full.worst == incremental.worst);
+  PCU_Comm_Free();
+  MPI_Finalize();
+}
@@ -0,0 +1,128 @@
+#include <ma.h>
+#include <gmi_mesh.h>
+#include <apfMDS.h>
+#include <apfBox.h>
+#include <apfMesh2.h>
+#include <apf.h>
+#include <PCU.h>
+#include <pcu_util.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+/* adapts a box with profiling on and checks that the profile
+   has a row for each phase with consistent element counts.
+   Half of the box is coarsened, so the collapse CavityOps
+   must show up in the coarsen rows. */
+
+class Refined : public ma::IsotropicFunction
+{
+  public:
+    Refined(ma::Mesh* m, double h):mesh(m),background(h) {}
+    virtual double getValue(ma::Entity* v)
+    {
+      ma::Vector x = ma::getPosition(mesh, v);
+      if (x[0] < 0.5)
+        return background / 2;
+      return background * 4;
+    }
+  private:
+    ma::Mesh* mesh;
+    double background;
+};
+
+static ma::Mesh* makeMesh(int n)
+{
+  ma::Mesh* m = apf::makeMdsBox(n, n, n, 1, 1, 1, true);
+  if (PCU_Comm_Self())
+    apf::clear(m);
+  apf::Migration* plan = new apf::Migration(m);
+  if (!PCU_Comm_Self()) {
+    apf::MeshIterator* it = m->begin(3);
+    apf::MeshEntity* e;
+    while ((e = m->iterate(it))) {
+      double z = apf::getLinearCentroid(m, e)[2];
+      plan->send(e, int(z * PCU_Comm_Peers()));
+    }
+    m->end(it);
+  }
+  m->migrate(plan);
+  return m;
+}
+
+static void check(const char* filename, long initial, long final)
+{
+  FILE* f = fopen(filename, "r");
+  PCU_ALWAYS_ASSERT(f);
+  char line[1024];
+  PCU_ALWAYS_ASSERT(fgets(line, sizeof(line), f));
+  PCU_ALWAYS_ASSERT(!strncmp(line, "phase,iteration,time_min", 24));
+  long elements = initial;
+  int coarsens = 0;
+  int refines = 0;
+  unsigned long collapses = 0;
+  char phase[64];
+  int iteration;
+  double tmin, tmax, tavg;
+  unsigned long examinedMin, examinedMax, examined, applied;
+  long created;
+  unsigned long destroyed, rounds, pulls, migrated, migratedMax;
+  long after;
+  while (fgets(line, sizeof(line), f)) {
+    int fields = sscanf(line,
+        "%63[^,],%d,%lf,%lf,%lf,%lu,%lu,%lu,%lu,%ld,%lu,%lu,%lu,%lu,%lu,%ld",
+        phase, &iteration, &tmin, &tmax, &tavg,
+        &examinedMin, &examinedMax, &examined, &applied, &created,
+        &destroyed, &rounds, &pulls, &migrated, &migratedMax, &after);
+    PCU_ALWAYS_ASSERT(fields == 16);
+    PCU_ALWAYS_ASSERT(tmin <= tavg && tavg <= tmax);
+    PCU_ALWAYS_ASSERT(examinedMin <= examinedMax && examinedMax <= examined);
+    PCU_ALWAYS_ASSERT(migratedMax <= migrated);
+    PCU_ALWAYS_ASSERT(created >= 0);
+    /* the rows account for every element created or destroyed */
+    PCU_ALWAYS_ASSERT(after == elements + created - long(destroyed));
+    elements = after;
+    std::string name(phase);
+    if (name == "coarsen") {
+      PCU_ALWAYS_ASSERT(iteration >= 0);
+      PCU_ALWAYS_ASSERT(examined > 0);
+      PCU_ALWAYS_ASSERT(applied == 0 || rounds > 0);
+      collapses += applied;
+      ++coarsens;
+    }
+    if (name == "refine") {
+      PCU_ALWAYS_ASSERT(iteration >= 0);
+      PCU_ALWAYS_ASSERT(examined > 0);
+      ++refines;
+    }
+  }
+  fclose(f);
+  PCU_ALWAYS_ASSERT(elements == final);
+  PCU_ALWAYS_ASSERT(coarsens > 0 && coarsens == refines);
+  PCU_ALWAYS_ASSERT(collapses > 0);
+}
+
+int main(int argc, char** argv)
+{
+  MPI_Init(&argc,&argv);
+  PCU_Comm_Init();
+  gmi_register_mesh();
+  int n = 8;
+  if (argc > 1)
+    n = atoi(argv[1]);
+  ma::Mesh* m = makeMesh(n);
+  long initial = PCU_Add_Long(m->count(3));
+  Refined sf(m, 1.0 / n);
+  ma::Input* in = ma::configure(m, &sf);
+  in->profileFile = "ma_profile.csv";
+  ma::adapt(in);
+  m->verify();
+  long final = PCU_Add_Long(m->count(3));
+  if (!PCU_Comm_Self())
+    check("ma_profile.csv", initial, final);
+  m->destroyNative();
+  apf::destroyMesh(m);
+  PCU_Comm_Free();
+  MPI_Finalize();
+}
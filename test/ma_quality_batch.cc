@@ -0,0 +1,164 @@
+#include <ma.h>
+#include <maShape.h>
+#include <gmi_mesh.h>
+#include <apfMDS.h>
+#include <apfBox.h>
+#include <apfMesh2.h>
+#include <apfShape.h>
+#include <apf.h>
+#include <PCU.h>
+#include <pcu_util.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+/* checks the batch quality measures against the one-element ones
+   on a distorted box and compares their throughput */
+
+static void distort(ma::Mesh* m, int dim, double amount)
+{
+  std::mt19937 random(7);
+  std::uniform_real_distribution<double> offset(-amount, amount);
+  apf::MeshIterator* it = m->begin(dim);
+  apf::MeshEntity* e;
+  while ((e = m->iterate(it))) {
+    if (m->getModelType(m->toModel(e)) != 3)
+      continue;
+    ma::Vector x;
+    m->getPoint(e, 0, x);
+    m->setPoint(e, 0, x + ma::Vector(offset(random), offset(random),
+          offset(random)));
+  }
+  m->end(it);
+}
+
+static std::vector<ma::Entity*> getAll(ma::Mesh* m, int dim)
+{
+  std::vector<ma::Entity*> all;
+  apf::MeshIterator* it = m->begin(dim);
+  apf::MeshEntity* e;
+  while ((e = m->iterate(it)))
+    all.push_back(e);
+  m->end(it);
+  return all;
+}
+
+static void compare(std::vector<double> const& a, std::vector<double> const& b)
+{
+  PCU_ALWAYS_ASSERT(a.size() == b.size());
+  for (size_t i = 0; i < a.size(); ++i) {
+    PCU_ALWAYS_ASSERT((a[i] > 0) == (b[i] > 0));
+    PCU_ALWAYS_ASSERT(std::fabs(a[i] - b[i]) <= 1e-10 * std::fabs(a[i]));
+  }
+}
+
+static void report(const char* what, size_t n, double scalar, double batch)
+{
+  printf("%s: %lu elements, one at a time %f s, batched %f s (%.1fx)\n",
+      what, (unsigned long)n, scalar, batch, scalar / batch);
+}
+
+static void checkLinear(ma::Mesh* m, ma::SizeField* sf, int dim,
+    const char* what)
+{
+  std::vector<ma::Entity*> es = getAll(m, dim);
+  std::vector<double> scalar(es.size());
+  std::vector<double> batch(es.size());
+  double t0 = PCU_Time();
+  for (size_t i = 0; i < es.size(); ++i)
+    scalar[i] = ma::measureElementQuality(m, sf, es[i]);
+  double t1 = PCU_Time();
+  ma::measureElementQualities(m, sf, &es[0], es.size(), &batch[0]);
+  double t2 = PCU_Time();
+  compare(scalar, batch);
+  report(what, es.size(), t1 - t0, t2 - t1);
+}
+
+/* the kernel alone, on points already packed */
+static void checkKernel(ma::Mesh* m, int repeat)
+{
+  std::vector<ma::Entity*> tets = getAll(m, 3);
+  int n = tets.size();
+  std::vector<ma::Vector> points(4 * n);
+  std::vector<double> xyz(12 * n);
+  for (int e = 0; e < n; ++e) {
+    ma::getVertPoints(m, tets[e], &points[4 * e]);
+    for (int i = 0; i < 4; ++i)
+      for (int d = 0; d < 3; ++d)
+        xyz[(3 * i + d) * n + e] = points[4 * e + i][d];
+  }
+  std::vector<double> scalar(n);
+  std::vector<double> batch(n);
+  double t0 = PCU_Time();
+  for (int r = 0; r < repeat; ++r)
+    for (int e = 0; e < n; ++e)
+      scalar[e] = ma::measureLinearTetQuality(&points[4 * e]);
+  double t1 = PCU_Time();
+  for (int r = 0; r < repeat; ++r)
+    ma::measureLinearTetQualities(n, &xyz[0], 0, &batch[0]);
+  double t2 = PCU_Time();
+  compare(scalar, batch);
+  report("linear tet kernel", size_t(n) * repeat, t1 - t0, t2 - t1);
+}
+
+static void checkQuadratic(ma::Mesh* m)
+{
+  std::vector<ma::Entity*> tets = getAll(m, 3);
+  std::vector<double> scalar(tets.size());
+  std::vector<double> batch(tets.size());
+  double t0 = PCU_Time();
+  for (size_t i = 0; i < tets.size(); ++i)
+    scalar[i] = ma::measureQuadraticTetQuality(m, tets[i]);
+  double t1 = PCU_Time();
+  ma::measureQuadraticTetQualities(m, &tets[0], tets.size(), &batch[0]);
+  double t2 = PCU_Time();
+  compare(scalar, batch);
+  int invalid = 0;
+  for (size_t i = 0; i < batch.size(); ++i)
+    if (batch[i] <= 0)
+      ++invalid;
+  /* the distortion should leave some curved tets invalid */
+  PCU_ALWAYS_ASSERT(invalid > 0);
+  PCU_ALWAYS_ASSERT(invalid < int(batch.size()));
+  report("quadratic tets", tets.size(), t1 - t0, t2 - t1);
+}
+
+int main(int argc, char** argv)
+{
+  MPI_Init(&argc,&argv);
+  PCU_Comm_Init();
+  gmi_register_mesh();
+  int n = 10;
+  if (argc > 1)
+    n = atoi(argv[1]);
+  ma::Mesh* m = apf::makeMdsBox(n, n, n, 1, 1, 1, true);
+  distort(m, 0, 0.2 / n);
+  apf::Field* sizes = apf::createLagrangeField(m, "sizes", apf::VECTOR, 1);
+  apf::Field* frames = apf::createLagrangeField(m, "frames", apf::MATRIX, 1);
+  apf::MeshIterator* it = m->begin(0);
+  apf::MeshEntity* v;
+  while ((v = m->iterate(it))) {
+    ma::Vector x = ma::getPosition(m, v);
+    double a = x[2];
+    ma::Matrix r(cos(a),-sin(a),0,
+                 sin(a), cos(a),0,
+                 0,      0,     1);
+    apf::setVector(sizes, v, 0, ma::Vector(0.05 + 0.1 * x[0], 0.1, 0.2));
+    apf::setMatrix(frames, v, 0, r);
+  }
+  m->end(it);
+  ma::SizeField* sf = ma::makeSizeField(m, sizes, frames);
+  checkLinear(m, sf, 3, "tets");
+  checkLinear(m, sf, 2, "triangles");
+  delete sf;
+  checkKernel(m, 20);
+  apf::changeMeshShape(m, apf::getLagrange(2));
+  distort(m, 1, 0.4 / n);
+  checkQuadratic(m);
+  m->destroyNative();
+  apf::destroyMesh(m);
+  PCU_Comm_Free();
+  MPI_Finalize();
+}
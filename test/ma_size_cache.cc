@@ -0,0 +1,154 @@
+#include <ma.h>
+#include <gmi_mesh.h>
+#include <apfMDS.h>
+#include <apfBox.h>
+#include <apfMesh2.h>
+#include <apf.h>
+#include <PCU.h>
+#include <pcu_util.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+/* checks anisotropic metric lengths against integration over
+   mesh elements, then checks and times the edge length cache
+   on its own and during an adapt run */
+
+static void setSizes(ma::Mesh* m, apf::Field* sizes, apf::Field* frames)
+{
+  double c = cos(0.5);
+  double s = sin(0.5);
+  ma::Matrix r(c,-s,0,
+               s, c,0,
+               0, 0,1);
+  apf::MeshIterator* it = m->begin(0);
+  apf::MeshEntity* v;
+  while ((v = m->iterate(it))) {
+    ma::Vector x = ma::getPosition(m, v);
+    apf::setVector(sizes, v, 0, ma::Vector(0.05 + 0.2 * x[0], 0.1, 0.2));
+    apf::setMatrix(frames, v, 0, r);
+  }
+  m->end(it);
+}
+
+static double integrate(ma::Mesh* m, ma::SizeField* sf, apf::MeshEntity* e)
+{
+  apf::MeshElement* me = apf::createMeshElement(m, e);
+  int dim = apf::getDimension(me);
+  double sum = 0;
+  for (int p = 0; p < apf::countIntPoints(me, 2); ++p) {
+    ma::Vector xi;
+    apf::getIntPoint(me, 2, p, xi);
+    ma::Matrix Q;
+    sf->getTransform(me, xi, Q);
+    ma::Matrix J;
+    apf::getJacobian(me, xi, J);
+    sum += apf::getIntWeight(me, 2, p) *
+      apf::getJacobianDeterminant(J * Q, dim);
+  }
+  apf::destroyMeshElement(me);
+  return sum;
+}
+
+static void checkMeasures(ma::Mesh* m, ma::SizeField* sf)
+{
+  for (int d = 1; d <= 3; ++d) {
+    apf::MeshIterator* it = m->begin(d);
+    apf::MeshEntity* e;
+    while ((e = m->iterate(it))) {
+      double expected = integrate(m, sf, e);
+      PCU_ALWAYS_ASSERT(
+          std::fabs(sf->measure(e) - expected) < 1e-10 * std::fabs(expected));
+    }
+    m->end(it);
+  }
+}
+
+static double sumLengths(ma::Mesh* m, ma::SizeField* sf, double& t)
+{
+  double t0 = PCU_Time();
+  double sum = 0;
+  apf::MeshIterator* it = m->begin(1);
+  apf::MeshEntity* e;
+  while ((e = m->iterate(it)))
+    sum += sf->measure(e);
+  m->end(it);
+  t = PCU_Time() - t0;
+  return sum;
+}
+
+static void checkCache(ma::Mesh* m, ma::SizeField* sf, const char* name)
+{
+  checkMeasures(m, sf);
+  double uncached, filling, cached;
+  double expected = sumLengths(m, sf, uncached);
+  sf->cacheEdgeLengths(true);
+  PCU_ALWAYS_ASSERT(sumLengths(m, sf, filling) == expected);
+  PCU_ALWAYS_ASSERT(sumLengths(m, sf, cached) == expected);
+  printf("%s: edge lengths %f s, filling the cache %f s, cached %f s\n",
+      name, uncached, filling, cached);
+  /* moving a vertex must invalidate the lengths of its edges */
+  apf::MeshIterator* it = m->begin(0);
+  apf::MeshEntity* v;
+  while ((v = m->iterate(it)))
+    if (m->getModelType(m->toModel(v)) == 3)
+      break;
+  m->end(it);
+  PCU_ALWAYS_ASSERT(v);
+  ma::Vector x = ma::getPosition(m, v);
+  m->setPoint(v, 0, x + ma::Vector(0.01, 0.02, 0.03));
+  checkMeasures(m, sf);
+  m->setPoint(v, 0, x);
+  checkMeasures(m, sf);
+  sf->cacheEdgeLengths(false);
+  PCU_ALWAYS_ASSERT(!m->findTag("ma_edge_length"));
+}
+
+static double adaptBox(int n, bool cache, size_t& elements)
+{
+  ma::Mesh* m = apf::makeMdsBox(n, n, n, 1, 1, 1, true);
+  apf::Field* sizes = apf::createLagrangeField(m, "sizes", apf::VECTOR, 1);
+  apf::Field* frames = apf::createLagrangeField(m, "frames", apf::MATRIX, 1);
+  setSizes(m, sizes, frames);
+  ma::Input* in = ma::configure(m, sizes, frames);
+  in->shouldCacheEdgeLengths = cache;
+  double t0 = PCU_Time();
+  ma::adapt(in);
+  double t = PCU_Time() - t0;
+  PCU_ALWAYS_ASSERT(!m->findTag("ma_edge_length"));
+  m->verify();
+  elements = m->count(3);
+  m->destroyNative();
+  apf::destroyMesh(m);
+  return t;
+}
+
+int main(int argc, char** argv)
+{
+  MPI_Init(&argc,&argv);
+  PCU_Comm_Init();
+  gmi_register_mesh();
+  int n = 10;
+  if (argc > 1)
+    n = atoi(argv[1]);
+  ma::Mesh* m = apf::makeMdsBox(n, n, n, 1, 1, 1, true);
+  apf::Field* sizes = apf::createLagrangeField(m, "sizes", apf::VECTOR, 1);
+  apf::Field* frames = apf::createLagrangeField(m, "frames", apf::MATRIX, 1);
+  setSizes(m, sizes, frames);
+  ma::SizeField* sf = ma::makeSizeField(m, sizes, frames, true);
+  checkCache(m, sf, "log aniso");
+  delete sf;
+  /* this one takes ownership of the fields */
+  sf = ma::makeSizeField(m, sizes, frames);
+  checkCache(m, sf, "aniso");
+  delete sf;
+  m->destroyNative();
+  apf::destroyMesh(m);
+  size_t withCache, without;
+  double t1 = adaptBox(n / 2, true, withCache);
+  double t0 = adaptBox(n / 2, false, without);
+  PCU_ALWAYS_ASSERT(withCache == without);
+  printf("adapt: %f s without the length cache, %f s with it\n", t0, t1);
+  PCU_Comm_Free();
+  MPI_Finalize();
+}
@@ -0,0 +1,135 @@
+#include <ma.h>
+#include <maShape.h>
+#include <gmi_mesh.h>
+#include <apfMDS.h>
+#include <apfBox.h>
+#include <apfMesh2.h>
+#include <apf.h>
+#include <PCU.h>
+#include <pcu_util.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+/* coarsens most of a box with edge collapses applied on one and on
+   several threads, with and without incremental marking passes,
+   and checks that the threaded runs give valid meshes of the same
+   volume and about as many elements of similar quality. */
+
+class Coarse : public ma::IsotropicFunction
+{
+  public:
+    Coarse(ma::Mesh* m, double h):mesh(m),background(h) {}
+    virtual double getValue(ma::Entity* v)
+    {
+      ma::Vector x = ma::getPosition(mesh, v);
+      if (std::fabs(x[0] - 0.5) < 0.1)
+        return background;
+      return background * 3;
+    }
+  private:
+    ma::Mesh* mesh;
+    double background;
+};
+
+static ma::Mesh* makeMesh(int n)
+{
+  ma::Mesh* m = apf::makeMdsBox(n, n, n, 1, 1, 1, true);
+  if (PCU_Comm_Self())
+    apf::clear(m);
+  apf::Migration* plan = new apf::Migration(m);
+  if (!PCU_Comm_Self()) {
+    apf::MeshIterator* it = m->begin(3);
+    apf::MeshEntity* e;
+    while ((e = m->iterate(it))) {
+      double z = apf::getLinearCentroid(m, e)[2];
+      plan->send(e, int(z * PCU_Comm_Peers()));
+    }
+    m->end(it);
+  }
+  m->migrate(plan);
+  return m;
+}
+
+struct Result
+{
+  long elements;
+  double volume;
+  double worst;
+  double time;
+};
+
+static Result run(int n, int threads, bool incremental)
+{
+  ma::Mesh* m = makeMesh(n);
+  Coarse sf(m, 1.0 / n);
+  ma::Input* in = ma::configure(m, &sf);
+  in->workerThreads = threads;
+  in->shouldAdaptIncrementally = incremental;
+  double t0 = PCU_Time();
+  ma::adapt(in);
+  Result r;
+  r.time = PCU_Max_Double(PCU_Time() - t0);
+  m->verify();
+  PCU_ALWAYS_ASSERT(!m->findTag("ma_colors"));
+  PCU_ALWAYS_ASSERT(!m->findTag("ma_batch"));
+  PCU_ALWAYS_ASSERT(!m->findTag("ma_target"));
+  r.elements = PCU_Add_Long(m->count(3));
+  ma::SizeField* f = ma::makeSizeField(m, &sf);
+  r.volume = 0;
+  r.worst = 1;
+  apf::MeshIterator* it = m->begin(3);
+  apf::MeshEntity* e;
+  while ((e = m->iterate(it))) {
+    r.volume += apf::measure(m, e);
+    r.worst = std::min(r.worst, ma::measureElementQuality(m, f, e));
+  }
+  m->end(it);
+  r.volume = PCU_Add_Double(r.volume);
+  r.worst = PCU_Min_Double(r.worst);
+  delete f;
+  m->destroyNative();
+  apf::destroyMesh(m);
+  return r;
+}
+
+static void print(const char* name, Result const& r)
+{
+  if (!PCU_Comm_Self())
+    printf("%s: %ld tets, worst quality %f in %f s\n",
+        name, r.elements, r.worst, r.time);
+}
+
+static void check(Result const& serial, Result const& threaded)
+{
+  PCU_ALWAYS_ASSERT(std::fabs(threaded.volume - 1) < 1e-10);
+  PCU_ALWAYS_ASSERT(threaded.worst > 0);
+  PCU_ALWAYS_ASSERT(threaded.worst > serial.worst / 2);
+  /* the collapses run in another order, so the meshes differ */
+  PCU_ALWAYS_ASSERT(threaded.elements < serial.elements * 1.2);
+  PCU_ALWAYS_ASSERT(threaded.elements > serial.elements * 0.8);
+}
+
+int main(int argc, char** argv)
+{
+  MPI_Init(&argc,&argv);
+  PCU_Comm_Init();
+  gmi_register_mesh();
+  int n = 16;
+  if (argc > 1)
+    n = atoi(argv[1]);
+  int threads = 4;
+  if (argc > 2)
+    threads = atoi(argv[2]);
+  Result serial = run(n, 1, false);
+  print("one thread", serial);
+  PCU_ALWAYS_ASSERT(std::fabs(serial.volume - 1) < 1e-10);
+  Result threaded = run(n, threads, false);
+  print("worker threads", threaded);
+  check(serial, threaded);
+  Result incremental = run(n, threads, true);
+  print("worker threads, incremental", incremental);
+  check(serial, incremental);
+  PCU_Comm_Free();
+  MPI_Finalize();
+}
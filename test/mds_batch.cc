@@ -0,0 +1,158 @@
+#include <gmi_mesh.h>
+#include <apfMDS.h>
+#include <apfBox.h>
+#include <apfMesh2.h>
+#include <apf.h>
+#include <PCU.h>
+#include <pcu_util.h>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+/* the batched queries should agree with the single-entity ones,
+   both in the MDS overrides and the apf::Mesh defaults */
+
+enum { batch = 100 };
+
+/* runs the MDS override, or the apf::Mesh default if base is set */
+static void runBatch(apf::Mesh* m, bool base, apf::MeshEntity** es, int n,
+    apf::MeshTag* tag, int* ids, apf::ModelEntity** models, int* owners,
+    double* points)
+{
+  int d = apf::getDimension(m, es[0]);
+  if (base) {
+    m->apf::Mesh::getIntTagBatch(es, n, tag, ids);
+    m->apf::Mesh::toModelBatch(es, n, models);
+    m->apf::Mesh::getOwnerBatch(es, n, owners);
+    if (d == 0)
+      m->apf::Mesh::getPointBatch(es, n, points);
+  } else {
+    m->getIntTagBatch(es, n, tag, ids);
+    m->toModelBatch(es, n, models);
+    m->getOwnerBatch(es, n, owners);
+    if (d == 0)
+      m->getPointBatch(es, n, points);
+  }
+}
+
+static void checkBatch(apf::Mesh* m, bool base, apf::MeshEntity** es,
+    int n, apf::MeshTag* tag)
+{
+  int d = apf::getDimension(m, es[0]);
+  for (int dd = 0; dd < d; ++dd) {
+    apf::MeshEntity* down[batch * 12];
+    int degree = base ?
+      m->apf::Mesh::getDownwardBatch(es, n, dd, down) :
+      m->getDownwardBatch(es, n, dd, down);
+    for (int i = 0; i < n; ++i) {
+      apf::Downward one;
+      PCU_ALWAYS_ASSERT(m->getDownward(es[i], dd, one) == degree);
+      for (int j = 0; j < degree; ++j)
+        PCU_ALWAYS_ASSERT(down[i * degree + j] == one[j]);
+    }
+  }
+  int ids[batch];
+  apf::ModelEntity* models[batch];
+  int owners[batch];
+  double points[batch * 3];
+  runBatch(m, base, es, n, tag, ids, models, owners, points);
+  for (int i = 0; i < n; ++i) {
+    int id;
+    m->getIntTag(es[i], tag, &id);
+    PCU_ALWAYS_ASSERT(ids[i] == id);
+    PCU_ALWAYS_ASSERT(models[i] == m->toModel(es[i]));
+    PCU_ALWAYS_ASSERT(owners[i] == m->getOwner(es[i]));
+    if (d == 0) {
+      apf::Vector3 x;
+      m->getPoint(es[i], 0, x);
+      for (int j = 0; j < 3; ++j)
+        PCU_ALWAYS_ASSERT(points[i * 3 + j] == x[j]);
+    }
+  }
+}
+
+static void checkAll(apf::Mesh2* m, apf::MeshTag* tag, bool base)
+{
+  for (int d = 0; d <= m->getDimension(); ++d) {
+    apf::MeshEntity* es[batch];
+    apf::MeshIterator* it = m->begin(d);
+    size_t total = 0;
+    int n;
+    while ((n = base ? m->apf::Mesh::iterateBatch(it, es, batch)
+                     : m->iterateBatch(it, es, batch))) {
+      checkBatch(m, base, es, n, tag);
+      total += n;
+    }
+    m->end(it);
+    PCU_ALWAYS_ASSERT(total == m->count(d));
+  }
+}
+
+/* sums element vertex coordinates, as an assembly loop would */
+static double sumVertices(apf::Mesh2* m, bool batched)
+{
+  int d = m->getDimension();
+  double sum = 0;
+  apf::MeshIterator* it = m->begin(d);
+  if (batched) {
+    apf::MeshEntity* es[batch];
+    apf::MeshEntity* verts[batch * 4];
+    double points[batch * 4 * 3];
+    int n;
+    while ((n = m->iterateBatch(it, es, batch))) {
+      int degree = m->getDownwardBatch(es, n, 0, verts);
+      m->getPointBatch(verts, n * degree, points);
+      for (int i = 0; i < n * degree * 3; ++i)
+        sum += points[i];
+    }
+  } else {
+    apf::MeshEntity* e;
+    while ((e = m->iterate(it))) {
+      apf::Downward verts;
+      int degree = m->getDownward(e, 0, verts);
+      for (int i = 0; i < degree; ++i) {
+        apf::Vector3 x;
+        m->getPoint(verts[i], 0, x);
+        sum += x[0] + x[1] + x[2];
+      }
+    }
+  }
+  m->end(it);
+  return sum;
+}
+
+int main(int argc, char** argv)
+{
+  MPI_Init(&argc,&argv);
+  PCU_Comm_Init();
+  gmi_register_mesh();
+  apf::Mesh2* m = apf::makeMdsBox(10, 10, 10, 1, 1, 1, true);
+  apf::MeshTag* tag = m->createIntTag("id", 1);
+  for (int d = 0; d <= 3; ++d) {
+    apf::MeshIterator* it = m->begin(d);
+    apf::MeshEntity* e;
+    int i = 0;
+    while ((e = m->iterate(it))) {
+      m->setIntTag(e, tag, &i);
+      ++i;
+    }
+    m->end(it);
+  }
+  checkAll(m, tag, false);
+  checkAll(m, tag, true);
+  double t0 = PCU_Time();
+  double single = sumVertices(m, false);
+  double t1 = PCU_Time();
+  double batched = sumVertices(m, true);
+  double t2 = PCU_Time();
+  PCU_ALWAYS_ASSERT(std::fabs(single - batched) < 1e-9 * std::fabs(single));
+  printf("element vertex coordinates: single %f s, batched %f s\n",
+      t1 - t0, t2 - t1);
+  for (int d = 0; d <= 3; ++d)
+    apf::removeTagFromDimension(m, tag, d);
+  m->destroyTag(tag);
+  m->destroyNative();
+  apf::destroyMesh(m);
+  PCU_Comm_Free();
+  MPI_Finalize();
+}
@@ -0,0 +1,108 @@
+#include <gmi_mesh.h>
+#include <apfMDS.h>
+#include <apfBox.h>
+#include <apfMesh2.h>
+#include <apf.h>
+#include <ma.h>
+#include <PCU.h>
+#include <pcu_util.h>
+#include <cmath>
+#include <cstdio>
+#include "split_box.h"
+
+/* refinement leaves holes in the MDS arrays where the old entities
+   were. Compacting should close them without changing the mesh,
+   its remote copies, or the fields on it */
+
+struct Summary
+{
+  size_t count[4];
+  double volume;
+  double error;
+};
+
+static void summarize(apf::Mesh2* m, apf::Field* f, Summary& s)
+{
+  for (int d = 0; d <= 3; ++d)
+    s.count[d] = m->count(d);
+  s.volume = 0;
+  apf::MeshIterator* it = m->begin(3);
+  apf::MeshEntity* e;
+  while ((e = m->iterate(it))) {
+    apf::MeshElement* me = apf::createMeshElement(m, e);
+    s.volume += apf::measure(me);
+    apf::destroyMeshElement(me);
+  }
+  m->end(it);
+  s.error = 0;
+  it = m->begin(0);
+  while ((e = m->iterate(it))) {
+    apf::Vector3 x;
+    m->getPoint(e, 0, x);
+    s.error += std::fabs(apf::getScalar(f, e, 0) - x[0]);
+  }
+  m->end(it);
+}
+
+static void check(apf::Mesh2* m, apf::Field* f, Summary const& before)
+{
+  Summary after;
+  summarize(m, f, after);
+  for (int d = 0; d <= 3; ++d)
+    PCU_ALWAYS_ASSERT(after.count[d] == before.count[d]);
+  PCU_ALWAYS_ASSERT(std::fabs(after.volume - before.volume) < 1e-12);
+  PCU_ALWAYS_ASSERT(after.error < 1e-12);
+  PCU_ALWAYS_ASSERT(apf::getMdsFill(m) == 1);
+  m->verify();
+  PCU_ALWAYS_ASSERT(
+      std::fabs(PCU_Add_Double(after.volume) - 1) < 1e-12);
+}
+
+/* the arena keeps one record of its arrays for all threads,
+   which here grow and free meshes of their own at the same time */
+static void* buildAndDestroy(void*)
+{
+  for (int i = 0; i < 4; ++i) {
+    apf::Mesh2* m = apf::makeMdsBox(4, 4, 4, 1, 1, 1, true);
+    PCU_ALWAYS_ASSERT(m->count(3) == 4 * 4 * 4 * 6);
+    m->destroyNative();
+    apf::destroyMesh(m);
+  }
+  return NULL;
+}
+
+int main(int argc, char** argv)
+{
+  int provided;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
+  PCU_Comm_Init();
+  gmi_register_mesh();
+  apf::setMdsArena(true);
+  PCU_Thrd_Run(4, buildAndDestroy, NULL);
+  apf::Mesh2* m = makeSplitBox(4);
+  ma::runUniformRefinement(m);
+  PCU_ALWAYS_ASSERT(!m->count(3) || apf::getMdsFill(m) < 1);
+  apf::Field* f = apf::createLagrangeField(m, "x", apf::SCALAR, 1);
+  apf::MeshIterator* it = m->begin(0);
+  apf::MeshEntity* e;
+  while ((e = m->iterate(it))) {
+    apf::Vector3 x;
+    m->getPoint(e, 0, x);
+    apf::setScalar(f, e, 0, x[0]);
+  }
+  m->end(it);
+  Summary before;
+  summarize(m, f, before);
+  apf::compactMdsMesh(m);
+  check(m, f, before);
+  ma::runUniformRefinement(m);
+  summarize(m, f, before);
+  apf::compactMdsMesh(m, true);
+  check(m, f, before);
+  apf::destroyField(f);
+  m->destroyNative();
+  apf::destroyMesh(m);
+  apf::setMdsArena(false);
+  PCU_Comm_Free();
+  MPI_Finalize();
+}
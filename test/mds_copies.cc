@@ -0,0 +1,109 @@
+#include <gmi_mesh.h>
+#include <apfMDS.h>
+#include <apfBox.h>
+#include <apfMesh2.h>
+#include <apf.h>
+#include <PCU.h>
+#include <pcu_util.h>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <vector>
+#include "split_box.h"
+
+/* packing the remote copies of a frozen mesh into per-peer blocks
+   should not change what the queries about them return */
+
+struct Sharing
+{
+  bool shared;
+  bool owned;
+  std::map<int, apf::MeshEntity*> remotes;
+  std::vector<int> residence;
+  bool operator==(Sharing const& other) const
+  {
+    return shared == other.shared && owned == other.owned &&
+      remotes == other.remotes && residence == other.residence;
+  }
+};
+
+static void getSharing(apf::Mesh2* m, std::vector<Sharing>& all)
+{
+  all.clear();
+  for (int d = 0; d <= 3; ++d) {
+    apf::MeshIterator* it = m->begin(d);
+    apf::MeshEntity* e;
+    while ((e = m->iterate(it))) {
+      Sharing s;
+      s.shared = m->isShared(e);
+      s.owned = m->isOwned(e);
+      apf::Copies remotes;
+      m->getRemotes(e, remotes);
+      s.remotes.insert(remotes.begin(), remotes.end());
+      apf::Parts residence;
+      m->getResidence(e, residence);
+      s.residence.assign(residence.begin(), residence.end());
+      all.push_back(s);
+    }
+    m->end(it);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  MPI_Init(&argc,&argv);
+  PCU_Comm_Init();
+  gmi_register_mesh();
+  int n = 8;
+  if (argc > 1)
+    n = atoi(argv[1]);
+  apf::Mesh2* m = makeSplitBox(n);
+  std::vector<Sharing> thawed, frozen;
+  getSharing(m, thawed);
+  size_t thawedBytes = apf::getMdsBytes(m);
+  m->freeze();
+  size_t frozenBytes = apf::getMdsBytes(m);
+  getSharing(m, frozen);
+  PCU_ALWAYS_ASSERT(frozen == thawed);
+  PCU_ALWAYS_ASSERT(frozenBytes <= thawedBytes);
+  long saved = PCU_Add_Long(thawedBytes - frozenBytes);
+  if (!PCU_Comm_Self())
+    printf("packing remote copies saved %ld bytes\n", saved);
+  apf::Field* f = apf::createFieldOn(m, "owner", apf::SCALAR);
+  apf::MeshIterator* it = m->begin(0);
+  apf::MeshEntity* v;
+  while ((v = m->iterate(it)))
+    apf::setScalar(f, v, 0, PCU_Comm_Self());
+  m->end(it);
+  apf::synchronize(f);
+  it = m->begin(0);
+  while ((v = m->iterate(it)))
+    PCU_ALWAYS_ASSERT(apf::getScalar(f, v, 0) == m->getOwner(v));
+  m->end(it);
+  apf::destroyField(f);
+  m->verify();
+  m->writeNative("copies.smb");
+  /* migration changes the copies, which thaws them */
+  apf::Migration* plan = new apf::Migration(m);
+  if (PCU_Comm_Self() == 1) {
+    it = m->begin(3);
+    apf::MeshEntity* e;
+    while ((e = m->iterate(it)))
+      plan->send(e, 0);
+    m->end(it);
+  }
+  m->migrate(plan);
+  m->verify();
+  m->freeze();
+  m->verify();
+  gmi_model* g = m->getModel();
+  apf::disownMdsModel(m);
+  m->destroyNative();
+  apf::destroyMesh(m);
+  m = apf::loadMdsMesh(g, "copies.smb");
+  m->verify();
+  m->destroyNative();
+  apf::destroyMesh(m);
+  PCU_Comm_Free();
+  MPI_Finalize();
+}
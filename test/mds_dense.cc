@@ -0,0 +1,136 @@
+#include <gmi_mesh.h>
+#include <apfMDS.h>
+#include <apfBox.h>
+#include <apfMesh2.h>
+#include <apf.h>
+#include <apfShape.h>
+#include <PCU.h>
+#include <pcu_util.h>
+#include <pumi.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include "split_box.h"
+
+/* dense field storage should hold the same values as tag storage
+   and give the same results from the field arithmetic, faster */
+
+static apf::Field* makeField(apf::Mesh2* m, const char* name)
+{
+  apf::Field* f = apf::createField(m, name, apf::VECTOR,
+      apf::getLagrange(2));
+  for (int d = 0; d <= 1; ++d) {
+    apf::MeshIterator* it = m->begin(d);
+    apf::MeshEntity* e;
+    while ((e = m->iterate(it))) {
+      apf::Vector3 x = apf::getLinearCentroid(m, e);
+      apf::setVector(f, e, 0, apf::Vector3(x[0], 2 * x[1], x[2] - 1));
+    }
+    m->end(it);
+  }
+  return f;
+}
+
+static void checkSame(apf::Mesh2* m, apf::Field* a, apf::Field* b)
+{
+  for (int d = 0; d <= 1; ++d) {
+    apf::MeshIterator* it = m->begin(d);
+    apf::MeshEntity* e;
+    while ((e = m->iterate(it))) {
+      apf::Vector3 va, vb;
+      apf::getVector(a, e, 0, va);
+      apf::getVector(b, e, 0, vb);
+      PCU_ALWAYS_ASSERT((va - vb).getLength() < 1e-12);
+    }
+    m->end(it);
+  }
+}
+
+/* ghosting moves field data as tags and should leave dense fields
+   dense, with ghost copies holding the values of their originals */
+static void checkGhosting(apf::Mesh2* m, apf::Field* tagged,
+    apf::Field* dense)
+{
+  size_t verts = m->count(0);
+  /* pumi ghosts the mesh it loaded */
+  pumi::instance()->mesh = m;
+  pumi_ghost_createLayer(m, 0, 3, 1, 1);
+  PCU_ALWAYS_ASSERT(apf::isDense(dense));
+  PCU_ALWAYS_ASSERT(PCU_Or(m->count(0) > verts));
+  checkSame(m, tagged, dense);
+  apf::MeshIterator* it = m->begin(0);
+  apf::MeshEntity* v;
+  while ((v = m->iterate(it))) {
+    apf::Vector3 x, value;
+    m->getPoint(v, 0, x);
+    apf::getVector(dense, v, 0, value);
+    apf::Vector3 expected(2 * x[0], 4 * x[1], 2 * (x[2] - 1));
+    PCU_ALWAYS_ASSERT((value - expected).getLength() < 1e-12);
+  }
+  m->end(it);
+  pumi_ghost_delete(m);
+  PCU_ALWAYS_ASSERT(apf::isDense(dense));
+  PCU_ALWAYS_ASSERT(m->count(0) == verts);
+  checkSame(m, tagged, dense);
+}
+
+static double timeAxpy(apf::Field* x, apf::Field* y, int times)
+{
+  double t0 = PCU_Time();
+  for (int i = 0; i < times; ++i)
+    apf::axpy(1.0 / times, x, y);
+  return PCU_Time() - t0;
+}
+
+int main(int argc, char** argv)
+{
+  MPI_Init(&argc,&argv);
+  PCU_Comm_Init();
+  gmi_register_mesh();
+  int n = 10;
+  if (argc > 1)
+    n = atoi(argv[1]);
+  apf::Mesh2* m = makeSplitBox(n);
+  apf::Field* tagged = makeField(m, "tagged");
+  apf::Field* dense = makeField(m, "dense");
+  apf::Field* dx = makeField(m, "dx");
+  apf::Field* tx = makeField(m, "tx");
+  double norm = apf::getNorm(tagged);
+  apf::makeDense(dense);
+  apf::makeDense(dx);
+  PCU_ALWAYS_ASSERT(apf::isDense(dense) && apf::isFrozen(dense));
+  PCU_ALWAYS_ASSERT(!apf::isDense(tagged));
+  PCU_ALWAYS_ASSERT(!apf::getArrayData(dense));
+  checkSame(m, tagged, dense);
+  PCU_ALWAYS_ASSERT(std::fabs(apf::getNorm(dense) - norm) < 1e-10 * norm);
+  /* vertex components are separate arrays indexed by the mesh */
+  apf::MeshIterator* it = m->begin(0);
+  apf::MeshEntity* v;
+  double const* ys = apf::getDenseArray(dense, apf::Mesh::VERTEX, 1);
+  while ((v = m->iterate(it))) {
+    apf::Vector3 x;
+    m->getPoint(v, 0, x);
+    PCU_ALWAYS_ASSERT(std::fabs(ys[m->getIndex(v)] - 2 * x[1]) < 1e-12);
+  }
+  m->end(it);
+  int times = 10;
+  double tagTime = timeAxpy(tx, tagged, times);
+  double denseTime = timeAxpy(dx, dense, times);
+  checkSame(m, tagged, dense);
+  PCU_ALWAYS_ASSERT(std::fabs(apf::getNorm(dense) - 2 * norm) < 1e-10 * norm);
+  if (!PCU_Comm_Self())
+    printf("%d axpys: %f s with tags, %f s dense\n", times, tagTime, denseTime);
+  if (PCU_Comm_Peers() > 1)
+    checkGhosting(m, tagged, dense);
+  /* modifying the mesh brings back tag storage */
+  apf::compactMdsMesh(m);
+  PCU_ALWAYS_ASSERT(!apf::isDense(dense));
+  checkSame(m, tagged, dense);
+  apf::makeDense(dense);
+  apf::zeroField(dense);
+  PCU_ALWAYS_ASSERT(apf::getNorm(dense) == 0);
+  m->destroyNative();
+  apf::destroyMesh(m);
+  PCU_Comm_Free();
+  MPI_Finalize();
+}
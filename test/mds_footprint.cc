@@ -0,0 +1,56 @@
+#include <gmi_mesh.h>
+#include <apfMDS.h>
+#include <apfBox.h>
+#include <apfMesh2.h>
+#include <apf.h>
+#include <PCU.h>
+#include <pcu_util.h>
+#include <cstdio>
+#include <cstdlib>
+
+/* compares the memory an MDS mesh takes with 32-bit and 64-bit
+   entity ids, and checks that it survives an smb round trip */
+
+static void printFootprint(apf::Mesh2* m, const char* what)
+{
+  size_t narrow = apf::getMdsBytes(m, 4);
+  size_t wide = apf::getMdsBytes(m, 8);
+  size_t actual = apf::getMdsBytes(m);
+  PCU_ALWAYS_ASSERT(actual == narrow || actual == wide);
+  PCU_ALWAYS_ASSERT(narrow < wide);
+  printf("%s: %lu entities, %.2f MB with 32-bit ids, %.2f MB with 64-bit"
+      " ids (%.0f%% more), this build uses %s\n", what,
+      (unsigned long)(m->count(0) + m->count(1) + m->count(2) + m->count(3)),
+      narrow / 1e6, wide / 1e6, (double(wide) / narrow - 1) * 100,
+      actual == narrow ? "32" : "64");
+}
+
+int main(int argc, char** argv)
+{
+  MPI_Init(&argc,&argv);
+  PCU_Comm_Init();
+  gmi_register_mesh();
+  int n = 10;
+  if (argc > 1)
+    n = atoi(argv[1]);
+  PCU_ALWAYS_ASSERT(apf::getMdsMaxEntities(apf::Mesh::HEX) > 1000 * 1000);
+  apf::Mesh2* m = apf::makeMdsBox(n, n, n, 1, 1, 1, true);
+  printFootprint(m, "tets");
+  size_t before = apf::getMdsBytes(m);
+  gmi_model* g = m->getModel();
+  m->writeNative("footprint.smb");
+  apf::disownMdsModel(m);
+  m->destroyNative();
+  apf::destroyMesh(m);
+  m = apf::loadMdsMesh(g, "footprint.smb");
+  PCU_ALWAYS_ASSERT(apf::getMdsBytes(m) <= before);
+  m->verify();
+  m->destroyNative();
+  apf::destroyMesh(m);
+  m = apf::makeMdsBox(n, n, n, 1, 1, 1, false);
+  printFootprint(m, "hexes");
+  m->destroyNative();
+  apf::destroyMesh(m);
+  PCU_Comm_Free();
+  MPI_Finalize();
+}
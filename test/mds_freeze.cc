@@ -0,0 +1,100 @@
+#include <gmi_mesh.h>
+#include <apfMDS.h>
+#include <apfBox.h>
+#include <apfMesh2.h>
+#include <apf.h>
+#include <PCU.h>
+#include <pcu_util.h>
+#include <cstdio>
+#include <vector>
+
+/* a frozen mesh should answer every adjacency query the same way
+   as the thawed mesh, in the same order, and thaw when changed */
+
+typedef std::vector<apf::MeshEntity*> Entities;
+
+static void getAll(apf::Mesh2* m, Entities& all)
+{
+  int d = m->getDimension();
+  for (int i = 0; i <= d; ++i) {
+    apf::MeshIterator* it = m->begin(i);
+    apf::MeshEntity* e;
+    while ((e = m->iterate(it)))
+      all.push_back(e);
+    m->end(it);
+  }
+}
+
+static void getAdjacency(apf::Mesh2* m, Entities const& all,
+    std::vector<Entities>& adj)
+{
+  int d = m->getDimension();
+  adj.clear();
+  for (size_t i = 0; i < all.size(); ++i) {
+    int ed = apf::getDimension(m, all[i]);
+    for (int j = 0; j <= d; ++j) {
+      apf::Adjacent a;
+      m->getAdjacent(all[i], j, a);
+      adj.push_back(Entities(a.begin(), a.end()));
+    }
+    if (ed < d) {
+      int n = m->countUpward(all[i]);
+      Entities up;
+      for (int j = 0; j < n; ++j)
+        up.push_back(m->getUpward(all[i], j));
+      adj.push_back(up);
+    }
+  }
+}
+
+/* visits the elements around each vertex, as patch recovery would */
+static double timePatches(apf::Mesh2* m)
+{
+  double t0 = PCU_Time();
+  size_t sum = 0;
+  for (int k = 0; k < 10; ++k) {
+    apf::MeshIterator* it = m->begin(0);
+    apf::MeshEntity* v;
+    while ((v = m->iterate(it))) {
+      apf::Adjacent a;
+      m->getAdjacent(v, m->getDimension(), a);
+      sum += a.getSize();
+    }
+    m->end(it);
+  }
+  PCU_ALWAYS_ASSERT(sum);
+  return PCU_Time() - t0;
+}
+
+int main(int argc, char** argv)
+{
+  MPI_Init(&argc,&argv);
+  PCU_Comm_Init();
+  gmi_register_mesh();
+  apf::Mesh2* m = apf::makeMdsBox(8, 8, 8, 1, 1, 1, true);
+  Entities all;
+  getAll(m, all);
+  std::vector<Entities> thawed, frozen;
+  getAdjacency(m, all, thawed);
+  double thawedTime = timePatches(m);
+  PCU_ALWAYS_ASSERT(!m->isFrozen());
+  m->freeze();
+  PCU_ALWAYS_ASSERT(m->isFrozen());
+  getAdjacency(m, all, frozen);
+  PCU_ALWAYS_ASSERT(frozen == thawed);
+  double frozenTime = timePatches(m);
+  printf("vertex to element queries: thawed %f s, frozen %f s\n",
+      thawedTime, frozenTime);
+  apf::MeshEntity* v = m->createVert(0);
+  PCU_ALWAYS_ASSERT(!m->isFrozen());
+  m->destroy(v);
+  m->freeze();
+  m->thaw();
+  PCU_ALWAYS_ASSERT(!m->isFrozen());
+  getAdjacency(m, all, frozen);
+  PCU_ALWAYS_ASSERT(frozen == thawed);
+  m->destroyNative();
+  apf::destroyMesh(m);
+  PCU_Comm_Free();
+  MPI_Finalize();
+}
@@ -0,0 +1,186 @@
+#include <gmi_mesh.h>
+#include <apfMDS.h>
+#include <apfBox.h>
+#include <apfMesh2.h>
+#include <apf.h>
+#include <PCU.h>
+#include <pcu_util.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <random>
+#include <vector>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
+/* times an element loop like that of an assembly kernel after
+   shuffling the mesh as an imported one might be, and after
+   reordering it by breadth-first search and by Hilbert curve */
+
+#ifdef __linux__
+static int openCacheMisses()
+{
+  perf_event_attr pe;
+  memset(&pe, 0, sizeof(pe));
+  pe.type = PERF_TYPE_HARDWARE;
+  pe.size = sizeof(pe);
+  pe.config = PERF_COUNT_HW_CACHE_MISSES;
+  pe.disabled = 1;
+  pe.exclude_kernel = 1;
+  pe.exclude_hv = 1;
+  return syscall(__NR_perf_event_open, &pe, 0, -1, -1, 0);
+}
+#else
+static int openCacheMisses()
+{
+  return -1;
+}
+#endif
+
+struct Counter
+{
+  Counter():fd(openCacheMisses()) {}
+  ~Counter()
+  {
+#ifdef __linux__
+    if (fd >= 0)
+      close(fd);
+#endif
+  }
+  void start()
+  {
+#ifdef __linux__
+    if (fd >= 0) {
+      ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+  }
+  long long stop()
+  {
+    long long count = -1;
+#ifdef __linux__
+    if (fd >= 0) {
+      ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+      if (read(fd, &count, sizeof(count)) != sizeof(count))
+        count = -1;
+    }
+#endif
+    return count;
+  }
+  int fd;
+};
+
+/* integrates the field and the Jacobian determinant over each element */
+static double elementLoop(apf::Mesh2* m, apf::Field* f)
+{
+  double sum = 0;
+  apf::MeshIterator* it = m->begin(m->getDimension());
+  apf::MeshEntity* e;
+  while ((e = m->iterate(it))) {
+    apf::MeshElement* me = apf::createMeshElement(m, e);
+    apf::Element* fe = apf::createElement(f, me);
+    int n = apf::countIntPoints(me, 2);
+    for (int i = 0; i < n; ++i) {
+      apf::Vector3 xi;
+      apf::getIntPoint(me, 2, i, xi);
+      apf::Matrix3x3 J;
+      apf::getJacobian(me, xi, J);
+      sum += apf::getScalar(fe, xi) * std::fabs(apf::getDeterminant(J))
+        * apf::getIntWeight(me, 2, i);
+    }
+    apf::destroyElement(fe);
+    apf::destroyMeshElement(me);
+  }
+  m->end(it);
+  return sum;
+}
+
+static double run(apf::Mesh2* m, apf::Field* f, const char* order,
+    double expected)
+{
+  Counter misses;
+  double t0 = PCU_Time();
+  misses.start();
+  double sum = elementLoop(m, f);
+  long long count = misses.stop();
+  double t = PCU_Time() - t0;
+  if (count >= 0)
+    printf("%-9s element loop %f s, %lld cache misses\n", order, t, count);
+  else
+    printf("%-9s element loop %f s, cache misses not available\n", order, t);
+  if (expected != 0)
+    PCU_ALWAYS_ASSERT(std::fabs(sum - expected) < 1e-10 * std::fabs(expected));
+  return sum;
+}
+
+static void reorder(apf::Mesh2* m, apf::MeshTag* t)
+{
+  apf::compactMdsMesh(m, true, t);
+  if (t) {
+    apf::removeTagFromDimension(m, t, 0);
+    m->destroyTag(t);
+  }
+  PCU_ALWAYS_ASSERT(apf::getMdsFill(m) == 1);
+}
+
+static apf::MeshTag* shuffle(apf::Mesh2* m)
+{
+  std::vector<int> order(m->count(0));
+  for (size_t i = 0; i < order.size(); ++i)
+    order[i] = i;
+  std::mt19937 random(42);
+  std::shuffle(order.begin(), order.end(), random);
+  apf::MeshTag* t = m->createIntTag("shuffle", 1);
+  apf::MeshIterator* it = m->begin(0);
+  apf::MeshEntity* v;
+  for (int i = 0; (v = m->iterate(it)); ++i)
+    m->setIntTag(v, t, &order[i]);
+  m->end(it);
+  return t;
+}
+
+int main(int argc, char** argv)
+{
+  MPI_Init(&argc,&argv);
+  PCU_Comm_Init();
+  gmi_register_mesh();
+  int n = 20;
+  if (argc > 1)
+    n = atoi(argv[1]);
+  apf::Mesh2* m = apf::makeMdsBox(n, n, n, 1, 1, 1, true);
+  apf::Field* f = apf::createLagrangeField(m, "f", apf::SCALAR, 1);
+  apf::MeshIterator* it = m->begin(0);
+  apf::MeshEntity* v;
+  while ((v = m->iterate(it))) {
+    apf::Vector3 x;
+    m->getPoint(v, 0, x);
+    apf::setScalar(f, v, 0, x[0] + 2 * x[1] + 3 * x[2]);
+  }
+  m->end(it);
+  double expected = run(m, f, "box", 0);
+  reorder(m, shuffle(m));
+  run(m, f, "shuffled", expected);
+  apf::MeshTag* shuffled = shuffle(m);
+  double t0 = PCU_Time();
+  reorder(m, 0);
+  double t1 = PCU_Time();
+  run(m, f, "bfs", expected);
+  reorder(m, shuffled);
+  double t2 = PCU_Time();
+  reorder(m, apf::numberMdsHilbert(m));
+  double t3 = PCU_Time();
+  run(m, f, "hilbert", expected);
+  printf("reordering a shuffled mesh: bfs %f s, hilbert %f s\n",
+      t1 - t0, t3 - t2);
+  m->destroyNative();
+  apf::destroyMesh(m);
+  PCU_Comm_Free();
+  MPI_Finalize();
+}
@@ -0,0 +1,145 @@
+#include <gmi_mesh.h>
+#include <apfMDS.h>
+#include <apfBox.h>
+#include <apfMesh2.h>
+#include <apf.h>
+#include <PCU.h>
+#include <pcu_util.h>
+#include <pthread.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+/* threads each iterate over a range of the elements and run
+   read-only queries on them, and the results together should
+   match a single loop over all the elements */
+
+struct Work
+{
+  apf::Mesh2* mesh;
+  apf::Field* field;
+  apf::MeshTag* tag;
+  int part;
+  int parts;
+  size_t count;
+  double sum;
+};
+
+static double query(Work* w, apf::MeshEntity* e)
+{
+  apf::Mesh2* m = w->mesh;
+  double sum = 0;
+  apf::Downward verts;
+  int nv = m->getDownward(e, 0, verts);
+  for (int i = 0; i < nv; ++i) {
+    apf::Vector3 x;
+    m->getPoint(verts[i], 0, x);
+    int id;
+    m->getIntTag(verts[i], w->tag, &id);
+    sum += x[0] + x[1] + x[2] + id + apf::getScalar(w->field, verts[i], 0);
+    apf::Adjacent around;
+    m->getAdjacent(verts[i], m->getDimension(), around);
+    sum += around.getSize();
+  }
+  apf::Adjacent faces;
+  m->getAdjacent(e, 2, faces);
+  for (size_t i = 0; i < faces.getSize(); ++i)
+    sum += m->countUpward(faces[i]) + m->getModelType(m->toModel(faces[i]));
+  apf::MeshElement* me = apf::createMeshElement(m, e);
+  sum += apf::measure(me);
+  apf::destroyMeshElement(me);
+  return sum;
+}
+
+static void* run(void* arg)
+{
+  Work* w = static_cast<Work*>(arg);
+  apf::Mesh2* m = w->mesh;
+  apf::MeshIterator* it = apf::beginMdsRange(m, m->getDimension(),
+      w->part, w->parts);
+  apf::MeshEntity* e;
+  while ((e = m->iterate(it))) {
+    w->sum += query(w, e);
+    ++(w->count);
+  }
+  m->end(it);
+  return NULL;
+}
+
+static void check(Work& serial, int parts)
+{
+  std::vector<Work> work(parts, serial);
+  std::vector<pthread_t> threads(parts);
+  for (int i = 0; i < parts; ++i) {
+    work[i].part = i;
+    work[i].parts = parts;
+    work[i].count = 0;
+    work[i].sum = 0;
+    PCU_ALWAYS_ASSERT(!pthread_create(&threads[i], NULL, run, &work[i]));
+  }
+  size_t count = 0;
+  double sum = 0;
+  for (int i = 0; i < parts; ++i) {
+    pthread_join(threads[i], NULL);
+    count += work[i].count;
+    sum += work[i].sum;
+  }
+  PCU_ALWAYS_ASSERT(count == serial.count);
+  PCU_ALWAYS_ASSERT(std::fabs(sum - serial.sum) < 1e-9 * serial.sum);
+}
+
+int main(int argc, char** argv)
+{
+  MPI_Init(&argc,&argv);
+  PCU_Comm_Init();
+  gmi_register_mesh();
+  int nthreads = 4;
+  if (argc > 1)
+    nthreads = atoi(argv[1]);
+  apf::Mesh2* m = apf::makeMdsBox(6, 6, 6, 1, 1, 1, true);
+  /* leave some gaps for the ranges to skip */
+  std::vector<apf::MeshEntity*> doomed;
+  apf::MeshIterator* it = m->begin(3);
+  apf::MeshEntity* e;
+  for (int i = 0; (e = m->iterate(it)); ++i)
+    if (i % 7 == 3)
+      doomed.push_back(e);
+  m->end(it);
+  for (size_t i = 0; i < doomed.size(); ++i)
+    m->destroy(doomed[i]);
+  Work serial;
+  serial.mesh = m;
+  serial.field = apf::createLagrangeField(m, "f", apf::SCALAR, 1);
+  serial.tag = m->createIntTag("id", 1);
+  it = m->begin(0);
+  for (int i = 0; (e = m->iterate(it)); ++i) {
+    m->setIntTag(e, serial.tag, &i);
+    apf::setScalar(serial.field, e, 0, i * 0.5);
+  }
+  m->end(it);
+  serial.part = 0;
+  serial.parts = 1;
+  serial.count = 0;
+  serial.sum = 0;
+  run(&serial);
+  PCU_ALWAYS_ASSERT(serial.count == m->count(3));
+  serial.count = 0;
+  serial.sum = 0;
+  it = m->begin(3);
+  while ((e = m->iterate(it))) {
+    serial.sum += query(&serial, e);
+    ++serial.count;
+  }
+  m->end(it);
+  check(serial, nthreads);
+  check(serial, 50);
+  m->freeze();
+  check(serial, nthreads);
+  apf::removeTagFromDimension(m, serial.tag, 0);
+  m->destroyTag(serial.tag);
+  m->destroyNative();
+  apf::destroyMesh(m);
+  PCU_Comm_Free();
+  MPI_Finalize();
+}
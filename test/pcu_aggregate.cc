@@ -0,0 +1,65 @@
+#include <PCU.h>
+#include <pcu_io.h>
+#include <pcu_util.h>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+/* writes a stream per rank into aggregated files, one per
+   group of ranks, and checks that each rank reads back its own */
+
+static std::string groupPath(int groupSize)
+{
+  int self = PCU_Comm_Self();
+  char path[64];
+  sprintf(path, "pcu_aggregate_%d_%d.bin", groupSize,
+      self - self % groupSize);
+  return path;
+}
+
+static void writeStreams(int groupSize)
+{
+  std::string path = groupPath(groupSize);
+  pcu_file* f = pcu_fopen_aggregate(path.c_str(), true, false, groupSize);
+  unsigned self = PCU_Comm_Self();
+  PCU_WRITE_UNSIGNED(f, self);
+  for (unsigned i = 0; i < self * 100; ++i)
+    PCU_WRITE_UNSIGNED(f, i);
+  pcu_write_string(f, path.c_str());
+  pcu_fclose(f);
+}
+
+static void readStreams(int groupSize)
+{
+  std::string path = groupPath(groupSize);
+  pcu_file* f = pcu_fopen_aggregate(path.c_str(), false, false, groupSize);
+  unsigned self;
+  PCU_READ_UNSIGNED(f, self);
+  PCU_ALWAYS_ASSERT(self == unsigned(PCU_Comm_Self()));
+  for (unsigned i = 0; i < self * 100; ++i) {
+    unsigned x;
+    PCU_READ_UNSIGNED(f, x);
+    PCU_ALWAYS_ASSERT(x == i);
+  }
+  char* s;
+  pcu_read_string(f, &s);
+  PCU_ALWAYS_ASSERT(path == s);
+  free(s);
+  pcu_fclose(f);
+}
+
+int main(int argc, char** argv)
+{
+  MPI_Init(&argc,&argv);
+  PCU_Comm_Init();
+  const int groupSizes[] = {1, 3, 64};
+  for (int i = 0; i < 3; ++i) {
+    writeStreams(groupSizes[i]);
+    readStreams(groupSizes[i]);
+    PCU_Barrier();
+    if (PCU_Comm_Self() % groupSizes[i] == 0)
+      remove(groupPath(groupSizes[i]).c_str());
+  }
+  PCU_Comm_Free();
+  MPI_Finalize();
+}
@@ -0,0 +1,71 @@
+#include <PCU.h>
+#include <pcu_io.h>
+#include <pcu_util.h>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+/* writes a compressed file of several blocks and reads it back in
+   pieces of many sizes with different numbers of decoding threads */
+
+static unsigned getValue(unsigned i)
+{
+  return (i / 7) * 2654435761u % 1000;
+}
+
+static const unsigned count = 3 * 1000 * 1000;
+
+static void writeFile(const char* path)
+{
+  pcu_file* f = pcu_fopen(path, true, true);
+  std::vector<unsigned> xs(count);
+  for (unsigned i = 0; i < count; ++i)
+    xs[i] = getValue(i);
+  pcu_write_unsigneds(f, &xs[0], count);
+  pcu_write_string(f, path);
+  pcu_fclose(f);
+}
+
+static void readFile(const char* path, int threads)
+{
+  pcu_set_io_threads(threads);
+  double t0 = PCU_Time();
+  pcu_file* f = pcu_fopen(path, false, true);
+  std::vector<unsigned> xs(count);
+  unsigned i = 0;
+  for (unsigned n = 1; i < count; n = n * 3 + 1) {
+    if (n > count - i)
+      n = count - i;
+    pcu_read_unsigneds(f, &xs[i], n);
+    i += n;
+  }
+  char* s;
+  pcu_read_string(f, &s);
+  pcu_fclose(f);
+  double t1 = PCU_Time();
+  for (i = 0; i < count; ++i)
+    PCU_ALWAYS_ASSERT(xs[i] == getValue(i));
+  PCU_ALWAYS_ASSERT(std::string(s) == path);
+  free(s);
+  if (!PCU_Comm_Self())
+    printf("read %s with %d decoding threads in %f seconds\n",
+        path, threads, t1 - t0);
+}
+
+int main(int argc, char** argv)
+{
+  MPI_Init(&argc,&argv);
+  PCU_Comm_Init();
+  char path[64];
+  sprintf(path, "pcu_blocks_%d.bz2", PCU_Comm_Self());
+  writeFile(path);
+  const int threads[] = {0, 1, 4};
+  for (int i = 0; i < 3; ++i)
+    readFile(path, threads[i]);
+  pcu_set_io_threads(-1);
+  readFile(path, -1);
+  remove(path);
+  PCU_Comm_Free();
+  MPI_Finalize();
+}
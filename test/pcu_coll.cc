@@ -0,0 +1,231 @@
+#include <PCU.h>
+#include <pcu_util.h>
+extern "C" {
+#include <pcu_coll.h>
+}
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+/* times and checks the collectives behind PCU_Add_Doubles,
+   PCU_Exscan_Longs and PCU_Max_Int on this run, flat and with
+   nodes of two ranks, then simulates them at 1k to 100k
+   ranks laid out in nodes of a given size, by running the PCU
+   collective patterns of all simulated ranks in this process.
+   Each rank has a clock, a message sent at time t arrives at
+   t + latency, and the latency of messages that leave a node
+   is larger. The simulated time of a collective is the latest
+   clock when all ranks are done. */
+
+struct Letter
+{
+  int from;
+  double arrival;
+  std::vector<char> data;
+};
+
+struct Layout
+{
+  int ranks;
+  int nodeSize; //for the latency model
+  int collNodeSize; //given to PCU, 1 means flat collectives
+  double local; //latency within a node, seconds
+  double remote; //latency between nodes, seconds
+};
+
+static Layout layout;
+static int simRank;
+static std::vector<double> clocks;
+static std::vector<std::deque<Letter> > boxes;
+
+static int simSize()
+{
+  return layout.ranks;
+}
+
+static int simRankFunc()
+{
+  return simRank;
+}
+
+static int simNodeSize()
+{
+  return layout.collNodeSize;
+}
+
+static void simSend(pcu_message* m, MPI_Comm)
+{
+  bool local = m->peer / layout.nodeSize == simRank / layout.nodeSize;
+  Letter l;
+  l.from = simRank;
+  l.arrival = clocks[simRank] + (local ? layout.local : layout.remote);
+  char* p = static_cast<char*>(m->buffer.start);
+  l.data.assign(p, p + m->buffer.size);
+  boxes[m->peer].push_back(l);
+}
+
+static bool simDone(pcu_message*)
+{
+  return true;
+}
+
+static bool simReceive(pcu_message* m, MPI_Comm)
+{
+  std::deque<Letter>& box = boxes[simRank];
+  for (size_t i = 0; i < box.size(); ++i) {
+    if (box[i].from != m->peer)
+      continue;
+    pcu_resize_buffer(&m->buffer, box[i].data.size());
+    if (box[i].data.size())
+      memcpy(m->buffer.start, &box[i].data[0], box[i].data.size());
+    clocks[simRank] = std::max(clocks[simRank], box[i].arrival);
+    box.erase(box.begin() + i);
+    return true;
+  }
+  return false;
+}
+
+enum Op { addDoubles, exscanLongs, maxInt, ops };
+static const char* const opNames[ops] =
+{"PCU_Add_Doubles", "PCU_Exscan_Longs", "PCU_Max_Int"};
+
+static double simulate(Op op)
+{
+  int n = layout.ranks;
+  clocks.assign(n, 0);
+  boxes.assign(n, std::deque<Letter>());
+  std::vector<pcu_coll> colls(n);
+  std::vector<double> doubles(n);
+  std::vector<long> longs(n);
+  std::vector<int> ints(n);
+  for (simRank = 0; simRank < n; ++simRank) {
+    pcu_coll* c = &colls[simRank];
+    pcu_make_message(&c->message);
+    if (op == addDoubles) {
+      doubles[simRank] = simRank;
+      pcu_begin_allreduce(c, pcu_add_doubles, &doubles[simRank],
+          sizeof(double));
+    } else if (op == exscanLongs) {
+      longs[simRank] = 1;
+      pcu_begin_scan(c, pcu_add_longs, &longs[simRank], sizeof(long));
+    } else {
+      ints[simRank] = simRank;
+      pcu_begin_allreduce(c, pcu_max_ints, &ints[simRank], sizeof(int));
+    }
+  }
+  std::vector<bool> done(n, false);
+  int left = n;
+  while (left)
+    for (simRank = 0; simRank < n; ++simRank)
+      if (!done[simRank] && !pcu_progress_coll(&colls[simRank])) {
+        done[simRank] = true;
+        --left;
+      }
+  for (int i = 0; i < n; ++i) {
+    if (op == addDoubles)
+      PCU_ALWAYS_ASSERT(doubles[i] == 0.5 * n * (n - 1.0));
+    else if (op == exscanLongs)
+      PCU_ALWAYS_ASSERT(longs[i] - 1 == i);
+    else
+      PCU_ALWAYS_ASSERT(ints[i] == n - 1);
+  }
+  return *std::max_element(clocks.begin(), clocks.end());
+}
+
+static void runSimulations(int nodeSize)
+{
+  pcu_mpi sim;
+  sim.size = simSize;
+  sim.rank = simRankFunc;
+  sim.node_size = simNodeSize;
+  sim.send = simSend;
+  sim.done = simDone;
+  sim.receive = simReceive;
+  pcu_mpi* real = pcu_get_mpi();
+  pcu_set_mpi(&sim);
+  layout.nodeSize = nodeSize;
+  layout.local = 0.5e-6;
+  layout.remote = 3e-6;
+  printf("simulated nodes of %d ranks, latency %g us within a node,"
+      " %g us between nodes\n", nodeSize,
+      layout.local * 1e6, layout.remote * 1e6);
+  const int sizes[] = {1000, 10000, 100000};
+  for (int i = 0; i < 3; ++i)
+    for (int op = 0; op < ops; ++op) {
+      layout.ranks = sizes[i];
+      layout.collNodeSize = 1;
+      double flat = simulate(Op(op));
+      layout.collNodeSize = nodeSize;
+      double nodes = simulate(Op(op));
+      printf("%6d ranks %-16s flat %6.2f us, two-level %6.2f us\n",
+          sizes[i], opNames[op], flat * 1e6, nodes * 1e6);
+    }
+  pcu_set_mpi(real);
+}
+
+static void timeCollectives(int calls)
+{
+  double p[4];
+  double t0 = PCU_Time();
+  for (int i = 0; i < calls; ++i) {
+    for (int j = 0; j < 4; ++j)
+      p[j] = j + 1;
+    PCU_Add_Doubles(p, 4);
+    for (int j = 0; j < 4; ++j)
+      PCU_ALWAYS_ASSERT(p[j] == (j + 1) * PCU_Comm_Peers());
+  }
+  double t1 = PCU_Time();
+  for (int i = 0; i < calls; ++i)
+    PCU_ALWAYS_ASSERT(PCU_Exscan_Long(1) == PCU_Comm_Self());
+  double t2 = PCU_Time();
+  for (int i = 0; i < calls; ++i)
+    PCU_ALWAYS_ASSERT(PCU_Max_Int(PCU_Comm_Self()) == PCU_Comm_Peers() - 1);
+  double t3 = PCU_Time();
+  double times[ops] = {t1 - t0, t2 - t1, t3 - t2};
+  PCU_Max_Doubles(times, ops);
+  if (!PCU_Comm_Self())
+    for (int op = 0; op < ops; ++op)
+      printf("%d ranks in nodes of %d: %s %.2f us\n",
+          PCU_Comm_Peers(), pcu_mpi_node_size(), opNames[op],
+          times[op] / calls * 1e6);
+}
+
+static int forcedNodeSize;
+
+static int forcedNodeSizeFunc()
+{
+  return forcedNodeSize;
+}
+
+/* times and checks the real collectives as if nodes held
+   nodeSize ranks, so both the flat and the two-level paths
+   run on a single machine */
+static void timeCollectivesIn(int nodeSize, int calls)
+{
+  pcu_mpi* real = pcu_get_mpi();
+  pcu_mpi forced = *real;
+  forced.node_size = forcedNodeSizeFunc;
+  forcedNodeSize = nodeSize;
+  pcu_set_mpi(&forced);
+  timeCollectives(calls);
+  pcu_set_mpi(real);
+}
+
+int main(int argc, char** argv)
+{
+  MPI_Init(&argc,&argv);
+  PCU_Comm_Init();
+  int nodeSize = 48;
+  if (argc > 1)
+    nodeSize = atoi(argv[1]);
+  PCU_ALWAYS_ASSERT(nodeSize > 0);
+  timeCollectivesIn(1, 1000);
+  timeCollectivesIn(2, 1000);
+  if (!PCU_Comm_Self())
+    runSimulations(nodeSize);
+  PCU_Comm_Free();
+  MPI_Finalize();
+}
@@ -0,0 +1,125 @@
+#include <PCU.h>
+#include <pcu_util.h>
+#include <cstdlib>
+
+/* a byte run-length codec, enough to tell whether PCU
+   compressed and restored messages without needing zlib */
+
+static size_t boundRuns(size_t size)
+{
+  return size * 2;
+}
+
+static size_t compressRuns(void* to, size_t toSize,
+    const void* from, size_t size)
+{
+  unsigned char* out = static_cast<unsigned char*>(to);
+  const unsigned char* in = static_cast<const unsigned char*>(from);
+  size_t n = 0;
+  for (size_t i = 0; i < size;) {
+    size_t run = 1;
+    while (i + run < size && run < 255 && in[i + run] == in[i])
+      ++run;
+    if (n + 2 > toSize)
+      return 0;
+    out[n++] = static_cast<unsigned char>(run);
+    out[n++] = in[i];
+    i += run;
+  }
+  return n;
+}
+
+static size_t decompressRuns(void* to, size_t toSize,
+    const void* from, size_t size)
+{
+  unsigned char* out = static_cast<unsigned char*>(to);
+  const unsigned char* in = static_cast<const unsigned char*>(from);
+  size_t n = 0;
+  for (size_t i = 0; i + 1 < size; i += 2)
+    for (int j = 0; j < in[i]; ++j) {
+      if (n == toSize)
+        return 0;
+      out[n++] = in[i + 1];
+    }
+  return n;
+}
+
+static const PCU_Codec runCodec =
+{ boundRuns, compressRuns, decompressRuns };
+
+/* the same bytes over and over if they should compress */
+static int getValue(int rank, int i, bool repeat)
+{
+  if (repeat)
+    return (rank % 128) * 0x01010101;
+  return rank + i * 7919;
+}
+
+/* each rank sends count ints to the next rank */
+static void sendRing(int count, bool repeat)
+{
+  int self = PCU_Comm_Self();
+  int peers = PCU_Comm_Peers();
+  int next = (self + 1) % peers;
+  int prev = (self + peers - 1) % peers;
+  PCU_Comm_Begin();
+  PCU_COMM_PACK(next, count);
+  for (int i = 0; i < count; ++i) {
+    int x = getValue(self, i, repeat);
+    PCU_COMM_PACK(next, x);
+  }
+  PCU_Comm_Send();
+  int received = 0;
+  while (PCU_Comm_Receive()) {
+    PCU_ALWAYS_ASSERT(PCU_Comm_Sender() == prev);
+    int n;
+    PCU_COMM_UNPACK(n);
+    PCU_ALWAYS_ASSERT(n == count);
+    PCU_ALWAYS_ASSERT(PCU_Comm_Remaining() == n * sizeof(int));
+    int* xs = PCU_COMM_EXTRACT(int, n);
+    for (int i = 0; i < n; ++i)
+      PCU_ALWAYS_ASSERT(xs[i] == getValue(prev, i, repeat));
+    ++received;
+  }
+  PCU_ALWAYS_ASSERT(received == 1);
+}
+
+static void sendRings()
+{
+  for (int count = 0; count < 5000; count = count * 3 + 1) {
+    sendRing(count, true);
+    sendRing(count, false);
+  }
+}
+
+static void* run(void*)
+{
+  PCU_Comm_Compress(&runCodec, 64);
+  sendRings();
+  PCU_Comm_Order(false);
+  sendRings();
+  PCU_Comm_Order(true);
+  int peers = PCU_Comm_Peers();
+  if (peers > 2) {
+    int self = PCU_Comm_Self();
+    int ranks[2] = {(self + 1) % peers, (self + peers - 1) % peers};
+    PCU_Comm_Neighbors(ranks, 2);
+    sendRings();
+    PCU_Comm_Clear_Neighbors();
+  }
+  PCU_Comm_Compress(NULL, 0);
+  sendRings();
+  return NULL;
+}
+
+int main(int argc, char** argv)
+{
+  int provided;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
+  PCU_Comm_Init();
+  run(NULL);
+  if (provided == MPI_THREAD_MULTIPLE)
+    PCU_Thrd_Run(2, run, NULL);
+  PCU_Comm_Free();
+  MPI_Finalize();
+}
@@ -0,0 +1,97 @@
+#include <PCU.h>
+#include <pcu_util.h>
+#include <cstdio>
+#include <cstdlib>
+
+/* ring neighbors: one or two of them depending on the number of ranks */
+static int getNeighbors(int* ranks)
+{
+  int self = PCU_Comm_Self();
+  int peers = PCU_Comm_Peers();
+  int n = 0;
+  if (peers > 1)
+    ranks[n++] = (self + 1) % peers;
+  if (peers > 2)
+    ranks[n++] = (self + peers - 1) % peers;
+  return n;
+}
+
+/* each rank sends its rank to its neighbors, except that
+   rank 0 sends nothing to test skipping of empty messages */
+static void exchange(int* ranks, int n, int size)
+{
+  int self = PCU_Comm_Self();
+  PCU_Comm_Begin();
+  if (self)
+    for (int i = 0; i < n; ++i)
+      for (int j = 0; j < size; ++j)
+        PCU_COMM_PACK(ranks[i], self);
+  PCU_Comm_Send();
+  int received = 0;
+  while (PCU_Comm_Receive()) {
+    int from = PCU_Comm_Sender();
+    PCU_ALWAYS_ASSERT(from != 0);
+    int x;
+    PCU_COMM_UNPACK(x);
+    PCU_ALWAYS_ASSERT(x == from);
+    size_t bytes;
+    PCU_Comm_Received(&bytes);
+    PCU_ALWAYS_ASSERT(bytes == size * sizeof(int));
+    PCU_Comm_Extract(bytes - sizeof(int));
+    ++received;
+  }
+  int expected = n;
+  for (int i = 0; i < n; ++i)
+    if (ranks[i] == 0)
+      --expected;
+  PCU_ALWAYS_ASSERT(received == expected);
+}
+
+static double timePhases(int* ranks, int n, int phases)
+{
+  PCU_Barrier();
+  double t0 = PCU_Time();
+  for (int i = 0; i < phases; ++i)
+    exchange(ranks, n, 8);
+  return PCU_Max_Double(PCU_Time() - t0);
+}
+
+static void* run(void* in)
+{
+  int phases = *static_cast<int*>(in);
+  int ranks[2];
+  int n = getNeighbors(ranks);
+  double global = timePhases(ranks, n, phases);
+  PCU_Comm_Neighbors(ranks, n);
+  double fixed = timePhases(ranks, n, phases);
+  /* alternate the two kinds of phases */
+  for (int i = 0; i < 4; ++i) {
+    PCU_Comm_Clear_Neighbors();
+    exchange(ranks, n, 1000);
+    PCU_Comm_Neighbors(ranks, n);
+    exchange(ranks, n, 1000);
+    exchange(ranks, n, 1);
+  }
+  PCU_Comm_Clear_Neighbors();
+  if (!PCU_Comm_Self())
+    printf("%d ranks, %d phases: global %f seconds, neighbors %f seconds\n",
+        PCU_Comm_Peers(), phases, global, fixed);
+  return NULL;
+}
+
+int main(int argc, char** argv)
+{
+  int provided;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
+  PCU_Comm_Init();
+  int phases = 100;
+  if (argc > 1)
+    phases = atoi(argv[1]);
+  run(&phases);
+  if (provided == MPI_THREAD_MULTIPLE) {
+    void* args[3] = {&phases, &phases, &phases};
+    PCU_Thrd_Run(3, run, args);
+  }
+  PCU_Comm_Free();
+  MPI_Finalize();
+}
@@ -0,0 +1,69 @@
+#include <PCU.h>
+#include <pcu_util.h>
+#include <cstdio>
+#include <cstdlib>
+
+/* packs n small messages to each of k neighbors, interleaving
+   neighbors so consecutive packs go to different peers,
+   and reports the pack throughput of the slowest rank */
+
+struct Item
+{
+  int from;
+  int i;
+  double x;
+};
+
+static double packPhase(int n, int k)
+{
+  int self = PCU_Comm_Self();
+  int peers = PCU_Comm_Peers();
+  PCU_Comm_Begin();
+  double t0 = PCU_Time();
+  for (int i = 0; i < n; ++i)
+    for (int j = 1; j <= k; ++j) {
+      Item item;
+      item.from = self;
+      item.i = i;
+      item.x = i * 0.5;
+      PCU_COMM_PACK((self + j) % peers, item);
+    }
+  double t1 = PCU_Time();
+  PCU_Comm_Send();
+  long received = 0;
+  while (PCU_Comm_Receive()) {
+    Item item;
+    PCU_COMM_UNPACK(item);
+    PCU_ALWAYS_ASSERT(item.from == PCU_Comm_Sender());
+    ++received;
+  }
+  PCU_ALWAYS_ASSERT(received == (long)n * k);
+  return t1 - t0;
+}
+
+int main(int argc, char** argv)
+{
+  MPI_Init(&argc,&argv);
+  PCU_Comm_Init();
+  if (argc < 3 || argc > 5) {
+    if (!PCU_Comm_Self())
+      printf("Usage: %s <messages per neighbor> <neighbors> [phases]"
+             " [profile prefix]\n", argv[0]);
+    MPI_Finalize();
+    exit(EXIT_FAILURE);
+  }
+  int n = atoi(argv[1]);
+  int k = atoi(argv[2]);
+  int phases = argc >= 4 ? atoi(argv[3]) : 5;
+  if (argc == 5)
+    PCU_Comm_Profile(argv[4]);
+  PCU_ALWAYS_ASSERT(k < PCU_Comm_Peers());
+  for (int p = 0; p < phases; ++p) {
+    double t = PCU_Max_Double(packPhase(n, k));
+    if (!PCU_Comm_Self())
+      printf("packed %d x %d messages in %f seconds, %.3g packs/s\n",
+          n, k, t, t > 0 ? n * (double)k / t : 0);
+  }
+  PCU_Comm_Free();
+  MPI_Finalize();
+}
@@ -0,0 +1,137 @@
+#include <PCU.h>
+#include <pcu_util.h>
+extern "C" {
+#include <pcu_buffer.h>
+}
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+/* checks the buffer pool behind PCU messengers: the size classes
+   and cap of the pool itself, then phases of growing and shrinking
+   messages, with and without threads, which should reuse the
+   buffers of earlier phases once every size has been seen */
+
+static void checkPool()
+{
+  pcu_pool p;
+  pcu_make_pool(&p);
+  pcu_buffer b;
+  pcu_pool_take(&p, &b, 1000);
+  PCU_ALWAYS_ASSERT(b.capacity == 1000 && p.allocations == 1);
+  pcu_pool_give(&p, &b);
+  PCU_ALWAYS_ASSERT(!b.start && p.bytes == 1000);
+  /* a pooled buffer of the same class is used if it is big enough */
+  pcu_pool_take(&p, &b, 600);
+  PCU_ALWAYS_ASSERT(b.capacity == 1000 && p.reused == 1);
+  pcu_pool_give(&p, &b);
+  pcu_pool_take(&p, &b, 1020);
+  PCU_ALWAYS_ASSERT(b.capacity == 1020 && p.allocations == 2);
+  pcu_pool_give(&p, &b);
+  pcu_pool_take(&p, &b, 1010);
+  PCU_ALWAYS_ASSERT(b.capacity == 1020 && p.reused == 2);
+  pcu_buffer c;
+  pcu_pool_take(&p, &c, 1010);
+  PCU_ALWAYS_ASSERT(c.capacity == 1010 && p.allocations == 3);
+  pcu_pool_give(&p, &b);
+  pcu_pool_give(&p, &c);
+  /* otherwise any buffer of a larger class will do */
+  pcu_pool_take(&p, &b, 500);
+  PCU_ALWAYS_ASSERT(b.capacity >= 1000 && p.reused == 3);
+  pcu_pool_give(&p, &b);
+  /* the pool keeps at most 256MB, the rest goes back to the system */
+  size_t bytes = p.bytes;
+  pcu_pool_take(&p, &b, (size_t)1 << 28);
+  pcu_pool_give(&p, &b);
+  PCU_ALWAYS_ASSERT(!b.start && p.bytes == bytes);
+  /* growing a buffer into pooled memory keeps its contents */
+  pcu_make_buffer(&b);
+  for (int i = 0; i < 10000; ++i)
+    *(int*)pcu_push_pooled(&p, &b, sizeof(int)) = i;
+  for (int i = 0; i < 10000; ++i)
+    PCU_ALWAYS_ASSERT(((int*)b.start)[i] == i);
+  pcu_pool_give(&p, &b);
+  pcu_free_pool(&p);
+  PCU_ALWAYS_ASSERT(p.bytes == 0);
+}
+
+/* every rank sends n ints to every rank */
+static void sendAll(int n)
+{
+  int self = PCU_Comm_Self();
+  int peers = PCU_Comm_Peers();
+  std::vector<int> out(n);
+  PCU_Comm_Begin();
+  for (int to = 0; to < peers; ++to) {
+    for (int i = 0; i < n; ++i)
+      out[i] = self * to + i;
+    PCU_Comm_Pack(to, &out[0], n * sizeof(int));
+  }
+  PCU_Comm_Send();
+  int received = 0;
+  while (PCU_Comm_Receive()) {
+    int from = PCU_Comm_Sender();
+    PCU_ALWAYS_ASSERT(PCU_Comm_Remaining() == n * sizeof(int));
+    int* in = PCU_COMM_EXTRACT(int, n);
+    for (int i = 0; i < n; ++i)
+      PCU_ALWAYS_ASSERT(in[i] == from * self + i);
+    ++received;
+  }
+  PCU_ALWAYS_ASSERT(received == peers);
+}
+
+/* sizes go up and back down, and are not powers of two */
+static void sendGrowingAndShrinking()
+{
+  for (int n = 3; n < 100000; n = n * 5 + 1)
+    sendAll(n);
+  for (int n = 100000; n > 2; n /= 7)
+    sendAll(n);
+}
+
+/* after two warm-up passes the pool holds a buffer for every
+   size, so later passes should not need new ones */
+static void checkReuse()
+{
+  for (int i = 0; i < 2; ++i)
+    sendGrowingAndShrinking();
+  size_t reused, allocations;
+  PCU_Comm_Pool(&reused, &allocations, 0);
+  for (int i = 0; i < 3; ++i)
+    sendGrowingAndShrinking();
+  size_t reusedAfter, allocationsAfter, pooled;
+  PCU_Comm_Pool(&reusedAfter, &allocationsAfter, &pooled);
+  PCU_ALWAYS_ASSERT(reusedAfter > reused);
+  /* threads in a process hand each other their buffers, so buffers
+     move between the pools of threads and a few get allocated */
+  if (PCU_Thrd_Peers() > 1)
+    PCU_ALWAYS_ASSERT(allocationsAfter - allocations <
+        (reusedAfter - reused) / 4);
+  else
+    PCU_ALWAYS_ASSERT(allocationsAfter == allocations);
+  PCU_ALWAYS_ASSERT(pooled > 0);
+}
+
+static void* run(void*)
+{
+  checkReuse();
+  PCU_Comm_Order(true);
+  checkReuse();
+  PCU_Comm_Order(false);
+  return NULL;
+}
+
+int main(int argc, char** argv)
+{
+  int provided;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
+  PCU_Comm_Init();
+  checkPool();
+  run(NULL);
+  int nthreads = 4;
+  if (argc > 1)
+    nthreads = atoi(argv[1]);
+  PCU_Thrd_Run(nthreads, run, NULL);
+  PCU_Comm_Free();
+  MPI_Finalize();
+}
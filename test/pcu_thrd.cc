@@ -0,0 +1,95 @@
+#include <PCU.h>
+#include <pcu_util.h>
+#include <cstdlib>
+
+static void sendRing()
+{
+  int self = PCU_Comm_Self();
+  int peers = PCU_Comm_Peers();
+  int next = (self + 1) % peers;
+  int prev = (self + peers - 1) % peers;
+  PCU_Comm_Begin();
+  PCU_COMM_PACK(next, self);
+  PCU_Comm_Send();
+  int received = 0;
+  while (PCU_Comm_Receive()) {
+    int from;
+    PCU_COMM_UNPACK(from);
+    PCU_ALWAYS_ASSERT(from == prev);
+    PCU_ALWAYS_ASSERT(PCU_Comm_Sender() == prev);
+    ++received;
+  }
+  PCU_ALWAYS_ASSERT(received == 1);
+}
+
+static void sendAll()
+{
+  int self = PCU_Comm_Self();
+  int peers = PCU_Comm_Peers();
+  PCU_Comm_Begin();
+  for (int to = 0; to < peers; ++to)
+    for (int i = 0; i <= to; ++i)
+      PCU_COMM_PACK(to, self);
+  PCU_Comm_Send();
+  int received = 0;
+  while (PCU_Comm_Listen()) {
+    int from = PCU_Comm_Sender();
+    PCU_ALWAYS_ASSERT(PCU_Comm_Remaining() == (self + 1) * sizeof(int));
+    int x;
+    PCU_COMM_UNPACK(x);
+    PCU_ALWAYS_ASSERT(x == from);
+    int* xs = PCU_COMM_EXTRACT(int, self);
+    for (int i = 0; i < self; ++i)
+      PCU_ALWAYS_ASSERT(xs[i] == from);
+    PCU_ALWAYS_ASSERT(PCU_Comm_Remaining() == 0);
+    PCU_ALWAYS_ASSERT(PCU_Comm_Unpacked());
+    ++received;
+  }
+  PCU_ALWAYS_ASSERT(received == peers);
+}
+
+static void checkCollectives()
+{
+  int self = PCU_Comm_Self();
+  int peers = PCU_Comm_Peers();
+  PCU_ALWAYS_ASSERT(PCU_Add_Int(1) == peers);
+  PCU_ALWAYS_ASSERT(PCU_Max_Int(self) == peers - 1);
+  PCU_ALWAYS_ASSERT(PCU_Min_Int(self) == 0);
+  PCU_ALWAYS_ASSERT(PCU_Exscan_Int(1) == self);
+  PCU_ALWAYS_ASSERT(PCU_Exscan_Long(2) == 2L * self);
+  PCU_ALWAYS_ASSERT(PCU_Add_Double(0.5) == 0.5 * peers);
+  PCU_Barrier();
+}
+
+static void* run(void*)
+{
+  PCU_ALWAYS_ASSERT(PCU_Comm_Peers() ==
+      PCU_Proc_Peers() * PCU_Thrd_Peers());
+  PCU_ALWAYS_ASSERT(PCU_Comm_Self() ==
+      PCU_Proc_Self() * PCU_Thrd_Peers() + PCU_Thrd_Self());
+  checkCollectives();
+  for (int i = 0; i < 10; ++i) {
+    sendRing();
+    sendAll();
+  }
+  PCU_Comm_Order(false);
+  for (int i = 0; i < 10; ++i)
+    sendAll();
+  return NULL;
+}
+
+int main(int argc, char** argv)
+{
+  int provided;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
+  PCU_Comm_Init();
+  int nthreads = 4;
+  if (argc > 1)
+    nthreads = atoi(argv[1]);
+  PCU_Thrd_Run(nthreads, run, NULL);
+  PCU_ALWAYS_ASSERT(PCU_Comm_Peers() == PCU_Proc_Peers());
+  PCU_ALWAYS_ASSERT(PCU_Thrd_Peers() == 1);
+  checkCollectives();
+  PCU_Comm_Free();
+  MPI_Finalize();
+}
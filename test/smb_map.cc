@@ -0,0 +1,135 @@
+#include <gmi_mesh.h>
+#include <apfMDS.h>
+#include <apfBox.h>
+#include <apfMesh2.h>
+#include <apf.h>
+#include <apfGeometry.h>
+#include <PCU.h>
+#include <pcu_util.h>
+#include <cstdio>
+
+/* writes a box mesh as a mapped smb file, loads it back,
+   and changes the loaded mesh, which should leave the file alone */
+
+static double getValue(apf::Vector3 const& x)
+{
+  return x[0] + 10 * x[1] + 100 * x[2];
+}
+
+static void tagMesh(apf::Mesh2* m)
+{
+  apf::Field* f = apf::createFieldOn(m, "f", apf::SCALAR);
+  apf::MeshTag* t = m->createIntTag("t", 1);
+  apf::MeshIterator* it = m->begin(0);
+  apf::MeshEntity* v;
+  while ((v = m->iterate(it))) {
+    apf::Vector3 x;
+    m->getPoint(v, 0, x);
+    apf::setScalar(f, v, 0, getValue(x));
+  }
+  m->end(it);
+  it = m->begin(m->getDimension());
+  int i = 0;
+  while ((v = m->iterate(it)))
+    if (i++ % 3 == 0)
+      m->setIntTag(v, t, &i);
+  m->end(it);
+}
+
+/* the two meshes should be the same, entity by entity */
+static void compare(apf::Mesh2* a, apf::Mesh2* b)
+{
+  PCU_ALWAYS_ASSERT(a->getDimension() == b->getDimension());
+  for (int d = 0; d <= a->getDimension(); ++d)
+    PCU_ALWAYS_ASSERT(apf::countOwned(a, d) == apf::countOwned(b, d));
+  apf::Field* fa = a->findField("f");
+  apf::Field* fb = b->findField("f");
+  PCU_ALWAYS_ASSERT(fa && fb);
+  apf::MeshIterator* ia = a->begin(0);
+  apf::MeshIterator* ib = b->begin(0);
+  apf::MeshEntity* va;
+  while ((va = a->iterate(ia))) {
+    apf::MeshEntity* vb = b->iterate(ib);
+    apf::Vector3 xa, xb;
+    a->getPoint(va, 0, xa);
+    b->getPoint(vb, 0, xb);
+    PCU_ALWAYS_ASSERT(apf::areClose(xa, xb, 0.0));
+    PCU_ALWAYS_ASSERT(apf::getScalar(fb, vb, 0) == getValue(xb));
+  }
+  a->end(ia);
+  b->end(ib);
+  apf::MeshTag* ta = a->findTag("t");
+  apf::MeshTag* tb = b->findTag("t");
+  PCU_ALWAYS_ASSERT(ta && tb);
+  int d = a->getDimension();
+  ia = a->begin(d);
+  ib = b->begin(d);
+  while ((va = a->iterate(ia))) {
+    apf::MeshEntity* vb = b->iterate(ib);
+    PCU_ALWAYS_ASSERT(a->hasTag(va, ta) == b->hasTag(vb, tb));
+    if (a->hasTag(va, ta)) {
+      int x, y;
+      a->getIntTag(va, ta, &x);
+      b->getIntTag(vb, tb, &y);
+      PCU_ALWAYS_ASSERT(x == y);
+    }
+  }
+  a->end(ia);
+  b->end(ib);
+}
+
+/* moves a vertex, which writes to a mapped page, and adds a
+   tetrahedron, which moves the mapped arrays to the heap */
+static void change(apf::Mesh2* m)
+{
+  apf::MeshIterator* it = m->begin(0);
+  apf::MeshEntity* v = m->iterate(it);
+  m->end(it);
+  m->setPoint(v, 0, apf::Vector3(-1, -1, -1));
+  it = m->begin(3);
+  apf::ModelEntity* c = m->toModel(m->iterate(it));
+  m->end(it);
+  size_t nv = m->count(0);
+  size_t nr = m->count(3);
+  apf::MeshEntity* vs[4];
+  for (int i = 0; i < 4; ++i) {
+    apf::Vector3 x(2, 2, 2);
+    if (i)
+      x[i - 1] += 1;
+    vs[i] = m->createVert(c);
+    m->setPoint(vs[i], 0, x);
+  }
+  apf::buildElement(m, c, apf::Mesh::TET, vs);
+  m->acceptChanges();
+  PCU_ALWAYS_ASSERT(m->count(0) == nv + 4);
+  PCU_ALWAYS_ASSERT(m->count(3) == nr + 1);
+  apf::Vector3 x;
+  m->getPoint(v, 0, x);
+  PCU_ALWAYS_ASSERT(apf::areClose(x, apf::Vector3(-1, -1, -1), 0.0));
+}
+
+int main(int argc, char** argv)
+{
+  MPI_Init(&argc,&argv);
+  PCU_Comm_Init();
+  PCU_ALWAYS_ASSERT(PCU_Comm_Peers() == 1);
+  gmi_register_mesh();
+  apf::Mesh2* m = apf::makeMdsBox(4, 4, 4, 1, 1, 1, true);
+  gmi_model* g = m->getModel();
+  tagMesh(m);
+  m->writeNative("map:smb_map.smb");
+  for (int i = 0; i < 2; ++i) {
+    apf::Mesh2* m2 = apf::loadMdsMesh(g, "smb_map.smb");
+    m2->verify();
+    compare(m, m2);
+    change(m2);
+    apf::disownMdsModel(m2);
+    m2->destroyNative();
+    apf::destroyMesh(m2);
+  }
+  m->destroyNative();
+  apf::destroyMesh(m);
+  remove("smb_map0.smb");
+  PCU_Comm_Free();
+  MPI_Finalize();
+}
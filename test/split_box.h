@@ -0,0 +1,35 @@
+#ifndef SPLIT_BOX_H
+#define SPLIT_BOX_H
+
+#include <apfMDS.h>
+#include <apfBox.h>
+#include <apfMesh2.h>
+#include <apf.h>
+#include <PCU.h>
+
+/* an n by n by n box of tets over the unit cube, built on rank 0 and
+   split by the planes x = 0.5 and y = 0.5 into four quarters, quarter
+   q going to rank q modulo the number of ranks. With two or more
+   ranks the parts share faces, and with four they also share edges
+   that have more than two copies. */
+inline apf::Mesh2* makeSplitBox(int n)
+{
+  apf::Mesh2* m = apf::makeMdsBox(n, n, n, 1, 1, 1, true);
+  if (PCU_Comm_Self())
+    apf::clear(m);
+  apf::Migration* plan = new apf::Migration(m);
+  if (!PCU_Comm_Self()) {
+    apf::MeshIterator* it = m->begin(3);
+    apf::MeshEntity* e;
+    while ((e = m->iterate(it))) {
+      apf::Vector3 x = apf::getLinearCentroid(m, e);
+      int to = (x[0] > 0.5) + 2 * (x[1] > 0.5);
+      plan->send(e, to % PCU_Comm_Peers());
+    }
+    m->end(it);
+  }
+  m->migrate(plan);
+  return m;
+}
+
+#endif
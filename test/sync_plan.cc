@@ -0,0 +1,193 @@
+#include <gmi_mesh.h>
+#include <apfMDS.h>
+#include <apfBox.h>
+#include <apfMesh2.h>
+#include <apfShape.h>
+#include <apf.h>
+#include <PCU.h>
+#include <pcu_util.h>
+#include <cstdio>
+#include <cstdlib>
+#include "split_box.h"
+
+/* synchronizing and accumulating with a plan, or with a batch of
+   fields, should give the same values as without, also after the
+   mesh changes */
+
+/* owners get a function of position, copies get junk */
+static void fill(apf::Field* f, bool owned)
+{
+  apf::Mesh* m = apf::getMesh(f);
+  for (int d = 0; d <= 1; ++d) {
+    apf::MeshIterator* it = m->begin(d);
+    apf::MeshEntity* e;
+    while ((e = m->iterate(it))) {
+      apf::Vector3 x = apf::getLinearCentroid(m, e);
+      apf::Vector3 v(x[0], x[1] * x[2], 1);
+      if (owned && !m->isOwned(e))
+        v = apf::Vector3(-1, -1, -1);
+      if (!owned)
+        v = apf::Vector3(1, 2, 3);
+      if (apf::getShape(f)->countNodesOn(m->getType(e)))
+        apf::setVector(f, e, 0, v);
+    }
+    m->end(it);
+  }
+}
+
+static void checkSame(apf::Field* a, apf::Field* b)
+{
+  apf::Mesh* m = apf::getMesh(a);
+  for (int d = 0; d <= 1; ++d) {
+    apf::MeshIterator* it = m->begin(d);
+    apf::MeshEntity* e;
+    while ((e = m->iterate(it))) {
+      if (!apf::getShape(a)->countNodesOn(m->getType(e)))
+        continue;
+      apf::Vector3 va, vb;
+      apf::getVector(a, e, 0, va);
+      apf::getVector(b, e, 0, vb);
+      PCU_ALWAYS_ASSERT((va - vb).getLength() < 1e-12);
+      PCU_ALWAYS_ASSERT(va[0] != -1);
+    }
+    m->end(it);
+  }
+}
+
+static void check(apf::Mesh2* m, apf::SyncPlan* plans[2])
+{
+  for (int order = 1; order <= 2; ++order) {
+    apf::FieldShape* s = apf::getLagrange(order);
+    apf::Field* a = apf::createField(m, "a", apf::VECTOR, s);
+    apf::Field* b = apf::createField(m, "b", apf::VECTOR, s);
+    fill(a, true);
+    fill(b, true);
+    apf::synchronize(a);
+    apf::synchronize(b, plans[order - 1]);
+    checkSame(a, b);
+    fill(a, false);
+    fill(b, false);
+    apf::accumulate(a);
+    apf::accumulate(b, plans[order - 1]);
+    checkSame(a, b);
+    apf::destroyField(a);
+    apf::destroyField(b);
+  }
+}
+
+/* fields of mixed shapes synchronized as a batch, overlapping
+   the messages with a loop over the elements */
+static void checkBatch(apf::Mesh2* m)
+{
+  apf::Field* a[3];
+  apf::Field* b[3];
+  for (int i = 0; i < 3; ++i) {
+    apf::FieldShape* s = apf::getLagrange(i == 1 ? 2 : 1);
+    char name[8];
+    sprintf(name, "a%d", i);
+    a[i] = apf::createField(m, name, apf::VECTOR, s);
+    sprintf(name, "b%d", i);
+    b[i] = apf::createField(m, name, apf::VECTOR, s);
+  }
+  apf::SyncBatch* batch = apf::createSyncBatch(b, 3);
+  for (int i = 0; i < 3; ++i) {
+    fill(a[i], true);
+    fill(b[i], true);
+    apf::synchronize(a[i]);
+  }
+  apf::beginSynchronize(batch);
+  double volume = 0;
+  apf::MeshIterator* it = m->begin(3);
+  apf::MeshEntity* e;
+  while ((e = m->iterate(it)))
+    volume += apf::measure(m, e);
+  m->end(it);
+  apf::endSynchronize(batch);
+  PCU_ALWAYS_ASSERT(volume > 0 || !m->count(3));
+  for (int i = 0; i < 3; ++i) {
+    checkSame(a[i], b[i]);
+    fill(a[i], false);
+    fill(b[i], false);
+    apf::accumulate(a[i]);
+  }
+  apf::accumulate(batch);
+  for (int i = 0; i < 3; ++i)
+    checkSame(a[i], b[i]);
+  apf::destroySyncBatch(batch);
+  for (int i = 0; i < 3; ++i) {
+    apf::destroyField(a[i]);
+    apf::destroyField(b[i]);
+  }
+}
+
+static double timeSyncs(apf::Field* f, apf::SyncPlan* plan)
+{
+  double t0 = PCU_Time();
+  for (int i = 0; i < 20; ++i) {
+    if (plan)
+      apf::synchronize(f, plan);
+    else
+      apf::synchronize(f);
+  }
+  return PCU_Time() - t0;
+}
+
+int main(int argc, char** argv)
+{
+  MPI_Init(&argc,&argv);
+  PCU_Comm_Init();
+  gmi_register_mesh();
+  int n = 8;
+  if (argc > 1)
+    n = atoi(argv[1]);
+  apf::Mesh2* m = makeSplitBox(n);
+  apf::SyncPlan* plans[2];
+  plans[0] = apf::createSyncPlan(m, apf::getLagrange(1));
+  plans[1] = apf::createSyncPlan(m, apf::getLagrange(2));
+  check(m, plans);
+  apf::Field* f = apf::createField(m, "f", apf::VECTOR, apf::getLagrange(2));
+  fill(f, true);
+  double without = timeSyncs(f, 0);
+  double with = timeSyncs(f, plans[1]);
+  apf::destroyField(f);
+  if (!PCU_Comm_Self())
+    printf("20 syncs: %f s without a plan, %f s with one\n", without, with);
+  checkBatch(m);
+  apf::Field* fs[10];
+  for (int i = 0; i < 10; ++i) {
+    char name[8];
+    sprintf(name, "f%d", i);
+    fs[i] = apf::createField(m, name, apf::SCALAR, apf::getLagrange(1));
+  }
+  apf::SyncBatch* batch = apf::createSyncBatch(fs, 10);
+  double t0 = PCU_Time();
+  for (int i = 0; i < 10; ++i)
+    apf::synchronize(fs[i], plans[0]);
+  double t1 = PCU_Time();
+  apf::synchronize(batch);
+  double t2 = PCU_Time();
+  apf::destroySyncBatch(batch);
+  for (int i = 0; i < 10; ++i)
+    apf::destroyField(fs[i]);
+  if (!PCU_Comm_Self())
+    printf("10 fields: %f s one by one, %f s as a batch\n", t1 - t0, t2 - t1);
+  /* the plans have to notice this on their own */
+  apf::Migration* plan = new apf::Migration(m);
+  if (PCU_Comm_Self() == 1) {
+    apf::MeshIterator* it = m->begin(3);
+    apf::MeshEntity* e;
+    for (int i = 0; (e = m->iterate(it)); ++i)
+      if (i % 2)
+        plan->send(e, 0);
+    m->end(it);
+  }
+  m->migrate(plan);
+  check(m, plans);
+  checkBatch(m);
+  apf::destroySyncPlan(plans[0]);
+  apf::destroySyncPlan(plans[1]);
+  m->destroyNative();
+  apf::destroyMesh(m);
+  PCU_Comm_Free();
+  MPI_Finalize();
+}
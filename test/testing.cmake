@@ -21,6 +21,32 @@ mpi_test(eigen_test 1 ./eigen_test)
 mpi_test(integrate 1 ./integrate)
 mpi_test(qr_test 1 ./qr)
 mpi_test(base64 1 ./base64)
+mpi_test(smb_map 1 ./smb_map)
+mpi_test(mds_freeze 1 ./mds_freeze)
+mpi_test(mds_batch 1 ./mds_batch)
+mpi_test(mds_threads 1 ./mds_threads 4)
+mpi_test(mds_compact 2 ./mds_compact)
+mpi_test(mds_footprint 1 ./mds_footprint 10)
+mpi_test(mds_sfc 1 ./mds_sfc 10)
+mpi_test(mds_dense 2 ./mds_dense 10)
+mpi_test(mds_copies 4 ./mds_copies 8)
+mpi_test(sync_plan 4 ./sync_plan 8)
+mpi_test(ma_size_cache 1 ./ma_size_cache 10)
+mpi_test(ma_quality_batch 1 ./ma_quality_batch 10)
+mpi_test(ma_incremental 2 ./ma_incremental 12)
+mpi_test(ma_profile 2 ./ma_profile 8)
+mpi_test(ma_threads 2 ./ma_threads 12)
+mpi_test(pcu_thrd 2 ./pcu_thrd 4)
+mpi_test(pcu_pool 2 ./pcu_pool 4)
+mpi_test(pcu_pack 4 ./pcu_pack 1000 3)
+mpi_test(pcu_profile 4 ./pcu_pack 100 3 2 pcu_pack_profile)
+mpi_test(pcu_neighbors 4 ./pcu_neighbors)
+mpi_test(pcu_compress 4 ./pcu_compress)
+mpi_test(pcu_coll 4 ./pcu_coll)
+mpi_test(pcu_aggregate 4 ./pcu_aggregate)
+if(PCU_COMPRESS)
+  mpi_test(pcu_blocks 2 ./pcu_blocks)
+endif()
 mpi_test(tensor_test 1 ./tensor)
 
 